@@ -0,0 +1,223 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+// chunk头，之后紧跟数据区（头部补齐到16字节，保证块的对齐）
+struct ArenaChunk {
+    ArenaChunk *next;
+    size_t size; // 数据区字节数
+};
+
+#define CHUNK_HEADER_SIZE ((sizeof(ArenaChunk) + 15) & ~(size_t)15)
+
+// size所在的级别
+static int size_class(size_t size) {
+    int cls = 0;
+    size_t block = ARENA_MIN_SIZE;
+    while (block < size && cls < ARENA_NUM_CLASSES - 1) {
+        block <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+static size_t class_size(int cls) {
+    return (size_t)ARENA_MIN_SIZE << cls;
+}
+
+static void push_free(Arena *arena, int cls, void *ptr) {
+    *(void**)ptr = arena->free_lists[cls];
+    arena->free_lists[cls] = ptr;
+}
+
+// 当前chunk尚未切分的尾部按从大到小的级别切成空闲块，换chunk时不浪费
+static void retire_tail(Arena *arena) {
+    while (arena->cursor && arena->limit - arena->cursor >= ARENA_MIN_SIZE) {
+        size_t remaining = (size_t)(arena->limit - arena->cursor);
+        int cls = size_class(remaining);
+        if (class_size(cls) > remaining) cls--;
+        push_free(arena, cls, arena->cursor);
+        arena->cursor += class_size(cls);
+    }
+    arena->cursor = NULL;
+    arena->limit = NULL;
+}
+
+// 取一个数据区不小于size的chunk：优先复用保留的chunk中最小的一个，没有时向系统申请。*actual为数据区大小
+static unsigned char* new_chunk(Arena *arena, size_t size, size_t *actual) {
+    ArenaChunk **best = NULL;
+    for (ArenaChunk **link = &arena->spare; *link; link = &(*link)->next) {
+        if ((*link)->size >= size && (!best || (*link)->size < (*best)->size)) best = link;
+    }
+    ArenaChunk *chunk;
+    if (best) {
+        chunk = *best;
+        *best = chunk->next;
+    } else {
+        chunk = (ArenaChunk*)malloc(CHUNK_HEADER_SIZE + size);
+        if (!chunk) return NULL;
+        chunk->size = size;
+        arena->reserved += size;
+        arena->num_chunks++;
+    }
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    *actual = chunk->size;
+    return (unsigned char*)chunk + CHUNK_HEADER_SIZE;
+}
+
+static void free_chunks(ArenaChunk *chunk) {
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+Arena* arena_create(void) {
+    return (Arena*)calloc(1, sizeof(Arena));
+}
+
+void arena_destroy(Arena *arena) {
+    if (!arena) return;
+    free_chunks(arena->chunks);
+    free_chunks(arena->spare);
+    free(arena);
+}
+
+void* arena_alloc(Arena *arena, size_t size) {
+    if (!arena) return malloc(size);
+    int cls = size_class(size);
+    size_t block = class_size(cls);
+    if (block < size) return NULL;
+
+    void *ptr = arena->free_lists[cls];
+    if (ptr) {
+        arena->free_lists[cls] = *(void**)ptr;
+    } else if (block > ARENA_CHUNK_SIZE / 4) {
+        size_t actual;
+        ptr = new_chunk(arena, block, &actual);
+        if (!ptr) return NULL;
+    } else {
+        if (!arena->cursor || (size_t)(arena->limit - arena->cursor) < block) {
+            retire_tail(arena);
+            size_t actual;
+            unsigned char *data = new_chunk(arena, ARENA_CHUNK_SIZE, &actual);
+            if (!data) return NULL;
+            arena->cursor = data;
+            arena->limit = data + actual;
+        }
+        ptr = arena->cursor;
+        arena->cursor += block;
+    }
+    arena->used += block;
+    return ptr;
+}
+
+void arena_release(Arena *arena, void *ptr, size_t size) {
+    if (!arena) {
+        free(ptr);
+        return;
+    }
+    if (!ptr) return;
+    int cls = size_class(size);
+    push_free(arena, cls, ptr);
+    arena->used -= class_size(cls);
+}
+
+void* arena_grow(Arena *arena, void *ptr, size_t old_size, size_t size) {
+    if (!arena) return realloc(ptr, size);
+    if (!ptr) return arena_alloc(arena, size);
+    if (size_class(size) == size_class(old_size)) return ptr;
+    void *grown = arena_alloc(arena, size);
+    if (!grown) return NULL;
+    memcpy(grown, ptr, old_size < size ? old_size : size);
+    arena_release(arena, ptr, old_size);
+    return grown;
+}
+
+// 把链表src接到*dst前面
+static void splice_chunks(ArenaChunk **dst, ArenaChunk *src) {
+    if (!src) return;
+    ArenaChunk *tail = src;
+    while (tail->next) tail = tail->next;
+    tail->next = *dst;
+    *dst = src;
+}
+
+void arena_reset(Arena *arena) {
+    if (!arena) return;
+    splice_chunks(&arena->spare, arena->chunks);
+    arena->chunks = NULL;
+    arena->cursor = NULL;
+    arena->limit = NULL;
+    memset(arena->free_lists, 0, sizeof(arena->free_lists));
+    arena->used = 0;
+}
+
+void arena_adopt(Arena *dst, Arena *src) {
+    if (!dst || !src || dst == src) return;
+    retire_tail(src);
+    splice_chunks(&dst->chunks, src->chunks);
+    splice_chunks(&dst->spare, src->spare);
+    // src的空闲块接到dst同级链表的前面
+    for (int cls = 0; cls < ARENA_NUM_CLASSES; cls++) {
+        void *head = src->free_lists[cls];
+        if (!head) continue;
+        void *tail = head;
+        while (*(void**)tail) tail = *(void**)tail;
+        *(void**)tail = dst->free_lists[cls];
+        dst->free_lists[cls] = head;
+    }
+    dst->reserved += src->reserved;
+    dst->used += src->used;
+    dst->num_chunks += src->num_chunks;
+    memset(src, 0, sizeof(Arena));
+}
+
+// 先对每段ARENA_SORT_RUN个元素做插入排序，再两两归并，在base与缓冲区之间来回复制
+#define ARENA_SORT_RUN 16
+
+void arena_sort(Arena *arena, void *base, size_t count, size_t size, int (*compare)(const void*, const void*)) {
+    if (count < 2 || size == 0) return;
+    unsigned char *buffer = arena ? (unsigned char*)arena_alloc(arena, count * size) : NULL;
+    if (!buffer) {
+        qsort(base, count, size, compare);
+        return;
+    }
+    unsigned char *src = (unsigned char*)base;
+    unsigned char *dst = buffer;
+    // 插入排序时缓冲区的开头暂存待插入的元素
+    for (size_t lo = 0; lo < count; lo += ARENA_SORT_RUN) {
+        size_t hi = lo + ARENA_SORT_RUN < count ? lo + ARENA_SORT_RUN : count;
+        for (size_t i = lo + 1; i < hi; i++) {
+            if (compare(src + (i - 1) * size, src + i * size) <= 0) continue;
+            memcpy(buffer, src + i * size, size);
+            size_t j = i;
+            for (; j > lo && compare(src + (j - 1) * size, buffer) > 0; j--) {
+                memcpy(src + j * size, src + (j - 1) * size, size);
+            }
+            memcpy(src + j * size, buffer, size);
+        }
+    }
+    for (size_t width = ARENA_SORT_RUN; width < count; width *= 2) {
+        for (size_t lo = 0; lo < count; lo += 2 * width) {
+            size_t mid = lo + width < count ? lo + width : count;
+            size_t hi = lo + 2 * width < count ? lo + 2 * width : count;
+            size_t i = lo, j = mid, out = lo;
+            while (i < mid && j < hi) {
+                // 相等时取左半的元素，保持稳定
+                if (compare(src + j * size, src + i * size) < 0) memcpy(dst + out++ * size, src + j++ * size, size);
+                else memcpy(dst + out++ * size, src + i++ * size, size);
+            }
+            memcpy(dst + out * size, src + i * size, (mid - i) * size);
+            out += mid - i;
+            memcpy(dst + out * size, src + j * size, (hi - j) * size);
+        }
+        unsigned char *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != (unsigned char*)base) memcpy(base, src, count * size);
+    arena_release(arena, buffer, count * size);
+}
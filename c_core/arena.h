@@ -0,0 +1,55 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// 区域分配器：向系统按大块（chunk）申请内存，用bump指针切分成2的幂大小的块（最小ARENA_MIN_SIZE字节）；
+// 归还的块挂到同级的空闲链表，供之后同级的分配复用。块不单独还给系统，
+// arena_destroy按chunk整体释放，释放次数只与总字节数/ARENA_CHUNK_SIZE有关，与块的个数无关。
+// 超过ARENA_CHUNK_SIZE/4的块单独占一个chunk（归还后同样进入空闲链表）。
+//
+// arena_reset作废全部块但保留chunk，之后的分配先复用保留的chunk：反复执行同样规模的工作（如查询）时，
+// 稳定之后不再向系统申请内存。arena为NULL时各函数退化为malloc/realloc/free。
+//
+// 一个arena同时只能由一个线程使用。块可以归还给分配它以外的arena（只进入对方的空闲链表），
+// 前提是两者由同一所有者管理、一起销毁（如arena_adopt之后）
+#define ARENA_CHUNK_SIZE ((size_t)1 << 20)
+#define ARENA_MIN_SIZE 16
+#define ARENA_NUM_CLASSES 40
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct Arena {
+    ArenaChunk *chunks;       // 正在使用的chunk（最新的在前）
+    ArenaChunk *spare;        // arena_reset后保留、尚未复用的chunk
+    unsigned char *cursor;    // 当前chunk中尚未切分的区间[cursor, limit)
+    unsigned char *limit;
+    void *free_lists[ARENA_NUM_CLASSES]; // 第i级为ARENA_MIN_SIZE << i字节的空闲块，块的开头存下一块的指针
+    size_t reserved;          // 向系统申请的总字节数（含保留的chunk）
+    size_t used;              // 已分配且未归还的字节数（按块的实际大小计）
+    size_t num_chunks;        // 向系统申请过的chunk数（只增不减，可用差值统计一段工作中的malloc次数）
+} Arena;
+
+Arena* arena_create(void);
+// 释放arena的全部chunk（之前分配的块全部失效）
+void arena_destroy(Arena *arena);
+
+// 分配至少size字节（size为0时按ARENA_MIN_SIZE），按16字节对齐，失败返回NULL
+void* arena_alloc(Arena *arena, size_t size);
+// 归还arena_alloc的块，size须与分配时请求的大小落在同一级（通常直接传原请求大小）
+void arena_release(Arena *arena, void *ptr, size_t size);
+// 把old_size字节的块换成至少size字节的块（内容复制过去，旧块归还）；ptr为NULL时等同arena_alloc，
+// 同级时原样返回ptr；失败返回NULL，旧块保持不变
+void* arena_grow(Arena *arena, void *ptr, size_t old_size, size_t size);
+
+// 作废全部已分配的块，chunk留待之后的分配复用（不归还系统）
+void arena_reset(Arena *arena);
+
+// dst接管src的全部chunk与空闲块，src变为空（仍可继续使用或销毁）
+void arena_adopt(Arena *dst, Arena *src);
+
+// 稳定的归并排序，用法同qsort：临时缓冲区从arena分配、排完即归还。glibc的qsort对超过1KB的数组会malloc，
+// 查询路径上用它代替qsort；arena为NULL或分配失败时退化为qsort（比较函数为全序时两者结果相同）
+void arena_sort(Arena *arena, void *base, size_t count, size_t size, int (*compare)(const void*, const void*));
+
+#endif
@@ -0,0 +1,740 @@
+// 端到端基准：生成确定性的Zipf分布语料（文档文件）与对应的查询日志，沿用引擎自己的代码路径测量
+// 索引构建耗时、索引加载耗时、逐条查询延迟的分位数（p50/p95/p99）、吞吐量与进程的峰值RSS，
+// 结果写成JSON文件，便于在不同提交之间对比回归
+// 用法：bench_engine [--docs N] [--vocab N] [--length N] [--zipf S] [--queries N] [--seed N]
+//                    [--threads N] [--shards N] [--clients N] [--parallel-postings N] [--parallel-threads N]
+//                    [--dir 目录] [--out 文件] [--label 文本]
+// --parallel-postings N与--parallel-threads N为段内并行打分的门槛（见search.h，0表示不并行）与线程数上限，
+// --clients N（N>1）时再用N个工作线程并发执行一遍查询日志（共享同一个段集合，各用自己的查询上下文），报告总吞吐量
+// 语料按参数缓存在<目录>/zipf_<文档数>_<词表>_<长度>_<指数>_<种子>下，参数相同的再次运行直接复用文档文件
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <sys/stat.h>
+#include "inverted_index.h"
+#include "search.h"
+#include "segment_set.h"
+#include "thread.h"
+#include "utils.h"
+#include "worker_pool.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <direct.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define BENCH_WORD_LETTERS 5          // 每个词5个小写字母，词表上限26^5
+#define BENCH_MAX_VOCAB 11881376
+#define BENCH_WORDS_PER_LINE 12
+#define BENCH_PHRASE_SLOTS 4096       // 从语料中记录的相邻词对（短语查询的来源）
+#define BENCH_LOAD_REPEAT 5
+#define BENCH_PATH_SIZE 1024
+
+// 查询日志中的查询类别
+typedef enum QueryKind {
+    KIND_TERM = 0, // 单个词
+    KIND_MULTI,    // 2~3个词
+    KIND_PREFIX,   // 2个字母的前缀（扩展出多个词条）
+    KIND_PHRASE,   // 语料中出现过的相邻词对
+    KIND_BOOLEAN,  // AND/OR/NOT组合
+    KIND_COUNT
+} QueryKind;
+
+static const char *kind_names[KIND_COUNT] = { "term", "multi", "prefix", "phrase", "boolean" };
+
+typedef struct BenchConfig {
+    int docs;
+    int vocab;
+    int doc_length; // 平均文档长度：实际长度在[doc_length/2, doc_length*3/2)内均匀分布
+    double zipf;    // Zipf指数s：排名r的词出现概率正比于1/r^s
+    int queries;
+    uint64_t seed;
+    int threads;
+    int shards;
+    int clients; // 并发查询的工作线程数（<=1表示不执行并发的一遍）
+    long long parallel_postings; // 段内并行打分的门槛（<=0表示不并行）
+    int parallel_threads;        // 段内并行的线程数上限（<=0表示CPU核数）
+    const char *dir;
+    const char *out;
+    const char *label;
+} BenchConfig;
+
+typedef struct BenchQuery {
+    QueryKind kind;
+    char *text;
+} BenchQuery;
+
+static uint64_t rng_state;
+
+static uint64_t rng_next(void) {
+    // xorshift64*：种子固定时每次运行生成相同的语料与查询
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static void rng_seed(uint64_t seed) {
+    rng_state = seed ? seed : 0x9e3779b97f4a7c15ULL;
+    for (int i = 0; i < 4; i++) rng_next();
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 进程到目前为止的峰值常驻内存（KB），无法获取时为0
+static long peak_rss_kb(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return (long)(counters.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (long)(usage.ru_maxrss / 1024);
+#else
+    return (long)usage.ru_maxrss;
+#endif
+#endif
+}
+
+static int make_dir(const char *path) {
+#ifdef _WIN32
+    if (_mkdir(path) == 0) return 0;
+#else
+    if (mkdir(path, 0755) == 0) return 0;
+#endif
+    struct stat path_stat;
+    return stat(path, &path_stat) == 0 && S_ISDIR(path_stat.st_mode) ? 0 : -1;
+}
+
+static int file_exists(const char *path) {
+    struct stat path_stat;
+    return stat(path, &path_stat) == 0;
+}
+
+// 词表排名到词的映射：排名乘以与26互素的常数后按26进制展开，相邻排名的词不共享前缀
+static void rank_word(int rank, char *word) {
+    uint64_t code = ((uint64_t)rank * 7919ULL + 104729ULL) % BENCH_MAX_VOCAB;
+    for (int i = BENCH_WORD_LETTERS - 1; i >= 0; i--) {
+        word[i] = (char)('a' + code % 26);
+        code /= 26;
+    }
+    word[BENCH_WORD_LETTERS] = '\0';
+}
+
+static double* zipf_cdf(int vocab, double s) {
+    double *cdf = (double*)malloc(vocab * sizeof(double));
+    if (!cdf) return NULL;
+    double total = 0.0;
+    for (int i = 0; i < vocab; i++) {
+        total += 1.0 / pow(i + 1, s);
+        cdf[i] = total;
+    }
+    for (int i = 0; i < vocab; i++) cdf[i] /= total;
+    return cdf;
+}
+
+static int sample_zipf(const double *cdf, int n) {
+    double u = (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+    int left = 0, right = n - 1;
+    while (left < right) {
+        int mid = left + (right - left) / 2;
+        if (cdf[mid] < u) left = mid + 1;
+        else right = mid;
+    }
+    return left;
+}
+
+typedef struct CorpusStats {
+    long long bytes;
+    long long tokens;
+    double seconds;
+    int reused;
+} CorpusStats;
+
+// 生成语料：write_files为0时只重放随机序列（文档文件已存在），词对照样记录，保证查询日志与语料一致
+static int generate_corpus(const BenchConfig *config, const double *cdf, const char *docs_dir, int write_files,
+                           int (*phrases)[2], CorpusStats *stats) {
+    char path[BENCH_PATH_SIZE + 64];
+    char word[BENCH_WORD_LETTERS + 1];
+    rng_seed(config->seed);
+    for (int doc = 0; doc < config->docs; doc++) {
+        FILE *file = NULL;
+        if (write_files) {
+            snprintf(path, sizeof(path), "%s/doc%07d.txt", docs_dir, doc);
+            file = fopen(path, "w");
+            if (!file) return -1;
+        }
+        int length = config->doc_length / 2 + (int)(rng_next() % (uint64_t)config->doc_length);
+        int phrase_at = (int)(rng_next() % (uint64_t)(length > 1 ? length - 1 : 1));
+        int *slot = phrases[doc % BENCH_PHRASE_SLOTS];
+        for (int i = 0; i < length; i++) {
+            int rank = sample_zipf(cdf, config->vocab);
+            if (i == phrase_at) slot[0] = rank;
+            if (i == phrase_at + 1) slot[1] = rank;
+            if (file) {
+                rank_word(rank, word);
+                fputs(word, file);
+                fputc((i + 1) % BENCH_WORDS_PER_LINE == 0 || i + 1 == length ? '\n' : ' ', file);
+            }
+            stats->bytes += BENCH_WORD_LETTERS + 1;
+        }
+        stats->tokens += length;
+        if (file && fclose(file) != 0) return -1;
+    }
+    return 0;
+}
+
+// 查询日志：类别按固定比例抽取，查询词按与语料相同的Zipf分布抽取
+static BenchQuery* generate_queries(const BenchConfig *config, const double *cdf, int (*phrases)[2]) {
+    BenchQuery *queries = (BenchQuery*)calloc(config->queries, sizeof(BenchQuery));
+    if (!queries) return NULL;
+    rng_seed(config->seed ^ 0x5851f42d4c957f2dULL);
+    int num_phrases = config->docs < BENCH_PHRASE_SLOTS ? config->docs : BENCH_PHRASE_SLOTS;
+
+    for (int q = 0; q < config->queries; q++) {
+        char text[128];
+        char a[BENCH_WORD_LETTERS + 1], b[BENCH_WORD_LETTERS + 1], c[BENCH_WORD_LETTERS + 1];
+        rank_word(sample_zipf(cdf, config->vocab), a);
+        rank_word(sample_zipf(cdf, config->vocab), b);
+        rank_word(sample_zipf(cdf, config->vocab), c);
+        int r = (int)(rng_next() % 100);
+        QueryKind kind;
+        if (r < 45) {
+            kind = KIND_TERM;
+            snprintf(text, sizeof(text), "%s", a);
+        } else if (r < 70) {
+            kind = KIND_MULTI;
+            if (r % 2) snprintf(text, sizeof(text), "%s %s", a, b);
+            else snprintf(text, sizeof(text), "%s %s %s", a, b, c);
+        } else if (r < 82) {
+            kind = KIND_PREFIX;
+            snprintf(text, sizeof(text), "%.2s", a);
+        } else if (r < 92) {
+            kind = KIND_PHRASE;
+            const int *pair = phrases[rng_next() % (uint64_t)num_phrases];
+            rank_word(pair[0], a);
+            rank_word(pair[1], b);
+            snprintf(text, sizeof(text), "\"%s %s\"", a, b);
+        } else {
+            kind = KIND_BOOLEAN;
+            if (r < 95) snprintf(text, sizeof(text), "%s AND %s", a, b);
+            else if (r < 98) snprintf(text, sizeof(text), "%s AND NOT %s", a, b);
+            else snprintf(text, sizeof(text), "(%s OR %s) AND %s", a, b, c);
+        }
+        queries[q].kind = kind;
+        queries[q].text = strdup(text);
+        if (!queries[q].text) {
+            for (int i = 0; i < q; i++) free(queries[i].text);
+            free(queries);
+            return NULL;
+        }
+    }
+    return queries;
+}
+
+static int write_queries(const char *path, const BenchQuery *queries, int count) {
+    FILE *file = fopen(path, "w");
+    if (!file) return -1;
+    for (int i = 0; i < count; i++) fprintf(file, "%s\t%s\n", kind_names[queries[i].kind], queries[i].text);
+    return fclose(file);
+}
+
+// 与main.c的分片构建相同：每个分片为一段连续的文档区间建索引
+typedef struct ShardBuild {
+    char **paths;
+    int num_paths;
+    int num_threads;
+} ShardBuild;
+
+static int build_shard(int shard, int num_shards, const char *shard_dir, void *context) {
+    ShardBuild *build = (ShardBuild*)context;
+    int begin = (int)((long long)build->num_paths * shard / num_shards);
+    int end = (int)((long long)build->num_paths * (shard + 1) / num_shards);
+    int num_docs = 0;
+    char **doc_paths = NULL;
+    InvertedIndex *index = inverted_index_create(0, 0);
+    build_index_from_files(build->paths + begin, end - begin, index, &doc_paths, &num_docs, build->num_threads);
+    index->num_docs = num_docs;
+    int status = segment_set_replace(shard_dir, index, doc_paths, num_docs);
+    inverted_index_free(index);
+    for (int i = 0; i < num_docs; i++) free(doc_paths[i]);
+    free(doc_paths);
+    return status;
+}
+
+static int build_bench_index(const BenchConfig *config, const char *docs_dir, const char *index_dir) {
+    if (config->shards >= 2) {
+        ShardBuild build = { NULL, 0, config->threads };
+        build.paths = list_documents(docs_dir, &build.num_paths);
+        int status = segment_set_replace_sharded(index_dir, config->shards, build_shard, &build);
+        for (int i = 0; i < build.num_paths; i++) free(build.paths[i]);
+        free(build.paths);
+        return status;
+    }
+    int num_docs = 0;
+    char **doc_paths = NULL;
+    InvertedIndex *index = inverted_index_create(0, 0);
+    build_index_from_docs(docs_dir, index, &doc_paths, &num_docs, config->threads);
+    index->num_docs = num_docs;
+    int status = num_docs == config->docs ? segment_set_replace(index_dir, index, doc_paths, num_docs) : -1;
+    inverted_index_free(index);
+    for (int i = 0; i < num_docs; i++) free(doc_paths[i]);
+    free(doc_paths);
+    return status;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+// 最近秩法：已排序数组中不小于p比例样本的最小值
+static double percentile(const double *sorted, int count, double p) {
+    if (count <= 0) return 0.0;
+    int index = (int)ceil(p * count) - 1;
+    if (index < 0) index = 0;
+    if (index >= count) index = count - 1;
+    return sorted[index];
+}
+
+typedef struct LatencyStats {
+    int count;
+    double mean_us;
+    double p50_us;
+    double p95_us;
+    double p99_us;
+    double max_us;
+} LatencyStats;
+
+// latencies会被排序
+static void summarize(double *latencies, int count, LatencyStats *stats) {
+    memset(stats, 0, sizeof(LatencyStats));
+    stats->count = count;
+    if (count == 0) return;
+    double total = 0.0;
+    for (int i = 0; i < count; i++) total += latencies[i];
+    qsort(latencies, count, sizeof(double), compare_doubles);
+    stats->mean_us = total / count;
+    stats->p50_us = percentile(latencies, count, 0.50);
+    stats->p95_us = percentile(latencies, count, 0.95);
+    stats->p99_us = percentile(latencies, count, 0.99);
+    stats->max_us = latencies[count - 1];
+}
+
+typedef struct QueryRun {
+    double seconds;
+    double qps;
+    long long results;
+    uint64_t digest; // 全部结果的文档ID序列的FNV-1a，结果变化时不同
+    LatencyStats all;
+    LatencyStats kinds[KIND_COUNT];
+} QueryRun;
+
+// 先不计时地执行一遍查询日志（预热页缓存与查询上下文），再逐条计时执行一遍；两遍共用一个查询上下文
+static int run_queries(const SegmentSet *set, const BenchQuery *queries, int count, ScoringModel model,
+                       const BenchConfig *config, QueryRun *run) {
+    memset(run, 0, sizeof(QueryRun));
+    SearchOptions options;
+    search_options_init(&options);
+    options.model = model;
+    options.parallel_postings = config->parallel_postings;
+    options.parallel_threads = config->parallel_threads;
+
+    double *latencies = (double*)malloc((count > 0 ? count : 1) * sizeof(double));
+    double *by_kind = (double*)malloc((count > 0 ? count : 1) * sizeof(double));
+    SearchContext *context = search_context_create();
+    if (!latencies || !by_kind || !context) {
+        free(latencies);
+        free(by_kind);
+        search_context_free(context);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int result_count;
+        search_context_run(context, set, queries[i].text, &options, &result_count);
+    }
+
+    run->digest = 1469598103934665603ULL;
+    double start = now_seconds();
+    for (int i = 0; i < count; i++) {
+        double t0 = now_seconds();
+        int result_count;
+        const SearchResult *results = search_context_run(context, set, queries[i].text, &options, &result_count);
+        latencies[i] = (now_seconds() - t0) * 1e6;
+        run->results += result_count;
+        for (int j = 0; j < result_count; j++) {
+            run->digest = (run->digest ^ (uint64_t)results[j].doc_id) * 1099511628211ULL;
+        }
+        run->digest = (run->digest ^ 0xff) * 1099511628211ULL;
+    }
+    search_context_free(context);
+    run->seconds = now_seconds() - start;
+    run->qps = run->seconds > 0 ? count / run->seconds : 0.0;
+
+    for (int kind = 0; kind < KIND_COUNT; kind++) {
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            if (queries[i].kind == (QueryKind)kind) by_kind[n++] = latencies[i];
+        }
+        summarize(by_kind, n, &run->kinds[kind]);
+    }
+    summarize(latencies, count, &run->all);
+    free(latencies);
+    free(by_kind);
+    return 0;
+}
+
+// 并发执行查询日志：每条查询一个任务，结果的文档ID写入各自的位置，最后按查询顺序计算校验和
+typedef struct ConcurrentRun {
+    const SegmentSet *set;
+    const BenchQuery *queries;
+    const SearchOptions *options;
+    SearchContext **contexts; // 每个工作线程一个
+    int *doc_ids;             // 第i条查询的结果在[i*top_k, (i+1)*top_k)
+    int *counts;
+    int clients;
+    double seconds;
+    double qps;
+    uint64_t digest;          // 与逐条执行时的result_digest算法相同，两者应一致
+} ConcurrentRun;
+
+typedef struct ConcurrentQuery {
+    ConcurrentRun *run;
+    int index;
+} ConcurrentQuery;
+
+static void concurrent_query(void *arg, int worker) {
+    ConcurrentQuery *task = (ConcurrentQuery*)arg;
+    ConcurrentRun *run = task->run;
+    int result_count;
+    const SearchResult *results = search_context_run(run->contexts[worker], run->set, run->queries[task->index].text,
+                                                     run->options, &result_count);
+    int *doc_ids = run->doc_ids + (size_t)task->index * run->options->top_k;
+    for (int j = 0; j < result_count; j++) doc_ids[j] = results[j].doc_id;
+    run->counts[task->index] = result_count;
+}
+
+// 先并发预热一遍（各线程的查询上下文都达到稳定），再计时执行一遍
+static int run_concurrent(const SegmentSet *set, const BenchQuery *queries, int count, ScoringModel model,
+                          const BenchConfig *config, ConcurrentRun *run) {
+    memset(run, 0, sizeof(ConcurrentRun));
+    SearchOptions options;
+    search_options_init(&options);
+    options.model = model;
+    options.parallel_postings = config->parallel_postings;
+    options.parallel_threads = config->parallel_threads;
+    run->set = set;
+    run->queries = queries;
+    run->options = &options;
+    int clients = config->clients;
+    run->clients = clients;
+    run->contexts = (SearchContext**)calloc(clients, sizeof(SearchContext*));
+    run->doc_ids = (int*)malloc((size_t)(count > 0 ? count : 1) * options.top_k * sizeof(int));
+    run->counts = (int*)calloc(count > 0 ? count : 1, sizeof(int));
+    ConcurrentQuery *tasks = (ConcurrentQuery*)malloc((count > 0 ? count : 1) * sizeof(ConcurrentQuery));
+    WorkerPool *pool = worker_pool_create(clients, 0);
+    // 与常驻服务一致：各上下文的分片与段内并行任务共用一个池
+    WorkerPool *scoring_pool = worker_pool_create(cpu_count(), 0);
+    int status = run->contexts && run->doc_ids && run->counts && tasks && pool && scoring_pool ? 0 : -1;
+    for (int i = 0; i < clients && status == 0; i++) {
+        run->contexts[i] = search_context_create();
+        if (!run->contexts[i]) status = -1;
+        else search_context_set_pool(run->contexts[i], scoring_pool);
+    }
+
+    for (int pass = 0; pass < 2 && status == 0; pass++) {
+        double start = now_seconds();
+        for (int i = 0; i < count; i++) {
+            tasks[i].run = run;
+            tasks[i].index = i;
+            worker_pool_submit(pool, concurrent_query, &tasks[i]);
+        }
+        worker_pool_wait(pool);
+        run->seconds = now_seconds() - start;
+    }
+    run->qps = run->seconds > 0 ? count / run->seconds : 0.0;
+    run->digest = 1469598103934665603ULL;
+    for (int i = 0; i < count && status == 0; i++) {
+        const int *doc_ids = run->doc_ids + (size_t)i * options.top_k;
+        for (int j = 0; j < run->counts[i]; j++) {
+            run->digest = (run->digest ^ (uint64_t)doc_ids[j]) * 1099511628211ULL;
+        }
+        run->digest = (run->digest ^ 0xff) * 1099511628211ULL;
+    }
+
+    worker_pool_free(pool);
+    for (int i = 0; run->contexts && i < clients; i++) search_context_free(run->contexts[i]);
+    worker_pool_free(scoring_pool);
+    free(run->contexts);
+    free(run->doc_ids);
+    free(run->counts);
+    free(tasks);
+    run->contexts = NULL;
+    run->doc_ids = NULL;
+    run->counts = NULL;
+    run->options = NULL;
+    return status;
+}
+
+// 短语回归检查：语料的词都是BENCH_WORD_LETTERS个字母，6个字母的词一定不在索引中。
+// 含这种词的短语（以及与之AND的查询）不匹配任何文档；单字母的词构建时不收录，在短语中只占位置。
+// 查询模板中的%s替换为最常见的词，全部符合预期返回0
+static int check_phrase_queries(const SegmentSet *set) {
+    static const struct { const char *format; int matches; } checks[] = {
+        { "\"%s\"", 1 },
+        { "\"qqqqqq %s\"", 0 },
+        { "\"qqqqqq zzzzzz\" %s", 0 },
+        { "\"qqqqqq %s\" AND %s", 0 },
+        { "\"x %s\"", 1 },
+        { "\"x %s\" AND %s", 1 },
+    };
+    char word[BENCH_WORD_LETTERS + 1], query[128];
+    rank_word(0, word);
+    SearchContext *context = search_context_create();
+    if (!context) return -1;
+    SearchOptions options;
+    search_options_init(&options);
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+        snprintf(query, sizeof(query), checks[i].format, word, word);
+        int result_count;
+        search_context_run(context, set, query, &options, &result_count);
+        if ((result_count > 0) != checks[i].matches) {
+            fprintf(stderr, "短语检查失败：%s 返回 %d 条结果\n", query, result_count);
+            failed = 1;
+        }
+    }
+    search_context_free(context);
+    return failed ? -1 : 0;
+}
+
+static void print_latency_json(FILE *out, const LatencyStats *stats) {
+    fprintf(out, "{\"count\": %d, \"mean_us\": %.1f, \"p50_us\": %.1f, \"p95_us\": %.1f, \"p99_us\": %.1f, "
+            "\"max_us\": %.1f}", stats->count, stats->mean_us, stats->p50_us, stats->p95_us, stats->p99_us,
+            stats->max_us);
+}
+
+static void print_run_json(FILE *out, const char *name, const QueryRun *run, int last) {
+    fprintf(out, "    \"%s\": {\n", name);
+    fprintf(out, "      \"seconds\": %.4f,\n", run->seconds);
+    fprintf(out, "      \"qps\": %.1f,\n", run->qps);
+    fprintf(out, "      \"results\": %lld,\n", run->results);
+    fprintf(out, "      \"result_digest\": \"%016llx\",\n", (unsigned long long)run->digest);
+    fprintf(out, "      \"latency\": ");
+    print_latency_json(out, &run->all);
+    fprintf(out, ",\n      \"kinds\": {\n");
+    for (int kind = 0; kind < KIND_COUNT; kind++) {
+        fprintf(out, "        \"%s\": ", kind_names[kind]);
+        print_latency_json(out, &run->kinds[kind]);
+        fprintf(out, "%s\n", kind + 1 < KIND_COUNT ? "," : "");
+    }
+    fprintf(out, "      }\n    }%s\n", last ? "" : ",");
+}
+
+// JSON中的字符串（只转义引号、反斜杠与控制字符）
+static void print_json_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char*)text; *p; p++) {
+        if (*p == '"' || *p == '\\') fprintf(out, "\\%c", *p);
+        else if (*p < 0x20) fprintf(out, "\\u%04x", *p);
+        else fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static int parse_args(int argc, char *argv[], BenchConfig *config) {
+    for (int i = 1; i < argc; i++) {
+        const char *name = argv[i];
+        if (i + 1 >= argc) return -1;
+        const char *value = argv[++i];
+        if (strcmp(name, "--docs") == 0) config->docs = atoi(value);
+        else if (strcmp(name, "--vocab") == 0) config->vocab = atoi(value);
+        else if (strcmp(name, "--length") == 0) config->doc_length = atoi(value);
+        else if (strcmp(name, "--zipf") == 0) config->zipf = atof(value);
+        else if (strcmp(name, "--queries") == 0) config->queries = atoi(value);
+        else if (strcmp(name, "--seed") == 0) config->seed = strtoull(value, NULL, 10);
+        else if (strcmp(name, "--threads") == 0) config->threads = atoi(value);
+        else if (strcmp(name, "--shards") == 0) config->shards = atoi(value);
+        else if (strcmp(name, "--clients") == 0) config->clients = atoi(value);
+        else if (strcmp(name, "--parallel-postings") == 0) config->parallel_postings = atoll(value);
+        else if (strcmp(name, "--parallel-threads") == 0) config->parallel_threads = atoi(value);
+        else if (strcmp(name, "--dir") == 0) config->dir = value;
+        else if (strcmp(name, "--out") == 0) config->out = value;
+        else if (strcmp(name, "--label") == 0) config->label = value;
+        else return -1;
+    }
+    if (config->docs <= 0 || config->vocab <= 0 || config->vocab > BENCH_MAX_VOCAB || config->doc_length < 2
+        || config->zipf <= 0 || config->queries <= 0) {
+        return -1;
+    }
+    if (config->threads <= 0) config->threads = cpu_count();
+    if (config->shards > config->docs) config->shards = config->docs;
+    if (config->shards > MAX_SHARDS) config->shards = MAX_SHARDS;
+    if (config->shards < 1) config->shards = 1;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    BenchConfig config = { 100000, 50000, 120, 1.0, 2000, 42, 0, 1, 0, SEARCH_DEFAULT_PARALLEL_POSTINGS, 0, "bench_data", "bench_results.json", "" };
+    if (parse_args(argc, argv, &config) != 0) {
+        fprintf(stderr, "用法：bench_engine [--docs N] [--vocab N] [--length N] [--zipf S] [--queries N] [--seed N]\n"
+                        "                   [--threads N] [--shards N] [--clients N] [--parallel-postings N] [--parallel-threads N]\n"
+                        "                   [--dir 目录] [--out 文件] [--label 文本]\n");
+        return 1;
+    }
+
+    // 语料目录之下的路径留出文件名的长度
+    char corpus_dir[BENCH_PATH_SIZE], docs_dir[BENCH_PATH_SIZE + 16], index_dir[BENCH_PATH_SIZE + 16];
+    char marker[BENCH_PATH_SIZE + 16], query_path[BENCH_PATH_SIZE + 16];
+    snprintf(corpus_dir, sizeof(corpus_dir), "%s/zipf_%d_%d_%d_%g_%llu", config.dir, config.docs, config.vocab,
+             config.doc_length, config.zipf, (unsigned long long)config.seed);
+    snprintf(docs_dir, sizeof(docs_dir), "%s/docs", corpus_dir);
+    snprintf(index_dir, sizeof(index_dir), "%s/index", corpus_dir);
+    snprintf(marker, sizeof(marker), "%s/COMPLETE", corpus_dir);
+    snprintf(query_path, sizeof(query_path), "%s/queries.txt", corpus_dir);
+    if (make_dir(config.dir) != 0 || make_dir(corpus_dir) != 0 || make_dir(docs_dir) != 0
+        || make_dir(index_dir) != 0) {
+        fprintf(stderr, "无法创建目录：%s\n", corpus_dir);
+        return 1;
+    }
+
+    // 1. 语料与查询日志
+    double *cdf = zipf_cdf(config.vocab, config.zipf);
+    int (*phrases)[2] = (int (*)[2])calloc(BENCH_PHRASE_SLOTS, sizeof(*phrases));
+    if (!cdf || !phrases) {
+        fprintf(stderr, "内存不足\n");
+        return 1;
+    }
+    CorpusStats corpus = { 0, 0, 0.0, file_exists(marker) };
+    printf("%s语料：%d 文档，词表 %d，平均每文档 %d 词，Zipf s=%g...\n", corpus.reused ? "复用" : "生成",
+           config.docs, config.vocab, config.doc_length, config.zipf);
+    double t0 = now_seconds();
+    if (generate_corpus(&config, cdf, docs_dir, !corpus.reused, phrases, &corpus) != 0) {
+        fprintf(stderr, "写入语料失败：%s\n", docs_dir);
+        return 1;
+    }
+    corpus.seconds = now_seconds() - t0;
+    if (!corpus.reused) {
+        FILE *file = fopen(marker, "w");
+        if (file) fclose(file);
+    }
+    BenchQuery *queries = generate_queries(&config, cdf, phrases);
+    if (!queries || write_queries(query_path, queries, config.queries) != 0) {
+        fprintf(stderr, "写入查询日志失败：%s\n", query_path);
+        return 1;
+    }
+    free(cdf);
+    free(phrases);
+
+    // 2. 构建（与search_engine的构建路径相同，索引写入语料目录下的index）
+    printf("构建索引（%d 个线程，%d 个分片）...\n", config.threads, config.shards);
+    t0 = now_seconds();
+    if (build_bench_index(&config, docs_dir, index_dir) != 0) {
+        fprintf(stderr, "索引构建失败：%s\n", index_dir);
+        return 1;
+    }
+    double build_seconds = now_seconds() - t0;
+    long build_rss = peak_rss_kb();
+
+    // 3. 加载：第一次打开之后再重复打开几次，取中位数
+    double load_times[BENCH_LOAD_REPEAT];
+    SegmentSet *set = NULL;
+    for (int i = 0; i < BENCH_LOAD_REPEAT; i++) {
+        if (set) segment_set_close(set);
+        t0 = now_seconds();
+        set = segment_set_open(index_dir);
+        load_times[i] = now_seconds() - t0;
+        if (!set) {
+            fprintf(stderr, "无法打开索引：%s\n", index_dir);
+            return 1;
+        }
+    }
+    double first_load = load_times[0];
+    qsort(load_times, BENCH_LOAD_REPEAT, sizeof(double), compare_doubles);
+    long long index_bytes = 0;
+    for (int i = 0; i < set->num_segments; i++) index_bytes += (long long)set->segments[i]->size;
+    long load_rss = peak_rss_kb();
+    if (check_phrase_queries(set) != 0) return 1;
+
+    // 4. 查询：两种打分模型各执行一遍查询日志
+    printf("执行查询日志：%d 条查询...\n", config.queries);
+    QueryRun tfidf_run, bm25_run;
+    if (run_queries(set, queries, config.queries, SCORING_MODEL_TFIDF, &config, &tfidf_run) != 0
+        || run_queries(set, queries, config.queries, SCORING_MODEL_BM25, &config, &bm25_run) != 0) {
+        fprintf(stderr, "内存不足\n");
+        return 1;
+    }
+    ConcurrentRun concurrent;
+    memset(&concurrent, 0, sizeof(ConcurrentRun));
+    if (config.clients > 1) {
+        printf("并发执行查询日志（TF-IDF，%d 个工作线程）...\n", config.clients);
+        if (run_concurrent(set, queries, config.queries, SCORING_MODEL_TFIDF, &config, &concurrent) != 0) {
+            fprintf(stderr, "内存不足\n");
+            return 1;
+        }
+    }
+    long query_rss = peak_rss_kb();
+
+    printf("构建 %.2fs（%.0f 文档/s），加载 %.2fms，索引 %.1fMB\n", build_seconds, config.docs / build_seconds,
+           load_times[BENCH_LOAD_REPEAT / 2] * 1e3, index_bytes / 1048576.0);
+    printf("TF-IDF：%.0f 查询/s，p50 %.0fus，p95 %.0fus，p99 %.0fus\n", tfidf_run.qps, tfidf_run.all.p50_us,
+           tfidf_run.all.p95_us, tfidf_run.all.p99_us);
+    printf("BM25：  %.0f 查询/s，p50 %.0fus，p95 %.0fus，p99 %.0fus\n", bm25_run.qps, bm25_run.all.p50_us,
+           bm25_run.all.p95_us, bm25_run.all.p99_us);
+    if (concurrent.clients > 1) {
+        printf("并发：  %.0f 查询/s（%d 个工作线程，单线程的%.2f倍），结果%s\n", concurrent.qps, concurrent.clients,
+               tfidf_run.qps > 0 ? concurrent.qps / tfidf_run.qps : 0.0,
+               concurrent.digest == tfidf_run.digest ? "与逐条执行一致" : "与逐条执行不一致");
+    }
+    printf("峰值RSS %.1fMB\n", query_rss / 1024.0);
+
+    // 5. JSON结果
+    FILE *out = fopen(config.out, "w");
+    if (!out) {
+        fprintf(stderr, "无法写入结果：%s\n", config.out);
+        return 1;
+    }
+    fprintf(out, "{\n  \"benchmark\": \"bench_engine\",\n  \"label\": ");
+    print_json_string(out, config.label);
+    fprintf(out, ",\n  \"config\": {\"docs\": %d, \"vocab\": %d, \"doc_length\": %d, \"zipf\": %g, \"queries\": %d, "
+            "\"seed\": %llu, \"threads\": %d, \"shards\": %d, \"clients\": %d, \"parallel_postings\": %lld, "
+            "\"parallel_threads\": %d, \"top_k\": %d},\n", config.docs, config.vocab, config.doc_length, config.zipf, config.queries,
+            (unsigned long long)config.seed, config.threads, set->num_shards, config.clients, config.parallel_postings,
+            config.parallel_threads, SEARCH_DEFAULT_TOP_K);
+    fprintf(out, "  \"corpus\": {\"bytes\": %lld, \"tokens\": %lld, \"generate_seconds\": %.3f, \"reused\": %s},\n",
+            corpus.bytes, corpus.tokens, corpus.seconds, corpus.reused ? "true" : "false");
+    fprintf(out, "  \"build\": {\"seconds\": %.3f, \"docs_per_second\": %.1f, \"mb_per_second\": %.2f, "
+            "\"index_bytes\": %lld, \"segments\": %d, \"peak_rss_kb\": %ld},\n", build_seconds,
+            config.docs / build_seconds, corpus.bytes / 1048576.0 / build_seconds, index_bytes, set->num_segments,
+            build_rss);
+    fprintf(out, "  \"load\": {\"first_ms\": %.3f, \"median_ms\": %.3f, \"repeat\": %d, \"peak_rss_kb\": %ld},\n",
+            first_load * 1e3, load_times[BENCH_LOAD_REPEAT / 2] * 1e3, BENCH_LOAD_REPEAT, load_rss);
+    fprintf(out, "  \"query\": {\n");
+    print_run_json(out, "tfidf", &tfidf_run, 0);
+    print_run_json(out, "bm25", &bm25_run, 0);
+    if (concurrent.clients > 1) {
+        fprintf(out, "    \"concurrent\": {\"clients\": %d, \"seconds\": %.4f, \"qps\": %.1f, \"speedup\": %.2f, "
+                "\"result_digest\": \"%016llx\"},\n", concurrent.clients, concurrent.seconds, concurrent.qps,
+                tfidf_run.qps > 0 ? concurrent.qps / tfidf_run.qps : 0.0, (unsigned long long)concurrent.digest);
+    }
+    fprintf(out, "    \"peak_rss_kb\": %ld\n  }\n}\n", query_rss);
+    int status = fclose(out) == 0 ? 0 : 1;
+    printf("结果已写入 %s\n", config.out);
+
+    segment_set_close(set);
+    for (int i = 0; i < config.queries; i++) free(queries[i].text);
+    free(queries);
+    return status;
+}
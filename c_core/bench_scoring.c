@@ -0,0 +1,264 @@
+// 打分基准：在合成的Zipf分布语料（默认12万文档）上对比
+// 旧实现（结果数组线性查找累加 + 全量qsort）、穷举打分（分页累加器 + 有界小顶堆）与动态剪枝（MaxScore + 块级上界），
+// 以及BM25模型下的穷举与剪枝（对比两种模型的查询延迟）
+// 用法：bench_scoring [文档数] [k]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include "inverted_index.h"
+#include "segment.h"
+#include "tfidf.h"
+
+#define BENCH_VOCAB_SIZE 50000
+#define BENCH_DOC_LENGTH 120 // 平均文档长度：实际长度在[BENCH_DOC_LENGTH/2, BENCH_DOC_LENGTH*3/2)内均匀分布
+#define BENCH_SEGMENT_FILE "bench_scoring.seg"
+#define BENCH_REPEAT 5
+#define BENCH_MAX_TERMS 20000
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+    // xorshift64*：固定种子，每次运行生成相同的语料
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 按Zipf分布（s=1）抽取词条排名
+static int sample_zipf(const double *cdf, int n) {
+    double u = (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+    int left = 0, right = n - 1;
+    while (left < right) {
+        int mid = left + (right - left) / 2;
+        if (cdf[mid] < u) left = mid + 1;
+        else right = mid;
+    }
+    return left;
+}
+
+// 旧实现：每个posting都在结果数组中线性查找文档，最后对全部匹配文档排序
+static DocScore* legacy_document_scores(const Segment *segment, const TermHandle *terms, int num_terms,
+                                        int *result_count) {
+    *result_count = 0;
+    DocScore *scores = NULL;
+    int capacity = 0;
+
+    for (int i = 0; i < num_terms; i++) {
+        PostingCursor cursor;
+        if (!segment_posting_cursor(segment, &terms[i], &cursor)) continue;
+        while (posting_cursor_next(&cursor)) {
+            double tfidf = calculate_tfidf(cursor.term_frequency, terms[i].doc_count, segment->num_docs);
+            int found = 0;
+            for (int j = 0; j < *result_count; j++) {
+                if (scores[j].doc_id == cursor.doc_id) {
+                    scores[j].score += tfidf;
+                    found = 1;
+                    break;
+                }
+            }
+            if (!found) {
+                if (*result_count >= capacity) {
+                    capacity = capacity ? capacity * 2 : 16;
+                    scores = (DocScore*)realloc(scores, capacity * sizeof(DocScore));
+                }
+                scores[*result_count].doc_id = cursor.doc_id;
+                scores[*result_count].score = tfidf;
+                (*result_count)++;
+            }
+        }
+    }
+
+    if (*result_count > 0) sort_doc_scores(scores, *result_count, NULL);
+    return scores;
+}
+
+static int build_corpus(int num_docs) {
+    double *cdf = (double*)malloc(BENCH_VOCAB_SIZE * sizeof(double));
+    double total = 0.0;
+    for (int i = 0; i < BENCH_VOCAB_SIZE; i++) {
+        total += 1.0 / (i + 1);
+        cdf[i] = total;
+    }
+    for (int i = 0; i < BENCH_VOCAB_SIZE; i++) cdf[i] /= total;
+
+    InvertedIndex *index = inverted_index_create(BENCH_VOCAB_SIZE * 2, num_docs);
+    char **doc_paths = (char**)malloc(num_docs * sizeof(char*));
+    char term[32];
+    for (int doc_id = 0; doc_id < num_docs; doc_id++) {
+        int length = BENCH_DOC_LENGTH / 2 + (int)(rng_next() % BENCH_DOC_LENGTH);
+        for (int i = 0; i < length; i++) {
+            int len = snprintf(term, sizeof(term), "w%d", sample_zipf(cdf, BENCH_VOCAB_SIZE));
+            inverted_index_add_term(index, term, (size_t)len, doc_id);
+        }
+        char path[32];
+        snprintf(path, sizeof(path), "doc%06d.txt", doc_id);
+        doc_paths[doc_id] = strdup(path);
+    }
+
+    int ret = segment_write(index, doc_paths, num_docs, BENCH_SEGMENT_FILE);
+
+    for (int i = 0; i < num_docs; i++) free(doc_paths[i]);
+    free(doc_paths);
+    inverted_index_free(index);
+    free(cdf);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    int num_docs = argc > 1 ? atoi(argv[1]) : 120000;
+    int k = argc > 2 ? atoi(argv[2]) : 100;
+    if (num_docs <= 0) num_docs = 120000;
+
+    printf("构建合成语料：%d 文档，词表 %d，平均每文档 %d 词...\n", num_docs, BENCH_VOCAB_SIZE, BENCH_DOC_LENGTH);
+    double t0 = now_seconds();
+    if (build_corpus(num_docs) != 0) {
+        fprintf(stderr, "写入段文件失败\n");
+        return 1;
+    }
+    printf("构建耗时 %.2fs\n", now_seconds() - t0);
+
+    Segment *segment = segment_open(BENCH_SEGMENT_FILE);
+    if (!segment) {
+        fprintf(stderr, "无法打开段文件\n");
+        return 1;
+    }
+
+    // 查询覆盖高频、中频、低频词条的组合；之后是前缀扩展出的成百上千个OR词条（旧实现太慢，只对比后两者）
+    static const char *queries[][3] = {
+        { "w200", NULL, NULL },
+        { "w50", "w300", NULL },
+        { "w20", "w80", "w1000" },
+        { "w10", "w5000", NULL },
+        { "w3", "w40", NULL },
+    };
+    static const char *broad_queries[] = { "w12", "w3", "w1" };
+    int num_queries = sizeof(queries) / sizeof(queries[0]);
+    int num_broad = sizeof(broad_queries) / sizeof(broad_queries[0]);
+    int mismatches = 0;
+    TermHandle *handles = (TermHandle*)malloc(BENCH_MAX_TERMS * sizeof(TermHandle));
+
+    // 平均文档长度与查询时一样在打开索引时算一次
+    uint64_t total_length = 0;
+    for (int doc_id = 0; doc_id < segment->num_docs; doc_id++) {
+        total_length += segment_decode_doc_length(segment->doc_lengths[doc_id]);
+    }
+    ScoringParams bm25;
+    scoring_params_init(&bm25, SCORING_MODEL_BM25, 0, (double)total_length / segment->num_docs);
+    printf("%-22s %10s %12s %12s %12s %12s %12s\n", "查询", "匹配文档", "旧实现(ms)", "穷举(ms)", "剪枝(ms)",
+           "BM25穷举", "BM25剪枝");
+    for (int q = 0; q < num_queries + num_broad; q++) {
+        int num_terms = 0;
+        char label[64] = "";
+        if (q < num_queries) {
+            for (int i = 0; i < 3 && queries[q][i]; i++) {
+                if (segment_lookup(segment, queries[q][i], strlen(queries[q][i]), &handles[num_terms])) {
+                    num_terms++;
+                }
+                strcat(label, queries[q][i]);
+                strcat(label, " ");
+            }
+        } else {
+            int lo, hi;
+            segment_prefix_range(segment, broad_queries[q - num_queries], &lo, &hi);
+            for (int id = lo; id < hi && num_terms < BENCH_MAX_TERMS; id++) {
+                segment_term_handle(segment, id, &handles[num_terms++]);
+            }
+            snprintf(label, sizeof(label), "%s* (%d词)", broad_queries[q - num_queries], num_terms);
+        }
+
+        // 旧实现只跑一次；穷举打分统计匹配文档数（k=0返回全部）
+        int legacy_count = 0, all_count = 0;
+        DocScore *legacy = NULL;
+        double legacy_ms = -1.0;
+        if (q < num_queries) {
+            double start = now_seconds();
+            legacy = legacy_document_scores(segment, handles, num_terms, &legacy_count);
+            legacy_ms = (now_seconds() - start) * 1000.0;
+        } else {
+            legacy = calculate_document_scores(segment, handles, num_terms, NULL, NULL, 0, &legacy_count);
+        }
+        all_count = legacy_count;
+
+        int count = 0, pruned_count = 0;
+        DocScore *top = NULL, *pruned_top = NULL;
+        double start = now_seconds();
+        for (int r = 0; r < BENCH_REPEAT; r++) {
+            free(top);
+            top = calculate_document_scores(segment, handles, num_terms, NULL, NULL, k, &count);
+        }
+        double exhaustive_ms = (now_seconds() - start) * 1000.0 / BENCH_REPEAT;
+
+        start = now_seconds();
+        for (int r = 0; r < BENCH_REPEAT; r++) {
+            free(pruned_top);
+            pruned_top = calculate_document_scores_pruned(segment, handles, num_terms, NULL, NULL, k, &pruned_count);
+        }
+        double pruned_ms = (now_seconds() - start) * 1000.0 / BENCH_REPEAT;
+
+        int bm25_count = 0, bm25_pruned_count = 0;
+        DocScore *bm25_top = NULL, *bm25_pruned_top = NULL;
+        start = now_seconds();
+        for (int r = 0; r < BENCH_REPEAT; r++) {
+            free(bm25_top);
+            bm25_top = calculate_document_scores(segment, handles, num_terms, NULL, &bm25, k, &bm25_count);
+        }
+        double bm25_ms = (now_seconds() - start) * 1000.0 / BENCH_REPEAT;
+
+        start = now_seconds();
+        for (int r = 0; r < BENCH_REPEAT; r++) {
+            free(bm25_pruned_top);
+            bm25_pruned_top = calculate_document_scores_pruned(segment, handles, num_terms, NULL, &bm25, k,
+                                                               &bm25_pruned_count);
+        }
+        double bm25_pruned_ms = (now_seconds() - start) * 1000.0 / BENCH_REPEAT;
+
+        // 两种模型下剪枝与穷举打分的前k名都必须逐位一致；旧实现按输入顺序累加，分数只比较到1e-9
+        int expected = legacy_count < k || k <= 0 ? legacy_count : k;
+        if (count != expected || pruned_count != expected || bm25_count != expected || bm25_pruned_count != expected) {
+            mismatches++;
+        } else {
+            for (int i = 0; i < count; i++) {
+                if (pruned_top[i].doc_id != top[i].doc_id || pruned_top[i].score != top[i].score
+                    || fabs(top[i].score - legacy[i].score) > 1e-9
+                    || bm25_pruned_top[i].doc_id != bm25_top[i].doc_id || bm25_pruned_top[i].score != bm25_top[i].score) {
+                    mismatches++;
+                    break;
+                }
+            }
+        }
+
+        if (legacy_ms >= 0) {
+            printf("%-22s %10d %12.2f %12.2f %12.2f %12.2f %12.2f\n", label, all_count, legacy_ms, exhaustive_ms,
+                   pruned_ms, bm25_ms, bm25_pruned_ms);
+        } else {
+            printf("%-22s %10d %12s %12.2f %12.2f %12.2f %12.2f\n", label, all_count, "-", exhaustive_ms, pruned_ms,
+                   bm25_ms, bm25_pruned_ms);
+        }
+        free(legacy);
+        free(top);
+        free(pruned_top);
+        free(bm25_top);
+        free(bm25_pruned_top);
+    }
+    free(handles);
+
+    segment_close(segment);
+    remove(BENCH_SEGMENT_FILE);
+
+    if (mismatches) {
+        printf("前%d名结果不一致的查询：%d\n", k, mismatches);
+        return 1;
+    }
+    printf("所有查询的前%d名结果一致\n", k);
+    return 0;
+}
@@ -0,0 +1,135 @@
+// 分词基准：在合成文本（默认64MB，大小写混合的英文单词、数字与标点）上
+// 对比各分词实现（逐字节 / SSE2 / AVX2）的吞吐量（MB/s），并校验它们切出的词条完全一致
+// 用法：bench_tokenizer [MB数]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "tokenizer.h"
+
+#define BENCH_REPEAT 5
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+    // xorshift64*：固定种子，每次运行生成相同的文本
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 词条数与内容校验和（FNV-1a，按词条顺序累积，词条之间插入分隔值）
+typedef struct TokenDigest {
+    size_t count;
+    size_t bytes;
+    uint64_t hash;
+} TokenDigest;
+
+static void digest_token(const char *token, size_t len, void *context) {
+    TokenDigest *digest = (TokenDigest*)context;
+    uint64_t hash = digest->hash;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)token[i]) * 0x100000001b3ULL;
+    }
+    digest->hash = (hash ^ 0xff) * 0x100000001b3ULL;
+    digest->count++;
+    digest->bytes += len;
+}
+
+static void count_token(const char *token, size_t len, void *context) {
+    (void)token;
+    (void)len;
+    (*(size_t*)context)++;
+}
+
+// 单词长度2~12，首字母大写或全大写的概率各约1/8，单词之间是空格、标点、数字或换行
+static void generate_text(char *text, size_t size) {
+    static const char delimiters[] = "      ,.;:!?()-'\"\n0123456789";
+    size_t i = 0;
+    while (i < size) {
+        uint64_t r = rng_next();
+        int len = 2 + (int)(r % 11);
+        int style = (int)((r >> 8) & 7);
+        for (int j = 0; j < len && i < size; j++) {
+            char c = (char)('a' + (rng_next() % 26));
+            if (style == 0 || (style == 1 && j == 0)) c = (char)(c - 'a' + 'A');
+            text[i++] = c;
+        }
+        int gap = 1 + (int)((r >> 16) % 3 == 0);
+        for (int j = 0; j < gap && i < size; j++) {
+            text[i++] = delimiters[(r >> (24 + j * 8)) % (sizeof(delimiters) - 1)];
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int megabytes = argc > 1 ? atoi(argv[1]) : 64;
+    if (megabytes <= 0) megabytes = 64;
+    size_t size = (size_t)megabytes << 20;
+
+    char *source = (char*)malloc(size);
+    char *work = (char*)malloc(size);
+    if (!source || !work) {
+        fprintf(stderr, "内存不足\n");
+        return 1;
+    }
+    generate_text(source, size);
+
+    printf("合成文本 %d MB，默认实现：%s\n", megabytes, tokenizer_kernel_name(tokenizer_detect_kernel()));
+    printf("%-8s %12s %12s %10s\n", "实现", "词条数", "耗时(ms)", "MB/s");
+
+    static const TokenizerKernel kernels[] = { TOKENIZER_SCALAR, TOKENIZER_SSE2, TOKENIZER_AVX2 };
+    int num_kernels = sizeof(kernels) / sizeof(kernels[0]);
+    TokenDigest reference = { 0, 0, 0 };
+    int mismatches = 0;
+
+    for (int k = 0; k < num_kernels; k++) {
+        if (!tokenizer_kernel_supported(kernels[k])) {
+            printf("%-8s %12s\n", tokenizer_kernel_name(kernels[k]), "不支持");
+            continue;
+        }
+
+        // 校验：整段文本一次分词，词条序列的摘要必须与逐字节实现一致
+        TokenDigest digest = { 0, 0, 0xcbf29ce484222325ULL };
+        memcpy(work, source, size);
+        tokenize_buffer_with(kernels[k], work, size, 1, digest_token, &digest);
+        if (kernels[k] == TOKENIZER_SCALAR) {
+            reference = digest;
+        } else if (digest.count != reference.count || digest.bytes != reference.bytes
+                   || digest.hash != reference.hash) {
+            mismatches++;
+        }
+
+        // 计时：每轮先恢复原文（折叠是原地进行的），只统计分词本身
+        double elapsed = 0.0;
+        size_t count = 0;
+        for (int r = 0; r < BENCH_REPEAT; r++) {
+            memcpy(work, source, size);
+            count = 0;
+            double start = now_seconds();
+            tokenize_buffer_with(kernels[k], work, size, 1, count_token, &count);
+            elapsed += now_seconds() - start;
+        }
+        elapsed /= BENCH_REPEAT;
+        printf("%-8s %12zu %12.2f %10.1f\n", tokenizer_kernel_name(kernels[k]), count,
+               elapsed * 1000.0, megabytes / elapsed);
+    }
+
+    free(source);
+    free(work);
+
+    if (mismatches) {
+        printf("词条与逐字节实现不一致的实现：%d\n", mismatches);
+        return 1;
+    }
+    printf("所有实现切出的词条一致\n");
+    return 0;
+}
@@ -1,170 +1,290 @@
 #include "inverted_index.h"
 
-unsigned int hash_function(const char *term, int num_buckets) {
-    unsigned int hash = 0;
-    while (*term) {
-        hash = (hash << 5) + *term++;
+#define DEFAULT_CAPACITY 1024
+
+uint32_t hash_term(const char *term, size_t len) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = 0x9747b28c5bd1e995ULL ^ (len * m);
+
+    const unsigned char *p = (const unsigned char*)term;
+    const unsigned char *end = p + (len & ~(size_t)7);
+    while (p != end) {
+        uint64_t k;
+        memcpy(&k, p, 8);
+        p += 8;
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    switch (len & 7) {
+        case 7: h ^= (uint64_t)p[6] << 48; /* fall through */
+        case 6: h ^= (uint64_t)p[5] << 40; /* fall through */
+        case 5: h ^= (uint64_t)p[4] << 32; /* fall through */
+        case 4: h ^= (uint64_t)p[3] << 24; /* fall through */
+        case 3: h ^= (uint64_t)p[2] << 16; /* fall through */
+        case 2: h ^= (uint64_t)p[1] << 8;  /* fall through */
+        case 1: h ^= (uint64_t)p[0];
+                h *= m;
     }
-    return hash % num_buckets;
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+static uint32_t round_up_pow2(uint32_t n) {
+    uint32_t capacity = 16;
+    while (capacity < n) capacity <<= 1;
+    return capacity;
 }
 
-InvertedIndex* inverted_index_create(int num_buckets, int num_docs) {
-    InvertedIndex *index = (InvertedIndex*)malloc(sizeof(InvertedIndex));
-    if (index) {
-        index->num_buckets = num_buckets;
-        index->num_docs = num_docs;
-        index->buckets = (IndexNode**)calloc(num_buckets, sizeof(IndexNode*));
+InvertedIndex* inverted_index_create(int initial_capacity, int num_docs) {
+    InvertedIndex *index = (InvertedIndex*)calloc(1, sizeof(InvertedIndex));
+    if (!index) return NULL;
+
+    index->num_docs = num_docs;
+    index->capacity = round_up_pow2(initial_capacity > 0 ? (uint32_t)initial_capacity : DEFAULT_CAPACITY);
+    index->slots = (TermSlot*)calloc(index->capacity, sizeof(TermSlot));
+    index->arena = arena_create();
+    if (!index->slots || !index->arena) {
+        free(index->slots);
+        free(index->arena);
+        free(index);
+        return NULL;
     }
     return index;
 }
 
-void inverted_index_add_term(InvertedIndex *index, const char *term, int doc_id) {
-    if (!index || !term) return;
-    
-    unsigned int bucket = hash_function(term, index->num_buckets);
-    IndexNode *current = index->buckets[bucket];
-    
-    // 检查词是否已存在
-    while (current) {
-        if (strcmp(current->term, term) == 0) {
-            // 检查该文档是否已在 postings 中
-            Posting *post = current->postings;
-            while (post) {
-                if (post->doc_id == doc_id) {
-                    post->term_frequency++;
-                    return;
-                }
-                if (!post->next) break;
-                post = post->next;
+// 线性探测：返回词条所在的槽，或应插入的空槽
+static TermSlot* find_slot(InvertedIndex *index, const char *term, size_t len, uint32_t hash) {
+    uint32_t mask = index->capacity - 1;
+    uint32_t i = hash & mask;
+    while (1) {
+        TermSlot *slot = &index->slots[i];
+        if (slot->term_id == 0) return slot;
+        if (slot->hash == hash) {
+            const TermEntry *entry = &index->terms[slot->term_id - 1];
+            if (entry->term_len == len && memcmp(index->term_bytes + entry->term_offset, term, len) == 0) {
+                return slot;
             }
-            
-            // 添加新的 posting
-            Posting *new_post = (Posting*)malloc(sizeof(Posting));
-            new_post->doc_id = doc_id;
-            new_post->term_frequency = 1;
-            new_post->next = current->postings;
-            current->postings = new_post;
-            current->doc_count++;
-            return;
         }
-        if (!current->next) break;
-        current = current->next;
+        i = (i + 1) & mask;
     }
+}
+
+// 容量翻倍并按保存的哈希值重新放置（无需重新计算哈希或比较字节）
+static int grow_slots(InvertedIndex *index) {
+    uint32_t capacity = index->capacity * 2;
+    TermSlot *slots = (TermSlot*)calloc(capacity, sizeof(TermSlot));
+    if (!slots) return -1;
+
+    uint32_t mask = capacity - 1;
+    for (uint32_t i = 0; i < index->capacity; i++) {
+        TermSlot slot = index->slots[i];
+        if (slot.term_id == 0) continue;
+        uint32_t j = slot.hash & mask;
+        while (slots[j].term_id != 0) j = (j + 1) & mask;
+        slots[j] = slot;
+    }
+    free(index->slots);
+    index->slots = slots;
+    index->capacity = capacity;
+    return 0;
+}
+
+// 把词条字节驻留到字节池，返回偏移
+static int intern_term(InvertedIndex *index, const char *term, size_t len, uint32_t *offset) {
+    size_t needed = index->term_bytes_size + len + 1;
+    if (needed > index->term_bytes_capacity) {
+        size_t capacity = index->term_bytes_capacity ? index->term_bytes_capacity : 4096;
+        while (capacity < needed) capacity *= 2;
+        char *bytes = (char*)realloc(index->term_bytes, capacity);
+        if (!bytes) return -1;
+        index->term_bytes = bytes;
+        index->term_bytes_capacity = capacity;
+    }
+    *offset = (uint32_t)index->term_bytes_size;
+    memcpy(index->term_bytes + index->term_bytes_size, term, len);
+    index->term_bytes[index->term_bytes_size + len] = '\0';
+    index->term_bytes_size = needed;
+    return 0;
+}
+
+// 查找词条，不存在则插入，返回词条ID（失败返回-1）
+static int find_or_insert(InvertedIndex *index, const char *term, size_t len) {
+    uint32_t hash = hash_term(term, len);
+    TermSlot *slot = find_slot(index, term, len, hash);
+    if (slot->term_id != 0) return (int)slot->term_id - 1;
+
+    if ((uint64_t)(index->num_terms + 1) * 10 > (uint64_t)index->capacity * 7) {
+        if (grow_slots(index) != 0) return -1;
+        slot = find_slot(index, term, len, hash);
+    }
+    if (index->num_terms == index->term_capacity) {
+        int capacity = index->term_capacity ? index->term_capacity * 2 : 1024;
+        TermEntry *terms = (TermEntry*)realloc(index->terms, capacity * sizeof(TermEntry));
+        if (!terms) return -1;
+        index->terms = terms;
+        index->term_capacity = capacity;
+    }
+
+    TermEntry *entry = &index->terms[index->num_terms];
+    if (intern_term(index, term, len, &entry->term_offset) != 0) return -1;
+    entry->term_len = (uint32_t)len;
+    posting_list_init(&entry->postings, index->arena);
+
+    slot->hash = hash;
+    slot->term_id = (uint32_t)index->num_terms + 1;
+    return index->num_terms++;
+}
+
+void inverted_index_add_term(InvertedIndex *index, const char *term, size_t len, int doc_id) {
+    if (!index || !term || len == 0) return;
     
-    // 词不存在，创建新的索引节点
-    IndexNode *new_node = (IndexNode*)malloc(sizeof(IndexNode));
-    new_node->term = (char*)malloc(strlen(term) + 1);
-    strcpy(new_node->term, term);
-    new_node->doc_count = 1;
-    
-    // 创建 posting
-    new_node->postings = (Posting*)malloc(sizeof(Posting));
-    new_node->postings->doc_id = doc_id;
-    new_node->postings->term_frequency = 1;
-    new_node->postings->next = NULL;
-    
-    // 添加到链表
-    new_node->next = index->buckets[bucket];
-    index->buckets[bucket] = new_node;
+    // 同一文档的词频累加，新文档追加到postings末尾
+    int term_id = find_or_insert(index, term, len);
+    if (term_id < 0) return;
+    posting_list_add_occurrence(&index->terms[term_id].postings, doc_id);
 }
 
-Posting* inverted_index_get_postings(InvertedIndex *index, const char *term) {
-    if (!index || !term) return NULL;
+void inverted_index_add_term_at(InvertedIndex *index, const char *term, size_t len, int doc_id, uint32_t position) {
+    if (!index || !term || len == 0) return;
     
-    unsigned int bucket = hash_function(term, index->num_buckets);
-    IndexNode *current = index->buckets[bucket];
+    int term_id = find_or_insert(index, term, len);
+    if (term_id < 0) return;
+    posting_list_add_position(&index->terms[term_id].postings, doc_id, position);
+}
+
+int inverted_index_intern(InvertedIndex *index, const char *term, size_t len) {
+    if (!index || !term || len == 0) return -1;
+    return find_or_insert(index, term, len);
+}
+
+int* inverted_index_merge_terms(InvertedIndex *dst, InvertedIndex *src) {
+    if (!dst || !src) return NULL;
     
-    while (current) {
-        if (strcmp(current->term, term) == 0) {
-            return current->postings;
+    int *mapping = (int*)malloc((src->num_terms > 0 ? src->num_terms : 1) * sizeof(int));
+    if (!mapping) return NULL;
+    for (int i = 0; i < src->num_terms; i++) {
+        const TermEntry *entry = &src->terms[i];
+        mapping[i] = find_or_insert(dst, src->term_bytes + entry->term_offset, entry->term_len);
+        if (mapping[i] < 0) {
+            free(mapping);
+            return NULL;
         }
-        current = current->next;
     }
-    
-    return NULL;
+    arena_adopt(dst->arena, src->arena);
+    return mapping;
 }
 
-void inverted_index_free(InvertedIndex *index) {
-    if (!index) return;
+int inverted_index_merge_postings(InvertedIndex *dst, InvertedIndex *src, const int *mapping,
+                                  int stripe, int num_stripes, Arena *arena) {
+    if (!dst || !src || !mapping || num_stripes <= 0) return -1;
+    if (!arena) arena = dst->arena;
     
-    for (int i = 0; i < index->num_buckets; i++) {
-        IndexNode *current = index->buckets[i];
-        while (current) {
-            IndexNode *temp = current;
-            current = current->next;
-            
-            // 释放 postings
-            Posting *post = temp->postings;
-            while (post) {
-                Posting *post_temp = post;
-                post = post->next;
-                free(post_temp);
-            }
-            
-            free(temp->term);
-            free(temp);
+    // 经手的列表之后都从本stripe的arena分配（src的arena已归dst，不能被多个stripe同时使用）
+    for (int i = 0; i < src->num_terms; i++) {
+        int term_id = mapping[i];
+        if (term_id % num_stripes != stripe) continue;
+        
+        PostingList *postings = &dst->terms[term_id].postings;
+        PostingList *source = &src->terms[i].postings;
+        if (postings->doc_count == 0) {
+            // dst中的新词条：直接接管src的postings缓冲区（连同未封口的状态），不复制
+            *postings = *source;
+            postings->arena = arena;
+            posting_list_init(source, arena);
+        } else {
+            postings->arena = arena;
+            source->arena = arena;
+            posting_list_seal(source);
+            if (posting_list_concat(postings, source) != 0) return -1;
+            posting_list_free(source);
         }
     }
+    return 0;
+}
+
+int inverted_index_find(InvertedIndex *index, const char *term, size_t len) {
+    if (!index || !term) return -1;
+    TermSlot *slot = find_slot(index, term, len, hash_term(term, len));
+    return (int)slot->term_id - 1;
+}
+
+const char* inverted_index_term(InvertedIndex *index, int term_id) {
+    if (!index || term_id < 0 || term_id >= index->num_terms) return NULL;
+    return index->term_bytes + index->terms[term_id].term_offset;
+}
+
+PostingList* inverted_index_get_postings(InvertedIndex *index, const char *term) {
+    int term_id = inverted_index_find(index, term, term ? strlen(term) : 0);
+    return term_id >= 0 ? &index->terms[term_id].postings : NULL;
+}
+
+void inverted_index_seal(InvertedIndex *index) {
+    if (!index) return;
     
-    free(index->buckets);
-    free(index);
+    for (int i = 0; i < index->num_terms; i++) {
+        posting_list_seal(&index->terms[i].postings);
+    }
 }
 
-void inverted_index_save(InvertedIndex *index, const char *filename) {
-    if (!index || !filename) return;
+void inverted_index_adopt_arena(InvertedIndex *index, Arena *arena) {
+    if (!index || !arena || arena == index->arena) return;
     
-    FILE *file = fopen(filename, "wb");
-    if (!file) return;
+    arena_adopt(index->arena, arena);
+    for (int i = 0; i < index->num_terms; i++) {
+        if (index->terms[i].postings.arena == arena) index->terms[i].postings.arena = index->arena;
+    }
+}
+
+void inverted_index_free(InvertedIndex *index) {
+    if (!index) return;
     
-    // 保存基本信息
-    fwrite(&index->num_buckets, sizeof(int), 1, file);
-    fwrite(&index->num_docs, sizeof(int), 1, file);
+    // postings缓冲区都在arena中，不逐个释放
+    arena_destroy(index->arena);
+    free(index->terms);
+    free(index->term_bytes);
+    free(index->slots);
+    free(index);
+}
+
+void inverted_index_memory(const InvertedIndex *index, IndexMemory *memory) {
+    memset(memory, 0, sizeof(IndexMemory));
+    if (!index) return;
     
-    // 保存每个桶的内容
-    for (int i = 0; i < index->num_buckets; i++) {
-        IndexNode *current = index->buckets[i];
-        
-        // 保存该桶中节点数量
-        int node_count = 0;
-        IndexNode *temp = current;
-        while (temp) {
-            node_count++;
-            temp = temp->next;
-        }
-        fwrite(&node_count, sizeof(int), 1, file);
-        
-        // 保存每个节点
-        while (current) {
-            // 保存词
-            int term_len = strlen(current->term);
-            fwrite(&term_len, sizeof(int), 1, file);
-            fwrite(current->term, sizeof(char), term_len, file);
-            
-            // 保存文档计数
-            fwrite(&current->doc_count, sizeof(int), 1, file);
-            
-            // 保存posting数量
-            int post_count = 0;
-            Posting *post = current->postings;
-            while (post) {
-                post_count++;
-                post = post->next;
-            }
-            fwrite(&post_count, sizeof(int), 1, file);
-            
-            // 保存每个posting
-            post = current->postings;
-            while (post) {
-                fwrite(&post->doc_id, sizeof(int), 1, file);
-                fwrite(&post->term_frequency, sizeof(int), 1, file);
-                post = post->next;
-            }
-            
-            current = current->next;
-        }
+    memory->slots = (size_t)index->capacity * sizeof(TermSlot);
+    memory->terms = (size_t)index->term_capacity * sizeof(TermEntry);
+    memory->term_bytes = index->term_bytes_capacity;
+    for (int i = 0; i < index->num_terms; i++) {
+        const PostingList *list = &index->terms[i].postings;
+        memory->postings += list->capacity;
+        memory->skip_blocks += (size_t)list->block_capacity * sizeof(PostingBlock);
+        memory->positions += list->positions_capacity;
+        memory->position_blocks += (size_t)list->position_block_capacity * sizeof(uint64_t);
+    }
+    if (index->arena) {
+        memory->arena_reserved = index->arena->reserved;
+        memory->arena_used = index->arena->used;
+        memory->arena_chunks = index->arena->num_chunks;
     }
-    
-    fclose(file);
+}
+
+// 旧格式中postings无序，按文档ID排序后再压缩
+typedef struct LegacyPosting {
+    int doc_id;
+    int term_frequency;
+} LegacyPosting;
+
+static int compare_legacy_postings(const void *a, const void *b) {
+    const LegacyPosting *post_a = (const LegacyPosting*)a;
+    const LegacyPosting *post_b = (const LegacyPosting*)b;
+    return (post_a->doc_id > post_b->doc_id) - (post_a->doc_id < post_b->doc_id);
 }
 
 InvertedIndex* inverted_index_load(const char *filename) {
@@ -173,30 +293,21 @@ InvertedIndex* inverted_index_load(const char *filename) {
     FILE *file = fopen(filename, "rb");
     if (!file) return NULL;
     
-    InvertedIndex *index = (InvertedIndex*)malloc(sizeof(InvertedIndex));
-    if (!index) {
-        fclose(file);
-        return NULL;
-    }
-    
-    // 加载基本信息
-    fread(&index->num_buckets, sizeof(int), 1, file);
-    fread(&index->num_docs, sizeof(int), 1, file);
+    // 加载基本信息（旧格式的桶数只用于遍历文件结构）
+    int num_buckets = 0, num_docs = 0;
+    fread(&num_buckets, sizeof(int), 1, file);
+    fread(&num_docs, sizeof(int), 1, file);
     
-    index->buckets = (IndexNode**)calloc(index->num_buckets, sizeof(IndexNode*));
-    if (!index->buckets) {
-        free(index);
+    InvertedIndex *index = inverted_index_create(0, num_docs);
+    if (!index) {
         fclose(file);
         return NULL;
     }
     
     // 加载每个桶的内容
-    for (int i = 0; i < index->num_buckets; i++) {
+    for (int i = 0; i < num_buckets; i++) {
         int node_count;
-        fread(&node_count, sizeof(int), 1, file);
-        
-        IndexNode *head = NULL;
-        IndexNode **current_ptr = &head;
+        if (fread(&node_count, sizeof(int), 1, file) != 1) break;
         
         for (int j = 0; j < node_count; j++) {
             // 加载词
@@ -215,36 +326,27 @@ InvertedIndex* inverted_index_load(const char *filename) {
             int post_count;
             fread(&post_count, sizeof(int), 1, file);
             
-            // 创建索引节点
-            *current_ptr = (IndexNode*)malloc(sizeof(IndexNode));
-            (*current_ptr)->term = term;
-            (*current_ptr)->doc_count = doc_count;
-            (*current_ptr)->next = NULL;
+            int term_id = find_or_insert(index, term, term_len);
+            free(term);
             
             // 加载postings
-            Posting *post_head = NULL;
-            Posting **post_ptr = &post_head;
-            
+            LegacyPosting *posts = (LegacyPosting*)malloc((post_count > 0 ? post_count : 1) * sizeof(LegacyPosting));
             for (int k = 0; k < post_count; k++) {
-                int doc_id, term_freq;
-                fread(&doc_id, sizeof(int), 1, file);
-                fread(&term_freq, sizeof(int), 1, file);
-                
-                *post_ptr = (Posting*)malloc(sizeof(Posting));
-                (*post_ptr)->doc_id = doc_id;
-                (*post_ptr)->term_frequency = term_freq;
-                (*post_ptr)->next = NULL;
-                
-                post_ptr = &(*post_ptr)->next;
+                fread(&posts[k].doc_id, sizeof(int), 1, file);
+                fread(&posts[k].term_frequency, sizeof(int), 1, file);
             }
-            
-            (*current_ptr)->postings = post_head;
-            current_ptr = &(*current_ptr)->next;
+            qsort(posts, post_count, sizeof(LegacyPosting), compare_legacy_postings);
+            if (term_id >= 0) {
+                PostingList *list = &index->terms[term_id].postings;
+                for (int k = 0; k < post_count; k++) {
+                    posting_list_append(list, posts[k].doc_id, posts[k].term_frequency);
+                }
+                posting_list_seal(list);
+            }
+            free(posts);
         }
-        
-        index->buckets[i] = head;
     }
     
     fclose(file);
     return index;
-}
\ No newline at end of file
+}
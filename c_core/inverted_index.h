@@ -4,35 +4,82 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include "postings.h"
 
-typedef struct Posting {
-    int doc_id;
-    int term_frequency;
-    struct Posting *next;
-} Posting;
+// 词典条目：词条字节驻留在索引的字节池中，按偏移引用
+typedef struct TermEntry {
+    uint32_t term_offset; // 在term_bytes中的偏移（词条以'\0'结尾）
+    uint32_t term_len;
+    PostingList postings; // 按文档ID排序的分块压缩postings（postings.doc_count即包含该词的文档数）
+} TermEntry;
 
-typedef struct IndexNode {
-    char *term;
-    Posting *postings;
-    int doc_count; // 包含该词的文档数
-    struct IndexNode *next;
-} IndexNode;
+// 开放寻址哈希槽：保存哈希值，探测时先比较哈希再比较字节
+typedef struct TermSlot {
+    uint32_t hash;
+    uint32_t term_id; // 词条ID+1，0表示空槽
+} TermSlot;
 
 typedef struct InvertedIndex {
-    IndexNode **buckets;
-    int num_buckets;
+    TermSlot *slots;       // 线性探测哈希表，容量为2的幂，装载因子超过0.7时翻倍
+    uint32_t capacity;
+    TermEntry *terms;      // 按插入顺序排列，下标即词条ID
+    int num_terms;
+    int term_capacity;
+    char *term_bytes;      // 所有词条字节的驻留池
+    size_t term_bytes_size;
+    size_t term_bytes_capacity;
+    Arena *arena;          // 所有postings缓冲区的分配区：释放索引时按chunk整体释放，不逐个词条释放
     int num_docs; // 总文档数
 } InvertedIndex;
 
-// 哈希函数
-unsigned int hash_function(const char *term, int num_buckets);
+// 索引各部分占用的字节数（按已分配的容量计）
+typedef struct IndexMemory {
+    size_t slots;           // 哈希槽
+    size_t terms;           // 词条数组
+    size_t term_bytes;      // 词条字节池
+    size_t postings;        // postings数据
+    size_t skip_blocks;     // 跳表头
+    size_t positions;       // 位置字节流
+    size_t position_blocks; // 每块的位置数据偏移
+    size_t arena_reserved;  // arena向系统申请的字节数（postings各缓冲区都在其中）
+    size_t arena_used;      // 其中已分配出去的字节数（按2的幂取整后的块大小计）
+    size_t arena_chunks;
+} IndexMemory;
 
-// 倒排索引操作
-InvertedIndex* inverted_index_create(int num_buckets, int num_docs);
-void inverted_index_add_term(InvertedIndex *index, const char *term, int doc_id);
-Posting* inverted_index_get_postings(InvertedIndex *index, const char *term);
+// 哈希函数（64位MurmurHash2变体折叠为32位；段文件中的哈希表使用同一函数）
+uint32_t hash_term(const char *term, size_t len);
+
+// 倒排索引操作（文档ID需按递增顺序添加；initial_capacity为0时使用默认容量）
+InvertedIndex* inverted_index_create(int initial_capacity, int num_docs);
+// 添加词条(term, len)的一次出现（term无需以'\0'结尾，字节会复制到索引的字节池）
+void inverted_index_add_term(InvertedIndex *index, const char *term, size_t len, int doc_id);
+// 同上，并记录该次出现在文档中的位置（第几个词，同一文档内递增）；一个索引要么都记录位置，要么都不记录
+void inverted_index_add_term_at(InvertedIndex *index, const char *term, size_t len, int doc_id, uint32_t position);
+// 确保词条(term, len)存在（不添加出现），返回词条ID，失败返回-1；之后可直接向其postings追加
+int inverted_index_intern(InvertedIndex *index, const char *term, size_t len);
+// 合并部分索引（src的文档ID必须都大于dst中已有的文档ID，例如按文档ID区间分别构建的部分索引）分两步：
+// 1. merge_terms把src的词条插入dst，返回src词条ID到dst词条ID的映射（调用者释放），失败返回NULL；
+//    dst同时接管src的arena（src的postings缓冲区之后归dst所有，会被直接移入dst）
+// 2. merge_postings把src的postings接到dst对应词条末尾，只处理dst词条ID % num_stripes == stripe的词条，
+//    不同stripe互不相交，可由多个线程并行执行；src的postings被移走或消耗，之后只能释放。
+//    arena为本stripe扩容时使用的分配区（NULL表示dst->arena），并行时每个stripe各用一个，
+//    全部完成后由inverted_index_adopt_arena交给dst
+int* inverted_index_merge_terms(InvertedIndex *dst, InvertedIndex *src);
+int inverted_index_merge_postings(InvertedIndex *dst, InvertedIndex *src, const int *mapping,
+                                  int stripe, int num_stripes, Arena *arena);
+// 接管arena中的全部内存，之后arena为空，可以销毁
+void inverted_index_adopt_arena(InvertedIndex *index, Arena *arena);
+// 查找词条，返回词条ID，不存在返回-1
+int inverted_index_find(InvertedIndex *index, const char *term, size_t len);
+const char* inverted_index_term(InvertedIndex *index, int term_id);
+PostingList* inverted_index_get_postings(InvertedIndex *index, const char *term);
+// 封口所有postings列表（写段文件前调用）
+void inverted_index_seal(InvertedIndex *index);
 void inverted_index_free(InvertedIndex *index);
-void inverted_index_save(InvertedIndex *index, const char *filename);
+// 统计索引各部分占用的字节数
+void inverted_index_memory(const InvertedIndex *index, IndexMemory *memory);
+// 加载旧格式的索引文件（inverted_index.dat，仅供格式转换使用；新索引见segment.h）
 InvertedIndex* inverted_index_load(const char *filename);
 
-#endif
\ No newline at end of file
+#endif
@@ -3,10 +3,18 @@
 #include <string.h>
 #include "trie.h"
 #include "inverted_index.h"
+#include "query_cache.h"
+#include "query_stats.h"
 #include "search.h"
+#include "segment.h"
+#include "segment_set.h"
+#include "server.h"
+#include "thread.h"
 #include "utils.h"
 #ifdef _WIN32
 #include <windows.h>
+#include <io.h>
+#include <fcntl.h>
 #endif
 
 
@@ -22,31 +30,43 @@ void create_index_dir() {
     #endif
 }
 
-// 构建索引（使用相对路径）
-void build_index(const char *doc_dir) {
-    printf("正在构建索引...\n");
+// 打印构建期索引各部分占用的内存
+static void print_index_memory(const InvertedIndex *index) {
+    IndexMemory memory;
+    inverted_index_memory(index, &memory);
+    const double mb = 1024.0 * 1024.0;
+    printf("索引内存：词典 %.1f MB（哈希槽 %.1f，词条 %.1f，字节池 %.1f），postings %.1f MB，跳表头 %.1f MB，"
+           "位置 %.1f MB，位置块偏移 %.1f MB；arena %llu 个chunk，申请 %.1f MB，已分配 %.1f MB\n",
+           (memory.slots + memory.terms + memory.term_bytes) / mb, memory.slots / mb, memory.terms / mb,
+           memory.term_bytes / mb, memory.postings / mb, memory.skip_blocks / mb, memory.positions / mb,
+           memory.position_blocks / mb, (unsigned long long)memory.arena_chunks, memory.arena_reserved / mb,
+           memory.arena_used / mb);
+}
+
+// 构建索引（使用相对路径；num_threads<=0表示使用全部CPU核）
+void build_index(const char *doc_dir, int num_threads) {
+    if (num_threads <= 0) num_threads = cpu_count();
+    printf("正在构建索引（%d 个线程）...\n", num_threads);
     
     // 创建索引目录
     create_index_dir();
     
-    // 初始化数据结构
-    TrieNode *trie = trie_create_node();
-    const int NUM_BUCKETS = 10007;
+    // 初始化数据结构（词典按需扩容，无需预设桶数）
     int num_docs = 0;
     char **doc_paths = NULL;
-    InvertedIndex *index = inverted_index_create(NUM_BUCKETS, num_docs);
+    InvertedIndex *index = inverted_index_create(0, num_docs);
     
     // 从文档目录构建索引
-    build_index_from_docs(doc_dir, trie, index, &doc_paths, &num_docs);
+    build_index_from_docs(doc_dir, index, &doc_paths, &num_docs, num_threads);
     index->num_docs = num_docs;
+    print_index_memory(index);
     
-    // 保存索引到index_data目录（相对路径）
-    trie_save(trie, INDEX_DIR "/trie.dat");
-    inverted_index_save(index, INDEX_DIR "/inverted_index.dat");
-    save_doc_paths(doc_paths, num_docs, INDEX_DIR "/doc_paths.dat");
+    // 保存为一个新段，清单替换为只含该段（相对路径）
+    if (segment_set_replace(INDEX_DIR, index, doc_paths, num_docs) != 0) {
+        printf("索引写入失败：%s\n", INDEX_DIR);
+    }
     
     // 释放内存
-    trie_free(trie);
     inverted_index_free(index);
     for (int i = 0; i < num_docs; i++) free(doc_paths[i]);
     free(doc_paths);
@@ -54,30 +74,262 @@ void build_index(const char *doc_dir) {
     printf("索引构建完成，共处理 %d 个文档\n", num_docs);
 }
 
-// 加载索引（使用相对路径）
-void load_index(TrieNode **trie, InvertedIndex **index, char ***doc_paths, int *num_docs) {
+// 分片构建：文档按路径排序后切成num_shards个连续区间，每个分片只为自己的区间建一个索引（内存占用按分片计）
+typedef struct ShardBuild {
+    char **paths;
+    int num_paths;
+    int num_threads;
+    int total_docs; // 已写入的文档数
+} ShardBuild;
+
+static int build_shard(int shard, int num_shards, const char *shard_dir, void *context) {
+    ShardBuild *build = (ShardBuild*)context;
+    int begin = (int)((long long)build->num_paths * shard / num_shards);
+    int end = (int)((long long)build->num_paths * (shard + 1) / num_shards);
+    
+    int num_docs = 0;
+    char **doc_paths = NULL;
+    InvertedIndex *index = inverted_index_create(0, 0);
+    build_index_from_files(build->paths + begin, end - begin, index, &doc_paths, &num_docs, build->num_threads);
+    index->num_docs = num_docs;
+    int status = segment_set_replace(shard_dir, index, doc_paths, num_docs);
+    if (status == 0) {
+        printf("分片 %d/%d：%d 个文档\n", shard + 1, num_shards, num_docs);
+        build->total_docs += num_docs;
+    }
+    
+    inverted_index_free(index);
+    for (int i = 0; i < num_docs; i++) free(doc_paths[i]);
+    free(doc_paths);
+    return status;
+}
+
+// 构建分片索引（num_shards超过文档数时按文档数分片，不足2个时按不分片构建）
+void build_sharded_index(const char *doc_dir, int num_threads, int num_shards) {
+    if (num_threads <= 0) num_threads = cpu_count();
+    ShardBuild build = { NULL, 0, num_threads, 0 };
+    build.paths = list_documents(doc_dir, &build.num_paths);
+    if (num_shards > build.num_paths) num_shards = build.num_paths;
+    if (num_shards > MAX_SHARDS) num_shards = MAX_SHARDS;
+    if (num_shards < 2) {
+        for (int i = 0; i < build.num_paths; i++) free(build.paths[i]);
+        free(build.paths);
+        build_index(doc_dir, num_threads);
+        return;
+    }
+    printf("正在构建索引（%d 个分片，%d 个线程）...\n", num_shards, num_threads);
+    create_index_dir();
+    
+    if (segment_set_replace_sharded(INDEX_DIR, num_shards, build_shard, &build) != 0) {
+        printf("索引写入失败：%s\n", INDEX_DIR);
+    } else {
+        printf("索引构建完成，共处理 %d 个文档\n", build.total_docs);
+    }
+    for (int i = 0; i < build.num_paths; i++) free(build.paths[i]);
+    free(build.paths);
+}
+
+// 增量添加：只索引目录中尚未收录的文档，写成一个新段追加到清单末尾
+typedef struct IndexedPaths {
+    char **paths; // 已收录文档的路径（排序后二分查找）
+    int count;
+} IndexedPaths;
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static int is_new_document(const char *path, void *context) {
+    const IndexedPaths *indexed = (const IndexedPaths*)context;
+    return bsearch(&path, indexed->paths, indexed->count, sizeof(char*), compare_paths) == NULL;
+}
+
+int add_documents(const char *doc_dir, int num_threads) {
+    if (num_threads <= 0) num_threads = cpu_count();
+    printf("正在增量添加文档（%d 个线程）...\n", num_threads);
+    
+    // 已有索引中的文档路径（没有索引时全部视为新文档）
+    IndexedPaths indexed = { NULL, 0 };
+    SegmentSet *set = segment_set_open(INDEX_DIR);
+    if (set && set->total_docs > 0) {
+        indexed.paths = (char**)malloc(set->total_docs * sizeof(char*));
+        for (int i = 0; indexed.paths && i < set->total_docs; i++) {
+            if (!segment_set_is_live(set, i)) continue; // 已删除的文档可以重新添加
+            const char *path = segment_set_doc_path(set, i);
+            if (path) indexed.paths[indexed.count++] = (char*)path;
+        }
+        if (indexed.paths) qsort(indexed.paths, indexed.count, sizeof(char*), compare_paths);
+    }
+    
+    int num_docs = 0;
+    char **doc_paths = NULL;
+    InvertedIndex *index = inverted_index_create(0, 0);
+    build_index_from_filtered_docs(doc_dir, is_new_document, &indexed, index, &doc_paths, &num_docs, num_threads);
+    index->num_docs = num_docs;
+    free(indexed.paths);
+    segment_set_close(set);
+    
+    int status = 0;
+    if (num_docs == 0) {
+        printf("没有需要添加的新文档\n");
+    } else if (segment_set_append(INDEX_DIR, index, doc_paths, num_docs) != 0) {
+        printf("索引写入失败：%s\n", INDEX_DIR);
+        status = 1;
+    } else {
+        printf("增量添加完成，新增 %d 个文档\n", num_docs);
+    }
+    
+    inverted_index_free(index);
+    for (int i = 0; i < num_docs; i++) free(doc_paths[i]);
+    free(doc_paths);
+    return status;
+}
+
+// 按文档路径删除（路径与搜索结果中显示的一致），只写删除标记，不重建索引
+int delete_documents(char **paths, int count) {
+    int deleted = segment_set_delete(INDEX_DIR, paths, count);
+    if (deleted < 0) {
+        printf("删除失败：%s\n", INDEX_DIR);
+        return 1;
+    }
+    printf("删除完成，共删除 %d 个文档\n", deleted);
+    return 0;
+}
+
+// 更新文档：删除这些路径的旧版本，重新索引仍存在的文件并写成新段，两者同时生效
+int update_documents(char **paths, int count) {
+    int num_docs = 0;
+    char **doc_paths = NULL;
+    InvertedIndex *index = inverted_index_create(0, 0);
+    build_index_from_files(paths, count, index, &doc_paths, &num_docs, 0);
+    index->num_docs = num_docs;
+    
+    int deleted = segment_set_update(INDEX_DIR, paths, count, index, doc_paths, num_docs);
+    int status = 0;
+    if (deleted < 0) {
+        printf("更新失败：%s\n", INDEX_DIR);
+        status = 1;
+    } else {
+        printf("更新完成，删除 %d 个旧文档，写入 %d 个新文档\n", deleted, num_docs);
+    }
+    
+    inverted_index_free(index);
+    for (int i = 0; i < num_docs; i++) free(doc_paths[i]);
+    free(doc_paths);
+    return status;
+}
+
+// 手动合并：按分层策略反复合并，直到没有需要合并的段
+int merge_index() {
+    int merged = 0;
+    int status;
+    while ((status = segment_set_merge_once(INDEX_DIR)) == 1) merged++;
+    if (status < 0) {
+        printf("段合并失败：%s\n", INDEX_DIR);
+        return 1;
+    }
+    printf("段合并完成，共执行 %d 次合并\n", merged);
+    return 0;
+}
+
+// 将旧格式索引（trie.dat/inverted_index.dat/doc_paths.dat）转换为段文件
+int convert_legacy_index() {
+    printf("正在转换旧格式索引...\n");
+    
+    Trie *trie = trie_load(INDEX_DIR "/trie.dat");
+    InvertedIndex *index = inverted_index_load(INDEX_DIR "/inverted_index.dat");
+    int num_docs = 0;
+    char **doc_paths = load_doc_paths(INDEX_DIR "/doc_paths.dat", &num_docs);
+    
+    if (!index || !doc_paths || num_docs <= 0) {
+        printf("旧格式索引加载失败，请确保index_data目录下有inverted_index.dat和doc_paths.dat\n");
+        trie_free(trie);
+        inverted_index_free(index);
+        for (int i = 0; i < num_docs; i++) free(doc_paths[i]);
+        free(doc_paths);
+        return 1;
+    }
+    index->num_docs = num_docs;
+    
+    // 段文件的词典同时承担前缀查询，Trie树只用于校验词表是否一致
+    if (trie) {
+        int missing = 0;
+        for (int i = 0; i < index->num_terms; i++) {
+            if (!trie_search(trie, inverted_index_term(index, i))) missing++;
+        }
+        if (missing > 0) {
+            printf("警告：%d 个索引词条不在trie.dat中\n", missing);
+        }
+    }
+    
+    int status = segment_set_replace(INDEX_DIR, index, doc_paths, num_docs);
+    if (status == 0) {
+        printf("转换完成：%s（%d 个文档）\n", INDEX_DIR, num_docs);
+    } else {
+        printf("索引写入失败：%s\n", INDEX_DIR);
+    }
+    
+    trie_free(trie);
+    inverted_index_free(index);
+    for (int i = 0; i < num_docs; i++) free(doc_paths[i]);
+    free(doc_paths);
+    return status == 0 ? 0 : 1;
+}
+
+// 加载索引（映射清单中的全部段文件，不做反序列化）
+SegmentSet* load_index() {
     printf("正在加载索引...\n");
     
-    // 从index_data目录加载索引（相对路径）
-    *trie = trie_load(INDEX_DIR "/trie.dat");
-    *index = inverted_index_load(INDEX_DIR "/inverted_index.dat");
-    *doc_paths = load_doc_paths(INDEX_DIR "/doc_paths.dat", num_docs);
+    SegmentSet *set = segment_set_open(INDEX_DIR);
     
     // 检查是否加载成功
-    if (!*trie || !*index || !*doc_paths || *num_docs <= 0) {
+    if (!set || set->total_docs <= 0) {
         printf("索引加载失败！请先构建索引。\n");
-        printf("请确保index_data目录下有以下文件：\n");
-        printf("- trie.dat\n- inverted_index.dat\n- doc_paths.dat\n");
+        printf("请确保index_data目录下有MANIFEST或index.seg文件（旧格式索引可用 convert 模式转换）\n");
         exit(1);
     }
     
-    printf("索引加载完成，共 %d 个文档\n", *num_docs);
+    if (set->num_shards > 1) {
+        printf("索引加载完成，共 %d 个文档（%d 个分片，%d 个段）\n", set->live_docs, set->num_shards, set->num_segments);
+    } else {
+        printf("索引加载完成，共 %d 个文档（%d 个段）\n", set->live_docs, set->num_segments);
+    }
+    return set;
+}
+
+// 常驻服务模式：只加载一次索引，通过stdin/stdout分帧协议处理请求（协议见server.h）
+// cache_bytes为各工作线程的查询结果缓存合计的内存上限（各线程均分），record_stats非0时每次执行的搜索计入进程内的耗时直方图，
+// num_workers为并发执行查询的工作线程数（<=0表示CPU核数）
+int serve_index(size_t cache_bytes, int record_stats, int num_workers) {
+    #ifdef _WIN32
+        // 负载按字节计数，需关闭换行符转换
+        _setmode(_fileno(stdin), _O_BINARY);
+        _setmode(_fileno(stdout), _O_BINARY);
+    #endif
+
+    // stdout只用于协议，加载信息输出到stderr
+    SegmentSet *set = segment_set_open(INDEX_DIR);
+    if (!set || set->total_docs <= 0) {
+        fprintf(stderr, "索引加载失败：%s\n", INDEX_DIR);
+        segment_set_close(set);
+        return 1;
+    }
+    
+    // 服务期间由后台线程合并增量添加的小段，合并后服务自动切换到新的段集合
+    SegmentMerger *merger = segment_merger_start(INDEX_DIR);
+    if (num_workers <= 0) num_workers = cpu_count();
+    int status = server_run(&set, INDEX_DIR, cache_bytes, record_stats, num_workers, stdin, stdout);
+    segment_merger_stop(merger);
+    segment_set_close(set);
+    return status;
 }
 
 // 交互式搜索功能
-void interactive_search(TrieNode *trie, InvertedIndex *index, char **doc_paths, int num_docs) {
+void interactive_search(const SegmentSet *set, const SearchOptions *options) {
     char query[BUFFER_SIZE];
     printf("\n进入搜索模式，输入查询词（输入q退出）：\n");
+    SearchContext *context = search_context_create();
+    if (!context) return;
     
     while (1) {
         printf("搜索: ");
@@ -89,9 +341,12 @@ void interactive_search(TrieNode *trie, InvertedIndex *index, char **doc_paths,
         // 退出条件
         if (strcmp(query, "q") == 0 || strcmp(query, "Q") == 0) break;
         
-        // 执行搜索并显示结果
+        // 执行搜索并显示结果（结果归上下文所有，下一次查询时作废）
         int result_count;
-        SearchResult *results = perform_search(trie, index, query, doc_paths, num_docs, &result_count);
+        const SearchResult *results = search_context_run(context, set, query, options, &result_count);
+        if (result_count == 0) {
+            printf("未找到与\"%s\"匹配的文档\n", query);
+        }
         
         printf("\n找到 %d 个结果：\n", result_count);
         for (int i = 0; i < result_count; i++) {
@@ -99,9 +354,8 @@ void interactive_search(TrieNode *trie, InvertedIndex *index, char **doc_paths,
             printf("%d. 文档: %s (分数: %.4f)\n", 
                    i + 1, results[i].doc_path, results[i].score);
         }
-        
-        free_search_results(results, result_count);
     }
+    search_context_free(context);
 }
 
 int main(int argc, char *argv[]) {
@@ -109,60 +363,142 @@ int main(int argc, char *argv[]) {
         SetConsoleOutputCP(CP_UTF8); // 确保中文输出正常（若有）
     #endif
 
-    // 检查参数：支持3种模式（构建索引、交互搜索、命令行搜索）
+    // 检查参数：支持10种模式（构建索引、交互搜索、命令行搜索、旧索引转换、常驻服务、前缀建议、增量添加、段合并、删除、更新）
+    // 模式7：增量添加（参数为"add" + 文档目录 [+ 线程数]）
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "add") == 0) {
+        return add_documents(argv[2], argc == 4 ? atoi(argv[3]) : 0);
+    }
+    // 模式9/10：按路径删除或更新文档（参数为"delete"/"update" + 一个或多个文档路径）
+    if (argc >= 3 && strcmp(argv[1], "delete") == 0) {
+        return delete_documents(argv + 2, argc - 2);
+    }
+    if (argc >= 3 && strcmp(argv[1], "update") == 0) {
+        return update_documents(argv + 2, argc - 2);
+    }
+    // 常驻服务可指定查询结果缓存的总上限（MB，0表示不缓存；每个工作线程各有一个缓存，均分这个上限），
+    // --stats打开查询统计，--workers指定工作线程数
+    if (argc >= 3 && strcmp(argv[1], "serve") == 0) {
+        size_t cache_bytes = QUERY_CACHE_DEFAULT_BYTES;
+        int record_stats = 0, num_workers = 0;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--stats") == 0) {
+                record_stats = 1;
+            } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+                num_workers = atoi(argv[++i]);
+            } else if (i == 2) {
+                int cache_mb = atoi(argv[i]);
+                cache_bytes = cache_mb > 0 ? (size_t)cache_mb << 20 : 0;
+            } else {
+                printf("未知的服务选项：%s\n", argv[i]);
+                return 1;
+            }
+        }
+        return serve_index(cache_bytes, record_stats, num_workers);
+    }
     if (argc == 2) {
+        // 模式4：旧格式索引转换（参数为"convert"）
+        if (strcmp(argv[1], "convert") == 0) {
+            return convert_legacy_index();
+        }
+        // 模式5：常驻服务（参数为"serve"，供Python桥接层复用同一进程）
+        else if (strcmp(argv[1], "serve") == 0) {
+            return serve_index(QUERY_CACHE_DEFAULT_BYTES, 0, 0);
+        }
+        // 模式8：段合并（参数为"merge"）
+        else if (strcmp(argv[1], "merge") == 0) {
+            return merge_index();
+        }
         // 模式1：构建索引（参数为文档目录）
-        if (strcmp(argv[1], "search") != 0) {
-            build_index(argv[1]);
+        else if (strcmp(argv[1], "search") != 0) {
+            build_index(argv[1], 0);
         } 
         // 模式2：交互搜索（参数为"search"）
         else {
-            TrieNode *trie = NULL;
-            InvertedIndex *index = NULL;
-            char **doc_paths = NULL;
-            int num_docs = 0;
-            
-            load_index(&trie, &index, &doc_paths, &num_docs);
-            interactive_search(trie, index, doc_paths, num_docs);
+            SegmentSet *set = load_index();
+            interactive_search(set, NULL);
             
             // 释放资源
-            trie_free(trie);
-            inverted_index_free(index);
-            for (int i = 0; i < num_docs; i++) free(doc_paths[i]);
-            free(doc_paths);
+            segment_set_close(set);
         }
     }
-    // 模式3：命令行搜索（参数为"search" + 查询词，供Python调用）
-    else if (argc == 3 && strcmp(argv[1], "search") == 0) {
-        TrieNode *trie = NULL;
-        InvertedIndex *index = NULL;
-        char **doc_paths = NULL;
-        int num_docs = 0;
+    // 模式3：命令行搜索（参数为"search" + 查询词 [+ 打分方式] [+ 打分模型] [+ --stats]，供Python调用）
+    else if (argc >= 3 && argc <= 6 && strcmp(argv[1], "search") == 0) {
         const char *query = argv[2];
+        SearchOptions options;
+        search_options_init(&options);
+        QueryStats stats;
+        memset(&stats, 0, sizeof(QueryStats));
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "--stats") == 0) {
+                options.stats = &stats;
+            } else if (parse_scoring_mode(argv[i], &options.scoring) != 0
+                       && parse_scoring_model(argv[i], &options.model) != 0) {
+                printf("未知的打分选项：%s（打分方式可选pruned/exhaustive，模型可选tfidf/bm25）\n", argv[i]);
+                return 1;
+            }
+        }
         
-        load_index(&trie, &index, &doc_paths, &num_docs);
+        long long load_start = monotonic_ns();
+        SegmentSet *set = load_index();
+        long long load_ns = monotonic_ns() - load_start;
         
         // 执行搜索并按标准化格式输出
         int result_count;
-        SearchResult *results = perform_search(trie, index, query, doc_paths, num_docs, &result_count);
+        SearchResult *results = perform_search(set, query, &options, &result_count);
+        if (result_count == 0) {
+            printf("未找到与\"%s\"匹配的文档\n", query);
+        }
         printf("找到 %d 个结果：\n", result_count);
         for (int i = 0; i < result_count; i++) {
             printf("%d. 文档: %s (分数: %.4f)\n", 
                    i + 1, results[i].doc_path, results[i].score);
         }
+        // --stats：最后一行输出加载耗时与本次查询的统计（JSON）
+        if (options.stats) {
+            printf("{\"load_us\": %.1f, \"query\": ", load_ns / 1e3);
+            query_stats_write_json(&stats, stdout);
+            printf("}\n");
+        }
         
         // 释放资源
         free_search_results(results, result_count);
-        trie_free(trie);
-        inverted_index_free(index);
-        for (int i = 0; i < num_docs; i++) free(doc_paths[i]);
-        free(doc_paths);
+        segment_set_close(set);
+    }
+    // 模式6：前缀建议（参数为"suggest" + 前缀 [+ 个数]），按文档频率输出最常见的补全词
+    else if ((argc == 3 || argc == 4) && strcmp(argv[1], "suggest") == 0) {
+        int limit = argc == 4 ? atoi(argv[3]) : SERVER_SUGGEST_LIMIT;
+        if (limit <= 0) limit = SERVER_SUGGEST_LIMIT;
+        
+        SegmentSet *set = load_index();
+        SetSuggestion *suggestions = (SetSuggestion*)malloc(limit * sizeof(SetSuggestion));
+        int count = suggestions ? segment_set_suggest(set, argv[2], strlen(argv[2]), suggestions, limit) : 0;
+        printf("找到 %d 个建议：\n", count);
+        for (int i = 0; i < count; i++) {
+            printf("%d. %s (文档数: %lld)\n", i + 1, suggestions[i].term, suggestions[i].doc_count);
+        }
+        
+        free(suggestions);
+        segment_set_close(set);
+    }
+    // 模式1：构建索引并指定线程数（可再指定分片数）
+    else if (argc == 3 && strcmp(argv[1], "search") != 0) {
+        build_index(argv[1], atoi(argv[2]));
+    }
+    else if (argc == 4 && strcmp(argv[1], "search") != 0) {
+        build_sharded_index(argv[1], atoi(argv[2]), atoi(argv[3]));
     }
     else {
         printf("用法：\n");
-        printf("  构建索引：%s <文档目录路径>\n", argv[0]);
+        printf("  构建索引：%s <文档目录路径> [线程数] [分片数]\n", argv[0]);
         printf("  交互搜索：%s search\n", argv[0]);
-        printf("  命令行搜索：%s search <查询词>\n", argv[0]);
+        printf("  命令行搜索：%s search <查询词> [pruned|exhaustive] [tfidf|bm25] [--stats]\n", argv[0]);
+        printf("  增量添加：%s add <文档目录路径> [线程数]\n", argv[0]);
+        printf("  段合并：%s merge\n", argv[0]);
+        printf("  删除文档：%s delete <文档路径>...\n", argv[0]);
+        printf("  更新文档：%s update <文档路径>...\n", argv[0]);
+        printf("  旧索引转换：%s convert\n", argv[0]);
+        printf("  前缀建议：%s suggest <前缀> [个数]\n", argv[0]);
+        printf("  常驻服务：%s serve [查询缓存总上限MB，各工作线程均分] [--stats] [--workers 线程数]\n", argv[0]);
         return 1;
     }
     
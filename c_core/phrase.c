@@ -0,0 +1,190 @@
+#include "phrase.h"
+#include <string.h>
+
+// 一个词在当前文档中的位置（按词频增长，跨文档复用）
+typedef struct PositionBuffer {
+    uint32_t *values;
+    int count;
+    int capacity;
+} PositionBuffer;
+
+// 解码游标当前posting的全部位置，失败返回-1
+static int load_positions(PostingCursor *cursor, PositionBuffer *buffer, Arena *scratch) {
+    if (cursor->term_frequency > buffer->capacity) {
+        int capacity = buffer->capacity ? buffer->capacity : 16;
+        while (capacity < cursor->term_frequency) capacity *= 2;
+        uint32_t *values = (uint32_t*)arena_grow(scratch, buffer->values, buffer->capacity * sizeof(uint32_t),
+                                                 capacity * sizeof(uint32_t));
+        if (!values) return -1;
+        buffer->values = values;
+        buffer->capacity = capacity;
+    }
+    buffer->count = posting_cursor_positions(cursor, buffer->values, buffer->capacity);
+    return buffer->count < 0 ? -1 : 0;
+}
+
+// 每个词一个位置缓冲区（初始为空），失败返回NULL
+static PositionBuffer* new_buffers(int count, Arena *scratch) {
+    PositionBuffer *buffers = (PositionBuffer*)arena_alloc(scratch, count * sizeof(PositionBuffer));
+    if (buffers) memset(buffers, 0, count * sizeof(PositionBuffer));
+    return buffers;
+}
+
+static void free_buffers(PositionBuffer *buffers, int count, Arena *scratch) {
+    if (!buffers) return;
+    for (int i = 0; i < count; i++) arena_release(scratch, buffers[i].values, buffers[i].capacity * sizeof(uint32_t));
+    arena_release(scratch, buffers, count * sizeof(PositionBuffer));
+}
+
+// 位置交集：是否存在起点start，使每个词的位置中都有start + offset。
+// 候选起点由先导词的位置给出且递增，其余词的位置指针只需单调前进
+static int positions_align(const PhraseTerm *terms, const PositionBuffer *buffers, int num_terms, int lead,
+                           int *cursors) {
+    for (int i = 0; i < num_terms; i++) cursors[i] = 0;
+    const PositionBuffer *leader = &buffers[lead];
+    for (int p = 0; p < leader->count; p++) {
+        if (leader->values[p] < terms[lead].offset) continue;
+        uint32_t start = leader->values[p] - terms[lead].offset;
+        int matched = 1;
+        for (int i = 0; i < num_terms && matched; i++) {
+            if (i == lead) continue;
+            uint32_t want = start + terms[i].offset;
+            const PositionBuffer *buffer = &buffers[i];
+            while (cursors[i] < buffer->count && buffer->values[cursors[i]] < want) cursors[i]++;
+            if (cursors[i] == buffer->count) return 0; // 该词已没有更靠后的位置
+            matched = buffer->values[cursors[i]] == want;
+        }
+        if (matched) return 1;
+    }
+    return 0;
+}
+
+// docs中第一个不小于doc_id的文档，没有时返回-1
+static int next_candidate(const uint64_t *docs, int num_words, int doc_id) {
+    int w = doc_id >> 6;
+    if (w >= num_words) return -1;
+    uint64_t word = docs[w] & (~0ULL << (doc_id & 63));
+    while (!word) {
+        if (++w >= num_words) return -1;
+        word = docs[w];
+    }
+    return w * 64 + __builtin_ctzll(word);
+}
+
+int phrase_filter(const Segment *segment, const PhraseTerm *terms, int num_terms, uint64_t *docs, Arena *scratch) {
+    if (!segment || !terms || num_terms <= 0 || !docs) return -1;
+    int num_words = (segment->num_docs + 63) / 64;
+    size_t matched_size = (num_words > 0 ? num_words : 1) * sizeof(uint64_t);
+    uint64_t *matched = (uint64_t*)arena_alloc(scratch, matched_size);
+    PostingCursor *cursors = (PostingCursor*)arena_alloc(scratch, num_terms * sizeof(PostingCursor));
+    PositionBuffer *buffers = new_buffers(num_terms, scratch);
+    int *position_cursors = (int*)arena_alloc(scratch, num_terms * sizeof(int));
+    int status = matched && cursors && buffers && position_cursors ? 0 : -1;
+    if (matched) memset(matched, 0, matched_size);
+
+    // 段中缺少任何一个词时没有文档包含短语
+    int positional = segment_has_positions(segment);
+    int opened = status == 0;
+    int lead = 0;
+    for (int i = 0; i < num_terms && opened; i++) {
+        opened = positional ? segment_position_cursor(segment, &terms[i].handle, &cursors[i])
+                            : segment_posting_cursor(segment, &terms[i].handle, &cursors[i]);
+        if (terms[i].handle.doc_count < terms[lead].handle.doc_count) lead = i;
+    }
+
+    int target = 0;
+    while (opened && status == 0) {
+        // 目标只取候选文档，候选稀疏时先导词借助跳表头跳过其间的块
+        target = next_candidate(docs, num_words, target);
+        if (target < 0 || !posting_cursor_advance(&cursors[lead], target)) break;
+        target = cursors[lead].doc_id;
+        // 其余词跳到先导词的文档；有词跳过了该文档时，以它的文档为新目标重新对齐
+        int aligned = 1, exhausted = 0;
+        for (int i = 0; i < num_terms; i++) {
+            if (i == lead) continue;
+            if (!posting_cursor_advance(&cursors[i], target)) {
+                exhausted = 1;
+                break;
+            }
+            if (cursors[i].doc_id > target) {
+                target = cursors[i].doc_id;
+                aligned = 0;
+                break;
+            }
+        }
+        if (exhausted) break;
+        if (!aligned) continue;
+
+        if (target < segment->num_docs && DOC_IS_LIVE(docs, target)) {
+            int found = 1;
+            if (positional) {
+                for (int i = 0; i < num_terms && status == 0; i++) {
+                    status = load_positions(&cursors[i], &buffers[i], scratch);
+                }
+                found = status == 0 && positions_align(terms, buffers, num_terms, lead, position_cursors);
+            }
+            if (found) matched[target >> 6] |= 1ULL << (target & 63);
+        }
+        target++;
+    }
+
+    int remaining = 0;
+    for (int w = 0; w < num_words && status == 0; w++) {
+        docs[w] &= matched[w];
+        remaining += __builtin_popcountll(docs[w]);
+    }
+    arena_release(scratch, matched, matched_size);
+    arena_release(scratch, cursors, num_terms * sizeof(PostingCursor));
+    free_buffers(buffers, num_terms, scratch);
+    arena_release(scratch, position_cursors, num_terms * sizeof(int));
+    return status == 0 ? remaining : -1;
+}
+
+// 两个升序位置列表之间的最小距离（两指针归并）
+static uint32_t min_distance(const PositionBuffer *a, const PositionBuffer *b) {
+    uint32_t best = UINT32_MAX;
+    int i = 0, j = 0;
+    while (i < a->count && j < b->count && best > 1) {
+        uint32_t x = a->values[i], y = b->values[j];
+        uint32_t distance = x > y ? x - y : y - x;
+        if (distance < best) best = distance;
+        if (x < y) i++;
+        else j++;
+    }
+    return best;
+}
+
+int proximity_boosts(const Segment *segment, const TermHandle *terms, int num_terms,
+                     const int *docs, int num_docs, double *boosts, Arena *scratch) {
+    if (!segment || !boosts || num_docs < 0) return -1;
+    for (int d = 0; d < num_docs; d++) boosts[d] = 0.0;
+    if (num_terms < 2 || num_docs == 0 || !segment_has_positions(segment)) return 0;
+
+    PostingCursor *cursors = (PostingCursor*)arena_alloc(scratch, num_terms * sizeof(PostingCursor));
+    PositionBuffer *buffers = new_buffers(num_terms, scratch);
+    unsigned char *opened = (unsigned char*)arena_alloc(scratch, num_terms);
+    unsigned char *present = (unsigned char*)arena_alloc(scratch, num_terms);
+    int status = cursors && buffers && opened && present ? 0 : -1;
+    for (int i = 0; i < num_terms && status == 0; i++) {
+        opened[i] = (unsigned char)segment_position_cursor(segment, &terms[i], &cursors[i]);
+    }
+
+    for (int d = 0; d < num_docs && status == 0; d++) {
+        for (int i = 0; i < num_terms && status == 0; i++) {
+            present[i] = opened[i] && posting_cursor_advance(&cursors[i], docs[d]) && cursors[i].doc_id == docs[d];
+            if (present[i]) status = load_positions(&cursors[i], &buffers[i], scratch);
+        }
+        double boost = 0.0;
+        for (int i = 0; i + 1 < num_terms; i++) {
+            if (!present[i] || !present[i + 1]) continue;
+            uint32_t distance = min_distance(&buffers[i], &buffers[i + 1]);
+            if (distance > 0 && distance != UINT32_MAX) boost += 1.0 / distance;
+        }
+        boosts[d] = boost;
+    }
+    arena_release(scratch, cursors, num_terms * sizeof(PostingCursor));
+    free_buffers(buffers, num_terms, scratch);
+    arena_release(scratch, opened, num_terms);
+    arena_release(scratch, present, num_terms);
+    return status;
+}
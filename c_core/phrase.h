@@ -0,0 +1,30 @@
+#ifndef PHRASE_H
+#define PHRASE_H
+
+#include <stdint.h>
+#include "segment.h"
+#include "arena.h"
+
+// 基于位置的查询：短语匹配与邻近度加分，直接在段的位置字节流上计算（位置格式见postings.h）
+// 段没有位置时短语退化为要求短语中的词出现在同一文档，邻近度加分为0
+// 临时内存（游标、位置缓冲区）从scratch分配并在返回前归还，scratch为NULL时使用malloc
+
+// 短语中的一个词：handle为该词在段中的句柄（term_id为-1表示段中没有该词），
+// offset为该词在短语中的位置（停用词等不在词典中的词只占位置，不出现在短语词中）
+typedef struct PhraseTerm {
+    TermHandle handle;
+    uint32_t offset;
+} PhraseTerm;
+
+// 在docs（段内文档位图，调用者按段文档数分配）标记的文档中筛选包含短语的文档：
+// 以文档频率最低的词为先导逐文档求交（其余词借助跳表头跳块），再按offset对齐求位置交集。
+// 不包含短语的文档在docs中清零，返回剩余的文档数，失败返回-1
+int phrase_filter(const Segment *segment, const PhraseTerm *terms, int num_terms, uint64_t *docs, Arena *scratch);
+
+// 邻近度：terms为按查询顺序排列的不同查询词（term_id为-1表示段中没有该词），
+// 对docs（段内文档ID，升序）中的每个文档，累加每对相邻查询词在文档中最小距离的倒数，写入boosts。
+// 成功返回0，失败返回-1
+int proximity_boosts(const Segment *segment, const TermHandle *terms, int num_terms,
+                     const int *docs, int num_docs, double *boosts, Arena *scratch);
+
+#endif
@@ -0,0 +1,347 @@
+#include "postings.h"
+#include <string.h>
+
+void posting_list_init(PostingList *list, Arena *arena) {
+    memset(list, 0, sizeof(PostingList));
+    list->arena = arena;
+    list->last_doc_id = -1;
+}
+
+void posting_list_free(PostingList *list) {
+    if (!list) return;
+    arena_release(list->arena, list->data, list->capacity);
+    arena_release(list->arena, list->blocks, (size_t)list->block_capacity * sizeof(PostingBlock));
+    arena_release(list->arena, list->positions, list->positions_capacity);
+    arena_release(list->arena, list->position_blocks, (size_t)list->position_block_capacity * sizeof(uint64_t));
+    posting_list_init(list, list->arena);
+}
+
+size_t varint_encode(uint32_t value, unsigned char *out) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char)value;
+    return n;
+}
+
+// 解码一个varint，数据不完整时返回NULL
+static inline const unsigned char* varint_decode(const unsigned char *p, const unsigned char *end, uint32_t *value) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        unsigned char byte = *p++;
+        result |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static int reserve_data(PostingList *list, uint32_t extra) {
+    if (list->size + extra <= list->capacity) return 0;
+    uint32_t capacity = list->capacity ? list->capacity : 16;
+    while (capacity < list->size + extra) capacity *= 2;
+    unsigned char *data = (unsigned char*)arena_grow(list->arena, list->data, list->capacity, capacity);
+    if (!data) return -1;
+    list->data = data;
+    list->capacity = capacity;
+    return 0;
+}
+
+static int reserve_positions(PostingList *list, uint32_t extra) {
+    if (list->positions && list->positions_size + extra <= list->positions_capacity) return 0;
+    uint32_t capacity = list->positions_capacity ? list->positions_capacity : 16;
+    while (capacity < list->positions_size + extra) capacity *= 2;
+    unsigned char *positions = (unsigned char*)arena_grow(list->arena, list->positions, list->positions_capacity,
+                                                          capacity);
+    if (!positions) return -1;
+    list->positions = positions;
+    list->positions_capacity = capacity;
+    return 0;
+}
+
+// 封口当前块，写入跳表头
+static void close_block(PostingList *list) {
+    if (list->open_count == 0) return;
+    if (list->num_blocks == list->block_capacity) {
+        int capacity = list->block_capacity ? list->block_capacity * 2 : 1;
+        PostingBlock *blocks = (PostingBlock*)arena_grow(list->arena, list->blocks,
+                                                          (size_t)list->block_capacity * sizeof(PostingBlock),
+                                                          (size_t)capacity * sizeof(PostingBlock));
+        if (!blocks) return;
+        list->blocks = blocks;
+        list->block_capacity = capacity;
+    }
+    if (list->positions && list->num_blocks == list->position_block_capacity) {
+        int capacity = list->block_capacity;
+        uint64_t *position_blocks = (uint64_t*)arena_grow(list->arena, list->position_blocks,
+                                                            (size_t)list->position_block_capacity * sizeof(uint64_t),
+                                                            (size_t)capacity * sizeof(uint64_t));
+        if (!position_blocks) return;
+        list->position_blocks = position_blocks;
+        list->position_block_capacity = capacity;
+    }
+    if (list->positions) list->position_blocks[list->num_blocks] = list->open_position_offset;
+    PostingBlock *block = &list->blocks[list->num_blocks++];
+    block->last_doc_id = list->encoded_doc_id;
+    block->data_offset = list->open_offset;
+    block->count = list->open_count;
+    block->max_tf = list->open_max_tf;
+
+    list->open_offset = list->size;
+    list->open_count = 0;
+    list->open_max_tf = 0;
+}
+
+// 编码last_doc_id上尚未写出的词频（差值相对上一个已编码的posting）
+static void flush_pending(PostingList *list) {
+    if (list->pending_tf == 0) return;
+    if (reserve_data(list, 10) != 0) return;
+    uint32_t doc_id = (uint32_t)list->last_doc_id;
+    if (list->open_count == 0) list->open_position_offset = list->pending_position_offset;
+    list->size += (uint32_t)varint_encode(doc_id - list->encoded_doc_id, list->data + list->size);
+    list->size += (uint32_t)varint_encode((uint32_t)list->pending_tf, list->data + list->size);
+    list->encoded_doc_id = doc_id;
+    if ((uint32_t)list->pending_tf > list->open_max_tf) list->open_max_tf = (uint32_t)list->pending_tf;
+    if ((uint32_t)list->pending_tf > list->max_tf) list->max_tf = (uint32_t)list->pending_tf;
+    list->open_count++;
+    list->pending_tf = 0;
+    if (list->open_count == POSTING_BLOCK_SIZE) {
+        close_block(list);
+    }
+}
+
+int posting_list_add_occurrence(PostingList *list, int doc_id) {
+    if (doc_id < 0) return -1;
+    if (doc_id == list->last_doc_id) {
+        if (list->pending_tf == 0) return -1; // 该文档已封口编码，不能再累加
+        list->pending_tf++;
+        return 0;
+    }
+    if (doc_id < list->last_doc_id) return -1;
+
+    // 新文档：先编码上一个文档的posting
+    flush_pending(list);
+    list->last_doc_id = doc_id;
+    list->pending_tf = 1;
+    list->doc_count++;
+    return 1;
+}
+
+int posting_list_add_position(PostingList *list, int doc_id, uint32_t position) {
+    if (!list->positions && list->doc_count > 0) return -1;
+    if (doc_id == list->last_doc_id && position <= list->last_position) return -1;
+    if (reserve_positions(list, 5) != 0) return -1;
+
+    uint32_t offset = list->positions_size;
+    int added = posting_list_add_occurrence(list, doc_id);
+    if (added < 0) return -1;
+    if (added) {
+        list->pending_position_offset = offset;
+        list->last_position = 0;
+    }
+    list->positions_size += (uint32_t)varint_encode(position - list->last_position, list->positions + offset);
+    list->last_position = position;
+    return added;
+}
+
+int posting_list_append(PostingList *list, int doc_id, int term_frequency) {
+    if (list->positions) return -1;
+    if (doc_id < 0 || doc_id <= list->last_doc_id || term_frequency <= 0) return -1;
+    flush_pending(list);
+    list->last_doc_id = doc_id;
+    list->pending_tf = term_frequency;
+    list->doc_count++;
+    return 0;
+}
+
+int posting_list_append_positions(PostingList *list, int doc_id, int term_frequency,
+                                  const unsigned char *bytes, uint32_t size) {
+    if (!list->positions && list->doc_count > 0) return -1;
+    if (doc_id < 0 || doc_id <= list->last_doc_id || term_frequency <= 0 || size == 0) return -1;
+    if (reserve_positions(list, size) != 0) return -1;
+    flush_pending(list);
+    list->pending_position_offset = list->positions_size;
+    memcpy(list->positions + list->positions_size, bytes, size);
+    list->positions_size += size;
+    list->last_position = 0;
+    list->last_doc_id = doc_id;
+    list->pending_tf = term_frequency;
+    list->doc_count++;
+    return 0;
+}
+
+void posting_list_seal(PostingList *list) {
+    flush_pending(list);
+    close_block(list);
+}
+
+int posting_list_concat(PostingList *dst, const PostingList *src) {
+    if (src->pending_tf != 0 || src->open_count != 0) return -1; // src必须已封口
+
+    // 逐个追加而不是整块复制：dst末尾的块可能未满，重新分块后与单线程构建的字节完全一致
+    PostingCursor cursor;
+    posting_cursor_init_list(&cursor, src);
+    while (posting_cursor_next(&cursor)) {
+        if (src->positions) {
+            const unsigned char *bytes;
+            uint32_t size;
+            if (posting_cursor_position_bytes(&cursor, &bytes, &size) != 0
+                || posting_list_append_positions(dst, cursor.doc_id, cursor.term_frequency, bytes, size) != 0) {
+                return -1;
+            }
+        } else if (posting_list_append(dst, cursor.doc_id, cursor.term_frequency) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void posting_cursor_init(PostingCursor *cursor, const unsigned char *data, uint32_t data_size,
+                         const PostingBlock *blocks, int num_blocks) {
+    cursor->data = data;
+    cursor->end = data + data_size;
+    cursor->blocks = blocks;
+    cursor->num_blocks = blocks ? num_blocks : 0;
+    cursor->block = -1;
+    cursor->ptr = NULL;
+    cursor->remaining = 0;
+    cursor->doc_id = -1;
+    cursor->term_frequency = 0;
+    cursor->positions = NULL;
+    cursor->positions_end = NULL;
+    cursor->position_blocks = NULL;
+    cursor->position_ptr = NULL;
+    cursor->position_skip = 0;
+}
+
+void posting_cursor_init_list(PostingCursor *cursor, const PostingList *list) {
+    posting_cursor_init(cursor, list->data, list->size, list->blocks, list->num_blocks);
+    if (list->positions) {
+        posting_cursor_attach_positions(cursor, list->positions, list->positions_size, list->position_blocks);
+    }
+}
+
+void posting_cursor_attach_positions(PostingCursor *cursor, const unsigned char *positions, uint64_t size,
+                                     const uint64_t *position_blocks) {
+    cursor->positions = positions && position_blocks ? positions : NULL;
+    cursor->positions_end = cursor->positions ? positions + size : NULL;
+    cursor->position_blocks = cursor->positions ? position_blocks : NULL;
+}
+
+static inline int cursor_finish(PostingCursor *cursor) {
+    cursor->block = cursor->num_blocks;
+    cursor->remaining = 0;
+    cursor->doc_id = POSTING_END;
+    cursor->term_frequency = 0;
+    return 0;
+}
+
+// 定位到第block块的开头
+static inline int cursor_enter_block(PostingCursor *cursor, int block) {
+    if (block >= cursor->num_blocks) return cursor_finish(cursor);
+    const PostingBlock *header = &cursor->blocks[block];
+    if (header->data_offset > (uint32_t)(cursor->end - cursor->data)) return cursor_finish(cursor);
+
+    cursor->block = block;
+    cursor->ptr = cursor->data + header->data_offset;
+    cursor->remaining = header->count;
+    // 差值基准：上一块的最后一个文档ID
+    cursor->doc_id = block > 0 ? (int)cursor->blocks[block - 1].last_doc_id : 0;
+    cursor->term_frequency = 0;
+    if (cursor->positions) {
+        uint64_t offset = cursor->position_blocks[block];
+        cursor->position_ptr = offset <= (uint64_t)(cursor->positions_end - cursor->positions)
+                             ? cursor->positions + offset : NULL;
+        cursor->position_skip = 0;
+    }
+    return 1;
+}
+
+int posting_cursor_next(PostingCursor *cursor) {
+    if (cursor->doc_id == POSTING_END) return 0;
+    // 上一个posting的位置留到真正需要时再跳过
+    cursor->position_skip += cursor->term_frequency;
+    while (cursor->remaining == 0) {
+        if (!cursor_enter_block(cursor, cursor->block + 1)) return 0;
+    }
+
+    uint32_t delta, tf;
+    const unsigned char *p = varint_decode(cursor->ptr, cursor->end, &delta);
+    if (p) p = varint_decode(p, cursor->end, &tf);
+    if (!p) return cursor_finish(cursor);
+
+    cursor->ptr = p;
+    cursor->remaining--;
+    cursor->doc_id += (int)delta;
+    cursor->term_frequency = (int)tf;
+    return 1;
+}
+
+int posting_cursor_advance(PostingCursor *cursor, int target) {
+    if (cursor->doc_id >= target && cursor->block >= 0) {
+        return cursor->doc_id != POSTING_END;
+    }
+
+    // 借助跳表头跳过last_doc_id < target的整块
+    int block = cursor->block < 0 ? 0 : cursor->block;
+    if (block < cursor->num_blocks && (int)cursor->blocks[block].last_doc_id < target) {
+        while (block < cursor->num_blocks && (int)cursor->blocks[block].last_doc_id < target) block++;
+        if (!cursor_enter_block(cursor, block)) return 0;
+    }
+
+    while (posting_cursor_next(cursor)) {
+        if (cursor->doc_id >= target) return 1;
+    }
+    return 0;
+}
+
+// 跳过当前posting之前的位置，返回当前posting位置数据的起点（没有位置返回NULL）
+static const unsigned char* cursor_position_start(PostingCursor *cursor) {
+    if (!cursor->positions || !cursor->position_ptr || cursor->block < 0 || cursor->doc_id == POSTING_END) {
+        return NULL;
+    }
+    const unsigned char *p = cursor->position_ptr;
+    for (; cursor->position_skip > 0; cursor->position_skip--) {
+        while (p < cursor->positions_end && (*p & 0x80)) p++;
+        if (p >= cursor->positions_end) {
+            cursor->position_ptr = NULL;
+            return NULL;
+        }
+        p++;
+    }
+    cursor->position_ptr = p;
+    return p;
+}
+
+int posting_cursor_positions(PostingCursor *cursor, uint32_t *positions, int max) {
+    const unsigned char *p = cursor_position_start(cursor);
+    if (!p) return -1;
+    int count = cursor->term_frequency < max ? cursor->term_frequency : max;
+    uint32_t position = 0;
+    for (int i = 0; i < count; i++) {
+        uint32_t delta;
+        p = varint_decode(p, cursor->positions_end, &delta);
+        if (!p) return -1;
+        position += delta;
+        positions[i] = position;
+    }
+    return count;
+}
+
+int posting_cursor_position_bytes(PostingCursor *cursor, const unsigned char **bytes, uint32_t *size) {
+    const unsigned char *start = cursor_position_start(cursor);
+    if (!start) return -1;
+    const unsigned char *p = start;
+    for (int i = 0; i < cursor->term_frequency; i++) {
+        uint32_t delta;
+        p = varint_decode(p, cursor->positions_end, &delta);
+        if (!p) return -1;
+    }
+    *bytes = start;
+    *size = (uint32_t)(p - start);
+    return 0;
+}
@@ -0,0 +1,126 @@
+#ifndef POSTINGS_H
+#define POSTINGS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "arena.h"
+
+// 按文档ID排序、分块压缩的postings列表
+// 每块最多POSTING_BLOCK_SIZE个posting，块内依次存放 varint(文档ID差值) varint(词频)；
+// 差值相对前一个posting（块首相对上一块的last_doc_id，第一块相对0）
+// 每块有一个跳表头（PostingBlock），查询时可按last_doc_id整块跳过，
+// 并可由max_tf得到块内分数上界（动态剪枝据此跳过不可能进入前k名的文档）
+//
+// 位置（可选）存放在独立的字节流中，不与文档ID/词频交错，不使用位置的查询不会读取：
+// 每个posting依次存放词频个 varint(位置差值)，差值相对同一文档中的前一个位置（第一个相对0）；
+// 每块另记该块第一个posting的位置数据偏移，游标进入块后按需跳过前面posting的位置
+#define POSTING_BLOCK_SIZE 128
+
+typedef struct PostingBlock {
+    uint32_t last_doc_id; // 块内最大（最后）的文档ID
+    uint32_t data_offset; // 块数据相对该词条postings数据起点的字节偏移
+    uint32_t count;       // 块内posting个数
+    uint32_t max_tf;      // 块内最大词频
+} PostingBlock;
+
+// 构建期使用的可增长postings列表（文档ID必须单调不减地追加）
+// arena非NULL时四个缓冲区都从arena分配、扩容时旧缓冲区归还arena；为NULL时使用malloc/realloc
+typedef struct PostingList {
+    Arena *arena;
+    unsigned char *data;
+    uint32_t size;
+    uint32_t capacity;
+    PostingBlock *blocks;
+    int num_blocks;
+    int block_capacity;
+    int doc_count;        // posting总数（即包含该词的文档数）
+    int last_doc_id;      // 最近追加的文档ID（-1表示空）
+    int pending_tf;       // last_doc_id尚未编码的词频（同一文档的词频仍在累加）
+    uint32_t open_count;  // 当前未封口块中已编码的posting数
+    uint32_t open_offset; // 当前未封口块的数据起点
+    uint32_t encoded_doc_id; // 最近一个已编码posting的文档ID（下一个差值的基准）
+    uint32_t open_max_tf; // 当前未封口块中的最大词频
+    uint32_t max_tf;      // 整个列表的最大词频（已编码部分）
+    unsigned char *positions; // 位置字节流（NULL表示该列表不记录位置）
+    uint32_t positions_size;
+    uint32_t positions_capacity;
+    uint64_t *position_blocks; // 每块第一个posting在位置字节流中的偏移（与blocks一一对应）
+    int position_block_capacity;
+    uint32_t open_position_offset;    // 当前未封口块的位置数据起点
+    uint32_t pending_position_offset; // last_doc_id的位置数据起点
+    uint32_t last_position;           // last_doc_id中最近记录的位置（差值基准）
+} PostingList;
+
+// 只读游标：直接在压缩块上迭代（构建期的PostingList与mmap的段文件通用）
+typedef struct PostingCursor {
+    const unsigned char *data;
+    const unsigned char *end;
+    const PostingBlock *blocks;
+    int num_blocks;
+    int block;                // 当前块下标
+    const unsigned char *ptr; // 当前块内下一个待解码的位置
+    uint32_t remaining;       // 当前块内尚未解码的posting数
+    int doc_id;               // 当前posting（迭代结束后为POSTING_END）
+    int term_frequency;
+    const unsigned char *positions;  // 位置字节流（NULL表示没有位置）
+    const unsigned char *positions_end;
+    const uint64_t *position_blocks; // 每块位置数据相对positions的偏移
+    const unsigned char *position_ptr; // 当前块内已定位到的位置数据
+    int position_skip;        // 从position_ptr到当前posting的位置数据之间还需跳过的位置个数
+} PostingCursor;
+
+#define POSTING_END 0x7fffffff
+
+// 初始化为空列表，缓冲区从arena分配（NULL表示使用malloc）
+void posting_list_init(PostingList *list, Arena *arena);
+void posting_list_free(PostingList *list);
+
+// 记录文档doc_id中出现一次该词；返回1表示新文档，0表示同一文档词频+1，-1表示文档ID乱序
+int posting_list_add_occurrence(PostingList *list, int doc_id);
+
+// 同posting_list_add_occurrence，并记录该次出现在文档中的位置（同一文档内位置必须递增）；
+// 列表要么每次出现都记录位置，要么都不记录，混用返回-1
+int posting_list_add_position(PostingList *list, int doc_id, uint32_t position);
+
+// 直接追加一个(文档ID, 词频)；doc_id必须大于已有的文档ID，成功返回0
+int posting_list_append(PostingList *list, int doc_id, int term_frequency);
+
+// 同posting_list_append，并复制该posting已编码的位置字节（posting_cursor_position_bytes的结果，
+// 位置差值只在文档内计算，原样复制即可）；成功返回0
+int posting_list_append_positions(PostingList *list, int doc_id, int term_frequency,
+                                  const unsigned char *bytes, uint32_t size);
+
+// 编码尚未写出的posting并封口最后一块（写段文件或遍历前调用；之后仍可继续追加）
+void posting_list_seal(PostingList *list);
+
+// 把已封口的src接到dst末尾（src的文档ID必须都大于dst的），dst无需封口
+// 用于合并按文档ID区间分别构建的部分索引（src记录了位置时一并复制）；成功返回0
+int posting_list_concat(PostingList *dst, const PostingList *src);
+
+// varint编解码
+size_t varint_encode(uint32_t value, unsigned char *out);
+
+// 游标：初始化后需先调用posting_cursor_next定位到第一个posting
+void posting_cursor_init(PostingCursor *cursor, const unsigned char *data, uint32_t data_size,
+                         const PostingBlock *blocks, int num_blocks);
+void posting_cursor_init_list(PostingCursor *cursor, const PostingList *list);
+
+// 前进到下一个posting，返回0表示已到末尾
+int posting_cursor_next(PostingCursor *cursor);
+
+// 前进到第一个文档ID>=target的posting（利用跳表头整块跳过），返回0表示已到末尾
+int posting_cursor_advance(PostingCursor *cursor, int target);
+
+// 为游标接上位置字节流（position_blocks与游标的blocks一一对应，偏移相对positions）；
+// 在posting_cursor_next之前调用，init_list会自动接上列表自己的位置
+void posting_cursor_attach_positions(PostingCursor *cursor, const unsigned char *positions, uint64_t size,
+                                     const uint64_t *position_blocks);
+
+// 解码当前posting的位置（升序的绝对位置），至多写入max个，返回写入个数；没有位置或数据损坏返回-1
+int posting_cursor_positions(PostingCursor *cursor, uint32_t *positions, int max);
+
+// 当前posting已编码的位置字节（供合并时原样复制），成功返回0
+int posting_cursor_position_bytes(PostingCursor *cursor, const unsigned char **bytes, uint32_t *size);
+
+#endif
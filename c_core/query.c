@@ -0,0 +1,820 @@
+#include "query.h"
+#include <string.h>
+#include <ctype.h>
+#include "tokenizer.h"
+
+// ---------------------------------------------------------------------------
+// 词法分析
+// ---------------------------------------------------------------------------
+
+typedef enum QueryTokenType {
+    QTOKEN_END = 0,
+    QTOKEN_WORD,
+    QTOKEN_PHRASE, // 引号内的文本（不含引号）
+    QTOKEN_AND,
+    QTOKEN_OR,
+    QTOKEN_NOT,
+    QTOKEN_LPAREN,
+    QTOKEN_RPAREN
+} QueryTokenType;
+
+typedef struct QueryLexer {
+    const char *p;
+    QueryTokenType type; // 当前记号
+    const char *text;    // WORD/PHRASE的文本
+    size_t len;
+    int depth;           // 语法分析时当前所在的括号与NOT的嵌套层数
+    Arena *arena;        // 语法分析时树的节点与词条从这里分配
+} QueryLexer;
+
+static int is_word_byte(char c) {
+    return c && !isspace((unsigned char)c) && c != '(' && c != ')' && c != '"';
+}
+
+static void lexer_next(QueryLexer *lexer) {
+    const char *p = lexer->p;
+    while (*p && isspace((unsigned char)*p)) p++;
+    lexer->text = p;
+    lexer->len = 0;
+    if (!*p) {
+        lexer->type = QTOKEN_END;
+    } else if (*p == '(' || *p == ')') {
+        lexer->type = *p == '(' ? QTOKEN_LPAREN : QTOKEN_RPAREN;
+        p++;
+    } else if (*p == '"') {
+        // 缺少右引号时短语到查询末尾为止
+        const char *end = strchr(p + 1, '"');
+        if (!end) end = p + 1 + strlen(p + 1);
+        lexer->type = QTOKEN_PHRASE;
+        lexer->text = p + 1;
+        lexer->len = (size_t)(end - p - 1);
+        p = *end ? end + 1 : end;
+    } else {
+        const char *start = p;
+        while (is_word_byte(*p)) p++;
+        lexer->len = (size_t)(p - start);
+        if (lexer->len == 3 && memcmp(start, "AND", 3) == 0) lexer->type = QTOKEN_AND;
+        else if (lexer->len == 2 && memcmp(start, "OR", 2) == 0) lexer->type = QTOKEN_OR;
+        else if (lexer->len == 3 && memcmp(start, "NOT", 3) == 0) lexer->type = QTOKEN_NOT;
+        else lexer->type = QTOKEN_WORD;
+    }
+    lexer->p = p;
+}
+
+int query_is_boolean(const char *query) {
+    if (!query) return 0;
+    QueryLexer lexer = { query, QTOKEN_END, NULL, 0 };
+    for (lexer_next(&lexer); lexer.type != QTOKEN_END; lexer_next(&lexer)) {
+        if (lexer.type != QTOKEN_WORD && lexer.type != QTOKEN_PHRASE) return 1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// 语法分析
+// ---------------------------------------------------------------------------
+
+void query_free(QueryNode *node, Arena *arena) {
+    if (!node) return;
+    for (int i = 0; i < node->num_terms; i++) arena_release(arena, node->terms[i], strlen(node->terms[i]) + 1);
+    arena_release(arena, node->terms, node->num_terms * sizeof(char*));
+    for (int i = 0; i < node->num_children; i++) query_free(node->children[i], arena);
+    arena_release(arena, node->children, node->num_children * sizeof(QueryNode*));
+    arena_release(arena, node->handles, node->num_handles * sizeof(TermHandle));
+    arena_release(arena, node->phrase_terms, node->num_phrase_terms * sizeof(PhraseTerm));
+    arena_release(arena, node, sizeof(QueryNode));
+}
+
+static QueryNode* new_node(QueryNodeType type, Arena *arena) {
+    QueryNode *node = (QueryNode*)arena_alloc(arena, sizeof(QueryNode));
+    if (!node) return NULL;
+    memset(node, 0, sizeof(QueryNode));
+    node->type = type;
+    return node;
+}
+
+// 向内部节点追加子节点（child为NULL时忽略），失败返回-1并释放child
+static int add_child(QueryNode *node, QueryNode *child, Arena *arena) {
+    if (!child) return 0;
+    QueryNode **children = (QueryNode**)arena_grow(arena, node->children, node->num_children * sizeof(QueryNode*),
+                                                   (node->num_children + 1) * sizeof(QueryNode*));
+    if (!children) {
+        query_free(child, arena);
+        return -1;
+    }
+    node->children = children;
+    node->children[node->num_children++] = child;
+    return 0;
+}
+
+// 没有子节点的内部节点返回NULL，只有一个子节点时直接返回该子节点
+static QueryNode* collapse(QueryNode *node, Arena *arena) {
+    if (!node || node->num_children > 1) return node;
+    QueryNode *child = node->num_children == 1 ? node->children[0] : NULL;
+    arena_release(arena, node->children, node->num_children * sizeof(QueryNode*));
+    arena_release(arena, node, sizeof(QueryNode));
+    return child;
+}
+
+// 分词收集：词条复制为独立的字符串，指针数组按词条数逐个扩大（与节点的terms大小一致）
+typedef struct TermCollector {
+    Arena *arena; // 词条与指针数组从这里分配（NULL时使用malloc），解析出的树接管词条
+    char **terms;
+    int count;
+    int failed;
+} TermCollector;
+
+static void collect_term(const char *token, size_t len, void *context) {
+    TermCollector *collector = (TermCollector*)context;
+    if (collector->failed) return;
+    char *term = (char*)arena_alloc(collector->arena, len + 1);
+    char **terms = term ? (char**)arena_grow(collector->arena, collector->terms, collector->count * sizeof(char*),
+                                             (collector->count + 1) * sizeof(char*)) : NULL;
+    if (!terms) {
+        arena_release(collector->arena, term, len + 1);
+        collector->failed = 1;
+        return;
+    }
+    collector->terms = terms;
+    memcpy(term, token, len);
+    term[len] = '\0';
+    collector->terms[collector->count++] = term;
+}
+
+// 归还收集到的词条与指针数组
+static void release_terms(TermCollector *collector) {
+    for (int i = 0; i < collector->count; i++) {
+        arena_release(collector->arena, collector->terms[i], strlen(collector->terms[i]) + 1);
+    }
+    arena_release(collector->arena, collector->terms, collector->count * sizeof(char*));
+}
+
+// 用共享分词器切分文本（与文档的切分和大小写折叠一致），内存从arena分配
+static int tokenize_text(const char *text, size_t len, Arena *arena, TermCollector *collector) {
+    memset(collector, 0, sizeof(TermCollector));
+    collector->arena = arena;
+    char *copy = (char*)arena_alloc(arena, len + 1);
+    if (!copy) return -1;
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    tokenize_buffer(copy, len, 1, collect_term, collector);
+    arena_release(arena, copy, len + 1);
+    if (collector->failed) {
+        release_terms(collector);
+        return -1;
+    }
+    return 0;
+}
+
+QueryNode* query_clone(const QueryNode *node, Arena *arena) {
+    QueryNode *copy = new_node(node->type, arena);
+    if (!copy) return NULL;
+    TermCollector collector = { arena, NULL, 0, 0 };
+    for (int i = 0; i < node->num_terms; i++) collect_term(node->terms[i], strlen(node->terms[i]), &collector);
+    int failed = collector.failed;
+    if (failed) {
+        release_terms(&collector);
+    } else {
+        copy->terms = collector.terms;
+        copy->num_terms = collector.count;
+    }
+    for (int i = 0; i < node->num_children && !failed; i++) {
+        QueryNode *child = query_clone(node->children[i], arena);
+        if (!child || add_child(copy, child, arena) != 0) failed = 1;
+    }
+    if (failed) {
+        query_free(copy, arena);
+        return NULL;
+    }
+    return copy;
+}
+
+// 规范化的输出缓冲区
+typedef struct NormalizedQuery {
+    Arena *arena;
+    char *text;
+    size_t len;
+    size_t capacity;
+    int failed;
+} NormalizedQuery;
+
+static void append_text(NormalizedQuery *out, const char *text, size_t len) {
+    if (out->failed) return;
+    if (out->len + len + 1 > out->capacity) {
+        size_t capacity = out->capacity ? out->capacity : 64;
+        while (out->len + len + 1 > capacity) capacity *= 2;
+        char *grown = (char*)arena_grow(out->arena, out->text, out->capacity, capacity);
+        if (!grown) {
+            out->failed = 1;
+            return;
+        }
+        out->text = grown;
+        out->capacity = capacity;
+    }
+    memcpy(out->text + out->len, text, len);
+    out->len += len;
+    out->text[out->len] = '\0';
+}
+
+// 记号之间用一个空格分隔
+static void append_token(NormalizedQuery *out, const char *text, size_t len) {
+    if (out->len > 0) append_text(out, " ", 1);
+    append_text(out, text, len);
+}
+
+char* query_normalize(const char *query, Arena *arena) {
+    if (!query) return NULL;
+    NormalizedQuery out = { arena, NULL, 0, 0, 0 };
+    append_text(&out, "", 0);
+    int boolean = query_is_boolean(query);
+    QueryLexer lexer = { query, QTOKEN_END, NULL, 0 };
+    for (lexer_next(&lexer); lexer.type != QTOKEN_END && !out.failed; lexer_next(&lexer)) {
+        switch (lexer.type) {
+            case QTOKEN_AND: append_token(&out, "AND", 3); continue;
+            case QTOKEN_OR: append_token(&out, "OR", 2); continue;
+            case QTOKEN_NOT: append_token(&out, "NOT", 3); continue;
+            case QTOKEN_LPAREN: append_token(&out, "(", 1); continue;
+            case QTOKEN_RPAREN: append_token(&out, ")", 1); continue;
+            default: break;
+        }
+        TermCollector collector;
+        if (tokenize_text(lexer.text, lexer.len, arena, &collector) != 0) {
+            out.failed = 1;
+            break;
+        }
+        // 短语加引号；布尔查询中被切成多段的词是一个OR分组，加括号保持结合关系
+        int phrase = lexer.type == QTOKEN_PHRASE;
+        int group = !phrase && boolean && collector.count > 1;
+        if (collector.count > 0 && (phrase || group)) append_token(&out, phrase ? "\"" : "(", 1);
+        for (int i = 0; i < collector.count; i++) {
+            append_token(&out, collector.terms[i], strlen(collector.terms[i]));
+        }
+        if (collector.count > 0 && (phrase || group)) append_token(&out, phrase ? "\"" : ")", 1);
+        release_terms(&collector);
+    }
+    if (out.failed) {
+        arena_release(arena, out.text, out.capacity);
+        return NULL;
+    }
+    return out.text;
+}
+
+static QueryNode* parse_or(QueryLexer *lexer, int *failed);
+
+static QueryNode* parse_primary(QueryLexer *lexer, int *failed) {
+    if (lexer->type == QTOKEN_LPAREN) {
+        if (lexer->depth >= QUERY_MAX_DEPTH) {
+            *failed = 1;
+            return NULL;
+        }
+        lexer_next(lexer);
+        lexer->depth++;
+        QueryNode *node = parse_or(lexer, failed);
+        lexer->depth--;
+        if (lexer->type == QTOKEN_RPAREN) lexer_next(lexer);
+        return node;
+    }
+    if (lexer->type != QTOKEN_WORD && lexer->type != QTOKEN_PHRASE) {
+        lexer_next(lexer); // 不能出现在此处的记号（如多余的右括号）直接跳过
+        return NULL;
+    }
+
+    int phrase = lexer->type == QTOKEN_PHRASE;
+    TermCollector collector;
+    if (tokenize_text(lexer->text, lexer->len, lexer->arena, &collector) != 0) {
+        *failed = 1;
+        return NULL;
+    }
+    lexer_next(lexer);
+    if (collector.count == 0) return NULL;
+    if (phrase || collector.count == 1) {
+        QueryNode *node = new_node(phrase ? QUERY_PHRASE : QUERY_TERM, lexer->arena);
+        if (!node) {
+            release_terms(&collector);
+            *failed = 1;
+            return NULL;
+        }
+        node->terms = collector.terms;
+        node->num_terms = collector.count;
+        return node;
+    }
+
+    // 一个词被切成多段（如"e-mail"）：各段之间按OR处理
+    Arena *arena = lexer->arena;
+    QueryNode *node = new_node(QUERY_OR, arena);
+    for (int i = 0; i < collector.count; i++) {
+        QueryNode *term = node ? new_node(QUERY_TERM, arena) : NULL;
+        char **terms = term ? (char**)arena_alloc(arena, sizeof(char*)) : NULL;
+        if (!terms) {
+            arena_release(arena, collector.terms[i], strlen(collector.terms[i]) + 1);
+            arena_release(arena, term, sizeof(QueryNode));
+            *failed = 1;
+            continue;
+        }
+        term->terms = terms;
+        term->terms[0] = collector.terms[i];
+        term->num_terms = 1;
+        if (add_child(node, term, arena) != 0) *failed = 1;
+    }
+    arena_release(arena, collector.terms, collector.count * sizeof(char*));
+    return collapse(node, arena);
+}
+
+static QueryNode* parse_unary(QueryLexer *lexer, int *failed) {
+    if (lexer->type != QTOKEN_NOT) return parse_primary(lexer, failed);
+    if (lexer->depth >= QUERY_MAX_DEPTH) {
+        *failed = 1;
+        return NULL;
+    }
+    lexer_next(lexer);
+    lexer->depth++;
+    QueryNode *operand = parse_unary(lexer, failed);
+    lexer->depth--;
+    if (!operand) return NULL;
+    QueryNode *node = new_node(QUERY_NOT, lexer->arena);
+    if (!node || add_child(node, operand, lexer->arena) != 0) {
+        if (!node) query_free(operand, lexer->arena);
+        arena_release(lexer->arena, node, sizeof(QueryNode));
+        *failed = 1;
+        return NULL;
+    }
+    return node;
+}
+
+static QueryNode* parse_and(QueryLexer *lexer, int *failed) {
+    QueryNode *node = new_node(QUERY_AND, lexer->arena);
+    if (!node) {
+        *failed = 1;
+        return NULL;
+    }
+    if (add_child(node, parse_unary(lexer, failed), lexer->arena) != 0) *failed = 1;
+    while (!*failed && lexer->type == QTOKEN_AND) {
+        lexer_next(lexer);
+        if (add_child(node, parse_unary(lexer, failed), lexer->arena) != 0) *failed = 1;
+    }
+    return collapse(node, lexer->arena);
+}
+
+// 相邻的操作数之间没有运算符时按OR处理
+static int starts_operand(QueryTokenType type) {
+    return type == QTOKEN_WORD || type == QTOKEN_PHRASE || type == QTOKEN_NOT || type == QTOKEN_LPAREN;
+}
+
+static QueryNode* parse_or(QueryLexer *lexer, int *failed) {
+    QueryNode *node = new_node(QUERY_OR, lexer->arena);
+    if (!node) {
+        *failed = 1;
+        return NULL;
+    }
+    if (add_child(node, parse_and(lexer, failed), lexer->arena) != 0) *failed = 1;
+    while (!*failed && (lexer->type == QTOKEN_OR || lexer->type == QTOKEN_AND || starts_operand(lexer->type))) {
+        // 开头或连续出现的运算符（如"a OR OR b"、"AND b"）跳过
+        if (lexer->type == QTOKEN_OR || lexer->type == QTOKEN_AND) lexer_next(lexer);
+        if (add_child(node, parse_and(lexer, failed), lexer->arena) != 0) *failed = 1;
+    }
+    return collapse(node, lexer->arena);
+}
+
+QueryNode* query_parse(const char *query, Arena *arena) {
+    if (!query) return NULL;
+    QueryLexer lexer = { query, QTOKEN_END, NULL, 0, 0, arena };
+    lexer_next(&lexer);
+    int failed = 0;
+    QueryNode *root = new_node(QUERY_OR, arena);
+    if (!root) return NULL;
+    // 多余的右括号结束了一个分组时继续解析后面的部分，各部分之间按OR处理（放在同一个OR节点下，不加深树）
+    while (lexer.type != QTOKEN_END && !failed) {
+        QueryNode *part = parse_or(&lexer, &failed);
+        if (lexer.type == QTOKEN_RPAREN) lexer_next(&lexer);
+        if (add_child(root, part, arena) != 0) failed = 1;
+    }
+    if (failed) {
+        query_free(root, arena);
+        return NULL;
+    }
+    return collapse(root, arena);
+}
+
+static int count_leaves(const QueryNode *node) {
+    if (node->type == QUERY_TERM || node->type == QUERY_PHRASE) return 1;
+    int count = 0;
+    for (int i = 0; i < node->num_children; i++) count += count_leaves(node->children[i]);
+    return count;
+}
+
+static void collect_leaves(QueryNode *node, int negated, QueryNode **leaves, unsigned char *flags, int *count) {
+    if (node->type == QUERY_TERM || node->type == QUERY_PHRASE) {
+        leaves[*count] = node;
+        flags[*count] = (unsigned char)negated;
+        (*count)++;
+        return;
+    }
+    int child_negated = node->type == QUERY_NOT ? !negated : negated;
+    for (int i = 0; i < node->num_children; i++) collect_leaves(node->children[i], child_negated, leaves, flags, count);
+}
+
+int query_collect_leaves(QueryNode *root, Arena *arena, QueryNode ***leaves, unsigned char **negated) {
+    *leaves = NULL;
+    *negated = NULL;
+    if (!root) return 0;
+    int total = count_leaves(root);
+    *leaves = (QueryNode**)arena_alloc(arena, total * sizeof(QueryNode*));
+    *negated = (unsigned char*)arena_alloc(arena, total);
+    if (!*leaves || !*negated) {
+        arena_release(arena, *leaves, total * sizeof(QueryNode*));
+        arena_release(arena, *negated, total);
+        *leaves = NULL;
+        *negated = NULL;
+        return -1;
+    }
+    int count = 0;
+    collect_leaves(root, 0, *leaves, *negated, &count);
+    return count;
+}
+
+int query_bind_term(QueryNode *leaf, const TermHandle *handles, int count, Arena *arena) {
+    arena_release(arena, leaf->handles, leaf->num_handles * sizeof(TermHandle));
+    leaf->handles = NULL;
+    leaf->num_handles = 0;
+    if (count <= 0) return 0;
+    leaf->handles = (TermHandle*)arena_alloc(arena, count * sizeof(TermHandle));
+    if (!leaf->handles) return -1;
+    memcpy(leaf->handles, handles, count * sizeof(TermHandle));
+    leaf->num_handles = count;
+    return 0;
+}
+
+int query_bind_phrase(QueryNode *leaf, const PhraseTerm *terms, int count, Arena *arena) {
+    arena_release(arena, leaf->phrase_terms, leaf->num_phrase_terms * sizeof(PhraseTerm));
+    leaf->phrase_terms = NULL;
+    leaf->num_phrase_terms = 0;
+    if (count <= 0) return 0;
+    leaf->phrase_terms = (PhraseTerm*)arena_alloc(arena, count * sizeof(PhraseTerm));
+    if (!leaf->phrase_terms) return -1;
+    memcpy(leaf->phrase_terms, terms, count * sizeof(PhraseTerm));
+    leaf->num_phrase_terms = count;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// 执行
+// ---------------------------------------------------------------------------
+
+// 求值过程中的文档列表与位图都从arena分配、用完即归还；文档列表一律按段的文档数分配，
+// 大小相同的列表落在同一级，归还后由下一个列表复用
+typedef struct QueryExecutor {
+    const Segment *segment;
+    const uint64_t *live_docs;
+    int num_docs;
+    int num_words; // 文档位图的uint64个数
+    Arena *arena;
+} QueryExecutor;
+
+// 操作数的代价：求出其文档列表需要遍历的postings数（估计值）
+static long long node_cost(const QueryExecutor *exec, const QueryNode *node) {
+    long long cost = 0;
+    switch (node->type) {
+        case QUERY_TERM:
+            for (int i = 0; i < node->num_handles; i++) cost += node->handles[i].doc_count;
+            return cost;
+        case QUERY_PHRASE:
+            // 逐文档求交由最短的词带动
+            if (node->num_phrase_terms == 0) return 0;
+            cost = node->phrase_terms[0].handle.doc_count;
+            for (int i = 1; i < node->num_phrase_terms; i++) {
+                if (node->phrase_terms[i].handle.doc_count < cost) cost = node->phrase_terms[i].handle.doc_count;
+            }
+            return cost;
+        case QUERY_AND:
+            cost = exec->num_docs;
+            for (int i = 0; i < node->num_children; i++) {
+                if (node->children[i]->type == QUERY_NOT) continue;
+                long long child = node_cost(exec, node->children[i]);
+                if (child < cost) cost = child;
+            }
+            return cost;
+        case QUERY_OR:
+            for (int i = 0; i < node->num_children; i++) cost += node_cost(exec, node->children[i]);
+            return cost;
+        case QUERY_NOT:
+        default:
+            return exec->num_docs;
+    }
+}
+
+static size_t bitmap_bytes(const QueryExecutor *exec) {
+    return (exec->num_words > 0 ? exec->num_words : 1) * sizeof(uint64_t);
+}
+
+static uint64_t* new_bitmap(const QueryExecutor *exec) {
+    uint64_t *bits = (uint64_t*)arena_alloc(exec->arena, bitmap_bytes(exec));
+    if (bits) memset(bits, 0, bitmap_bytes(exec));
+    return bits;
+}
+
+static void free_bitmap(const QueryExecutor *exec, uint64_t *bits) {
+    arena_release(exec->arena, bits, bitmap_bytes(exec));
+}
+
+static size_t list_bytes(int num_docs) {
+    return (num_docs > 0 ? num_docs : 1) * sizeof(int);
+}
+
+// 能容纳段内全部文档的列表
+static int* new_list(const QueryExecutor *exec) {
+    return (int*)arena_alloc(exec->arena, list_bytes(exec->num_docs));
+}
+
+static void free_list(const QueryExecutor *exec, int *docs) {
+    arena_release(exec->arena, docs, list_bytes(exec->num_docs));
+}
+
+// 位图中的文档按ID升序写成列表
+static int* bitmap_to_list(const QueryExecutor *exec, const uint64_t *bits, int *count) {
+    int *docs = new_list(exec);
+    *count = 0;
+    if (!docs) return NULL;
+    for (int w = 0; w < exec->num_words; w++) {
+        uint64_t word = bits[w];
+        while (word) {
+            docs[(*count)++] = w * 64 + __builtin_ctzll(word);
+            word &= word - 1;
+        }
+    }
+    return docs;
+}
+
+// 全部存活文档
+static int* all_docs(const QueryExecutor *exec, int *count) {
+    int *docs = new_list(exec);
+    *count = 0;
+    if (!docs) return NULL;
+    for (int doc_id = 0; doc_id < exec->num_docs; doc_id++) {
+        if (DOC_IS_LIVE(exec->live_docs, doc_id)) docs[(*count)++] = doc_id;
+    }
+    return docs;
+}
+
+static int* materialize(const QueryExecutor *exec, const QueryNode *node, int *count);
+static int filter(const QueryExecutor *exec, const QueryNode *node, int *docs, int count);
+
+// 只保留docs中不满足node的文档（有序差集），返回剩余个数，失败返回-1
+static int filter_out(const QueryExecutor *exec, const QueryNode *node, int *docs, int count) {
+    if (count == 0) return 0;
+    int *matched = new_list(exec);
+    if (!matched) return -1;
+    memcpy(matched, docs, count * sizeof(int));
+    int num_matched = filter(exec, node, matched, count);
+    if (num_matched < 0) {
+        free_list(exec, matched);
+        return -1;
+    }
+    int kept = 0, j = 0;
+    for (int i = 0; i < count; i++) {
+        while (j < num_matched && matched[j] < docs[i]) j++;
+        if (j < num_matched && matched[j] == docs[i]) continue;
+        docs[kept++] = docs[i];
+    }
+    free_list(exec, matched);
+    return kept;
+}
+
+// 文档列表转为位图
+static uint64_t* list_to_bitmap(const QueryExecutor *exec, const int *docs, int count) {
+    uint64_t *bits = new_bitmap(exec);
+    if (!bits) return NULL;
+    for (int i = 0; i < count; i++) bits[docs[i] >> 6] |= 1ULL << (docs[i] & 63);
+    return bits;
+}
+
+// 按位图压缩列表，返回剩余个数
+static int keep_marked(int *docs, int count, const uint64_t *bits) {
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if ((bits[docs[i] >> 6] >> (docs[i] & 63)) & 1) docs[kept++] = docs[i];
+    }
+    return kept;
+}
+
+// AND的操作数顺序：非NOT的操作数按代价升序（最短的先求），NOT操作数放在最后
+typedef struct OperandOrder {
+    const QueryNode *node;
+    long long cost;
+    int index;
+} OperandOrder;
+
+static int compare_operands(const void *a, const void *b) {
+    const OperandOrder *x = (const OperandOrder*)a;
+    const OperandOrder *y = (const OperandOrder*)b;
+    if (x->cost != y->cost) return x->cost < y->cost ? -1 : 1;
+    return x->index - y->index;
+}
+
+static OperandOrder* order_operands(const QueryExecutor *exec, const QueryNode *node) {
+    OperandOrder *order = (OperandOrder*)arena_alloc(exec->arena, node->num_children * sizeof(OperandOrder));
+    if (!order) return NULL;
+    for (int i = 0; i < node->num_children; i++) {
+        const QueryNode *child = node->children[i];
+        order[i].node = child;
+        order[i].cost = child->type == QUERY_NOT ? (long long)exec->num_docs + 1 : node_cost(exec, child);
+        order[i].index = i;
+    }
+    arena_sort(exec->arena, order, node->num_children, sizeof(OperandOrder), compare_operands);
+    return order;
+}
+
+static void free_order(const QueryExecutor *exec, const QueryNode *node, OperandOrder *order) {
+    arena_release(exec->arena, order, node->num_children * sizeof(OperandOrder));
+}
+
+// 依次用AND的各操作数筛选docs（从first开始），返回剩余个数
+static int filter_operands(const QueryExecutor *exec, const OperandOrder *order, int first, int num_operands,
+                           int *docs, int count) {
+    for (int i = first; i < num_operands && count > 0; i++) {
+        const QueryNode *operand = order[i].node;
+        count = operand->type == QUERY_NOT ? filter_out(exec, operand->children[0], docs, count)
+                                           : filter(exec, operand, docs, count);
+        if (count < 0) return -1;
+    }
+    return count;
+}
+
+// 在docs中只保留满足node的文档（docs升序，原地压缩），返回剩余个数，失败返回-1
+static int filter(const QueryExecutor *exec, const QueryNode *node, int *docs, int count) {
+    if (count == 0) return 0;
+    switch (node->type) {
+        case QUERY_TERM: {
+            // 候选文档升序，每个扩展词的游标只前进不后退，借助跳表头跳过候选之间的块
+            size_t cursors_size = (node->num_handles > 0 ? node->num_handles : 1) * sizeof(PostingCursor);
+            PostingCursor *cursors = (PostingCursor*)arena_alloc(exec->arena, cursors_size);
+            if (!cursors) return -1;
+            int num_cursors = 0;
+            for (int i = 0; i < node->num_handles; i++) {
+                if (segment_posting_cursor(exec->segment, &node->handles[i], &cursors[num_cursors])) num_cursors++;
+            }
+            int kept = 0;
+            for (int i = 0; i < count; i++) {
+                int doc_id = docs[i];
+                for (int c = 0; c < num_cursors; c++) {
+                    if (posting_cursor_advance(&cursors[c], doc_id) && cursors[c].doc_id == doc_id) {
+                        docs[kept++] = doc_id;
+                        break;
+                    }
+                }
+            }
+            arena_release(exec->arena, cursors, cursors_size);
+            return kept;
+        }
+        case QUERY_PHRASE: {
+            if (node->num_phrase_terms == 0) return 0;
+            uint64_t *bits = list_to_bitmap(exec, docs, count);
+            if (!bits) return -1;
+            int remaining = phrase_filter(exec->segment, node->phrase_terms, node->num_phrase_terms, bits,
+                                          exec->arena);
+            int kept = remaining < 0 ? -1 : keep_marked(docs, count, bits);
+            free_bitmap(exec, bits);
+            return kept;
+        }
+        case QUERY_AND: {
+            OperandOrder *order = order_operands(exec, node);
+            if (!order) return -1;
+            count = filter_operands(exec, order, 0, node->num_children, docs, count);
+            free_order(exec, node, order);
+            return count;
+        }
+        case QUERY_OR: {
+            // 每个操作数只检查尚未被之前的操作数匹配的文档
+            uint64_t *matched = new_bitmap(exec);
+            int *pending = new_list(exec);
+            int *checked = new_list(exec);
+            int failed = !matched || !pending || !checked;
+            int num_pending = count;
+            if (!failed) memcpy(pending, docs, count * sizeof(int));
+            for (int i = 0; i < node->num_children && !failed && num_pending > 0; i++) {
+                memcpy(checked, pending, num_pending * sizeof(int));
+                int num_checked = filter(exec, node->children[i], checked, num_pending);
+                if (num_checked < 0) {
+                    failed = 1;
+                    break;
+                }
+                for (int j = 0; j < num_checked; j++) matched[checked[j] >> 6] |= 1ULL << (checked[j] & 63);
+                int kept = 0;
+                for (int j = 0; j < num_pending; j++) {
+                    if (!((matched[pending[j] >> 6] >> (pending[j] & 63)) & 1)) pending[kept++] = pending[j];
+                }
+                num_pending = kept;
+            }
+            int kept = failed ? -1 : keep_marked(docs, count, matched);
+            free_bitmap(exec, matched);
+            free_list(exec, pending);
+            free_list(exec, checked);
+            return kept;
+        }
+        case QUERY_NOT:
+            return filter_out(exec, node->children[0], docs, count);
+    }
+    return -1;
+}
+
+// 求出满足node的存活文档列表（升序），失败返回NULL
+static int* materialize(const QueryExecutor *exec, const QueryNode *node, int *count) {
+    *count = 0;
+    switch (node->type) {
+        case QUERY_TERM: {
+            // 扩展词的postings求并（同一文档可能出现在多个扩展词中）
+            uint64_t *bits = new_bitmap(exec);
+            if (!bits) return NULL;
+            for (int i = 0; i < node->num_handles; i++) {
+                PostingCursor cursor;
+                if (!segment_posting_cursor(exec->segment, &node->handles[i], &cursor)) continue;
+                while (posting_cursor_next(&cursor)) {
+                    int doc_id = cursor.doc_id;
+                    if (doc_id < exec->num_docs && DOC_IS_LIVE(exec->live_docs, doc_id)) {
+                        bits[doc_id >> 6] |= 1ULL << (doc_id & 63);
+                    }
+                }
+            }
+            int *docs = bitmap_to_list(exec, bits, count);
+            free_bitmap(exec, bits);
+            return docs;
+        }
+        case QUERY_PHRASE: {
+            if (node->num_phrase_terms == 0) return new_list(exec);
+            int num_docs;
+            int *docs = all_docs(exec, &num_docs);
+            if (!docs) return NULL;
+            *count = filter(exec, node, docs, num_docs);
+            if (*count < 0) {
+                free_list(exec, docs);
+                *count = 0;
+                return NULL;
+            }
+            return docs;
+        }
+        case QUERY_AND: {
+            // 先求代价最小的操作数，其余操作数只检查它的结果；全是NOT时从全部存活文档开始
+            OperandOrder *order = order_operands(exec, node);
+            if (!order) return NULL;
+            int first = order[0].node->type == QUERY_NOT ? 0 : 1;
+            int *docs = first ? materialize(exec, order[0].node, count) : all_docs(exec, count);
+            if (docs) {
+                *count = filter_operands(exec, order, first, node->num_children, docs, *count);
+                if (*count < 0) {
+                    free_list(exec, docs);
+                    docs = NULL;
+                    *count = 0;
+                }
+            }
+            free_order(exec, node, order);
+            return docs;
+        }
+        case QUERY_OR: {
+            uint64_t *bits = new_bitmap(exec);
+            if (!bits) return NULL;
+            for (int i = 0; i < node->num_children; i++) {
+                int child_count;
+                int *child = materialize(exec, node->children[i], &child_count);
+                if (!child) {
+                    free_bitmap(exec, bits);
+                    return NULL;
+                }
+                for (int j = 0; j < child_count; j++) bits[child[j] >> 6] |= 1ULL << (child[j] & 63);
+                free_list(exec, child);
+            }
+            int *docs = bitmap_to_list(exec, bits, count);
+            free_bitmap(exec, bits);
+            return docs;
+        }
+        case QUERY_NOT: {
+            int *docs = all_docs(exec, count);
+            if (!docs) return NULL;
+            *count = filter_out(exec, node->children[0], docs, *count);
+            if (*count < 0) {
+                free_list(exec, docs);
+                *count = 0;
+                return NULL;
+            }
+            return docs;
+        }
+    }
+    return NULL;
+}
+
+int* query_execute(const QueryNode *root, const Segment *segment, const uint64_t *live_docs, Arena *arena,
+                   int *count) {
+    *count = -1;
+    if (!root || !segment) return NULL;
+    QueryExecutor exec;
+    exec.segment = segment;
+    exec.live_docs = live_docs;
+    exec.num_docs = segment->num_docs;
+    exec.num_words = (segment->num_docs + 63) / 64;
+    exec.arena = arena;
+    int *docs = materialize(&exec, root, count);
+    if (!docs) *count = -1;
+    return docs;
+}
+
+void query_release_docs(int *docs, const Segment *segment, Arena *arena) {
+    arena_release(arena, docs, list_bytes(segment->num_docs));
+}
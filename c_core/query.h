@@ -0,0 +1,80 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include <stdint.h>
+#include "arena.h"
+#include "segment.h"
+#include "phrase.h"
+
+// 布尔查询：解析为运算符树，再在每个段的按文档ID排序的postings上求出匹配文档
+//
+// 语法（运算符必须大写，优先级 NOT > AND > OR）：
+//   a AND b      两者都出现
+//   a OR b       任一出现；相邻的操作数之间没有运算符时也按OR处理（与普通查询一致）
+//   NOT a        不出现
+//   ( ... )      分组；缺少右括号时到查询末尾为止
+// 括号与NOT合计最多嵌套QUERY_MAX_DEPTH层，更深的查询解析失败（解析与执行都是递归的，以此限制栈深度）
+//   "a b"        短语（按原顺序紧邻出现，见phrase.h）
+// 普通的词与普通查询一样做前缀扩展，一个词被分词器切成多段时各段之间按OR处理；
+// 扩展不出任何词条的词（如停用词）、只由停用词与短词组成的短语、含索引中没有的词的短语不匹配任何文档
+
+#define QUERY_MAX_DEPTH 64
+
+typedef enum QueryNodeType {
+    QUERY_TERM = 0, // 单个查询词（按前缀扩展出的词条匹配）
+    QUERY_PHRASE,   // 短语
+    QUERY_AND,
+    QUERY_OR,
+    QUERY_NOT       // 只有一个子节点
+} QueryNodeType;
+
+typedef struct QueryNode {
+    QueryNodeType type;
+    char **terms;      // TERM：1个词；PHRASE：短语中的全部词（下标即在短语中的位置）
+    int num_terms;
+    struct QueryNode **children;
+    int num_children;
+    // 叶子在当前段中的词条，执行前由调用者用query_bind_term/query_bind_phrase绑定
+    TermHandle *handles;      // TERM：该词在段中的扩展词条
+    int num_handles;
+    PhraseTerm *phrase_terms; // PHRASE：短语中除停用词与短词以外的词（有词不在段中时为空）
+    int num_phrase_terms;
+} QueryNode;
+
+// 查询是否用到了布尔语法（AND/OR/NOT运算符或括号）；不含时按普通查询处理
+int query_is_boolean(const char *query);
+
+// 规范化查询文本（失败返回NULL）：查询词按分词器切分并转为小写，运算符、括号与短语的引号保留，
+// 记号之间用一个空格分隔。求值结果相同的写法（大小写、空白、标点不同）得到同一个字符串，可作为缓存键；
+// 规范化后的文本与原查询按同样的语法求值（是否为布尔查询也不变）。
+// 结果与临时内存都从arena分配，随arena作废；arena为NULL时使用malloc，调用者free结果
+char* query_normalize(const char *query, Arena *arena);
+
+// 以下函数的内存都从arena分配（arena为NULL时使用malloc）：树的节点、词条与绑定随arena作废，
+// 也可以用query_free逐个归还（须传入分配时的arena）
+
+// 解析查询，没有任何查询词或嵌套超过QUERY_MAX_DEPTH层时返回NULL
+QueryNode* query_parse(const char *query, Arena *arena);
+void query_free(QueryNode *node, Arena *arena);
+
+// 复制一棵树（词条一并复制，不复制绑定），失败返回NULL。
+// 绑定保存在节点中，多个线程同时在不同的段上求值时各自使用一份副本
+QueryNode* query_clone(const QueryNode *node, Arena *arena);
+
+// 按在查询中出现的顺序收集叶子（TERM与PHRASE），negated[i]非0表示第i个叶子处在奇数层NOT之下。
+// 返回叶子数n，*leaves（n个指针）与*negated（n字节）从arena分配；失败返回-1
+int query_collect_leaves(QueryNode *root, Arena *arena, QueryNode ***leaves, unsigned char **negated);
+
+// 为叶子绑定当前段中的词条（复制一份，替换并归还之前的绑定），成功返回0
+int query_bind_term(QueryNode *leaf, const TermHandle *handles, int count, Arena *arena);
+int query_bind_phrase(QueryNode *leaf, const PhraseTerm *terms, int count, Arena *arena);
+
+// 在段上求出满足查询的存活文档（段内文档ID升序），*count为文档数；失败返回NULL且*count为-1。
+// 结果与求值的临时列表、位图都从arena分配，结果用完后由query_release_docs归还。
+// AND先求出代价（postings数估计）最小的操作数，其余操作数只对已有的候选文档检查：
+// 游标借助跳表头跳到候选文档，不解码与候选无关的块
+int* query_execute(const QueryNode *root, const Segment *segment, const uint64_t *live_docs, Arena *arena,
+                   int *count);
+void query_release_docs(int *docs, const Segment *segment, Arena *arena);
+
+#endif
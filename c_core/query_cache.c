@@ -0,0 +1,274 @@
+#include "query_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include "query.h"
+
+#define QUERY_CACHE_INITIAL_BUCKETS 64
+
+// 键中的搜索选项：不影响结果的取值先归一（如各种“不限”的写法、TF-IDF下的BM25参数）
+typedef struct CacheKeyOptions {
+    int top_k;
+    ScoringMode scoring;
+    int max_expansions;
+    long long max_expansion_postings;
+    double proximity_weight;
+    ScoringModel model;
+    double bm25_k1;
+    double bm25_b;
+} CacheKeyOptions;
+
+// 缓存项与其结果数组、键文本、文档路径分配在同一块内存中：
+// [CacheEntry][SearchResult × count][键文本\0][路径\0 ...]
+typedef struct CacheEntry {
+    uint64_t hash;
+    CacheKeyOptions options;
+    const char *query;           // 规范化的查询文本
+    SearchResult *results;
+    int count;
+    size_t bytes;                // 整块内存的大小
+    struct CacheEntry *bucket_next;
+    struct CacheEntry *prev;     // LRU链表：head为最近使用
+    struct CacheEntry *next;
+} CacheEntry;
+
+struct QueryCache {
+    CacheEntry **buckets;
+    int num_buckets; // 2的幂
+    CacheEntry *head;
+    CacheEntry *tail;
+    uint64_t generation;
+    int has_generation;
+    QueryCacheStats stats;
+    Arena *scratch; // 规范化查询文本的临时内存（每次查询开始时作废，稳定之后命中的查询不再malloc）
+};
+
+static void key_options_init(CacheKeyOptions *key, const SearchOptions *options) {
+    memset(key, 0, sizeof(CacheKeyOptions));
+    key->top_k = options->top_k > 0 ? options->top_k : 0;
+    key->scoring = options->scoring;
+    key->max_expansions = options->max_expansions > 0 ? options->max_expansions : 0;
+    key->max_expansion_postings = options->max_expansion_postings > 0 ? options->max_expansion_postings : 0;
+    key->proximity_weight = options->proximity_weight > 0 ? options->proximity_weight : 0.0;
+    key->model = options->model;
+    if (options->model == SCORING_MODEL_BM25) {
+        key->bm25_k1 = options->bm25_k1;
+        key->bm25_b = options->bm25_b;
+    }
+}
+
+static int key_options_equal(const CacheKeyOptions *a, const CacheKeyOptions *b) {
+    return a->top_k == b->top_k && a->scoring == b->scoring && a->max_expansions == b->max_expansions
+        && a->max_expansion_postings == b->max_expansion_postings && a->proximity_weight == b->proximity_weight
+        && a->model == b->model && a->bm25_k1 == b->bm25_k1 && a->bm25_b == b->bm25_b;
+}
+
+// FNV-1a：查询文本之后再混入结果数与打分方式、模型（其余选项很少变化，只参与比较）
+static uint64_t hash_key(const char *query, const CacheKeyOptions *options) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char*)query; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    uint64_t extra[3] = { (uint64_t)options->top_k, (uint64_t)options->scoring, (uint64_t)options->model };
+    for (int i = 0; i < 3; i++) {
+        hash ^= extra[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+QueryCache* query_cache_create(size_t max_bytes) {
+    QueryCache *cache = (QueryCache*)calloc(1, sizeof(QueryCache));
+    if (!cache) return NULL;
+    cache->buckets = (CacheEntry**)calloc(QUERY_CACHE_INITIAL_BUCKETS, sizeof(CacheEntry*));
+    cache->scratch = arena_create();
+    if (!cache->buckets || !cache->scratch) {
+        free(cache->buckets);
+        arena_destroy(cache->scratch);
+        free(cache);
+        return NULL;
+    }
+    cache->num_buckets = QUERY_CACHE_INITIAL_BUCKETS;
+    cache->stats.max_bytes = max_bytes;
+    return cache;
+}
+
+void query_cache_clear(QueryCache *cache) {
+    if (!cache) return;
+    CacheEntry *entry = cache->head;
+    while (entry) {
+        CacheEntry *next = entry->next;
+        free(entry);
+        entry = next;
+    }
+    memset(cache->buckets, 0, cache->num_buckets * sizeof(CacheEntry*));
+    cache->head = cache->tail = NULL;
+    cache->stats.entries = 0;
+    cache->stats.bytes = 0;
+}
+
+void query_cache_free(QueryCache *cache) {
+    if (!cache) return;
+    query_cache_clear(cache);
+    free(cache->buckets);
+    arena_destroy(cache->scratch);
+    free(cache);
+}
+
+void query_cache_stats(const QueryCache *cache, QueryCacheStats *stats) {
+    if (!cache) {
+        memset(stats, 0, sizeof(QueryCacheStats));
+        return;
+    }
+    *stats = cache->stats;
+}
+
+static void list_unlink(QueryCache *cache, CacheEntry *entry) {
+    if (entry->prev) entry->prev->next = entry->next;
+    else cache->head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else cache->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+static void list_push_front(QueryCache *cache, CacheEntry *entry) {
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head) cache->head->prev = entry;
+    cache->head = entry;
+    if (!cache->tail) cache->tail = entry;
+}
+
+static CacheEntry* find_entry(const QueryCache *cache, uint64_t hash, const char *query,
+                              const CacheKeyOptions *options) {
+    for (CacheEntry *entry = cache->buckets[hash & (cache->num_buckets - 1)]; entry; entry = entry->bucket_next) {
+        if (entry->hash == hash && key_options_equal(&entry->options, options) && strcmp(entry->query, query) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// 从哈希表与LRU链表中摘除并释放
+static void remove_entry(QueryCache *cache, CacheEntry *entry) {
+    CacheEntry **link = &cache->buckets[entry->hash & (cache->num_buckets - 1)];
+    while (*link != entry) link = &(*link)->bucket_next;
+    *link = entry->bucket_next;
+    list_unlink(cache, entry);
+    cache->stats.entries--;
+    cache->stats.bytes -= entry->bytes;
+    free(entry);
+}
+
+// 缓存项多于桶数时桶数翻倍（扩容失败时继续使用原来的桶）
+static void grow_buckets(QueryCache *cache) {
+    if (cache->stats.entries < cache->num_buckets) return;
+    int num_buckets = cache->num_buckets * 2;
+    CacheEntry **buckets = (CacheEntry**)calloc(num_buckets, sizeof(CacheEntry*));
+    if (!buckets) return;
+    for (CacheEntry *entry = cache->head; entry; entry = entry->next) {
+        CacheEntry **bucket = &buckets[entry->hash & (num_buckets - 1)];
+        entry->bucket_next = *bucket;
+        *bucket = entry;
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->num_buckets = num_buckets;
+}
+
+// 把结果复制进一个新缓存项；超过内存上限或分配失败返回NULL
+static CacheEntry* new_entry(const QueryCache *cache, uint64_t hash, const char *query,
+                             const CacheKeyOptions *options, const SearchResult *results, int count) {
+    size_t query_len = strlen(query) + 1;
+    size_t bytes = sizeof(CacheEntry) + count * sizeof(SearchResult) + query_len;
+    for (int i = 0; i < count; i++) bytes += strlen(results[i].doc_path) + 1;
+    if (bytes > cache->stats.max_bytes) return NULL;
+
+    CacheEntry *entry = (CacheEntry*)malloc(bytes);
+    if (!entry) return NULL;
+    memset(entry, 0, sizeof(CacheEntry));
+    entry->hash = hash;
+    entry->options = *options;
+    entry->results = (SearchResult*)(entry + 1);
+    entry->count = count;
+    entry->bytes = bytes;
+    char *text = (char*)(entry->results + count);
+    memcpy(text, query, query_len);
+    entry->query = text;
+    text += query_len;
+    for (int i = 0; i < count; i++) {
+        size_t len = strlen(results[i].doc_path) + 1;
+        memcpy(text, results[i].doc_path, len);
+        entry->results[i].doc_id = results[i].doc_id;
+        entry->results[i].score = results[i].score;
+        entry->results[i].doc_path = text;
+        text += len;
+    }
+    return entry;
+}
+
+const SearchResult* query_cache_search(QueryCache *cache, SearchContext *context, const SegmentSet *set,
+                                       const char *query, const SearchOptions *options, int *result_count) {
+    *result_count = 0;
+    if (!cache || !context || !set || !query) return NULL;
+
+    SearchOptions defaults;
+    if (!options) {
+        search_options_init(&defaults);
+        options = &defaults;
+    }
+
+    // 段集合换成了新的generation：旧结果全部作废
+    if (!cache->has_generation || cache->generation != set->generation) {
+        if (cache->stats.entries > 0) cache->stats.invalidations++;
+        query_cache_clear(cache);
+        cache->generation = set->generation;
+        cache->has_generation = 1;
+    }
+
+    arena_reset(cache->scratch);
+    char *normalized = query_normalize(query, cache->scratch);
+    if (!normalized) {
+        // 规范化失败（内存不足）时不经过缓存
+        cache->stats.misses++;
+        return search_context_run(context, set, query, options, result_count);
+    }
+
+    CacheKeyOptions key;
+    key_options_init(&key, options);
+    uint64_t hash = hash_key(normalized, &key);
+    CacheEntry *entry = find_entry(cache, hash, normalized, &key);
+    if (entry) {
+        cache->stats.hits++;
+        list_unlink(cache, entry);
+        list_push_front(cache, entry);
+        *result_count = entry->count;
+        return entry->count > 0 ? entry->results : NULL;
+    }
+
+    cache->stats.misses++;
+    // 结果归context所有：放不进缓存时直接返回
+    int count;
+    const SearchResult *results = search_context_run(context, set, normalized, options, &count);
+    entry = new_entry(cache, hash, normalized, &key, results, count);
+    if (!entry) {
+        *result_count = count;
+        return results;
+    }
+
+    // 从最久未使用的一端淘汰，直到放得下新缓存项
+    while (cache->tail && cache->stats.bytes + entry->bytes > cache->stats.max_bytes) {
+        remove_entry(cache, cache->tail);
+        cache->stats.evictions++;
+    }
+    CacheEntry **bucket = &cache->buckets[hash & (cache->num_buckets - 1)];
+    entry->bucket_next = *bucket;
+    *bucket = entry;
+    list_push_front(cache, entry);
+    cache->stats.entries++;
+    cache->stats.bytes += entry->bytes;
+    grow_buckets(cache);
+
+    *result_count = entry->count;
+    return entry->count > 0 ? entry->results : NULL;
+}
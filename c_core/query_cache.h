@@ -0,0 +1,45 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "search.h"
+#include "segment_set.h"
+
+// 查询结果缓存：放在perform_search之前，供常驻进程复用重复查询的结果（前端的联想与搜索请求高度集中在少数查询上）
+//
+// 键为规范化的查询文本（见query_normalize：大小写、空白、标点不同但求值相同的写法共用一项）加上影响结果的搜索选项
+// （top_k、打分方式、打分模型及其参数、前缀扩展预算、邻近度权重）。
+// 按LRU淘汰，缓存项（结果数组与文档路径）占用的字节数不超过max_bytes；单个结果超过上限时不缓存。
+// 段集合的generation与缓存中的不同（增量添加、删除或合并之后）时，查询前清空全部缓存项。
+// 规范化在缓存自己的arena中进行，稳定之后命中不再向系统申请内存；未命中时新缓存项的复制仍使用malloc。
+// 不是线程安全的，并发使用时由调用者加锁
+#define QUERY_CACHE_DEFAULT_BYTES (16u << 20)
+
+typedef struct QueryCache QueryCache;
+
+typedef struct QueryCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;     // 因超出内存上限淘汰的缓存项
+    uint64_t invalidations; // 因generation变化而清空缓存的次数
+    int entries;
+    size_t bytes;
+    size_t max_bytes;
+} QueryCacheStats;
+
+// max_bytes为0时不缓存任何结果（只统计未命中），失败返回NULL
+QueryCache* query_cache_create(size_t max_bytes);
+void query_cache_free(QueryCache *cache);
+
+// 与search_context_run相同的查询，命中时直接返回缓存的结果，未命中时在context中执行并复制进缓存。
+// 返回的结果归缓存或context所有，在下一次调用query_cache_search、query_cache_clear、query_cache_free
+// 或下一次使用context查询之前有效；无结果时返回NULL
+const SearchResult* query_cache_search(QueryCache *cache, SearchContext *context, const SegmentSet *set,
+                                       const char *query, const SearchOptions *options, int *result_count);
+
+// 清空全部缓存项（计数器保留）
+void query_cache_clear(QueryCache *cache);
+void query_cache_stats(const QueryCache *cache, QueryCacheStats *stats);
+
+#endif
@@ -0,0 +1,115 @@
+#include "query_stats.h"
+#include "thread.h"
+
+static const char *stage_names[QUERY_STAGE_COUNT] = { "parse", "expand", "score", "proximity", "results" };
+
+// 进程内的直方图：计数只增不减，用原子加法更新（读取快照时不加锁，各字段之间可能相差正在记录的查询）
+typedef struct Histogram {
+    uint64_t buckets[QUERY_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+} Histogram;
+
+static Histogram total_histogram;
+static Histogram stage_histograms[QUERY_STAGE_COUNT];
+static uint64_t total_queries;
+static uint64_t total_expanded_terms;
+static uint64_t total_postings;
+static uint64_t total_accumulators;
+static uint64_t total_arena_chunks;
+
+void query_stats_lap(QueryStats *stats, QueryStage stage, long long *mark) {
+    if (!stats) return;
+    long long now = monotonic_ns();
+    stats->stage_ns[stage] += now - *mark;
+    *mark = now;
+}
+
+void query_stats_write_json(const QueryStats *stats, FILE *out) {
+    fprintf(out, "{\"total_us\": %.1f, \"stages_us\": {", stats->total_ns / 1e3);
+    for (int i = 0; i < QUERY_STAGE_COUNT; i++) {
+        fprintf(out, "%s\"%s\": %.1f", i ? ", " : "", stage_names[i], stats->stage_ns[i] / 1e3);
+    }
+    fprintf(out, "}, \"boolean\": %s, \"expanded_terms\": %lld, \"postings\": %lld, \"accumulators\": %lld, "
+            "\"arena_chunks\": %lld, \"parallel_ranges\": %lld, \"results\": %d}", stats->boolean ? "true" : "false",
+            stats->expanded_terms, stats->scoring.postings, stats->scoring.accumulators,
+            stats->arena_chunks, stats->scoring.parallel_ranges, stats->results);
+}
+
+static void atomic_add(uint64_t *value, uint64_t delta) {
+    __atomic_fetch_add(value, delta, __ATOMIC_RELAXED);
+}
+
+static int bucket_of(long long ns) {
+    uint64_t us = ns > 0 ? (uint64_t)ns / 1000 : 0;
+    int bucket = 0;
+    while (us > 0 && bucket < QUERY_HISTOGRAM_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static void histogram_add(Histogram *histogram, long long ns) {
+    atomic_add(&histogram->buckets[bucket_of(ns)], 1);
+    atomic_add(&histogram->count, 1);
+    atomic_add(&histogram->sum_ns, ns > 0 ? (uint64_t)ns : 0);
+}
+
+void query_stats_record(const QueryStats *stats) {
+    if (!stats) return;
+    histogram_add(&total_histogram, stats->total_ns);
+    for (int i = 0; i < QUERY_STAGE_COUNT; i++) histogram_add(&stage_histograms[i], stats->stage_ns[i]);
+    atomic_add(&total_queries, 1);
+    atomic_add(&total_expanded_terms, (uint64_t)stats->expanded_terms);
+    atomic_add(&total_postings, (uint64_t)stats->scoring.postings);
+    atomic_add(&total_accumulators, (uint64_t)stats->scoring.accumulators);
+    atomic_add(&total_arena_chunks, (uint64_t)stats->arena_chunks);
+}
+
+static uint64_t atomic_get(const uint64_t *value) {
+    return __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+// 第i个桶的上界（微秒）
+static uint64_t bucket_upper_us(int bucket) {
+    return 1ULL << bucket;
+}
+
+static void write_histogram_json(const Histogram *histogram, FILE *out) {
+    uint64_t buckets[QUERY_HISTOGRAM_BUCKETS];
+    uint64_t count = 0;
+    int last = -1;
+    for (int i = 0; i < QUERY_HISTOGRAM_BUCKETS; i++) {
+        buckets[i] = atomic_get(&histogram->buckets[i]);
+        count += buckets[i];
+        if (buckets[i]) last = i;
+    }
+    // 最近秩法：累计计数第一次达到ceil(p×count)的桶
+    uint64_t p50 = 0, p99 = 0;
+    uint64_t seen = 0;
+    for (int i = 0; i <= last; i++) {
+        seen += buckets[i];
+        if (!p50 && seen * 100 >= count * 50) p50 = bucket_upper_us(i);
+        if (!p99 && seen * 100 >= count * 99) p99 = bucket_upper_us(i);
+    }
+    fprintf(out, "{\"count\": %llu, \"sum_us\": %.1f, \"p50_us\": %llu, \"p99_us\": %llu, \"buckets\": [",
+            (unsigned long long)count, atomic_get(&histogram->sum_ns) / 1e3, (unsigned long long)p50,
+            (unsigned long long)p99);
+    for (int i = 0; i <= last; i++) fprintf(out, "%s%llu", i ? ", " : "", (unsigned long long)buckets[i]);
+    fprintf(out, "]}");
+}
+
+void query_stats_write_histograms_json(FILE *out) {
+    fprintf(out, "{\"queries\": %llu, \"expanded_terms\": %llu, \"postings\": %llu, \"accumulators\": %llu, "
+            "\"arena_chunks\": %llu, \"total\": ", (unsigned long long)atomic_get(&total_queries),
+            (unsigned long long)atomic_get(&total_expanded_terms), (unsigned long long)atomic_get(&total_postings),
+            (unsigned long long)atomic_get(&total_accumulators), (unsigned long long)atomic_get(&total_arena_chunks));
+    write_histogram_json(&total_histogram, out);
+    fprintf(out, ", \"stages\": {");
+    for (int i = 0; i < QUERY_STAGE_COUNT; i++) {
+        fprintf(out, "%s\"%s\": ", i ? ", " : "", stage_names[i]);
+        write_histogram_json(&stage_histograms[i], out);
+    }
+    fprintf(out, "}}");
+}
@@ -0,0 +1,54 @@
+#ifndef QUERY_STATS_H
+#define QUERY_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "tfidf.h"
+
+// 查询统计：单次查询的分阶段耗时与计数器，以及进程内按阶段汇总的耗时直方图
+//
+// 调用者把QueryStats（先清零）交给SearchOptions.stats，perform_search执行时填写；
+// stats为NULL时不读时钟、不累加计数，打分的内层循环与未加统计时相同。
+// 各阶段：
+//   parse      分词或布尔解析，短语与邻近度用到的精确词查找
+//   expand     前缀扩展（词典区间查找与全局文档频率汇总）
+//   score      短语过滤、布尔求值与打分（分片索引含各分片的并行打分与结果合并）
+//   proximity  邻近度重排
+//   results    按文档ID取出路径，生成结果数组
+
+typedef enum QueryStage {
+    QUERY_STAGE_PARSE = 0,
+    QUERY_STAGE_EXPAND,
+    QUERY_STAGE_SCORE,
+    QUERY_STAGE_PROXIMITY,
+    QUERY_STAGE_RESULTS,
+    QUERY_STAGE_COUNT
+} QueryStage;
+
+typedef struct QueryStats {
+    long long stage_ns[QUERY_STAGE_COUNT];
+    long long total_ns;
+    long long expanded_terms;  // 前缀扩展出的词条数
+    ScoringCounters scoring;   // 解码的postings、命中的累加器与打分中的堆分配（合计所有段与分片）
+    long long arena_chunks;    // 查询上下文的arena在本次查询中新申请的chunk数
+    int results;
+    int boolean;               // 是否按布尔查询求值
+} QueryStats;
+
+// 直方图的桶：第0个桶为不足1微秒，第i个桶为[2^(i-1), 2^i)微秒，最后一个桶不设上限
+#define QUERY_HISTOGRAM_BUCKETS 32
+
+// 把自mark以来的耗时记入stage，mark更新为当前时间；stats为NULL时什么也不做
+void query_stats_lap(QueryStats *stats, QueryStage stage, long long *mark);
+
+// 单次查询的统计，输出为一行JSON（不含换行）
+void query_stats_write_json(const QueryStats *stats, FILE *out);
+
+// 把一次查询计入进程内的直方图（各阶段与总耗时），可在多个线程中同时调用
+void query_stats_record(const QueryStats *stats);
+
+// 进程内直方图的快照，输出为一行JSON（不含换行）：查询数、各计数器的合计，
+// 以及总耗时与各阶段的{count, sum_us, p50_us, p99_us, buckets}，分位数为所在桶的上界
+void query_stats_write_histograms_json(FILE *out);
+
+#endif
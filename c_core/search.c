@@ -1,157 +1,1166 @@
 #include "search.h"
 #include <string.h>
-#include <ctype.h>
+#include "phrase.h"
+#include "query.h"
+#include "thread.h"
+#include "tokenizer.h"
+#include "topk.h"
+#include "worker_pool.h"
 
-// 简单的分词函数
-static char** tokenize_query(const char *query, int *token_count) {
+// 一次查询的临时内存（查询词、扩展词与句柄、位图、累加器、小顶堆、结果数组）都从查询上下文的arena分配，
+// 下一次查询开始时随arena_reset整体作废，不逐个释放；只有每个段、每个分片各分配一次的缓冲区用完即归还，
+// 供下一个段复用。布尔查询的运算符树、叶子的绑定与求值的文档列表（query.h）同样从这里分配。
+// 分片与段内并行的任务提交到上下文的线程池，不在每次查询时创建线程
+struct SearchContext {
+    Arena *scratch;
+    Arena *shard_scratch[MAX_SHARDS]; // 分片查询时各分片任务各自的arena（第一次用到时创建）
+    Arena *range_scratch[SEARCH_MAX_PARALLEL]; // 段内并行时各区间任务各自的arena（区间0在调用线程中，不使用）
+    WorkerPool *pool; // 执行分片与区间任务的线程池（没有指定共用的池时第一次用到才创建，cpu_count个线程）
+    int owns_pool;    // pool是否由上下文创建（随上下文释放）
+};
+
+// 上下文的线程池，创建失败时返回NULL（调用者在当前线程中依次执行各任务）
+static WorkerPool* context_pool(SearchContext *context) {
+    if (!context->pool) {
+        context->pool = worker_pool_create(cpu_count(), 0);
+        context->owns_pool = context->pool != NULL;
+    }
+    return context->pool;
+}
+
+// 查询分词的收集状态：词条指针与长度暂存，分词结束后再原地补'\0'
+typedef struct QueryTokens {
+    char **tokens;
+    size_t *lengths;
+    int *phrase_ids;
+    int count;
+    const char *text;  // 分词的缓冲区（引号不是字母，分词时原样保留）
+    size_t scanned;    // 已数过引号的字节数
+    int quotes;        // 已遇到的引号数
+} QueryTokens;
+
+static void collect_query_token(const char *token, size_t len, void *context) {
+    QueryTokens *collected = (QueryTokens*)context;
+    // 词条之前出现奇数个引号即在短语内，第n对引号是第n个短语
+    size_t offset = (size_t)(token - collected->text);
+    for (; collected->scanned < offset; collected->scanned++) {
+        if (collected->text[collected->scanned] == '"') collected->quotes++;
+    }
+    collected->scanned = offset + len;
+    collected->tokens[collected->count] = (char*)token;
+    collected->lengths[collected->count] = len;
+    collected->phrase_ids[collected->count] = collected->quotes % 2 ? collected->quotes / 2 : -1;
+    collected->count++;
+}
+
+// 查询分词：与文档使用同一个分词器，保证查询词与索引词条的切分和大小写折叠完全一致
+// 引号内的词组成短语，*phrase_ids给出每个词所在的短语编号（-1表示不在引号内，缺少右引号时到查询末尾为止）
+// 指针数组、短语编号与词条字节放在scratch的同一块内存中
+static char** tokenize_query(const char *query, Arena *scratch, int *token_count, int **phrase_ids) {
     *token_count = 0;
-    char **tokens = NULL;
+    *phrase_ids = NULL;
     
     if (!query || strlen(query) == 0) {
         return NULL;
     }
     
-    // 创建查询副本以便修改
-    char *query_copy = (char*)malloc(strlen(query) + 1);
-    strcpy(query_copy, query);
+    // 词条之间至少隔一个分隔符，词条数不超过 (len + 1) / 2
+    size_t len = strlen(query);
+    size_t max_tokens = (len + 1) / 2;
+    char **tokens = (char**)arena_alloc(scratch, max_tokens * (sizeof(char*) + sizeof(size_t) + sizeof(int)) + len + 1);
+    if (!tokens) return NULL;
+    size_t *lengths = (size_t*)(tokens + max_tokens);
+    int *phrases = (int*)(lengths + max_tokens);
+    char *query_copy = (char*)(phrases + max_tokens);
+    memcpy(query_copy, query, len + 1);
     
-    // 转换为小写
-    for (int i = 0; query_copy[i]; i++) {
-        query_copy[i] = tolower(query_copy[i]);
+    QueryTokens collected = { tokens, lengths, phrases, 0, query_copy, 0, 0 };
+    tokenize_buffer(query_copy, len, 1, collect_query_token, &collected);
+    
+    if (collected.count == 0) {
+        return NULL;
+    }
+    // 词条后面是分隔符或副本末尾的'\0'，原地截断即可作为C字符串使用
+    for (int i = 0; i < collected.count; i++) {
+        tokens[i][lengths[i]] = '\0';
+    }
+    *token_count = collected.count;
+    *phrase_ids = phrases;
+    return tokens;
+}
+
+// 查询词的前缀区间：词典按字典序排列，前缀匹配是一段连续的词条ID
+typedef struct TermRange {
+    int lo;
+    int hi;
+} TermRange;
+
+static int compare_term_ranges(const void *a, const void *b) {
+    const TermRange *x = (const TermRange*)a;
+    const TermRange *y = (const TermRange*)b;
+    if (x->lo != y->lo) return x->lo < y->lo ? -1 : 1;
+    return (x->hi < y->hi) - (x->hi > y->hi); // 同起点时长区间在前
+}
+
+// 段内的前缀扩展：各查询词的前缀区间求并（区间之间要么嵌套要么不相交，排序后跳过被包含的区间即可去重），
+// 按词条ID升序（即字典序）输出并集中的词条ID，不构造字符串列表
+static int* collect_prefix_terms(const Segment *segment, char **tokens, int token_count, Arena *scratch, int *count) {
+    *count = 0;
+    TermRange *ranges = (TermRange*)arena_alloc(scratch, token_count * sizeof(TermRange));
+    if (!ranges) return NULL;
+    int range_count = 0;
+    for (int i = 0; i < token_count; i++) {
+        segment_prefix_range(segment, tokens[i], &ranges[range_count].lo, &ranges[range_count].hi);
+        if (ranges[range_count].lo < ranges[range_count].hi) range_count++;
+    }
+    arena_sort(scratch, ranges, range_count, sizeof(TermRange), compare_term_ranges);
+    int merged = 0;
+    int total = 0;
+    for (int i = 0; i < range_count; i++) {
+        if (merged > 0 && ranges[i].lo < ranges[merged - 1].hi) continue;
+        ranges[merged++] = ranges[i];
+        total += ranges[i].hi - ranges[i].lo;
     }
     
-    // 分词（分隔符包含常见标点）
-    char *token = strtok(query_copy, " \t\n\r.,;:!?()[]{}");
-    while (token) {
-        // 过滤空字符串
-        if (strlen(token) > 0) {
-            *token_count += 1;
-            tokens = (char**)realloc(tokens, *token_count * sizeof(char*));
-            tokens[*token_count - 1] = (char*)malloc(strlen(token) + 1);
-            strcpy(tokens[*token_count - 1], token);
+    int *term_ids = (int*)arena_alloc(scratch, (total > 0 ? total : 1) * sizeof(int));
+    if (term_ids) {
+        for (int r = 0; r < merged; r++) {
+            for (int id = ranges[r].lo; id < ranges[r].hi; id++) term_ids[(*count)++] = id;
         }
-        token = strtok(NULL, " \t\n\r.,;:!?()[]{}");
+    }
+    return term_ids;
+}
+
+// 扩展预算：candidates按字典序排列，doc_counts为各自的文档频率，exact标记查询词本身。
+// 词条数与postings总数都在预算内时全部保留；否则查询词本身总会保留，其余扩展词按文档频率从高到低
+// （同df按字典序）挑选，直到词条数达到预算或下一个词条会超出postings预算。返回选中的下标
+static int* select_expansions(const long long *doc_counts, const unsigned char *exact, int count,
+                              const SearchOptions *options, Arena *scratch, int *selected_count) {
+    *selected_count = 0;
+    int *selected = (int*)arena_alloc(scratch, (count > 0 ? count : 1) * sizeof(int));
+    if (!selected) return NULL;
+    
+    long long postings = 0;
+    for (int i = 0; i < count; i++) postings += doc_counts[i];
+    if ((options->max_expansions <= 0 || count <= options->max_expansions)
+        && (options->max_expansion_postings <= 0 || postings <= options->max_expansion_postings)) {
+        for (int i = 0; i < count; i++) selected[i] = i;
+        *selected_count = count;
+        return selected;
     }
     
-    free(query_copy);
-    return tokens;
+    // 超出预算：先放入查询词本身，再用有界堆选出df最高的扩展词（df作分数、下标作同分次序）
+    int limit = options->max_expansions > 0 && options->max_expansions < count ? options->max_expansions : count;
+    postings = 0;
+    int chosen = 0;
+    for (int i = 0; i < count; i++) {
+        if (!exact[i]) continue;
+        selected[chosen++] = i;
+        postings += doc_counts[i];
+    }
+    int remaining = limit - chosen;
+    if (remaining > 0) {
+        TopK candidates;
+        topk_init(&candidates, remaining, scratch);
+        for (int i = 0; i < count; i++) {
+            if (!exact[i]) topk_push(&candidates, i, (double)doc_counts[i]);
+        }
+        int ranked_count;
+        DocScore *ranked = topk_finish(&candidates, &ranked_count);
+        for (int i = 0; i < ranked_count; i++) {
+            long long df = doc_counts[ranked[i].doc_id];
+            if (options->max_expansion_postings > 0 && postings + df > options->max_expansion_postings) break;
+            selected[chosen++] = ranked[i].doc_id;
+            postings += df;
+        }
+        topk_free(&candidates);
+    }
+    *selected_count = chosen;
+    return selected;
+}
+
+// 单段索引的前缀扩展：直接在词条ID上挑选并生成句柄（文档频率扣除已删除的文档）
+static TermHandle* expand_segment_terms(const SegmentSet *set, char **tokens, int token_count,
+                                        const SearchOptions *options, Arena *scratch, int *expanded_count) {
+    *expanded_count = 0;
+    const Segment *segment = set->segments[0];
+    int count;
+    int *term_ids = collect_prefix_terms(segment, tokens, token_count, scratch, &count);
+    long long *doc_counts = (long long*)arena_alloc(scratch, (count > 0 ? count : 1) * sizeof(long long));
+    unsigned char *exact = (unsigned char*)arena_alloc(scratch, count > 0 ? count : 1);
+    TermHandle *terms = NULL;
+    if (term_ids && doc_counts && exact) {
+        memset(exact, 0, count > 0 ? count : 1);
+        // 只出现在已删除文档中的词条不参与扩展
+        int live_count = 0;
+        for (int i = 0; i < count; i++) {
+            doc_counts[live_count] = segment_set_doc_count(set, 0, term_ids[i]);
+            if (doc_counts[live_count] > 0) term_ids[live_count++] = term_ids[i];
+        }
+        count = live_count;
+        // 查询词本身若在词典中，必然落在自己的前缀区间内：在有序的ID列表中二分定位
+        for (int t = 0; t < token_count; t++) {
+            TermHandle handle;
+            if (!segment_lookup(segment, tokens[t], strlen(tokens[t]), &handle)) continue;
+            int lo = 0, hi = count;
+            while (lo < hi) {
+                int mid = lo + (hi - lo) / 2;
+                if (term_ids[mid] < handle.term_id) lo = mid + 1;
+                else hi = mid;
+            }
+            if (lo < count && term_ids[lo] == handle.term_id) exact[lo] = 1;
+        }
+        
+        int selected_count;
+        int *selected = select_expansions(doc_counts, exact, count, options, scratch, &selected_count);
+        terms = (TermHandle*)arena_alloc(scratch, (selected_count > 0 ? selected_count : 1) * sizeof(TermHandle));
+        if (selected && terms) {
+            for (int i = 0; i < selected_count; i++) {
+                segment_term_handle(segment, term_ids[selected[i]], &terms[i]);
+                terms[i].doc_count = (int)doc_counts[selected[i]];
+            }
+            *expanded_count = selected_count;
+        }
+    }
+    return terms;
+}
+
+// 多段索引的查询词条：文档频率与最大词频是所有段的合计/最大值
+typedef struct QueryTerm {
+    const char *term; // 指向某个段映射区域中的词条（以'\0'结尾）
+    uint32_t len;
+    long long doc_count;
+    int max_tf;
+} QueryTerm;
+
+static int compare_query_terms(const void *a, const void *b) {
+    return strcmp(((const QueryTerm*)a)->term, ((const QueryTerm*)b)->term);
+}
+
+// 多段索引的前缀扩展：各段的扩展词放在一起按词条字符串排序，相同的词条合并并汇总全局统计，
+// 再在全局df上挑选，与把所有段合并成一个段后的扩展结果一致
+static QueryTerm* expand_set_terms(const SegmentSet *set, char **tokens, int token_count,
+                                   const SearchOptions *options, Arena *scratch, int *expanded_count) {
+    *expanded_count = 0;
+    int **segment_ids = (int**)arena_alloc(scratch, set->num_segments * sizeof(int*));
+    int *segment_counts = (int*)arena_alloc(scratch, set->num_segments * sizeof(int));
+    if (!segment_ids || !segment_counts) return NULL;
+    int total = 0;
+    for (int s = 0; s < set->num_segments; s++) {
+        segment_ids[s] = collect_prefix_terms(set->segments[s], tokens, token_count, scratch, &segment_counts[s]);
+        if (!segment_ids[s]) return NULL;
+        total += segment_counts[s];
+    }
+    if (total == 0) return NULL;
+    
+    QueryTerm *terms = (QueryTerm*)arena_alloc(scratch, total * sizeof(QueryTerm));
+    if (!terms) return NULL;
+    int count = 0;
+    for (int s = 0; s < set->num_segments; s++) {
+        const Segment *segment = set->segments[s];
+        for (int i = 0; i < segment_counts[s]; i++) {
+            const char *term = segment_term(segment, segment_ids[s][i]);
+            if (!term) continue;
+            terms[count].term = term;
+            terms[count].len = segment->terms[segment_ids[s][i]].term_len;
+            terms[count].doc_count = segment_set_doc_count(set, s, segment_ids[s][i]);
+            terms[count].max_tf = (int)segment->terms[segment_ids[s][i]].max_tf;
+            count++;
+        }
+    }
+    arena_sort(scratch, terms, count, sizeof(QueryTerm), compare_query_terms);
+    
+    // 相同的词条相邻：合并统计，只出现在已删除文档中的词条不参与扩展
+    int merged = 0;
+    for (int i = 0; i < count;) {
+        QueryTerm term = terms[i];
+        for (i++; i < count && strcmp(terms[i].term, term.term) == 0; i++) {
+            term.doc_count += terms[i].doc_count;
+            if (terms[i].max_tf > term.max_tf) term.max_tf = terms[i].max_tf;
+        }
+        if (term.doc_count > 0) terms[merged++] = term;
+    }
+    count = merged;
+    if (count == 0) return NULL;
+    
+    long long *doc_counts = (long long*)arena_alloc(scratch, count * sizeof(long long));
+    unsigned char *exact = (unsigned char*)arena_alloc(scratch, count);
+    if (!doc_counts || !exact) return NULL;
+    for (int i = 0; i < count; i++) {
+        doc_counts[i] = terms[i].doc_count;
+        exact[i] = 0;
+        for (int t = 0; t < token_count && !exact[i]; t++) {
+            exact[i] = strcmp(terms[i].term, tokens[t]) == 0;
+        }
+    }
+    int selected_count;
+    int *selected = select_expansions(doc_counts, exact, count, options, scratch, &selected_count);
+    QueryTerm *selected_terms = (QueryTerm*)arena_alloc(scratch, (selected_count > 0 ? selected_count : 1)
+                                                                 * sizeof(QueryTerm));
+    if (!selected || !selected_terms) return NULL;
+    for (int i = 0; i < selected_count; i++) selected_terms[i] = terms[selected[i]];
+    *expanded_count = selected_count;
+    return selected_terms;
 }
 
-// 辅助函数：检查词是否已在扩展列表中（优化效率）
-static int is_term_in_list(char **list, int list_len, const char *term) {
-    for (int i = 0; i < list_len; i++) {
-        if (strcmp(list[i], term) == 0) {
-            return 1;
+// 位置相关的查询条件：短语词与邻近度词都是精确的查询词（不做前缀扩展）。
+// 停用词与短词（构建索引时不收录的词）在短语中只占位置；其余短语词在索引中没有存活文档时短语不可能匹配。
+// 邻近度只使用在索引中有存活文档的词
+typedef struct PositionalQuery {
+    char **phrase_terms;      // 所有短语的词，按短语依次存放
+    uint32_t *phrase_offsets; // 词在所属短语中的位置
+    int *phrase_starts;       // 第p个短语的词为[phrase_starts[p], phrase_starts[p+1])
+    int num_phrases;
+    char **proximity_terms;   // 按查询顺序排列的不同查询词
+    int num_proximity_terms;
+    int unmatched;            // 有短语含索引中没有的词，查询不匹配任何文档
+} PositionalQuery;
+
+// 词条在所有段中的存活文档频率合计
+static long long set_term_doc_count(const SegmentSet *set, const char *term) {
+    long long total = 0;
+    for (int s = 0; s < set->num_segments; s++) {
+        TermHandle handle;
+        if (segment_lookup(set->segments[s], term, strlen(term), &handle)) {
+            total += segment_set_doc_count(set, s, handle.term_id);
         }
     }
+    return total;
+}
+
+static int positional_query_init(PositionalQuery *positional, const SegmentSet *set,
+                                 char **tokens, const int *phrase_ids, int token_count, Arena *scratch) {
+    memset(positional, 0, sizeof(PositionalQuery));
+    positional->phrase_terms = (char**)arena_alloc(scratch, token_count * sizeof(char*));
+    positional->phrase_offsets = (uint32_t*)arena_alloc(scratch, token_count * sizeof(uint32_t));
+    positional->phrase_starts = (int*)arena_alloc(scratch, (token_count + 1) * sizeof(int));
+    positional->proximity_terms = (char**)arena_alloc(scratch, token_count * sizeof(char*));
+    unsigned char *indexed = (unsigned char*)arena_alloc(scratch, token_count);
+    if (!positional->phrase_terms || !positional->phrase_offsets || !positional->phrase_starts
+        || !positional->proximity_terms || !indexed) {
+        memset(positional, 0, sizeof(PositionalQuery));
+        return -1;
+    }
+    for (int i = 0; i < token_count; i++) indexed[i] = set_term_doc_count(set, tokens[i]) > 0;
+    
+    // 短语：同一对引号内的连续词条，只由停用词与短词组成的短语不构成条件
+    int num_terms = 0;
+    for (int i = 0; i < token_count;) {
+        if (phrase_ids[i] < 0) {
+            i++;
+            continue;
+        }
+        int first = i;
+        int start = num_terms;
+        for (; i < token_count && phrase_ids[i] == phrase_ids[first]; i++) {
+            if (!indexed[i]) {
+                if (segment_set_indexes_token(set, tokens[i], strlen(tokens[i]))) positional->unmatched = 1;
+                continue;
+            }
+            positional->phrase_terms[num_terms] = tokens[i];
+            positional->phrase_offsets[num_terms] = (uint32_t)(i - first);
+            num_terms++;
+        }
+        if (num_terms > start) positional->phrase_starts[positional->num_phrases++] = start;
+    }
+    positional->phrase_starts[positional->num_phrases] = num_terms;
+    
+    // 邻近度：去重后的索引词，保持在查询中第一次出现的顺序
+    for (int i = 0; i < token_count; i++) {
+        if (!indexed[i]) continue;
+        int seen = 0;
+        for (int j = 0; j < positional->num_proximity_terms && !seen; j++) {
+            seen = strcmp(positional->proximity_terms[j], tokens[i]) == 0;
+        }
+        if (!seen) positional->proximity_terms[positional->num_proximity_terms++] = tokens[i];
+    }
     return 0;
 }
 
-SearchResult* perform_search(TrieNode *trie, InvertedIndex *index, const char *query, 
-                            char **doc_paths, int num_docs, int *result_count) {
-    *result_count = 0;
-    if (!trie || !index || !query || !doc_paths || num_docs <= 0) {
+// 段的文档位图占用的字节数
+static size_t doc_bitmap_size(const Segment *segment) {
+    int num_words = (segment->num_docs + 63) / 64;
+    return (num_words > 0 ? num_words : 1) * sizeof(uint64_t);
+}
+
+// 第s个段中包含所有短语的存活文档位图（从scratch分配，调用者用完归还），*remaining为其中的文档数，失败返回NULL
+static uint64_t* match_phrases(const SegmentSet *set, int s, const PositionalQuery *positional, Arena *scratch,
+                               int *remaining) {
+    const Segment *segment = set->segments[s];
+    const uint64_t *live_docs = segment_set_live_docs(set, s);
+    int num_words = (segment->num_docs + 63) / 64;
+    size_t terms_size = positional->phrase_starts[positional->num_phrases] * sizeof(PhraseTerm);
+    uint64_t *docs = (uint64_t*)arena_alloc(scratch, doc_bitmap_size(segment));
+    PhraseTerm *terms = (PhraseTerm*)arena_alloc(scratch, terms_size);
+    if (!docs || !terms) {
+        arena_release(scratch, docs, doc_bitmap_size(segment));
+        arena_release(scratch, terms, terms_size);
         return NULL;
     }
+    for (int w = 0; w < num_words; w++) {
+        int bits = segment->num_docs - w * 64;
+        docs[w] = live_docs ? live_docs[w] : bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
+    }
+    
+    *remaining = segment->num_docs;
+    for (int p = 0; p < positional->num_phrases && *remaining > 0; p++) {
+        int count = 0;
+        for (int i = positional->phrase_starts[p]; i < positional->phrase_starts[p + 1]; i++) {
+            segment_lookup(segment, positional->phrase_terms[i], strlen(positional->phrase_terms[i]),
+                           &terms[count].handle);
+            terms[count].offset = positional->phrase_offsets[i];
+            count++;
+        }
+        *remaining = phrase_filter(segment, terms, count, docs, scratch);
+        if (*remaining < 0) {
+            arena_release(scratch, docs, doc_bitmap_size(segment));
+            docs = NULL;
+            break;
+        }
+    }
+    arena_release(scratch, terms, terms_size);
+    return docs;
+}
+
+// 打分参数：模型取自options，N与平均文档长度使用所有段的存活文档
+static void scoring_params_for(const SegmentSet *set, const SearchOptions *options, ScoringParams *params) {
+    double avg_doc_length = set->live_docs > 0 ? (double)set->total_doc_length / set->live_docs : 0.0;
+    scoring_params_init(params, options->model, set->live_docs, avg_doc_length);
+    params->k1 = options->bm25_k1;
+    params->b = options->bm25_b;
+}
+
+// 按options的打分方式在params给出的文档范围内打分
+static DocScore* score_terms_in(const Segment *segment, const TermHandle *terms, int num_terms,
+                                const uint64_t *live_docs, const ScoringParams *params, ScoringMode scoring, int k,
+                                int *result_count) {
+    if (scoring == SCORING_EXHAUSTIVE) {
+        return calculate_document_scores(segment, terms, num_terms, live_docs, params, k, result_count);
+    }
+    return calculate_document_scores_pruned(segment, terms, num_terms, live_docs, params, k, result_count);
+}
+
+// 段内并行打分的一个文档ID区间（区间、scratch与计数器都在params中）
+typedef struct RangeTask {
+    const Segment *segment;
+    const TermHandle *terms;
+    int num_terms;
+    const uint64_t *live_docs;
+    ScoringMode scoring;
+    int k;
+    ScoringParams params;
+    ScoringCounters counts;
+    DocScore *scores;
+    int count;
+} RangeTask;
+
+static void score_range(void *arg, int worker) {
+    (void)worker;
+    RangeTask *task = (RangeTask*)arg;
+    task->scores = score_terms_in(task->segment, task->terms, task->num_terms, task->live_docs, &task->params,
+                                  task->scoring, task->k, &task->count);
+}
+
+// 段内并行的区间数：待打分的postings数（各词条在段内的文档频率之和）不到门槛、
+// 不允许段内并行（parallel为NULL）或段太小时为1
+static int parallel_ranges(const Segment *segment, const TermHandle *terms, int num_terms,
+                           const SearchOptions *options, const SearchContext *parallel) {
+    if (!parallel || options->parallel_postings <= 0) return 1;
+    long long postings = 0;
+    for (int i = 0; i < num_terms; i++) {
+        if (terms[i].term_id >= 0) postings += segment->terms[terms[i].term_id].doc_count;
+    }
+    if (postings < options->parallel_postings) return 1;
+    int ranges = options->parallel_threads > 0 ? options->parallel_threads : cpu_count();
+    if (ranges > SEARCH_MAX_PARALLEL) ranges = SEARCH_MAX_PARALLEL;
+    if (ranges > segment->num_docs / SEARCH_MIN_PARALLEL_DOCS) ranges = segment->num_docs / SEARCH_MIN_PARALLEL_DOCS;
+    return ranges > 1 ? ranges : 1;
+}
+
+// 把段的文档ID等分成num_ranges个区间，区间0在当前线程、其余区间提交到上下文的线程池打分
+// （线程池不可用或提交失败的区间在当前线程中执行），各区间的前k名再经有界堆合并。
+// 每个文档的分数只在所属区间内按同样的词条顺序累加，合并后与整段打分的结果逐位一致
+static DocScore* score_ranges(const Segment *segment, const TermHandle *terms, int num_terms,
+                              const uint64_t *live_docs, const ScoringParams *params, ScoringMode scoring, int k,
+                              SearchContext *parallel, int num_ranges, int *result_count) {
+    *result_count = 0;
+    Arena *scratch = params->scratch;
+    Arena **range_scratch = parallel->range_scratch;
+    RangeTask *tasks = (RangeTask*)arena_alloc(scratch, num_ranges * sizeof(RangeTask));
+    if (!tasks) return NULL;
+    for (int r = 0; r < num_ranges; r++) {
+        RangeTask *task = &tasks[r];
+        task->segment = segment;
+        task->terms = terms;
+        task->num_terms = num_terms;
+        task->live_docs = live_docs;
+        task->scoring = scoring;
+        task->k = k;
+        task->params = *params;
+        task->params.doc_begin = (int)((long long)segment->num_docs * r / num_ranges);
+        task->params.doc_end = (int)((long long)segment->num_docs * (r + 1) / num_ranges);
+        memset(&task->counts, 0, sizeof(ScoringCounters));
+        task->params.counters = params->counters ? &task->counts : NULL;
+        if (r > 0 && !range_scratch[r]) range_scratch[r] = arena_create();
+        task->params.scratch = r > 0 ? range_scratch[r] : scratch;
+        task->scores = NULL;
+        task->count = 0;
+        if (!task->params.scratch) return NULL;
+    }
+    WorkerPool *pool = context_pool(parallel);
+    WorkerGroup group = { 0 };
+    for (int r = 1; r < num_ranges; r++) {
+        if (worker_pool_submit_group(pool, &group, score_range, &tasks[r]) != 0) score_range(&tasks[r], 0);
+    }
+    score_range(&tasks[0], 0);
+    worker_pool_wait_group(pool, &group);
+    
+    TopK merged;
+    if (topk_init(&merged, k, scratch) != 0) return NULL;
+    for (int r = 0; r < num_ranges; r++) {
+        for (int i = 0; i < tasks[r].count; i++) {
+            topk_push(&merged, tasks[r].scores[i].doc_id, tasks[r].scores[i].score);
+        }
+        if (params->counters) {
+            params->counters->postings += tasks[r].counts.postings;
+            params->counters->accumulators += tasks[r].counts.accumulators;
+            params->counters->allocations += tasks[r].counts.allocations;
+        }
+    }
+    if (params->counters) params->counters->parallel_ranges += num_ranges;
+    return topk_finish(&merged, result_count);
+}
+
+// 在第s个段上打分，返回前k名：打分方式与模型取自options，IDF使用所有段的存活文档总数，
+// 跳过已删除的文档；查询含短语时只对包含所有短语的文档打分。counters非NULL时累加打分计数。
+// 临时内存与结果都从scratch分配；parallel非NULL且代价达到options的门槛时用它的线程池与区间arena在段内并行打分
+static DocScore* score_segment(const SegmentSet *set, int s, const PositionalQuery *positional,
+                               const TermHandle *terms, int num_terms, const SearchOptions *options, int k,
+                               ScoringCounters *counters, Arena *scratch, SearchContext *parallel,
+                               int *result_count) {
+    *result_count = 0;
+    const Segment *segment = set->segments[s];
+    const uint64_t *live_docs = segment_set_live_docs(set, s);
+    uint64_t *phrase_docs = NULL;
+    if (positional->num_phrases > 0) {
+        int remaining = 0;
+        phrase_docs = match_phrases(set, s, positional, scratch, &remaining);
+        if (!phrase_docs || remaining == 0) {
+            arena_release(scratch, phrase_docs, doc_bitmap_size(segment));
+            return NULL;
+        }
+        live_docs = phrase_docs;
+    }
+    ScoringParams params;
+    scoring_params_for(set, options, &params);
+    params.counters = counters;
+    params.scratch = scratch;
+    DocScore *scores;
+    int num_ranges = parallel_ranges(segment, terms, num_terms, options, parallel);
+    if (num_ranges > 1) {
+        scores = score_ranges(segment, terms, num_terms, live_docs, &params, options->scoring, k, parallel,
+                              num_ranges, result_count);
+    } else {
+        scores = score_terms_in(segment, terms, num_terms, live_docs, &params, options->scoring, k, result_count);
+    }
+    arena_release(scratch, phrase_docs, doc_bitmap_size(segment));
+    return scores;
+}
+
+// 分片的散发-汇集：每个分片只处理自己的段，在分片内选出前k名（全局文档ID），最后合并各分片的结果。
+// 任务结构体的第一个成员是ShardTask，其余为具体查询的只读状态
+typedef struct ShardTask {
+    const SegmentSet *set;
+    int shard;
+    Arena *scratch; // 分片任务的临时内存（只有一个分片时即上下文的scratch）
+    SearchContext *parallel; // 只有一个分片时为上下文（允许段内并行），否则为NULL
+    TopK top;
+    ScoringCounters *counters; // 不计数时为NULL，否则指向counts（各分片任务互不干扰）
+    ScoringCounters counts;
+    int failed;
+} ShardTask;
+
+// 对每个分片执行func(&tasks[i])：多于一个分片时分片0在当前线程中执行，其余提交到上下文的线程池
+// （线程池不可用或提交失败的分片在当前线程中执行）。
+// 只有一个分片时直接返回它的结果；任一分片失败时返回NULL。counters非NULL时累加各分片的打分计数。
+// 各分片使用上下文中自己的arena（在提交任务之前按需创建），结果从上下文的scratch分配
+static DocScore* run_shards(SearchContext *context, const SegmentSet *set, WorkerFunc func, void *tasks,
+                            size_t task_size, int k, ScoringCounters *counters, int *result_count) {
+    *result_count = 0;
+    int num_shards = set->num_shards;
+    int failed = 0;
+    for (int i = 0; i < num_shards; i++) {
+        ShardTask *task = (ShardTask*)((char*)tasks + i * task_size);
+        task->set = set;
+        task->shard = i;
+        memset(&task->counts, 0, sizeof(ScoringCounters));
+        task->counters = counters ? &task->counts : NULL;
+        if (num_shards > 1 && !context->shard_scratch[i]) context->shard_scratch[i] = arena_create();
+        task->scratch = num_shards > 1 ? context->shard_scratch[i] : context->scratch;
+        task->parallel = num_shards > 1 ? NULL : context;
+        task->failed = !task->scratch || topk_init(&task->top, k, task->scratch) != 0;
+        failed |= task->failed;
+    }
+    if (!failed) {
+        WorkerPool *pool = num_shards > 1 ? context_pool(context) : NULL;
+        WorkerGroup group = { 0 };
+        for (int i = 1; i < num_shards; i++) {
+            void *task = (char*)tasks + i * task_size;
+            if (worker_pool_submit_group(pool, &group, func, task) != 0) func(task, 0);
+        }
+        func(tasks, 0);
+        worker_pool_wait_group(pool, &group);
+    }
     
-    // 1. 分词
+    DocScore *merged_scores = NULL;
+    TopK merged;
+    for (int i = 0; i < num_shards; i++) {
+        ShardTask *task = (ShardTask*)((char*)tasks + i * task_size);
+        failed |= task->failed;
+        if (counters) {
+            counters->postings += task->counts.postings;
+            counters->accumulators += task->counts.accumulators;
+            counters->allocations += task->counts.allocations;
+            counters->parallel_ranges += task->counts.parallel_ranges;
+        }
+    }
+    if (!failed && num_shards == 1) {
+        merged_scores = topk_finish(&((ShardTask*)tasks)->top, result_count);
+    } else if (!failed && topk_init(&merged, k, context->scratch) == 0) {
+        for (int i = 0; i < num_shards; i++) {
+            ShardTask *task = (ShardTask*)((char*)tasks + i * task_size);
+            for (int j = 0; j < task->top.count; j++) {
+                topk_push(&merged, task->top.items[j].doc_id, task->top.items[j].score);
+            }
+        }
+        merged_scores = topk_finish(&merged, result_count);
+    }
+    return merged_scores;
+}
+
+// 普通查询的分片任务
+typedef struct TermShardTask {
+    ShardTask base;
+    const PositionalQuery *positional;
+    const QueryTerm *terms;
+    int num_terms;
+    const SearchOptions *options;
+    int k;
+} TermShardTask;
+
+static void score_term_shard(void *arg, int worker) {
+    (void)worker;
+    TermShardTask *task = (TermShardTask*)arg;
+    const SegmentSet *set = task->base.set;
+    Arena *scratch = task->base.scratch;
+    TermHandle *handles = (TermHandle*)arena_alloc(scratch, (task->num_terms > 0 ? task->num_terms : 1)
+                                                            * sizeof(TermHandle));
+    if (!handles) {
+        task->base.failed = 1;
+        return;
+    }
+    for (int s = set->shard_segments[task->base.shard]; s < set->shard_segments[task->base.shard + 1]; s++) {
+        const Segment *segment = set->segments[s];
+        int count = 0;
+        for (int i = 0; i < task->num_terms; i++) {
+            const QueryTerm *term = &task->terms[i];
+            if (!segment_lookup(segment, term->term, term->len, &handles[count])) continue;
+            handles[count].doc_count = (int)term->doc_count;
+            handles[count].max_tf = term->max_tf;
+            count++;
+        }
+        if (count == 0) continue;
+        
+        int segment_count;
+        DocScore *scores = score_segment(set, s, task->positional, handles, count, task->options, task->k,
+                                         task->base.counters, scratch, task->base.parallel, &segment_count);
+        for (int i = 0; i < segment_count; i++) {
+            topk_push(&task->base.top, set->doc_base[s] + scores[i].doc_id, scores[i].score);
+        }
+    }
+}
+
+// 多段索引：各段分别用全局df与全局最大词频打分（每个文档的分数在所属段内即可算完），
+// 各段的前k名换算成全局文档ID后再经有界堆合并；分片索引的各分片并行打分
+static DocScore* score_set(SearchContext *context, const SegmentSet *set, const PositionalQuery *positional,
+                           const QueryTerm *terms, int num_terms, const SearchOptions *options, int k,
+                           ScoringCounters *counters, int *result_count) {
+    *result_count = 0;
+    TermShardTask *tasks = (TermShardTask*)arena_alloc(context->scratch, set->num_shards * sizeof(TermShardTask));
+    if (!tasks) return NULL;
+    memset(tasks, 0, set->num_shards * sizeof(TermShardTask));
+    for (int i = 0; i < set->num_shards; i++) {
+        tasks[i].positional = positional;
+        tasks[i].terms = terms;
+        tasks[i].num_terms = num_terms;
+        tasks[i].options = options;
+        tasks[i].k = k;
+    }
+    return run_shards(context, set, score_term_shard, tasks, sizeof(TermShardTask), k, counters, result_count);
+}
+
+static int compare_score_doc_ids(const void *a, const void *b) {
+    int doc_a = ((const DocScore*)a)->doc_id;
+    int doc_b = ((const DocScore*)b)->doc_id;
+    return (doc_a > doc_b) - (doc_a < doc_b);
+}
+
+// 邻近度重排：scores为按基础分选出的候选（全局文档ID），按文档ID分组到各段后批量计算加分，
+// 加上options->proximity_weight倍的加分后重新排序，截取前top_k名。失败时保持基础分的排序
+static void apply_proximity(const SegmentSet *set, const PositionalQuery *positional,
+                            const SearchOptions *options, Arena *scratch, DocScore *scores, int *count) {
+    int n = *count;
+    int *docs = (int*)arena_alloc(scratch, n * sizeof(int));
+    double *boosts = (double*)arena_alloc(scratch, n * sizeof(double));
+    TermHandle *terms = (TermHandle*)arena_alloc(scratch, positional->num_proximity_terms * sizeof(TermHandle));
+    if (!docs || !boosts || !terms) {
+        return;
+    }
+    arena_sort(scratch, scores, n, sizeof(DocScore), compare_score_doc_ids);
+    int failed = 0;
+    for (int first = 0; first < n && !failed;) {
+        int local;
+        int s = segment_set_locate(set, scores[first].doc_id, &local);
+        int last = first;
+        // 全局文档ID按段连续编号：同一段的候选在排序后相邻，段内ID也已升序
+        for (; last < n; last++) {
+            int doc_id;
+            if (segment_set_locate(set, scores[last].doc_id, &doc_id) != s) break;
+            docs[last - first] = doc_id;
+        }
+        if (s >= 0) {
+            const Segment *segment = set->segments[s];
+            for (int i = 0; i < positional->num_proximity_terms; i++) {
+                const char *term = positional->proximity_terms[i];
+                segment_lookup(segment, term, strlen(term), &terms[i]);
+            }
+            failed = proximity_boosts(segment, terms, positional->num_proximity_terms,
+                                      docs, last - first, boosts, scratch) != 0;
+            for (int i = first; i < last && !failed; i++) {
+                scores[i].score += options->proximity_weight * boosts[i - first];
+            }
+        }
+        first = last > first ? last : first + 1;
+    }
+    sort_doc_scores(scores, n, scratch);
+    if (options->top_k > 0 && n > options->top_k) *count = options->top_k;
+}
+
+void search_options_init(SearchOptions *options) {
+    options->top_k = SEARCH_DEFAULT_TOP_K;
+    options->scoring = SCORING_PRUNED;
+    options->max_expansions = SEARCH_DEFAULT_MAX_EXPANSIONS;
+    options->max_expansion_postings = SEARCH_DEFAULT_MAX_EXPANSION_POSTINGS;
+    options->proximity_weight = SEARCH_DEFAULT_PROXIMITY_WEIGHT;
+    options->model = SCORING_MODEL_TFIDF;
+    options->bm25_k1 = BM25_DEFAULT_K1;
+    options->bm25_b = BM25_DEFAULT_B;
+    options->parallel_postings = SEARCH_DEFAULT_PARALLEL_POSTINGS;
+    options->parallel_threads = 0;
+    options->stats = NULL;
+}
+
+int parse_scoring_mode(const char *name, ScoringMode *mode) {
+    if (!name) return -1;
+    if (strcmp(name, "pruned") == 0) {
+        *mode = SCORING_PRUNED;
+    } else if (strcmp(name, "exhaustive") == 0) {
+        *mode = SCORING_EXHAUSTIVE;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// 邻近度重排的候选按基础分取前 top_k × SEARCH_PROXIMITY_CANDIDATE_FACTOR 名（0表示全部）
+static int candidate_pool(const SearchOptions *options, int proximity) {
+    int k = options->top_k;
+    if (proximity && k > 0) {
+        k = k > INT32_MAX / SEARCH_PROXIMITY_CANDIDATE_FACTOR ? 0 : k * SEARCH_PROXIMITY_CANDIDATE_FACTOR;
+    }
+    return k;
+}
+
+// 普通查询：所有词前缀扩展后按TF-IDF打分（OR语义），短语作为过滤条件，最后做邻近度重排
+static DocScore* search_terms(SearchContext *context, const SegmentSet *set, const char *query,
+                              const SearchOptions *options, long long *mark, int *result_count) {
+    *result_count = 0;
+    QueryStats *stats = options->stats;
+    ScoringCounters *counters = stats ? &stats->scoring : NULL;
+    Arena *scratch = context->scratch;
+    
+    // 1. 分词，并找出短语与邻近度用到的精确查询词
     int token_count;
-    char **tokens = tokenize_query(query, &token_count);
+    int *phrase_ids;
+    char **tokens = tokenize_query(query, scratch, &token_count, &phrase_ids);
     
     if (token_count == 0) {
-        printf("查询词不能为空！\n");
         return NULL;
     }
+    PositionalQuery positional;
+    if (positional_query_init(&positional, set, tokens, phrase_ids, token_count, scratch) != 0
+        || positional.unmatched) {
+        return NULL;
+    }
+    int proximity = positional.num_proximity_terms >= 2 && options->proximity_weight > 0;
+    int k = candidate_pool(options, proximity);
+    query_stats_lap(stats, QUERY_STAGE_PARSE, mark);
     
-    // 2. 处理前缀匹配（扩展查询词）
-    char **expanded_terms = NULL;
-    int expanded_count = 0;
-    
-    for (int i = 0; i < token_count; i++) {
-        char **matches;
-        int match_count;
-        
-        // 步骤1：添加完整词（若存在）
-        if (trie_search(trie, tokens[i]) && !is_term_in_list(expanded_terms, expanded_count, tokens[i])) {
-            expanded_count++;
-            expanded_terms = (char**)realloc(expanded_terms, expanded_count * sizeof(char*));
-            expanded_terms[expanded_count - 1] = (char*)malloc(strlen(tokens[i]) + 1);
-            strcpy(expanded_terms[expanded_count - 1], tokens[i]);
+    // 2. 前缀扩展并计算文档分数，选出前k名（结果已按分数降序排列）
+    //    单段索引直接在词条ID上扩展，每个词条只生成一次句柄；多段索引先汇总各段的全局统计
+    DocScore *doc_scores = NULL;
+    if (set->num_segments == 1) {
+        int expanded_count;
+        TermHandle *expanded_terms = expand_segment_terms(set, tokens, token_count, options, scratch,
+                                                          &expanded_count);
+        query_stats_lap(stats, QUERY_STAGE_EXPAND, mark);
+        if (expanded_count > 0) {
+            doc_scores = score_segment(set, 0, &positional, expanded_terms, expanded_count, options, k, counters,
+                                       scratch, context, result_count);
         }
-        
-        // 步骤2：添加前缀匹配词（去重）
-        trie_get_prefix_matches(trie, tokens[i], &matches, &match_count);
-        for (int j = 0; j < match_count; j++) {
-            if (!is_term_in_list(expanded_terms, expanded_count, matches[j])) {
-                expanded_count++;
-                expanded_terms = (char**)realloc(expanded_terms, expanded_count * sizeof(char*));
-                expanded_terms[expanded_count - 1] = (char*)malloc(strlen(matches[j]) + 1);
-                strcpy(expanded_terms[expanded_count - 1], matches[j]);
+        if (stats) stats->expanded_terms = expanded_count;
+    } else {
+        int expanded_count;
+        QueryTerm *expanded_terms = expand_set_terms(set, tokens, token_count, options, scratch, &expanded_count);
+        query_stats_lap(stats, QUERY_STAGE_EXPAND, mark);
+        if (expanded_count > 0) {
+            doc_scores = score_set(context, set, &positional, expanded_terms, expanded_count, options, k, counters,
+                                   result_count);
+        }
+        if (stats) stats->expanded_terms = expanded_count;
+    }
+    
+    query_stats_lap(stats, QUERY_STAGE_SCORE, mark);
+    
+    // 3. 邻近度重排：查询词在文档中挨得越近加分越多
+    if (proximity && *result_count > 0) {
+        apply_proximity(set, &positional, options, scratch, doc_scores, result_count);
+        query_stats_lap(stats, QUERY_STAGE_PROXIMITY, mark);
+    }
+    return doc_scores;
+}
+
+// 词条是否以token为前缀（即落在token的前缀扩展中）
+static int has_prefix(const QueryTerm *term, const char *token) {
+    size_t len = strlen(token);
+    return len <= term->len && memcmp(term->term, token, len) == 0;
+}
+
+// 布尔查询中叶子在一个段内的绑定：TERM绑定落在其前缀扩展中的词条，
+// PHRASE绑定在索引中有存活文档的词（其余的词只占位置；有这样的词不在本段时本段不可能匹配）
+static int bind_leaves(const SegmentSet *set, int s, QueryNode **leaves, int num_leaves,
+                       const QueryTerm *terms, const TermHandle *handles, const unsigned char *present,
+                       int num_terms, Arena *scratch) {
+    const Segment *segment = set->segments[s];
+    size_t bound_size = (num_terms > 0 ? num_terms : 1) * sizeof(TermHandle);
+    TermHandle *bound = (TermHandle*)arena_alloc(scratch, bound_size);
+    if (!bound) return -1;
+    int status = 0;
+    for (int l = 0; l < num_leaves && status == 0; l++) {
+        QueryNode *leaf = leaves[l];
+        if (leaf->type == QUERY_TERM) {
+            int count = 0;
+            for (int i = 0; i < num_terms; i++) {
+                if (present[i] && has_prefix(&terms[i], leaf->terms[0])) bound[count++] = handles[i];
             }
+            status = query_bind_term(leaf, bound, count, scratch);
+            continue;
+        }
+        PhraseTerm *phrase = (PhraseTerm*)arena_alloc(scratch, leaf->num_terms * sizeof(PhraseTerm));
+        if (!phrase) {
+            status = -1;
+            break;
+        }
+        int count = 0, missing = 0;
+        for (int i = 0; i < leaf->num_terms && !missing; i++) {
+            const char *word = leaf->terms[i];
+            if (!segment_set_indexes_token(set, word, strlen(word))) continue; // 停用词与短词只占位置
+            missing = !segment_lookup(segment, word, strlen(word), &phrase[count].handle);
+            phrase[count].offset = (uint32_t)i;
+            count++;
+        }
+        status = query_bind_phrase(leaf, phrase, missing ? 0 : count, scratch);
+        arena_release(scratch, phrase, leaf->num_terms * sizeof(PhraseTerm));
+    }
+    arena_release(scratch, bound, bound_size);
+    return status;
+}
+
+// 布尔查询的分片任务：查询只解析一次，叶子的绑定随段改变，多个分片时每个分片在自己的arena中复制一份树
+typedef struct BooleanShardTask {
+    ShardTask base;
+    QueryNode *root; // 调用者的树（只有一个分片时直接绑定，否则只读）
+    const QueryTerm *terms;
+    int num_terms;
+    const unsigned char *scored; // 第i个词条是否参与打分
+    const ScoringParams *params; // 各分片共用，计数写入自己的ShardTask
+    int k;
+} BooleanShardTask;
+
+static void score_boolean_shard(void *arg, int worker) {
+    (void)worker;
+    BooleanShardTask *task = (BooleanShardTask*)arg;
+    const SegmentSet *set = task->base.set;
+    Arena *scratch = task->base.scratch;
+    QueryNode *root = set->num_shards == 1 ? task->root : query_clone(task->root, scratch);
+    ScoringParams params = *task->params;
+    params.counters = task->base.counters;
+    params.scratch = scratch;
+    QueryNode **leaves = NULL;
+    unsigned char *negated = NULL;
+    int num_leaves = root ? query_collect_leaves(root, scratch, &leaves, &negated) : -1;
+    int num_terms = task->num_terms;
+    TermHandle *handles = (TermHandle*)arena_alloc(scratch, (num_terms > 0 ? num_terms : 1) * sizeof(TermHandle));
+    TermHandle *scoring = (TermHandle*)arena_alloc(scratch, (num_terms > 0 ? num_terms : 1) * sizeof(TermHandle));
+    unsigned char *present = (unsigned char*)arena_alloc(scratch, num_terms > 0 ? num_terms : 1);
+    int failed = num_leaves <= 0 || !handles || !scoring || !present;
+    
+    for (int s = set->shard_segments[task->base.shard]; s < set->shard_segments[task->base.shard + 1] && !failed;
+         s++) {
+        const Segment *segment = set->segments[s];
+        int num_scoring = 0;
+        for (int i = 0; i < num_terms; i++) {
+            const QueryTerm *term = &task->terms[i];
+            present[i] = (unsigned char)segment_lookup(segment, term->term, term->len, &handles[i]);
+            if (!present[i]) continue;
+            handles[i].doc_count = (int)term->doc_count;
+            handles[i].max_tf = term->max_tf;
+            if (task->scored[i]) scoring[num_scoring++] = handles[i];
+        }
+        if (bind_leaves(set, s, leaves, num_leaves, task->terms, handles, present, num_terms, scratch) != 0) {
+            failed = 1;
+            break;
+        }
+        int count;
+        int *docs = query_execute(root, segment, segment_set_live_docs(set, s), scratch, &count);
+        if (!docs) {
+            failed = 1;
+            break;
+        }
+        if (count == 0) {
+            query_release_docs(docs, segment, scratch);
+            continue;
         }
         
-        // 释放前缀匹配的临时内存
-        for (int j = 0; j < match_count; j++) {
-            free(matches[j]);
+        // 只对匹配文档打分（没有命中打分词的文档分数为0）
+        int segment_count;
+        DocScore *scores = calculate_candidate_scores(segment, scoring, num_scoring, docs, count, &params,
+                                                      task->k, &segment_count);
+        for (int i = 0; i < segment_count; i++) {
+            topk_push(&task->base.top, set->doc_base[s] + scores[i].doc_id, scores[i].score);
+        }
+        query_release_docs(docs, segment, scratch);
+    }
+    task->base.failed = failed;
+}
+
+// 布尔查询：在每个段上用运算符树求出匹配文档，再只对匹配文档打分。
+// 叶子的词一起做前缀扩展（与普通查询共用扩展预算），打分只用非否定叶子的扩展词；
+// 匹配文档中没有命中任何打分词的（如纯否定查询）分数为0。最后按非否定的词做邻近度重排。
+// 打分不遍历打分词的全部postings，options->scoring对布尔查询不起作用
+static DocScore* search_boolean(SearchContext *context, const SegmentSet *set, const char *query,
+                                const SearchOptions *options, long long *mark, int *result_count) {
+    *result_count = 0;
+    Arena *scratch = context->scratch;
+    QueryStats *stats = options->stats;
+    if (stats) stats->boolean = 1;
+    QueryNode *root = query_parse(query, scratch);
+    QueryNode **leaves = NULL;
+    unsigned char *negated = NULL;
+    int num_leaves = root ? query_collect_leaves(root, scratch, &leaves, &negated) : 0;
+    if (num_leaves <= 0) return NULL;
+    
+    // 1. 所有叶子的词，以及按查询顺序排列的非否定的词（打分与邻近度用）
+    int token_count = 0, positive_count = 0;
+    for (int l = 0; l < num_leaves; l++) token_count += leaves[l]->num_terms;
+    char **tokens = (char**)arena_alloc(scratch, token_count * sizeof(char*));
+    char **positive = (char**)arena_alloc(scratch, token_count * sizeof(char*));
+    int *no_phrases = (int*)arena_alloc(scratch, token_count * sizeof(int));
+    if (!tokens || !positive || !no_phrases) return NULL;
+    token_count = 0;
+    for (int l = 0; l < num_leaves; l++) {
+        for (int i = 0; i < leaves[l]->num_terms; i++) {
+            tokens[token_count++] = leaves[l]->terms[i];
+            if (!negated[l]) positive[positive_count++] = leaves[l]->terms[i];
         }
-        free(matches);
     }
+    for (int i = 0; i < token_count; i++) no_phrases[i] = -1;
     
-    // 3. 若无扩展词，使用原始词
-    if (expanded_count == 0) {
-        expanded_terms = tokens;
-        expanded_count = token_count;
-        tokens = NULL; // 避免双重释放
+    PositionalQuery positional;
+    int proximity = 0;
+    if (positional_query_init(&positional, set, positive, no_phrases, positive_count, scratch) == 0) {
+        proximity = positional.num_proximity_terms >= 2 && options->proximity_weight > 0;
     }
+    int k = candidate_pool(options, proximity);
+    query_stats_lap(stats, QUERY_STAGE_PARSE, mark);
     
-    // 4. 计算文档分数
-    DocScore *doc_scores = calculate_document_scores(index, expanded_terms, expanded_count, result_count);
+    // 2. 前缀扩展（按全局统计），标记落在非否定的词的扩展中的打分词
+    int num_terms;
+    QueryTerm *terms = expand_set_terms(set, tokens, token_count, options, scratch, &num_terms);
+    query_stats_lap(stats, QUERY_STAGE_EXPAND, mark);
+    if (stats) stats->expanded_terms = num_terms;
+    unsigned char *scored = (unsigned char*)arena_alloc(scratch, num_terms > 0 ? num_terms : 1);
+    ScoringParams params;
+    scoring_params_for(set, options, &params);
+    BooleanShardTask *tasks = (BooleanShardTask*)arena_alloc(scratch, set->num_shards * sizeof(BooleanShardTask));
+    for (int i = 0; i < num_terms && scored; i++) {
+        scored[i] = 0;
+        for (int t = 0; t < positive_count && !scored[i]; t++) scored[i] = has_prefix(&terms[i], positive[t]);
+    }
     
-    // 5. 排序（降序）
-    if (*result_count > 0) {
-        sort_doc_scores(doc_scores, *result_count);
-    } else {
-        printf("未找到与\"%s\"匹配的文档\n", query);
-        // 清理内存
-        for (int i = 0; i < expanded_count; i++) free(expanded_terms[i]);
-        free(expanded_terms);
-        for (int i = 0; i < token_count; i++) free(tokens[i]);
-        free(tokens);
+    // 3. 逐段求出匹配文档并打分（分片索引的各分片并行），换算成全局文档ID后经有界堆合并
+    DocScore *doc_scores = NULL;
+    if (scored && tasks) {
+        memset(tasks, 0, set->num_shards * sizeof(BooleanShardTask));
+        for (int i = 0; i < set->num_shards; i++) {
+            tasks[i].root = root;
+            tasks[i].terms = terms;
+            tasks[i].num_terms = num_terms;
+            tasks[i].scored = scored;
+            tasks[i].params = &params;
+            tasks[i].k = k;
+        }
+        doc_scores = run_shards(context, set, score_boolean_shard, tasks, sizeof(BooleanShardTask), k,
+                                stats ? &stats->scoring : NULL, result_count);
+        query_stats_lap(stats, QUERY_STAGE_SCORE, mark);
+        // 4. 邻近度重排
+        if (proximity && *result_count > 0) {
+            apply_proximity(set, &positional, options, scratch, doc_scores, result_count);
+            query_stats_lap(stats, QUERY_STAGE_PROXIMITY, mark);
+        }
+    }
+    return doc_scores;
+}
+
+SearchContext* search_context_create(void) {
+    SearchContext *context = (SearchContext*)calloc(1, sizeof(SearchContext));
+    if (!context) return NULL;
+    context->scratch = arena_create();
+    if (!context->scratch) {
+        free(context);
+        return NULL;
+    }
+    return context;
+}
+
+void search_context_free(SearchContext *context) {
+    if (!context) return;
+    arena_destroy(context->scratch);
+    for (int i = 0; i < MAX_SHARDS; i++) arena_destroy(context->shard_scratch[i]);
+    for (int i = 0; i < SEARCH_MAX_PARALLEL; i++) arena_destroy(context->range_scratch[i]);
+    if (context->owns_pool) worker_pool_free(context->pool);
+    free(context);
+}
+
+void search_context_set_pool(SearchContext *context, WorkerPool *pool) {
+    if (!context) return;
+    if (context->owns_pool) worker_pool_free(context->pool);
+    context->pool = pool;
+    context->owns_pool = 0;
+}
+
+// 上下文各arena向系统申请过的chunk数之和（查询前后的差值即本次查询新申请的chunk数）
+static size_t context_chunks(const SearchContext *context) {
+    size_t chunks = context->scratch->num_chunks;
+    for (int i = 0; i < MAX_SHARDS; i++) {
+        if (context->shard_scratch[i]) chunks += context->shard_scratch[i]->num_chunks;
+    }
+    for (int i = 0; i < SEARCH_MAX_PARALLEL; i++) {
+        if (context->range_scratch[i]) chunks += context->range_scratch[i]->num_chunks;
+    }
+    return chunks;
+}
+
+const SearchResult* search_context_run(SearchContext *context, const SegmentSet *set, const char *query,
+                                       const SearchOptions *options, int *result_count) {
+    *result_count = 0;
+    if (!context) return NULL;
+    SearchOptions defaults;
+    if (!options) {
+        search_options_init(&defaults);
+        options = &defaults;
+    }
+    // 上一次查询的临时内存与结果全部作废，chunk留给本次查询复用
+    arena_reset(context->scratch);
+    for (int i = 0; i < MAX_SHARDS; i++) arena_reset(context->shard_scratch[i]);
+    for (int i = 0; i < SEARCH_MAX_PARALLEL; i++) arena_reset(context->range_scratch[i]);
+    if (!set || !query || set->live_docs <= 0) {
         return NULL;
     }
+    // 统计关闭时不读时钟
+    QueryStats *stats = options->stats;
+    long long start = stats ? monotonic_ns() : 0;
+    long long mark = start;
+    size_t chunks = context_chunks(context);
     
-    // 6. 准备搜索结果（复制文档路径）
-    SearchResult *results = (SearchResult*)malloc(*result_count * sizeof(SearchResult));
+    // 用到AND/OR/NOT或括号的查询按运算符树求值，其余查询保持原有的OR语义
+    DocScore *doc_scores = query_is_boolean(query)
+        ? search_boolean(context, set, query, options, &mark, result_count)
+        : search_terms(context, set, query, options, &mark, result_count);
+    
+    // 4. 准备搜索结果：文档路径直接引用段集合中的字符串，不复制
+    SearchResult *results = NULL;
+    if (*result_count > 0) {
+        results = (SearchResult*)arena_alloc(context->scratch, *result_count * sizeof(SearchResult));
+    }
+    if (!results) {
+        *result_count = 0;
+        if (stats) {
+            stats->total_ns = monotonic_ns() - start;
+            stats->arena_chunks += context_chunks(context) - chunks;
+        }
+        return NULL;
+    }
     for (int i = 0; i < *result_count; i++) {
         results[i].doc_id = doc_scores[i].doc_id;
         results[i].score = doc_scores[i].score;
         
         // 验证文档ID有效性（避免越界）
-        if (doc_scores[i].doc_id >= 0 && doc_scores[i].doc_id < num_docs) {
-            results[i].doc_path = (char*)malloc(strlen(doc_paths[doc_scores[i].doc_id]) + 1);
-            strcpy(results[i].doc_path, doc_paths[doc_scores[i].doc_id]);
-        } else {
-            results[i].doc_path = (char*)malloc(sizeof("无效文档路径"));
-            strcpy(results[i].doc_path, "无效文档路径");
-        }
+        const char *doc_path = segment_set_doc_path(set, doc_scores[i].doc_id);
+        results[i].doc_path = doc_path ? doc_path : "无效文档路径";
     }
     
-    // 清理内存
-    free(doc_scores);
-    for (int i = 0; i < expanded_count; i++) free(expanded_terms[i]);
-    free(expanded_terms);
-    for (int i = 0; i < token_count; i++) free(tokens[i]);
-    free(tokens);
+    if (stats) {
+        query_stats_lap(stats, QUERY_STAGE_RESULTS, &mark);
+        stats->total_ns = mark - start;
+        stats->arena_chunks += context_chunks(context) - chunks;
+        stats->results = *result_count;
+    }
     
     return results;
 }
 
-void free_search_results(SearchResult *results, int count) {
-    if (!results) return;
+SearchResult* perform_search(const SegmentSet *set, const char *query, const SearchOptions *options,
+                             int *result_count) {
+    *result_count = 0;
+    SearchContext *context = search_context_create();
+    if (!context) return NULL;
+    int count;
+    const SearchResult *found = search_context_run(context, set, query, options, &count);
     
-    for (int i = 0; i < count; i++) {
-        free(results[i].doc_path);
+    // 结果数组与文档路径复制到同一块内存中：[SearchResult × count][路径\0 ...]
+    SearchResult *results = NULL;
+    if (count > 0) {
+        size_t bytes = count * sizeof(SearchResult);
+        for (int i = 0; i < count; i++) bytes += strlen(found[i].doc_path) + 1;
+        results = (SearchResult*)malloc(bytes);
     }
-    
+    if (results) {
+        char *text = (char*)(results + count);
+        for (int i = 0; i < count; i++) {
+            size_t len = strlen(found[i].doc_path) + 1;
+            memcpy(text, found[i].doc_path, len);
+            results[i] = found[i];
+            results[i].doc_path = text;
+            text += len;
+        }
+        *result_count = count;
+    }
+    search_context_free(context);
+    return results;
+}
+
+void free_search_results(SearchResult *results, int count) {
+    (void)count;
     free(results);
-}
\ No newline at end of file
+}
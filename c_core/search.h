@@ -1,22 +1,102 @@
 #ifndef SEARCH_H
 #define SEARCH_H
 
-#include "trie.h"
-#include "inverted_index.h"
+#include "segment.h"
+#include "segment_set.h"
 #include "tfidf.h"
+#include "query_stats.h"
+#include "worker_pool.h"
 
 // 搜索结果结构
 typedef struct SearchResult {
     int doc_id;
     double score;
-    char *doc_path; // 文档路径
+    const char *doc_path; // 文档路径
 } SearchResult;
 
-// 执行搜索
-SearchResult* perform_search(TrieNode *trie, InvertedIndex *index, const char *query, 
-                            char **doc_paths, int num_docs, int *result_count);
+// 默认返回的结果数
+#define SEARCH_DEFAULT_TOP_K 100
 
-// 释放搜索结果
+// 前缀扩展的默认预算：最多扩展出的词条数与这些词条的postings总数
+#define SEARCH_DEFAULT_MAX_EXPANSIONS 4096
+#define SEARCH_DEFAULT_MAX_EXPANSION_POSTINGS (1LL << 22)
+
+// 邻近度加分：查询中相邻的两个不同查询词在文档中的最小距离为d时加 weight / d（相邻出现加满weight），
+// 只对按基础分排在前 top_k × SEARCH_PROXIMITY_CANDIDATE_FACTOR 名的文档计算
+#define SEARCH_DEFAULT_PROXIMITY_WEIGHT 0.5
+#define SEARCH_PROXIMITY_CANDIDATE_FACTOR 4
+
+// 段内并行打分：一个段上待打分的postings数（各扩展词条在该段中的文档频率之和）达到门槛时，
+// 把段的文档ID切成若干连续区间，各区间在查询上下文的线程池中用自己的累加器与小顶堆打分，最后合并各区间的前k名，
+// 结果与单线程打分完全相同。门槛以下的查询仍只在调用线程中执行。
+// 分片索引的各分片已经并行，只有一个分片时才在段内并行
+#define SEARCH_DEFAULT_PARALLEL_POSTINGS (1LL << 20)
+#define SEARCH_MAX_PARALLEL 64              // 一个段至多切成的区间数
+#define SEARCH_MIN_PARALLEL_DOCS 4096       // 每个区间至少包含的文档数
+
+// 打分方式（两者返回完全相同的前k名，穷举打分用于对照验证）
+typedef enum ScoringMode {
+    SCORING_PRUNED = 0, // MaxScore + 块级上界动态剪枝（默认，前缀扩展出大量词条时只对可能进入前k名的文档打分）
+    SCORING_EXHAUSTIVE // 对所有词条的所有postings打分
+} ScoringMode;
+
+// 搜索选项
+typedef struct SearchOptions {
+    int top_k;           // 返回分数最高的top_k个结果（<=0表示全部）
+    ScoringMode scoring;
+    // 前缀扩展预算（<=0表示不限）：超出时按文档频率从高到低挑选扩展词，查询词本身总会保留
+    int max_expansions;
+    long long max_expansion_postings;
+    double proximity_weight; // 邻近度加分的权重（<=0表示不加分）
+    ScoringModel model;      // 打分模型（每次查询可选，默认TF-IDF）
+    double bm25_k1;
+    double bm25_b;
+    long long parallel_postings; // 段内并行打分的门槛（<=0表示不并行）
+    int parallel_threads;        // 段内并行的线程数上限（<=0表示CPU核数）
+    QueryStats *stats;       // 非NULL时记录本次查询的分阶段耗时与计数器（调用者先清零，见query_stats.h）
+} SearchOptions;
+
+// 填充默认选项（SEARCH_DEFAULT_TOP_K、动态剪枝、默认扩展预算与邻近度权重、TF-IDF与默认的BM25参数、
+// 默认的段内并行门槛，不记录统计）
+void search_options_init(SearchOptions *options);
+
+// 解析打分方式名称（"pruned"/"exhaustive"），无法识别返回-1
+int parse_scoring_mode(const char *name, ScoringMode *mode);
+
+// 查询上下文：持有查询用到的全部临时内存（查询词、扩展词与句柄、累加器、小顶堆、结果数组），
+// 每次查询开始时整体作废后重用；分片与段内并行的任务交给上下文的线程池（第一次用到时创建），不在每次查询时创建线程。
+// 同样规模的普通查询稳定之后不再向系统申请内存；布尔查询的解析与求值（query.h）仍使用malloc。
+// 一个上下文同一时间只能由一个线程使用，并发查询时每个线程各用一个；分片索引的各分片任务与段内并行打分的各区间任务使用上下文中各自的内存
+//
+// 线程安全的边界：段集合打开之后只读，查询路径（本文件与query.c、tfidf.c、phrase.c、segment_set_suggest）
+// 只读取段集合、只写调用者给的上下文与统计，进程内唯一共享的可写状态是原子更新的直方图（query_stats.c），
+// 也不向stdout输出。因此多个线程可以各用一个上下文同时在同一个段集合上查询，不需要任何锁；
+// 关闭或替换段集合须等所有使用它的查询结束（常驻服务的做法见server.h）
+typedef struct SearchContext SearchContext;
+
+SearchContext* search_context_create(void);
+void search_context_free(SearchContext *context);
+// 让上下文的分片与区间任务提交到调用者的pool（原来自己创建的池随之释放）。多个并发查询的上下文共用一个池时，
+// 整个进程用于分片与段内并行的线程数固定为池的大小，不随并发查询数增长；pool须在这些上下文之后释放
+void search_context_set_pool(SearchContext *context, WorkerPool *pool);
+
+// 同perform_search，结果归上下文所有，doc_path直接指向段集合中的路径（不复制）；
+// 结果在对同一上下文的下一次查询、search_context_free或段集合关闭之前有效，无结果时返回NULL。
+// 记录统计时stats->arena_chunks为本次查询中上下文各arena新申请的chunk数
+const SearchResult* search_context_run(SearchContext *context, const SegmentSet *set, const char *query,
+                                       const SearchOptions *options, int *result_count);
+
+// 执行搜索，返回分数最高的前top_k个结果（options为NULL时使用默认选项）
+// 直接在已映射的段文件上查询，多段索引时遍历所有段（IDF使用全部段的文档总数与文档频率），
+// 结果中的doc_id为全局文档ID；不向stdout输出，无结果时返回NULL
+// 查询语法：空白分隔的词做前缀扩展后按TF-IDF打分；双引号内的词组成短语，
+// 只返回包含所有短语（按原顺序紧邻出现，停用词保留间隔）的文档，短语中的词照常参与打分；
+// 用到大写的AND/OR/NOT或括号时按布尔查询求值（语法见query.h），只对匹配的文档打分
+// 一次性查询：使用临时的上下文，结果与文档路径复制到调用者所有的一块内存中（反复查询时用search_context_run）
+SearchResult* perform_search(const SegmentSet *set, const char *query, const SearchOptions *options,
+                             int *result_count);
+
+// 释放perform_search的结果
 void free_search_results(SearchResult *results, int count);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,681 @@
+#include "segment.h"
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// 写入
+// ---------------------------------------------------------------------------
+
+typedef struct SortedTerm {
+    const char *term;
+    int term_id;
+} SortedTerm;
+
+static int compare_terms(const void *a, const void *b) {
+    return strcmp(((const SortedTerm*)a)->term, ((const SortedTerm*)b)->term);
+}
+
+// 构建补全表时按排序后的词条ID取文档频率
+typedef struct SortedTermWeights {
+    const InvertedIndex *index;
+    const int *order;
+} SortedTermWeights;
+
+static uint32_t sorted_term_doc_count(const void *context, int term_id) {
+    const SortedTermWeights *weights = (const SortedTermWeights*)context;
+    return (uint32_t)weights->index->terms[weights->order[term_id]].postings.doc_count;
+}
+
+// 补零到页边界，返回新的写入位置
+static uint64_t pad_to_page(FILE *file, uint64_t pos) {
+    static const char zeros[SEGMENT_PAGE_SIZE];
+    uint64_t aligned = (pos + SEGMENT_PAGE_SIZE - 1) / SEGMENT_PAGE_SIZE * SEGMENT_PAGE_SIZE;
+    if (aligned > pos) {
+        fwrite(zeros, 1, (size_t)(aligned - pos), file);
+    }
+    return aligned;
+}
+
+// 开始一个新区块：对齐后记录偏移
+static uint64_t begin_section(FILE *file, SegmentHeader *header, int type, uint64_t pos) {
+    pos = pad_to_page(file, pos);
+    header->sections[type].offset = pos;
+    return pos;
+}
+
+// 长度0~SMALL_DOC_LENGTHS-1直接作为编码，其余编码 = SMALL_DOC_LENGTHS + 4位浮点（3位尾数、隐含最高位）
+#define SMALL_DOC_LENGTHS 24
+
+uint8_t segment_encode_doc_length(uint32_t length) {
+    if (length < SMALL_DOC_LENGTHS) return (uint8_t)length;
+    uint32_t rest = length - SMALL_DOC_LENGTHS;
+    int bits = 32 - __builtin_clz(rest | 1);
+    if (bits < 4) return (uint8_t)(SMALL_DOC_LENGTHS + rest);
+    int shift = bits - 4;
+    uint32_t code = SMALL_DOC_LENGTHS + (((rest >> shift) & 0x07) | ((uint32_t)(shift + 1) << 3));
+    return (uint8_t)(code > 255 ? 255 : code); // 超过2^31的长度饱和到最大编码
+}
+
+uint32_t segment_decode_doc_length(uint8_t code) {
+    if (code < SMALL_DOC_LENGTHS) return code;
+    uint32_t value = code - SMALL_DOC_LENGTHS;
+    int shift = (int)(value >> 3) - 1;
+    uint32_t rest = shift < 0 ? (value & 0x07) : ((value & 0x07) | 0x08) << shift;
+    return SMALL_DOC_LENGTHS + rest;
+}
+
+// 由postings统计每个文档的长度（各词条词频之和）并量化，失败返回NULL
+static uint8_t* count_doc_lengths(InvertedIndex *index, int num_docs) {
+    uint32_t *lengths = (uint32_t*)calloc(num_docs > 0 ? num_docs : 1, sizeof(uint32_t));
+    uint8_t *codes = (uint8_t*)malloc(num_docs > 0 ? num_docs : 1);
+    if (!lengths || !codes) {
+        free(lengths);
+        free(codes);
+        return NULL;
+    }
+    for (int i = 0; i < index->num_terms; i++) {
+        PostingCursor cursor;
+        posting_cursor_init_list(&cursor, &index->terms[i].postings);
+        while (posting_cursor_next(&cursor)) {
+            if (cursor.doc_id < num_docs) lengths[cursor.doc_id] += (uint32_t)cursor.term_frequency;
+        }
+    }
+    for (int i = 0; i < num_docs; i++) codes[i] = segment_encode_doc_length(lengths[i]);
+    free(lengths);
+    return codes;
+}
+
+int segment_write(InvertedIndex *index, char **doc_paths, int num_docs, const char *filename) {
+    if (!index || !filename || num_docs < 0) return -1;
+
+    // postings可能还有未编码的尾部，先全部封口
+    inverted_index_seal(index);
+
+    // 按字典序排列词条ID（前缀查询依赖此顺序）
+    int num_terms = index->num_terms;
+    // 每个有postings的词条都记录了位置时才写位置区块
+    int with_positions = num_terms > 0;
+    for (int i = 0; i < num_terms && with_positions; i++) {
+        const PostingList *list = &index->terms[i].postings;
+        if (list->doc_count > 0 && !list->positions) with_positions = 0;
+    }
+    SortedTerm *sorted = (SortedTerm*)malloc((num_terms > 0 ? num_terms : 1) * sizeof(SortedTerm));
+    int *order = (int*)malloc((num_terms > 0 ? num_terms : 1) * sizeof(int));
+    if (!sorted || !order) {
+        free(sorted);
+        free(order);
+        return -1;
+    }
+    for (int i = 0; i < num_terms; i++) {
+        sorted[i].term = inverted_index_term(index, i);
+        sorted[i].term_id = i;
+    }
+    qsort(sorted, num_terms, sizeof(SortedTerm), compare_terms);
+    for (int i = 0; i < num_terms; i++) order[i] = sorted[i].term_id;
+    free(sorted);
+
+    char tmp_name[1024];
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", filename);
+    FILE *file = fopen(tmp_name, "wb");
+    if (!file) {
+        free(order);
+        return -1;
+    }
+
+    SegmentHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SEGMENT_MAGIC;
+    header.version = SEGMENT_VERSION;
+    header.page_size = SEGMENT_PAGE_SIZE;
+    header.num_sections = SEGMENT_SECTION_COUNT;
+    header.num_docs = (uint32_t)num_docs;
+    header.num_terms = (uint32_t)num_terms;
+
+    // 文件头占第一页，最后再回填
+    fwrite(&header, sizeof(header), 1, file);
+    uint64_t pos = sizeof(header);
+
+    // 1. 词典
+    pos = begin_section(file, &header, SEGMENT_SECTION_TERMS, pos);
+    uint64_t posting_offset = 0;
+    uint32_t block_offset = 0;
+    uint32_t term_offset = 0;
+    for (int i = 0; i < num_terms; i++) {
+        const TermEntry *term = &index->terms[order[i]];
+        const PostingList *list = &term->postings;
+        SegmentTerm entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.posting_offset = posting_offset;
+        entry.posting_size = list->size;
+        entry.block_offset = block_offset;
+        entry.num_blocks = (uint32_t)list->num_blocks;
+        entry.term_offset = term_offset;
+        entry.term_len = term->term_len;
+        entry.doc_count = (uint32_t)list->doc_count;
+        entry.max_tf = list->max_tf;
+        fwrite(&entry, sizeof(entry), 1, file);
+        posting_offset += list->size;
+        block_offset += (uint32_t)list->num_blocks;
+        term_offset += entry.term_len + 1;
+    }
+    pos += (uint64_t)num_terms * sizeof(SegmentTerm);
+    header.sections[SEGMENT_SECTION_TERMS].size = (uint64_t)num_terms * sizeof(SegmentTerm);
+
+    // 2. 词条字符串池
+    pos = begin_section(file, &header, SEGMENT_SECTION_TERM_BYTES, pos);
+    for (int i = 0; i < num_terms; i++) {
+        const TermEntry *term = &index->terms[order[i]];
+        fwrite(index->term_bytes + term->term_offset, 1, term->term_len + 1, file);
+    }
+    pos += term_offset;
+    header.sections[SEGMENT_SECTION_TERM_BYTES].size = term_offset;
+
+    // 3. 词条哈希表（装载因子不超过0.5，槽中保存哈希值与排序后的词条ID+1）
+    pos = begin_section(file, &header, SEGMENT_SECTION_TERM_HASH, pos);
+    uint32_t slot_capacity = 16;
+    while (slot_capacity < (uint32_t)num_terms * 2) slot_capacity <<= 1;
+    TermSlot *slots = (TermSlot*)calloc(slot_capacity, sizeof(TermSlot));
+    if (!slots) {
+        fclose(file);
+        remove(tmp_name);
+        free(order);
+        return -1;
+    }
+    for (int i = 0; i < num_terms; i++) {
+        const TermEntry *term = &index->terms[order[i]];
+        uint32_t hash = hash_term(index->term_bytes + term->term_offset, term->term_len);
+        uint32_t j = hash & (slot_capacity - 1);
+        while (slots[j].term_id != 0) j = (j + 1) & (slot_capacity - 1);
+        slots[j].hash = hash;
+        slots[j].term_id = (uint32_t)i + 1;
+    }
+    fwrite(slots, sizeof(TermSlot), slot_capacity, file);
+    free(slots);
+    pos += (uint64_t)slot_capacity * sizeof(TermSlot);
+    header.sections[SEGMENT_SECTION_TERM_HASH].size = (uint64_t)slot_capacity * sizeof(TermSlot);
+
+    // 4. 词条双数组Trie（由排好序的词表构建，状态上的区间即词典中的词条ID区间）
+    pos = begin_section(file, &header, SEGMENT_SECTION_TERM_TRIE, pos);
+    const char **words = (const char**)malloc((num_terms > 0 ? num_terms : 1) * sizeof(char*));
+    Trie *trie = NULL;
+    if (words) {
+        for (int i = 0; i < num_terms; i++) {
+            words[i] = index->term_bytes + index->terms[order[i]].term_offset;
+        }
+        trie = trie_build(words, num_terms);
+        free(words);
+    }
+    if (!trie) {
+        fclose(file);
+        remove(tmp_name);
+        free(order);
+        return -1;
+    }
+    fwrite(trie->states, sizeof(TrieState), trie->num_states, file);
+    pos += (uint64_t)trie->num_states * sizeof(TrieState);
+    header.sections[SEGMENT_SECTION_TERM_TRIE].size = (uint64_t)trie->num_states * sizeof(TrieState);
+
+    // 5. 前缀补全表（每个前缀按文档频率预选最佳补全）
+    pos = begin_section(file, &header, SEGMENT_SECTION_TERM_COMPLETIONS, pos);
+    SortedTermWeights weights = { index, order };
+    uint32_t completions_size;
+    uint32_t *completions = trie_build_completions(trie, sorted_term_doc_count, &weights, &completions_size);
+    trie_free(trie);
+    if (!completions) {
+        fclose(file);
+        remove(tmp_name);
+        free(order);
+        return -1;
+    }
+    fwrite(completions, sizeof(uint32_t), completions_size, file);
+    free(completions);
+    pos += (uint64_t)completions_size * sizeof(uint32_t);
+    header.sections[SEGMENT_SECTION_TERM_COMPLETIONS].size = (uint64_t)completions_size * sizeof(uint32_t);
+
+    // 6. 压缩postings（构建期已按文档ID排序并分块压缩，直接拷贝）
+    pos = begin_section(file, &header, SEGMENT_SECTION_POSTINGS, pos);
+    for (int i = 0; i < num_terms; i++) {
+        const PostingList *list = &index->terms[order[i]].postings;
+        fwrite(list->data, 1, list->size, file);
+    }
+    pos += posting_offset;
+    header.sections[SEGMENT_SECTION_POSTINGS].size = posting_offset;
+
+    // 7. postings跳表头
+    pos = begin_section(file, &header, SEGMENT_SECTION_POSTING_BLOCKS, pos);
+    for (int i = 0; i < num_terms; i++) {
+        const PostingList *list = &index->terms[order[i]].postings;
+        fwrite(list->blocks, sizeof(PostingBlock), list->num_blocks, file);
+    }
+    pos += (uint64_t)block_offset * sizeof(PostingBlock);
+    header.sections[SEGMENT_SECTION_POSTING_BLOCKS].size = (uint64_t)block_offset * sizeof(PostingBlock);
+
+    // 8. 文档表
+    pos = begin_section(file, &header, SEGMENT_SECTION_DOCS, pos);
+    uint64_t path_offset = 0;
+    for (int i = 0; i < num_docs; i++) {
+        SegmentDoc doc;
+        memset(&doc, 0, sizeof(doc));
+        doc.path_offset = path_offset;
+        doc.path_len = (uint32_t)strlen(doc_paths[i]);
+        fwrite(&doc, sizeof(doc), 1, file);
+        path_offset += doc.path_len + 1;
+    }
+    pos += (uint64_t)num_docs * sizeof(SegmentDoc);
+    header.sections[SEGMENT_SECTION_DOCS].size = (uint64_t)num_docs * sizeof(SegmentDoc);
+
+    // 9. 文档路径字符串池
+    pos = begin_section(file, &header, SEGMENT_SECTION_DOC_BYTES, pos);
+    for (int i = 0; i < num_docs; i++) {
+        fwrite(doc_paths[i], 1, strlen(doc_paths[i]) + 1, file);
+    }
+    pos += path_offset;
+    header.sections[SEGMENT_SECTION_DOC_BYTES].size = path_offset;
+
+    // 10. 位置字节流
+    pos = begin_section(file, &header, SEGMENT_SECTION_POSITIONS, pos);
+    uint64_t position_offset = 0;
+    for (int i = 0; i < num_terms && with_positions; i++) {
+        const PostingList *list = &index->terms[order[i]].postings;
+        fwrite(list->positions, 1, list->positions_size, file);
+        position_offset += list->positions_size;
+    }
+    pos += position_offset;
+    header.sections[SEGMENT_SECTION_POSITIONS].size = position_offset;
+
+    // 11. 位置块偏移（词条内的相对偏移换算为区块内的绝对偏移）
+    pos = begin_section(file, &header, SEGMENT_SECTION_POSITION_BLOCKS, pos);
+    position_offset = 0;
+    for (int i = 0; i < num_terms && with_positions; i++) {
+        const PostingList *list = &index->terms[order[i]].postings;
+        for (int b = 0; b < list->num_blocks; b++) {
+            uint64_t offset = position_offset + list->position_blocks[b];
+            fwrite(&offset, sizeof(offset), 1, file);
+        }
+        position_offset += list->positions_size;
+    }
+    if (with_positions) {
+        pos += (uint64_t)block_offset * sizeof(uint64_t);
+        header.sections[SEGMENT_SECTION_POSITION_BLOCKS].size = (uint64_t)block_offset * sizeof(uint64_t);
+    }
+
+    // 12. 文档长度（各词条在文档中的词频之和，由postings统计后量化为一个字节）
+    pos = begin_section(file, &header, SEGMENT_SECTION_DOC_LENGTHS, pos);
+    uint8_t *doc_lengths = count_doc_lengths(index, num_docs);
+    if (!doc_lengths) {
+        fclose(file);
+        remove(tmp_name);
+        free(order);
+        return -1;
+    }
+    fwrite(doc_lengths, 1, num_docs, file);
+    free(doc_lengths);
+    pos += num_docs;
+    header.sections[SEGMENT_SECTION_DOC_LENGTHS].size = num_docs;
+
+    pos = pad_to_page(file, pos);
+    header.file_size = pos;
+
+    // 回填文件头
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    int failed = ferror(file);
+    fclose(file);
+    free(order);
+
+    if (failed) {
+        remove(tmp_name);
+        return -1;
+    }
+
+    // 用新文件替换旧文件（Windows下rename不能覆盖已有文件）
+#ifdef _WIN32
+    remove(filename);
+#endif
+    if (rename(tmp_name, filename) != 0) {
+        remove(tmp_name);
+        return -1;
+    }
+    return 0;
+}
+
+int segment_append_to_index(const Segment *segment, const uint64_t *live_docs, InvertedIndex *index, int doc_base,
+                            int with_positions) {
+    if (!segment || !index || doc_base < 0) return -1;
+    if (with_positions && !segment_has_positions(segment)) return -1;
+    // 存活文档的新编号（已删除的文档为-1）
+    int *doc_map = (int*)malloc((segment->num_docs > 0 ? segment->num_docs : 1) * sizeof(int));
+    if (!doc_map) return -1;
+    int num_live = 0;
+    for (int doc_id = 0; doc_id < segment->num_docs; doc_id++) {
+        doc_map[doc_id] = DOC_IS_LIVE(live_docs, doc_id) ? doc_base + num_live++ : -1;
+    }
+
+    int status = num_live;
+    for (int term_id = 0; term_id < segment->num_terms && status >= 0; term_id++) {
+        const char *term = segment_term(segment, term_id);
+        TermHandle handle;
+        PostingCursor cursor;
+        segment_term_handle(segment, term_id, &handle);
+        int opened = with_positions ? segment_position_cursor(segment, &handle, &cursor)
+                                    : segment_posting_cursor(segment, &handle, &cursor);
+        if (!term || !opened) {
+            status = -1;
+            break;
+        }
+        PostingList *list = NULL; // 遇到第一个存活文档时才加入词条
+        while (posting_cursor_next(&cursor)) {
+            int doc_id = cursor.doc_id >= 0 && cursor.doc_id < segment->num_docs ? doc_map[cursor.doc_id] : -1;
+            if (doc_id < 0) continue;
+            if (!list) {
+                int dst = inverted_index_intern(index, term, segment->terms[term_id].term_len);
+                if (dst < 0) {
+                    status = -1;
+                    break;
+                }
+                list = &index->terms[dst].postings;
+            }
+            int appended;
+            if (with_positions) {
+                const unsigned char *bytes;
+                uint32_t size;
+                appended = posting_cursor_position_bytes(&cursor, &bytes, &size) == 0
+                        && posting_list_append_positions(list, doc_id, cursor.term_frequency, bytes, size) == 0;
+            } else {
+                appended = posting_list_append(list, doc_id, cursor.term_frequency) == 0;
+            }
+            if (!appended) {
+                status = -1;
+                break;
+            }
+        }
+    }
+    free(doc_map);
+    return status;
+}
+
+// ---------------------------------------------------------------------------
+// 映射与校验
+// ---------------------------------------------------------------------------
+
+static void unmap_file(const unsigned char *base, size_t size, void *map_handle) {
+#ifdef _WIN32
+    (void)size;
+    if (base) UnmapViewOfFile(base);
+    if (map_handle) CloseHandle((HANDLE)map_handle);
+#else
+    (void)map_handle;
+    if (base) munmap((void*)base, size);
+#endif
+}
+
+static const unsigned char* map_file(const char *filename, size_t *size, void **map_handle) {
+    *size = 0;
+    *map_handle = NULL;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return NULL;
+
+    void *base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!base) {
+        CloseHandle(mapping);
+        return NULL;
+    }
+    *size = (size_t)file_size.QuadPart;
+    *map_handle = mapping;
+    return (const unsigned char*)base;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    *size = (size_t)st.st_size;
+    return (const unsigned char*)base;
+#endif
+}
+
+// 检查区块是否完整落在文件内，且大小是元素大小的整数倍
+static int section_valid(const SegmentHeader *header, int type, size_t file_size, size_t elem_size) {
+    const SegmentSection *section = &header->sections[type];
+    if (section->offset % SEGMENT_PAGE_SIZE != 0) return 0;
+    if (section->offset > file_size || section->size > file_size - section->offset) return 0;
+    return section->size % elem_size == 0;
+}
+
+Segment* segment_open(const char *filename) {
+    if (!filename) return NULL;
+
+    size_t size;
+    void *map_handle;
+    const unsigned char *base = map_file(filename, &size, &map_handle);
+    if (!base) return NULL;
+
+    const SegmentHeader *header = (const SegmentHeader*)base;
+    int valid = size >= sizeof(SegmentHeader)
+             && header->magic == SEGMENT_MAGIC
+             && header->version == SEGMENT_VERSION
+             && header->page_size == SEGMENT_PAGE_SIZE
+             && header->num_sections >= SEGMENT_SECTION_COUNT
+             && header->num_sections <= SEGMENT_MAX_SECTIONS
+             && header->file_size == size
+             && section_valid(header, SEGMENT_SECTION_TERMS, size, sizeof(SegmentTerm))
+             && section_valid(header, SEGMENT_SECTION_TERM_BYTES, size, 1)
+             && section_valid(header, SEGMENT_SECTION_TERM_HASH, size, sizeof(TermSlot))
+             && section_valid(header, SEGMENT_SECTION_TERM_TRIE, size, sizeof(TrieState))
+             && section_valid(header, SEGMENT_SECTION_TERM_COMPLETIONS, size, sizeof(uint32_t))
+             && section_valid(header, SEGMENT_SECTION_POSTINGS, size, 1)
+             && section_valid(header, SEGMENT_SECTION_POSTING_BLOCKS, size, sizeof(PostingBlock))
+             && section_valid(header, SEGMENT_SECTION_DOCS, size, sizeof(SegmentDoc))
+             && section_valid(header, SEGMENT_SECTION_DOC_BYTES, size, 1)
+             && section_valid(header, SEGMENT_SECTION_POSITIONS, size, 1)
+             && section_valid(header, SEGMENT_SECTION_POSITION_BLOCKS, size, sizeof(uint64_t))
+             && section_valid(header, SEGMENT_SECTION_DOC_LENGTHS, size, 1)
+             && (header->sections[SEGMENT_SECTION_POSITION_BLOCKS].size == 0
+                 || header->sections[SEGMENT_SECTION_POSITION_BLOCKS].size / sizeof(uint64_t)
+                    == header->sections[SEGMENT_SECTION_POSTING_BLOCKS].size / sizeof(PostingBlock))
+             && header->sections[SEGMENT_SECTION_TERMS].size == (uint64_t)header->num_terms * sizeof(SegmentTerm)
+             && header->sections[SEGMENT_SECTION_DOCS].size == (uint64_t)header->num_docs * sizeof(SegmentDoc)
+             && header->sections[SEGMENT_SECTION_DOC_LENGTHS].size == (uint64_t)header->num_docs
+             && header->sections[SEGMENT_SECTION_TERM_HASH].size / sizeof(TermSlot) > header->num_terms;
+    if (!valid) {
+        unmap_file(base, size, map_handle);
+        return NULL;
+    }
+
+    Segment *segment = (Segment*)malloc(sizeof(Segment));
+    if (!segment) {
+        unmap_file(base, size, map_handle);
+        return NULL;
+    }
+    segment->base = base;
+    segment->size = size;
+    segment->map_handle = map_handle;
+    segment->header = header;
+    segment->terms = (const SegmentTerm*)(base + header->sections[SEGMENT_SECTION_TERMS].offset);
+    segment->term_bytes = (const char*)(base + header->sections[SEGMENT_SECTION_TERM_BYTES].offset);
+    segment->term_bytes_size = (size_t)header->sections[SEGMENT_SECTION_TERM_BYTES].size;
+    segment->term_slots = (const TermSlot*)(base + header->sections[SEGMENT_SECTION_TERM_HASH].offset);
+    segment->term_slot_capacity = (uint32_t)(header->sections[SEGMENT_SECTION_TERM_HASH].size / sizeof(TermSlot));
+    trie_attach(&segment->term_trie, (const TrieState*)(base + header->sections[SEGMENT_SECTION_TERM_TRIE].offset),
+                (uint32_t)(header->sections[SEGMENT_SECTION_TERM_TRIE].size / sizeof(TrieState)));
+    if (trie_attach_completions(&segment->term_trie,
+                                (const uint32_t*)(base + header->sections[SEGMENT_SECTION_TERM_COMPLETIONS].offset),
+                                (uint32_t)(header->sections[SEGMENT_SECTION_TERM_COMPLETIONS].size / sizeof(uint32_t))) != 0) {
+        free(segment);
+        unmap_file(base, size, map_handle);
+        return NULL;
+    }
+    segment->postings = base + header->sections[SEGMENT_SECTION_POSTINGS].offset;
+    segment->postings_size = header->sections[SEGMENT_SECTION_POSTINGS].size;
+    segment->blocks = (const PostingBlock*)(base + header->sections[SEGMENT_SECTION_POSTING_BLOCKS].offset);
+    segment->num_blocks = header->sections[SEGMENT_SECTION_POSTING_BLOCKS].size / sizeof(PostingBlock);
+    segment->docs = (const SegmentDoc*)(base + header->sections[SEGMENT_SECTION_DOCS].offset);
+    segment->doc_bytes = (const char*)(base + header->sections[SEGMENT_SECTION_DOC_BYTES].offset);
+    segment->doc_bytes_size = (size_t)header->sections[SEGMENT_SECTION_DOC_BYTES].size;
+    segment->positions = base + header->sections[SEGMENT_SECTION_POSITIONS].offset;
+    segment->positions_size = header->sections[SEGMENT_SECTION_POSITIONS].size;
+    segment->position_blocks = header->sections[SEGMENT_SECTION_POSITION_BLOCKS].size > 0
+        ? (const uint64_t*)(base + header->sections[SEGMENT_SECTION_POSITION_BLOCKS].offset) : NULL;
+    segment->doc_lengths = (const uint8_t*)(base + header->sections[SEGMENT_SECTION_DOC_LENGTHS].offset);
+    segment->num_terms = (int)header->num_terms;
+    segment->num_docs = (int)header->num_docs;
+    return segment;
+}
+
+void segment_close(Segment *segment) {
+    if (!segment) return;
+    unmap_file(segment->base, segment->size, segment->map_handle);
+    free(segment);
+}
+
+// ---------------------------------------------------------------------------
+// 查询
+// ---------------------------------------------------------------------------
+
+const char* segment_term(const Segment *segment, int term_id) {
+    if (!segment || term_id < 0 || term_id >= segment->num_terms) return NULL;
+    const SegmentTerm *entry = &segment->terms[term_id];
+    if ((size_t)entry->term_offset + entry->term_len >= segment->term_bytes_size) return NULL;
+    return segment->term_bytes + entry->term_offset;
+}
+
+// 词条与key比较（词条不一定以'\0'结尾时也安全）
+static int compare_term(const Segment *segment, int term_id, const char *key, size_t key_len) {
+    const SegmentTerm *entry = &segment->terms[term_id];
+    const char *term = segment_term(segment, term_id);
+    if (!term) return -1;
+    size_t len = entry->term_len < key_len ? entry->term_len : key_len;
+    int cmp = memcmp(term, key, len);
+    if (cmp != 0) return cmp;
+    return (entry->term_len > key_len) - (entry->term_len < key_len);
+}
+
+int segment_lookup(const Segment *segment, const char *term, size_t len, TermHandle *handle) {
+    handle->term_id = -1;
+    handle->doc_count = 0;
+    handle->max_tf = 0;
+    handle->posting_offset = 0;
+    if (!segment || !term) return 0;
+
+    // 容量是2的幂，且至少有一个空槽（校验时保证槽数大于词条数），探测必然终止
+    uint32_t capacity = segment->term_slot_capacity;
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) return 0;
+    uint32_t hash = hash_term(term, len);
+    for (uint32_t i = hash & (capacity - 1), probes = 0; probes < capacity; i = (i + 1) & (capacity - 1), probes++) {
+        const TermSlot *slot = &segment->term_slots[i];
+        if (slot->term_id == 0) return 0;
+        if (slot->hash != hash || slot->term_id > (uint32_t)segment->num_terms) continue;
+        int term_id = (int)slot->term_id - 1;
+        if (compare_term(segment, term_id, term, len) == 0) {
+            segment_term_handle(segment, term_id, handle);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int segment_find_term(const Segment *segment, const char *term) {
+    TermHandle handle;
+    segment_lookup(segment, term, term ? strlen(term) : 0, &handle);
+    return handle.term_id;
+}
+
+void segment_term_handle(const Segment *segment, int term_id, TermHandle *handle) {
+    if (!segment || term_id < 0 || term_id >= segment->num_terms) {
+        handle->term_id = -1;
+        handle->doc_count = 0;
+        handle->max_tf = 0;
+        handle->posting_offset = 0;
+        return;
+    }
+    const SegmentTerm *entry = &segment->terms[term_id];
+    handle->term_id = term_id;
+    handle->doc_count = (int)entry->doc_count;
+    handle->max_tf = (int)entry->max_tf;
+    handle->posting_offset = entry->posting_offset;
+}
+
+void segment_prefix_range(const Segment *segment, const char *prefix, int *lo, int *hi) {
+    *lo = *hi = 0;
+    if (!segment || !prefix) return;
+
+    trie_prefix_range(&segment->term_trie, prefix, strlen(prefix), lo, hi);
+    // 区间来自文件，限制在词典范围内
+    if (*hi > segment->num_terms) *hi = segment->num_terms;
+    if (*lo > *hi) *lo = *hi;
+}
+
+static uint32_t segment_term_doc_count(const void *context, int term_id) {
+    const Segment *segment = (const Segment*)context;
+    return term_id >= 0 && term_id < segment->num_terms ? segment->terms[term_id].doc_count : 0;
+}
+
+int segment_suggest(const Segment *segment, const char *prefix, size_t len, int *term_ids, int max) {
+    if (!segment || !prefix) return 0;
+    int count = trie_complete(&segment->term_trie, prefix, len, segment_term_doc_count, segment, term_ids, max);
+    // 词条ID来自文件，越界的丢弃
+    int valid = 0;
+    for (int i = 0; i < count; i++) {
+        if (term_ids[i] >= 0 && term_ids[i] < segment->num_terms) term_ids[valid++] = term_ids[i];
+    }
+    return valid;
+}
+
+int segment_posting_cursor(const Segment *segment, const TermHandle *handle, PostingCursor *cursor) {
+    if (!segment || !handle || handle->term_id < 0 || handle->term_id >= segment->num_terms) return 0;
+
+    const SegmentTerm *entry = &segment->terms[handle->term_id];
+    if (handle->posting_offset > segment->postings_size
+        || entry->posting_size > segment->postings_size - handle->posting_offset
+        || entry->block_offset > segment->num_blocks
+        || entry->num_blocks > segment->num_blocks - entry->block_offset) {
+        return 0;
+    }
+    posting_cursor_init(cursor, segment->postings + handle->posting_offset, entry->posting_size,
+                        segment->blocks + entry->block_offset, (int)entry->num_blocks);
+    return 1;
+}
+
+int segment_has_positions(const Segment *segment) {
+    return segment && segment->position_blocks != NULL;
+}
+
+int segment_position_cursor(const Segment *segment, const TermHandle *handle, PostingCursor *cursor) {
+    if (!segment_has_positions(segment) || !segment_posting_cursor(segment, handle, cursor)) return 0;
+    const SegmentTerm *entry = &segment->terms[handle->term_id];
+    posting_cursor_attach_positions(cursor, segment->positions, segment->positions_size,
+                                    segment->position_blocks + entry->block_offset);
+    return 1;
+}
+
+const char* segment_doc_path(const Segment *segment, int doc_id) {
+    if (!segment || doc_id < 0 || doc_id >= segment->num_docs) return NULL;
+    const SegmentDoc *doc = &segment->docs[doc_id];
+    if (doc->path_offset + doc->path_len >= segment->doc_bytes_size) return NULL;
+    return segment->doc_bytes + doc->path_offset;
+}
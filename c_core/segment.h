@@ -0,0 +1,155 @@
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "inverted_index.h"
+#include "postings.h"
+#include "trie.h"
+
+// 段文件（index.seg）：版本化、按页对齐的只读索引文件，可直接mmap后查询
+// 布局：[文件头][词典][词条字符串池][词条哈希表][词条双数组Trie][前缀补全表][压缩postings][postings跳表头][文档表][文档路径字符串池]
+//       [位置][位置块偏移]（位置区块可为空：此时段不支持短语匹配，查询退化为要求短语中的词同时出现）[文档长度]
+// 每个区块都从页边界开始；所有整数按本机字节序（小端）存储
+#define SEGMENT_MAGIC 0x47455344u // "DSEG"
+#define SEGMENT_VERSION 8
+#define SEGMENT_PAGE_SIZE 4096
+#define SEGMENT_MAX_SECTIONS 16
+
+// 区块类型（文件头中sections数组的下标）
+typedef enum SegmentSectionType {
+    SEGMENT_SECTION_TERMS = 0,   // 词典：按字典序排列的SegmentTerm数组
+    SEGMENT_SECTION_TERM_BYTES,  // 词条字符串池（每个词条以'\0'结尾）
+    SEGMENT_SECTION_TERM_HASH,   // 词条哈希表：TermSlot数组（线性探测，容量为2的幂），用于精确查找
+    SEGMENT_SECTION_TERM_TRIE,   // 词条双数组Trie：TrieState数组（格式见trie.h），用于前缀查询
+    SEGMENT_SECTION_TERM_COMPLETIONS, // 前缀补全表：uint32数组（格式见trie_build_completions），按文档频率预选每个前缀的最佳补全
+    SEGMENT_SECTION_POSTINGS,    // 所有词条的分块压缩postings字节（格式见postings.h），按词条连续存放
+    SEGMENT_SECTION_POSTING_BLOCKS, // 所有词条的PostingBlock跳表头，按词条连续存放
+    SEGMENT_SECTION_DOCS,        // 文档表：SegmentDoc数组，下标即文档ID
+    SEGMENT_SECTION_DOC_BYTES,   // 文档路径字符串池（每个路径以'\0'结尾）
+    SEGMENT_SECTION_POSITIONS,   // 所有词条的位置字节流（格式见postings.h），按词条连续存放
+    SEGMENT_SECTION_POSITION_BLOCKS, // uint64数组，与POSTING_BLOCKS一一对应：该块位置数据在位置区块中的偏移
+    SEGMENT_SECTION_DOC_LENGTHS, // 每个文档一个字节：文档长度（索引词条数，即各词词频之和）的量化值，见segment_encode_doc_length
+    SEGMENT_SECTION_COUNT
+} SegmentSectionType;
+
+typedef struct SegmentSection {
+    uint64_t offset; // 相对文件起始的偏移（页对齐）
+    uint64_t size;   // 字节数
+} SegmentSection;
+
+typedef struct SegmentHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t num_sections;
+    uint32_t num_docs;
+    uint32_t num_terms;
+    uint64_t file_size;
+    SegmentSection sections[SEGMENT_MAX_SECTIONS];
+} SegmentHeader;
+
+typedef struct SegmentTerm {
+    uint64_t posting_offset; // 在压缩postings区块中的字节偏移
+    uint32_t posting_size;   // 压缩postings的字节数
+    uint32_t block_offset;   // 在跳表头数组中的起始下标
+    uint32_t num_blocks;
+    uint32_t term_offset;    // 在词条字符串池中的偏移
+    uint32_t term_len;
+    uint32_t doc_count;      // 包含该词的文档数（即postings个数）
+    uint32_t max_tf;         // 该词在所有文档中的最大词频（用于计算词条级分数上界）
+} SegmentTerm;
+
+typedef struct SegmentDoc {
+    uint64_t path_offset; // 在文档路径字符串池中的偏移
+    uint32_t path_len;
+    uint32_t reserved;
+} SegmentDoc;
+
+// 词条句柄：查一次词典得到，之后在整个查询流程中复用，不再重复查找
+typedef struct TermHandle {
+    int term_id;             // 词条ID（词典下标），-1表示不存在
+    int doc_count;           // 文档频率df
+    int max_tf;              // 最大词频（分数上界 = calculate_tfidf(max_tf, df, N)）
+    uint64_t posting_offset; // 压缩postings在postings区块中的字节偏移
+} TermHandle;
+
+// 已映射到内存的段（所有指针都指向映射区域，只读）
+typedef struct Segment {
+    const unsigned char *base;
+    size_t size;
+    const SegmentHeader *header;
+    const SegmentTerm *terms;
+    const char *term_bytes;
+    size_t term_bytes_size;
+    const TermSlot *term_slots;
+    uint32_t term_slot_capacity;
+    Trie term_trie;          // 状态数组与补全表指向映射区域
+    const unsigned char *postings;
+    uint64_t postings_size;
+    const PostingBlock *blocks;
+    uint64_t num_blocks;
+    const SegmentDoc *docs;
+    const char *doc_bytes;
+    size_t doc_bytes_size;
+    const unsigned char *positions; // 没有位置时position_blocks为NULL
+    uint64_t positions_size;
+    const uint64_t *position_blocks;
+    const uint8_t *doc_lengths; // 量化的文档长度，下标即文档ID
+    int num_terms;
+    int num_docs;
+    void *map_handle; // Windows下的文件映射句柄（其他平台不使用）
+} Segment;
+
+// 将倒排索引与文档路径写成段文件（先写临时文件再替换），成功返回0
+int segment_write(InvertedIndex *index, char **doc_paths, int num_docs, const char *filename);
+
+// 存活文档位图：第doc_id位为1表示文档未被删除；位图为NULL表示全部存活
+#define DOC_IS_LIVE(live_docs, doc_id) \
+    (!(live_docs) || (((live_docs)[(doc_id) >> 6] >> ((doc_id) & 63)) & 1))
+
+// 把段中存活文档的postings追加到index，用于合并多个段（同时回收已删除文档的postings）：
+// 存活文档按原顺序重新编号为doc_base, doc_base+1, ...，只出现在已删除文档中的词条不会加入index。
+// with_positions非0时一并复制位置（段必须有位置，且参与合并的段都要复制位置）。
+// index中已有的文档ID必须都小于doc_base。成功返回追加的文档数，失败返回-1
+int segment_append_to_index(const Segment *segment, const uint64_t *live_docs, InvertedIndex *index, int doc_base,
+                            int with_positions);
+
+// 映射段文件并校验文件头，失败返回NULL
+Segment* segment_open(const char *filename);
+void segment_close(Segment *segment);
+
+// 精确查找词条（哈希表），找到返回1并填充句柄，否则返回0且handle->term_id为-1
+int segment_lookup(const Segment *segment, const char *term, size_t len, TermHandle *handle);
+
+// 精确查找词条，返回词条ID（词典下标），不存在返回-1
+int segment_find_term(const Segment *segment, const char *term);
+
+// 由词条ID（如前缀区间中的ID）得到句柄
+void segment_term_handle(const Segment *segment, int term_id, TermHandle *handle);
+
+// 获取以prefix开头的所有词条的ID区间[*lo, *hi)（词典按字典序排列，前缀匹配是连续区间）
+// 沿Trie逐字节转移，区间直接记录在到达的状态上
+void segment_prefix_range(const Segment *segment, const char *prefix, int *lo, int *hi);
+
+// 前缀建议：以prefix开头、文档频率最高的至多max个词条ID写入term_ids（df降序，同df按字典序），返回个数
+// max不超过TRIE_COMPLETION_SLOTS时只需沿Trie走到前缀对应的状态，复制构建时预选的结果
+int segment_suggest(const Segment *segment, const char *prefix, size_t len, int *term_ids, int max);
+
+// 访问词条、postings与文档路径（均直接指向映射区域）
+const char* segment_term(const Segment *segment, int term_id);
+// 在句柄对应的压缩postings上初始化游标，词条不存在或数据越界返回0
+int segment_posting_cursor(const Segment *segment, const TermHandle *handle, PostingCursor *cursor);
+// 段是否记录了位置（由文档构建的段都有位置；由旧格式转换的段没有）
+int segment_has_positions(const Segment *segment);
+// 同segment_posting_cursor，并接上位置（posting_cursor_positions可用），段没有位置返回0
+int segment_position_cursor(const Segment *segment, const TermHandle *handle, PostingCursor *cursor);
+const char* segment_doc_path(const Segment *segment, int doc_id);
+
+// 文档长度的单字节量化：0~23原样保存，更长的长度保留4个有效二进制位（向下取整，相对误差小于1/8）。
+// 编码保序，解码值随编码单调递增；BM25按编码查表得到长度归一化因子
+uint8_t segment_encode_doc_length(uint32_t length);
+uint32_t segment_decode_doc_length(uint8_t code);
+
+#endif
@@ -0,0 +1,1332 @@
+#include "segment_set.h"
+#include "thread.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#define MANIFEST_LOCK_TIMEOUT_MS 30000 // 超过该时间仍拿不到锁，视为持锁进程已异常退出
+#define SEGMENT_SET_OPEN_RETRIES 3     // 打开期间段被并发合并删除时，重新读取清单的次数
+
+static void join_path(char *out, size_t size, const char *index_dir, const char *name) {
+    snprintf(out, size, "%s/%s", index_dir, name);
+}
+
+// ---------------------------------------------------------------------------
+// 清单
+// ---------------------------------------------------------------------------
+
+int manifest_read(const char *index_dir, Manifest *manifest) {
+    memset(manifest, 0, sizeof(*manifest));
+    manifest->next_segment = 1;
+
+    char path[1024];
+    join_path(path, sizeof(path), index_dir, MANIFEST_FILE_NAME);
+    FILE *file = fopen(path, "r");
+    if (!file) return 1;
+
+    char magic[32];
+    int version, count;
+    unsigned long long generation, next_segment;
+    int valid = fscanf(file, "%31s %d", magic, &version) == 2
+             && strcmp(magic, MANIFEST_MAGIC) == 0 && version >= 1 && version <= MANIFEST_VERSION
+             && fscanf(file, " generation %llu", &generation) == 1
+             && fscanf(file, " next_segment %llu", &next_segment) == 1
+             && fscanf(file, " segments %d", &count) == 1
+             && count >= 0;
+    if (valid && count > 0) {
+        manifest->entries = (ManifestEntry*)malloc(count * sizeof(ManifestEntry));
+        valid = manifest->entries != NULL;
+        for (int i = 0; valid && i < count; i++) {
+            ManifestEntry *entry = &manifest->entries[i];
+            valid = fscanf(file, " %63s %d", entry->name, &entry->num_docs) == 2 && entry->num_docs >= 0;
+            entry->num_deleted = 0;
+            entry->deletions[0] = '\0';
+            if (valid && version >= 2) {
+                valid = fscanf(file, " %d %63s", &entry->num_deleted, entry->deletions) == 2
+                     && entry->num_deleted >= 0 && entry->num_deleted <= entry->num_docs;
+                if (strcmp(entry->deletions, "-") == 0) entry->deletions[0] = '\0';
+            }
+        }
+    }
+    fclose(file);
+    if (!valid) {
+        manifest_free(manifest);
+        return -1;
+    }
+    manifest->generation = generation;
+    manifest->next_segment = next_segment;
+    manifest->num_entries = count;
+    return 0;
+}
+
+void manifest_free(Manifest *manifest) {
+    free(manifest->entries);
+    manifest->entries = NULL;
+    manifest->num_entries = 0;
+}
+
+// 先写临时文件再替换（Windows下rename不能覆盖已有文件）
+static int manifest_write(const char *index_dir, const Manifest *manifest) {
+    char path[1024], tmp_path[1024];
+    join_path(path, sizeof(path), index_dir, MANIFEST_FILE_NAME);
+    join_path(tmp_path, sizeof(tmp_path), index_dir, MANIFEST_FILE_NAME ".tmp");
+    FILE *file = fopen(tmp_path, "w");
+    if (!file) return -1;
+
+    fprintf(file, "%s %d\n", MANIFEST_MAGIC, MANIFEST_VERSION);
+    fprintf(file, "generation %llu\n", (unsigned long long)manifest->generation);
+    fprintf(file, "next_segment %llu\n", (unsigned long long)manifest->next_segment);
+    fprintf(file, "segments %d\n", manifest->num_entries);
+    for (int i = 0; i < manifest->num_entries; i++) {
+        const ManifestEntry *entry = &manifest->entries[i];
+        fprintf(file, "%s %d %d %s\n", entry->name, entry->num_docs, entry->num_deleted,
+                entry->deletions[0] ? entry->deletions : "-");
+    }
+    int failed = ferror(file);
+    if (fclose(file) != 0) failed = 1;
+    if (failed) {
+        remove(tmp_path);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+// 读取清单；没有清单但有旧的单段索引index.seg时，把它作为唯一的段纳入清单
+static int manifest_load(const char *index_dir, Manifest *manifest) {
+    int status = manifest_read(index_dir, manifest);
+    if (status != 1) return status;
+
+    char path[1024];
+    join_path(path, sizeof(path), index_dir, LEGACY_SEGMENT_NAME);
+    Segment *legacy = segment_open(path);
+    if (!legacy) return 0;
+    manifest->entries = (ManifestEntry*)malloc(sizeof(ManifestEntry));
+    if (!manifest->entries) {
+        segment_close(legacy);
+        return -1;
+    }
+    memset(manifest->entries, 0, sizeof(ManifestEntry));
+    snprintf(manifest->entries[0].name, SEGMENT_NAME_SIZE, "%s", LEGACY_SEGMENT_NAME);
+    manifest->entries[0].num_docs = legacy->num_docs;
+    manifest->num_entries = 1;
+    segment_close(legacy);
+    return 0;
+}
+
+// 清单锁：以独占方式创建锁文件，只在读取-修改-替换清单的短时间内持有
+static int manifest_lock(const char *index_dir) {
+    char path[1024];
+    join_path(path, sizeof(path), index_dir, MANIFEST_LOCK_NAME);
+    for (int waited = 0; ; waited += 10) {
+#ifdef _WIN32
+        int fd = _open(path, _O_CREAT | _O_EXCL | _O_WRONLY, _S_IREAD | _S_IWRITE);
+#else
+        int fd = open(path, O_CREAT | O_EXCL | O_WRONLY, 0644);
+#endif
+        if (fd >= 0) {
+#ifdef _WIN32
+            _close(fd);
+#else
+            close(fd);
+#endif
+            return 0;
+        }
+        if (errno != EEXIST) return -1; // 目录不存在（如分片已被全量重建删除）等无法重试的错误
+        if (waited >= MANIFEST_LOCK_TIMEOUT_MS) {
+            // 持锁进程已异常退出：清除遗留的锁文件后重试
+            remove(path);
+            waited = 0;
+            continue;
+        }
+        thread_sleep_ms(10);
+    }
+}
+
+static void manifest_unlock(const char *index_dir) {
+    char path[1024];
+    join_path(path, sizeof(path), index_dir, MANIFEST_LOCK_NAME);
+    remove(path);
+}
+
+// 构建中的段先写到唯一的临时文件名，拿到清单锁后再改名为正式的段文件名
+static void pending_segment_name(char *name, size_t size) {
+    static int counter = 0;
+#ifdef _WIN32
+    int pid = _getpid();
+#else
+    int pid = (int)getpid();
+#endif
+    snprintf(name, size, "pending_%d_%lu_%d.seg", pid, (unsigned long)time(NULL), counter++);
+}
+
+// 在持有清单锁时把临时段改名为下一个段文件名，写入entry
+static int commit_segment(const char *index_dir, Manifest *manifest, const char *pending, int num_docs,
+                          ManifestEntry *entry) {
+    char from[1024], to[1024];
+    snprintf(entry->name, SEGMENT_NAME_SIZE, "seg_%06llu.seg", (unsigned long long)manifest->next_segment++);
+    entry->num_docs = num_docs;
+    entry->num_deleted = 0;
+    entry->deletions[0] = '\0';
+    join_path(from, sizeof(from), index_dir, pending);
+    join_path(to, sizeof(to), index_dir, entry->name);
+#ifdef _WIN32
+    remove(to);
+#endif
+    return rename(from, to) == 0 ? 0 : -1;
+}
+
+static void remove_segment_file(const char *index_dir, const char *name) {
+    char path[1024];
+    join_path(path, sizeof(path), index_dir, name);
+    remove(path); // Windows下仍被其他进程映射的段删除失败，留待下次全量重建覆盖
+}
+
+// 删除段文件及其删除标记文件
+static void remove_entry_files(const char *index_dir, const ManifestEntry *entry) {
+    remove_segment_file(index_dir, entry->name);
+    if (entry->deletions[0]) remove_segment_file(index_dir, entry->deletions);
+}
+
+// ---------------------------------------------------------------------------
+// 分片清单
+// ---------------------------------------------------------------------------
+
+typedef struct ShardList {
+    uint64_t generation;
+    int num_shards;
+    char (*dirs)[SEGMENT_NAME_SIZE]; // 分片目录名（相对索引目录）
+} ShardList;
+
+static void shards_free(ShardList *shards) {
+    free(shards->dirs);
+    shards->dirs = NULL;
+    shards->num_shards = 0;
+}
+
+// 读取分片清单：成功返回0；不存在返回1（不分片的索引）；格式错误返回-1
+static int shards_read(const char *index_dir, ShardList *shards) {
+    memset(shards, 0, sizeof(*shards));
+    char path[1024];
+    join_path(path, sizeof(path), index_dir, SHARDS_FILE_NAME);
+    FILE *file = fopen(path, "r");
+    if (!file) return 1;
+
+    char magic[32];
+    int version, count;
+    unsigned long long generation;
+    int valid = fscanf(file, "%31s %d", magic, &version) == 2
+             && strcmp(magic, SHARDS_MAGIC) == 0 && version == SHARDS_VERSION
+             && fscanf(file, " generation %llu", &generation) == 1
+             && fscanf(file, " shards %d", &count) == 1
+             && count >= 2 && count <= MAX_SHARDS;
+    if (valid) {
+        shards->dirs = (char (*)[SEGMENT_NAME_SIZE])malloc(count * SEGMENT_NAME_SIZE);
+        valid = shards->dirs != NULL;
+        for (int i = 0; valid && i < count; i++) valid = fscanf(file, " %63s", shards->dirs[i]) == 1;
+    }
+    fclose(file);
+    if (!valid) {
+        shards_free(shards);
+        return -1;
+    }
+    shards->generation = generation;
+    shards->num_shards = count;
+    return 0;
+}
+
+// 与清单相同，先写临时文件再替换
+static int shards_write(const char *index_dir, const ShardList *shards) {
+    char path[1024], tmp_path[1024];
+    join_path(path, sizeof(path), index_dir, SHARDS_FILE_NAME);
+    join_path(tmp_path, sizeof(tmp_path), index_dir, SHARDS_FILE_NAME ".tmp");
+    FILE *file = fopen(tmp_path, "w");
+    if (!file) return -1;
+
+    fprintf(file, "%s %d\n", SHARDS_MAGIC, SHARDS_VERSION);
+    fprintf(file, "generation %llu\n", (unsigned long long)shards->generation);
+    fprintf(file, "shards %d\n", shards->num_shards);
+    for (int i = 0; i < shards->num_shards; i++) fprintf(file, "%s\n", shards->dirs[i]);
+    int failed = ferror(file);
+    if (fclose(file) != 0) failed = 1;
+    if (failed) {
+        remove(tmp_path);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+static int make_dir(const char *path) {
+#ifdef _WIN32
+    return _mkdir(path);
+#else
+    return mkdir(path, 0755);
+#endif
+}
+
+// 删除一个索引目录：清单中的段与删除标记、清单本身，最后删除（已为空的）目录
+static void remove_index_dir(const char *dir) {
+    Manifest manifest;
+    if (manifest_read(dir, &manifest) == 0) {
+        for (int i = 0; i < manifest.num_entries; i++) remove_entry_files(dir, &manifest.entries[i]);
+        manifest_free(&manifest);
+    }
+    remove_segment_file(dir, MANIFEST_FILE_NAME);
+#ifdef _WIN32
+    _rmdir(dir);
+#else
+    rmdir(dir);
+#endif
+}
+
+static void remove_shard_dirs(const char *index_dir, const ShardList *shards) {
+    for (int i = 0; i < shards->num_shards; i++) {
+        char path[1024];
+        join_path(path, sizeof(path), index_dir, shards->dirs[i]);
+        remove_index_dir(path);
+    }
+}
+
+int segment_set_shard_count(const char *index_dir) {
+    if (!index_dir) return -1;
+    ShardList shards;
+    int status = shards_read(index_dir, &shards);
+    if (status != 0) return status == 1 ? 1 : -1;
+    int count = shards.num_shards;
+    shards_free(&shards);
+    return count;
+}
+
+// ---------------------------------------------------------------------------
+// 删除标记
+// ---------------------------------------------------------------------------
+
+typedef struct DeletionsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_docs;
+    uint32_t num_deleted;
+    uint32_t num_term_counts;
+} DeletionsHeader;
+
+#define LIVE_DOCS_WORDS(num_docs) (((num_docs) + 63) / 64)
+
+static void deletions_free(SegmentDeletions *deletions) {
+    if (!deletions) return;
+    free(deletions->buffer);
+    free(deletions);
+}
+
+// 读入删除标记文件并校验与段的文档数一致，失败返回NULL
+static SegmentDeletions* deletions_load(const char *index_dir, const char *name, int num_docs) {
+    char path[1024];
+    join_path(path, sizeof(path), index_dir, name);
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+    DeletionsHeader header;
+    SegmentDeletions *deletions = NULL;
+    if (fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, DELETIONS_MAGIC, sizeof(DELETIONS_MAGIC)) == 0
+        && header.version == DELETIONS_VERSION && header.num_docs == (uint32_t)num_docs
+        && header.num_deleted <= header.num_docs) {
+        size_t words = LIVE_DOCS_WORDS(header.num_docs);
+        size_t size = words * sizeof(uint64_t) + (size_t)header.num_term_counts * 2 * sizeof(uint32_t);
+        deletions = (SegmentDeletions*)malloc(sizeof(SegmentDeletions));
+        void *buffer = malloc(size > 0 ? size : 1);
+        if (deletions && buffer && fread(buffer, 1, size, file) == size) {
+            deletions->buffer = buffer;
+            deletions->live_docs = (const uint64_t*)buffer;
+            deletions->term_counts = (const uint32_t*)((const uint64_t*)buffer + words);
+            deletions->num_term_counts = (int)header.num_term_counts;
+            deletions->num_deleted = (int)header.num_deleted;
+        } else {
+            free(buffer);
+            free(deletions);
+            deletions = NULL;
+        }
+    }
+    fclose(file);
+    return deletions;
+}
+
+// 写删除标记文件：逐词条扫描一遍段的postings，统计每个词条落在已删除文档中的postings数。成功返回0
+static int deletions_write(const char *index_dir, const char *name, const Segment *segment,
+                           const uint64_t *live_docs, int num_deleted) {
+    uint32_t *term_counts = NULL;
+    int num_term_counts = 0, capacity = 0;
+    for (int term_id = 0; term_id < segment->num_terms; term_id++) {
+        TermHandle handle;
+        PostingCursor cursor;
+        segment_term_handle(segment, term_id, &handle);
+        if (!segment_posting_cursor(segment, &handle, &cursor)) continue;
+        uint32_t deleted = 0;
+        while (posting_cursor_next(&cursor)) {
+            if (!DOC_IS_LIVE(live_docs, cursor.doc_id)) deleted++;
+        }
+        if (deleted == 0) continue;
+        if (num_term_counts == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            uint32_t *grown = (uint32_t*)realloc(term_counts, (size_t)capacity * 2 * sizeof(uint32_t));
+            if (!grown) {
+                free(term_counts);
+                return -1;
+            }
+            term_counts = grown;
+        }
+        term_counts[2 * num_term_counts] = (uint32_t)term_id;
+        term_counts[2 * num_term_counts + 1] = deleted;
+        num_term_counts++;
+    }
+
+    DeletionsHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DELETIONS_MAGIC, sizeof(DELETIONS_MAGIC));
+    header.version = DELETIONS_VERSION;
+    header.num_docs = (uint32_t)segment->num_docs;
+    header.num_deleted = (uint32_t)num_deleted;
+    header.num_term_counts = (uint32_t)num_term_counts;
+
+    char path[1024];
+    join_path(path, sizeof(path), index_dir, name);
+    FILE *file = fopen(path, "wb");
+    int failed = !file;
+    if (file) {
+        size_t words = LIVE_DOCS_WORDS(segment->num_docs);
+        failed = fwrite(&header, sizeof(header), 1, file) != 1
+              || fwrite(live_docs, sizeof(uint64_t), words, file) != words
+              || (num_term_counts > 0
+                  && fwrite(term_counts, 2 * sizeof(uint32_t), num_term_counts, file) != (size_t)num_term_counts);
+        if (fclose(file) != 0) failed = 1;
+        if (failed) remove(path);
+    }
+    free(term_counts);
+    return failed ? -1 : 0;
+}
+
+static int compare_path_ptrs(const void *a, const void *b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// 持锁时为entries中包含sorted_paths（已排序）的段写新的删除标记文件，并更新这些条目的删除信息。
+// 返回新删除的文档数；失败返回-1，已写出的新删除标记文件由调用者按条目差异清理
+static int apply_deletions(const char *index_dir, Manifest *manifest, ManifestEntry *entries, int num_entries,
+                           char **sorted_paths, int num_paths) {
+    int total_deleted = 0;
+    for (int i = 0; i < num_entries; i++) {
+        ManifestEntry *entry = &entries[i];
+        if (entry->num_deleted >= entry->num_docs) continue;
+        char path[1024];
+        join_path(path, sizeof(path), index_dir, entry->name);
+        Segment *segment = segment_open(path);
+        if (!segment) return -1;
+
+        size_t words = LIVE_DOCS_WORDS(segment->num_docs);
+        uint64_t *live_docs = (uint64_t*)malloc((words > 0 ? words : 1) * sizeof(uint64_t));
+        SegmentDeletions *old = entry->deletions[0]
+            ? deletions_load(index_dir, entry->deletions, segment->num_docs) : NULL;
+        if (!live_docs || (entry->deletions[0] && !old)) {
+            free(live_docs);
+            segment_close(segment);
+            return -1;
+        }
+        if (old) {
+            memcpy(live_docs, old->live_docs, words * sizeof(uint64_t));
+        } else {
+            memset(live_docs, 0xff, words * sizeof(uint64_t));
+        }
+        deletions_free(old);
+
+        int deleted = 0;
+        for (int d = 0; d < segment->num_docs; d++) {
+            if (!DOC_IS_LIVE(live_docs, d)) continue;
+            const char *doc_path = segment_doc_path(segment, d);
+            if (doc_path && bsearch(&doc_path, sorted_paths, num_paths, sizeof(char*), compare_path_ptrs)) {
+                live_docs[d >> 6] &= ~(1ULL << (d & 63));
+                deleted++;
+            }
+        }
+        int status = 0;
+        if (deleted > 0) {
+            char name[SEGMENT_NAME_SIZE];
+            snprintf(name, sizeof(name), "del_%06llu.del", (unsigned long long)manifest->next_segment++);
+            status = deletions_write(index_dir, name, segment, live_docs, entry->num_deleted + deleted);
+            if (status == 0) {
+                entry->num_deleted += deleted;
+                snprintf(entry->deletions, SEGMENT_NAME_SIZE, "%s", name);
+                total_deleted += deleted;
+            }
+        }
+        free(live_docs);
+        segment_close(segment);
+        if (status != 0) return -1;
+    }
+    return total_deleted;
+}
+
+// 删除标记发生变化的条目：成功时清理旧的删除标记文件，失败时清理新写出的
+static void remove_replaced_deletions(const char *index_dir, const ManifestEntry *from, const ManifestEntry *to,
+                                      int count) {
+    for (int i = 0; i < count; i++) {
+        if (from[i].deletions[0] && strcmp(from[i].deletions, to[i].deletions) != 0) {
+            remove_segment_file(index_dir, from[i].deletions);
+        }
+    }
+}
+
+// 写段文件并提交到清单：replace非0时清单只保留新段，否则先按delete_paths标记删除再把新段追加到末尾。
+// index为NULL时只删除。返回删除的文档数，失败返回-1
+static int write_and_commit(const char *index_dir, char **delete_paths, int num_delete,
+                            InvertedIndex *index, char **doc_paths, int num_docs, int replace) {
+    char pending[SEGMENT_NAME_SIZE], pending_path[1024];
+    int has_segment = index != NULL;
+    pending_segment_name(pending, sizeof(pending));
+    join_path(pending_path, sizeof(pending_path), index_dir, pending);
+    if (has_segment && segment_write(index, doc_paths, num_docs, pending_path) != 0) return -1;
+
+    // 待删除的路径排序后二分查找
+    char **sorted_paths = NULL;
+    if (num_delete > 0) {
+        sorted_paths = (char**)malloc(num_delete * sizeof(char*));
+        if (!sorted_paths) {
+            if (has_segment) remove(pending_path);
+            return -1;
+        }
+        memcpy(sorted_paths, delete_paths, num_delete * sizeof(char*));
+        qsort(sorted_paths, num_delete, sizeof(char*), compare_path_ptrs);
+    }
+
+    if (manifest_lock(index_dir) != 0) {
+        free(sorted_paths);
+        if (has_segment) remove(pending_path);
+        return -1;
+    }
+    Manifest manifest;
+    if (manifest_load(index_dir, &manifest) < 0) {
+        manifest_unlock(index_dir);
+        free(sorted_paths);
+        if (has_segment) remove(pending_path);
+        return -1;
+    }
+
+    ManifestEntry *entries = (ManifestEntry*)malloc((manifest.num_entries + 1) * sizeof(ManifestEntry));
+    int deleted = 0;
+    int status = entries ? 0 : -1;
+    Manifest updated = manifest;
+    updated.entries = entries;
+    updated.num_entries = 0;
+    if (status == 0 && !replace) {
+        if (manifest.num_entries > 0) {
+            memcpy(entries, manifest.entries, manifest.num_entries * sizeof(ManifestEntry));
+        }
+        updated.num_entries = manifest.num_entries;
+        if (num_delete > 0) {
+            deleted = apply_deletions(index_dir, &updated, entries, updated.num_entries, sorted_paths, num_delete);
+            if (deleted < 0) status = -1;
+        }
+    }
+    ManifestEntry entry;
+    int committed = 0;
+    if (status == 0 && has_segment) {
+        status = commit_segment(index_dir, &updated, pending, num_docs, &entry);
+        if (status == 0) {
+            entries[updated.num_entries++] = entry;
+            committed = 1;
+        }
+    }
+    if (status == 0) {
+        updated.generation = manifest.generation + 1;
+        status = manifest_write(index_dir, &updated);
+    }
+    manifest_unlock(index_dir);
+
+    if (status == 0 && replace) {
+        for (int i = 0; i < manifest.num_entries; i++) remove_entry_files(index_dir, &manifest.entries[i]);
+    } else if (status == 0 && entries) {
+        remove_replaced_deletions(index_dir, manifest.entries, entries, manifest.num_entries);
+    } else {
+        if (entries && !replace) remove_replaced_deletions(index_dir, entries, manifest.entries, manifest.num_entries);
+        if (committed) remove_segment_file(index_dir, entry.name);
+        else if (has_segment) remove(pending_path);
+    }
+    free(entries);
+    free(sorted_paths);
+    manifest_free(&manifest);
+    return status == 0 ? deleted : -1;
+}
+
+int segment_set_replace(const char *index_dir, InvertedIndex *index, char **doc_paths, int num_docs) {
+    if (!index_dir || !index) return -1;
+    if (write_and_commit(index_dir, NULL, 0, index, doc_paths, num_docs, 1) < 0) return -1;
+    save_index_stop_words(index_dir); // 查询时按构建时的停用词表区分停用词与索引中没有的词
+
+    // 原来是分片索引：删除分片清单后读者改为打开根目录的清单，再删除各分片
+    ShardList shards;
+    if (shards_read(index_dir, &shards) != 0 || manifest_lock(index_dir) != 0) return 0;
+    remove_segment_file(index_dir, SHARDS_FILE_NAME);
+    manifest_unlock(index_dir);
+    remove_shard_dirs(index_dir, &shards);
+    shards_free(&shards);
+    return 0;
+}
+
+int segment_set_replace_sharded(const char *index_dir, int num_shards, ShardBuildFunc build, void *context) {
+    if (!index_dir || !build || num_shards < 2 || num_shards > MAX_SHARDS) return -1;
+    ShardList old;
+    int old_status = shards_read(index_dir, &old);
+    if (old_status < 0) return -1;
+
+    // 分片清单与根目录清单共用一个递增的generation（根目录清单在分片期间保留为空清单），
+    // 在分片与不分片之间反复重建时generation也不会回到读者见过的值。
+    // 新分片目录名带上本次重建的generation，与正在被读取的旧分片互不干扰
+    Manifest manifest;
+    uint64_t generation = old_status == 0 ? old.generation : 0;
+    if (manifest_read(index_dir, &manifest) == 0) {
+        if (manifest.generation > generation) generation = manifest.generation;
+        manifest_free(&manifest);
+    }
+    ShardList updated;
+    updated.generation = generation + 1;
+    updated.num_shards = 0;
+    updated.dirs = (char (*)[SEGMENT_NAME_SIZE])malloc(num_shards * SEGMENT_NAME_SIZE);
+    int status = updated.dirs ? 0 : -1;
+    for (int i = 0; i < num_shards && status == 0; i++) {
+        char path[1024];
+        snprintf(updated.dirs[i], SEGMENT_NAME_SIZE, "shard_%llu_%03d", (unsigned long long)updated.generation, i);
+        join_path(path, sizeof(path), index_dir, updated.dirs[i]);
+        remove_index_dir(path); // 之前中断的重建留下的同名目录
+        if (make_dir(path) != 0) {
+            status = -1;
+            break;
+        }
+        updated.num_shards++;
+        status = build(i, num_shards, path, context) == 0 ? 0 : -1;
+    }
+
+    // 替换分片清单，再把根目录的清单清空（读者先看到分片清单，之后不再读取根目录的段）
+    int has_manifest = 0;
+    if (status == 0 && manifest_lock(index_dir) != 0) status = -1;
+    if (status == 0) {
+        has_manifest = manifest_read(index_dir, &manifest) == 0;
+        if (has_manifest && manifest.generation >= updated.generation) updated.generation = manifest.generation + 1;
+        status = shards_write(index_dir, &updated);
+        if (status == 0) {
+            Manifest emptied = { updated.generation, has_manifest ? manifest.next_segment : 1, NULL, 0 };
+            manifest_write(index_dir, &emptied);
+        }
+        manifest_unlock(index_dir);
+    }
+
+    if (status == 0 && has_manifest) {
+        for (int i = 0; i < manifest.num_entries; i++) remove_entry_files(index_dir, &manifest.entries[i]);
+    }
+    if (status == 0) {
+        save_index_stop_words(index_dir);
+        if (old_status == 0) remove_shard_dirs(index_dir, &old);
+    } else if (updated.dirs) {
+        remove_shard_dirs(index_dir, &updated);
+    }
+    if (has_manifest) manifest_free(&manifest);
+    if (old_status == 0) shards_free(&old);
+    shards_free(&updated);
+    return status;
+}
+
+int segment_set_append(const char *index_dir, InvertedIndex *index, char **doc_paths, int num_docs) {
+    if (!index_dir || !index || num_docs <= 0) return -1;
+    return segment_set_update(index_dir, NULL, 0, index, doc_paths, num_docs) < 0 ? -1 : 0;
+}
+
+int segment_set_delete(const char *index_dir, char **paths, int num_paths) {
+    return segment_set_update(index_dir, paths, num_paths, NULL, NULL, 0);
+}
+
+int segment_set_update(const char *index_dir, char **delete_paths, int num_delete,
+                       InvertedIndex *index, char **doc_paths, int num_docs) {
+    if (!index_dir || num_delete < 0 || (num_delete > 0 && !delete_paths)) return -1;
+    if (index && num_docs <= 0) index = NULL; // 没有新文档时只删除
+    if (num_delete == 0 && !index) return 0;
+    ShardList shards;
+    int status = shards_read(index_dir, &shards);
+    if (status < 0) return -1;
+    if (status == 1) return write_and_commit(index_dir, delete_paths, num_delete, index, doc_paths, num_docs, 0);
+
+    // 分片索引：路径只会出现在一个分片中，其余分片先删除，最后一个分片同时删除并追加新段
+    int deleted = 0;
+    for (int i = 0; i < shards.num_shards && deleted >= 0; i++) {
+        char path[1024];
+        join_path(path, sizeof(path), index_dir, shards.dirs[i]);
+        int last = i == shards.num_shards - 1;
+        if (!last && num_delete == 0) continue;
+        int count = write_and_commit(path, delete_paths, num_delete, last ? index : NULL, doc_paths, num_docs, 0);
+        deleted = count < 0 ? -1 : deleted + count;
+    }
+    shards_free(&shards);
+    return deleted;
+}
+
+// ---------------------------------------------------------------------------
+// 打开与查询
+// ---------------------------------------------------------------------------
+
+static SegmentSet* open_manifest_segments(const char *index_dir, const Manifest *manifest) {
+    SegmentSet *set = (SegmentSet*)malloc(sizeof(SegmentSet));
+    if (!set) return NULL;
+    int count = manifest->num_entries;
+    set->segments = (Segment**)calloc(count > 0 ? count : 1, sizeof(Segment*));
+    set->deletions = (SegmentDeletions**)calloc(count > 0 ? count : 1, sizeof(SegmentDeletions*));
+    set->doc_base = (int*)malloc((count > 0 ? count : 1) * sizeof(int));
+    set->num_segments = 0;
+    set->total_docs = 0;
+    set->live_docs = 0;
+    set->total_doc_length = 0;
+    set->generation = manifest->generation;
+    set->num_shards = 1;
+    set->shard_segments = (int*)calloc(2, sizeof(int));
+    set->stop_words = NULL;
+    set->stop_word_count = 0;
+    if (!set->segments || !set->deletions || !set->doc_base || !set->shard_segments) {
+        segment_set_close(set);
+        return NULL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        char path[1024];
+        join_path(path, sizeof(path), index_dir, manifest->entries[i].name);
+        Segment *segment = segment_open(path);
+        if (!segment) {
+            segment_set_close(set);
+            return NULL;
+        }
+        set->segments[set->num_segments] = segment;
+        set->doc_base[set->num_segments] = set->total_docs;
+        set->num_segments++;
+        set->total_docs += segment->num_docs;
+        set->live_docs += segment->num_docs;
+
+        const ManifestEntry *entry = &manifest->entries[i];
+        if (entry->deletions[0]) {
+            SegmentDeletions *deletions = deletions_load(index_dir, entry->deletions, segment->num_docs);
+            if (!deletions) {
+                segment_set_close(set);
+                return NULL;
+            }
+            set->deletions[set->num_segments - 1] = deletions;
+            set->live_docs -= deletions->num_deleted;
+        }
+        // BM25的平均文档长度只计存活文档（与合并后的段一致）
+        const uint64_t *live_docs = segment_set_live_docs(set, set->num_segments - 1);
+        for (int doc_id = 0; doc_id < segment->num_docs; doc_id++) {
+            if (DOC_IS_LIVE(live_docs, doc_id)) {
+                set->total_doc_length += segment_decode_doc_length(segment->doc_lengths[doc_id]);
+            }
+        }
+    }
+    set->shard_segments[1] = set->num_segments;
+    return set;
+}
+
+// 打开一个（不分片的）索引目录。is_shard非0时打开的是分片：没有段的清单得到空集合（分片可能没有文档），
+// 清单不存在（分片已被全量重建删除）时失败，不回退到旧的单段索引
+static SegmentSet* open_index_dir(const char *index_dir, int is_shard) {
+    for (int attempt = 0; attempt < SEGMENT_SET_OPEN_RETRIES; attempt++) {
+        Manifest manifest;
+        int status = is_shard ? manifest_read(index_dir, &manifest) : manifest_load(index_dir, &manifest);
+        if (status != 0) return NULL;
+        if (manifest.num_entries == 0 && !is_shard) {
+            manifest_free(&manifest);
+            return NULL;
+        }
+        SegmentSet *set = open_manifest_segments(index_dir, &manifest);
+        manifest_free(&manifest);
+        if (set) return set;
+        // 读取清单与打开段之间，段可能已被合并后删除：重新读取清单
+    }
+    return NULL;
+}
+
+// 依次打开各分片，把它们的段按分片顺序拼接成一个集合（段、删除标记的所有权转移给拼接后的集合）
+static SegmentSet* open_shards(const char *index_dir, const ShardList *shards) {
+    SegmentSet **parts = (SegmentSet**)calloc(shards->num_shards, sizeof(SegmentSet*));
+    if (!parts) return NULL;
+    int num_segments = 0;
+    int failed = 0;
+    uint64_t generation = shards->generation << 32;
+    for (int i = 0; i < shards->num_shards && !failed; i++) {
+        char path[1024];
+        join_path(path, sizeof(path), index_dir, shards->dirs[i]);
+        parts[i] = open_index_dir(path, 1);
+        if (!parts[i]) {
+            failed = 1;
+            break;
+        }
+        num_segments += parts[i]->num_segments;
+        generation += parts[i]->generation;
+    }
+
+    SegmentSet *set = NULL;
+    if (!failed) {
+        Manifest empty = { generation, 1, NULL, 0 };
+        set = open_manifest_segments(index_dir, &empty);
+        Segment **segments = (Segment**)malloc((num_segments > 0 ? num_segments : 1) * sizeof(Segment*));
+        SegmentDeletions **deletions =
+            (SegmentDeletions**)malloc((num_segments > 0 ? num_segments : 1) * sizeof(SegmentDeletions*));
+        int *doc_base = (int*)malloc((num_segments > 0 ? num_segments : 1) * sizeof(int));
+        int *shard_segments = (int*)malloc((shards->num_shards + 1) * sizeof(int));
+        if (!set || !segments || !deletions || !doc_base || !shard_segments) {
+            free(segments);
+            free(deletions);
+            free(doc_base);
+            free(shard_segments);
+            segment_set_close(set);
+            set = NULL;
+        } else {
+            free(set->segments);
+            free(set->deletions);
+            free(set->doc_base);
+            free(set->shard_segments);
+            set->segments = segments;
+            set->deletions = deletions;
+            set->doc_base = doc_base;
+            set->shard_segments = shard_segments;
+            set->num_shards = shards->num_shards;
+            for (int i = 0; i < shards->num_shards; i++) {
+                SegmentSet *part = parts[i];
+                set->shard_segments[i] = set->num_segments;
+                for (int s = 0; s < part->num_segments; s++) {
+                    set->segments[set->num_segments] = part->segments[s];
+                    set->deletions[set->num_segments] = part->deletions[s];
+                    set->doc_base[set->num_segments] = set->total_docs + part->doc_base[s];
+                    set->num_segments++;
+                }
+                set->total_docs += part->total_docs;
+                set->live_docs += part->live_docs;
+                set->total_doc_length += part->total_doc_length;
+                part->num_segments = 0; // 段已转移
+            }
+            set->shard_segments[shards->num_shards] = set->num_segments;
+        }
+    }
+    for (int i = 0; i < shards->num_shards; i++) segment_set_close(parts[i]);
+    free(parts);
+    if (set && set->total_docs == 0) {
+        segment_set_close(set);
+        set = NULL;
+    }
+    return set;
+}
+
+SegmentSet* segment_set_open(const char *index_dir) {
+    if (!index_dir) return NULL;
+    for (int attempt = 0; attempt < SEGMENT_SET_OPEN_RETRIES; attempt++) {
+        ShardList shards;
+        int status = shards_read(index_dir, &shards);
+        if (status < 0) return NULL;
+        SegmentSet *set;
+        if (status == 1) {
+            set = open_index_dir(index_dir, 0);
+        } else {
+            set = open_shards(index_dir, &shards);
+            shards_free(&shards);
+        }
+        if (set) {
+            set->stop_words = load_index_stop_words(index_dir, &set->stop_word_count);
+            return set;
+        }
+        if (status == 1) return NULL;
+        // 读取分片清单与打开分片之间，旧分片可能已被全量重建删除：重新读取分片清单
+    }
+    return NULL;
+}
+
+void segment_set_close(SegmentSet *set) {
+    if (!set) return;
+    for (int i = 0; set->segments && i < set->num_segments; i++) segment_close(set->segments[i]);
+    for (int i = 0; set->deletions && i < set->num_segments; i++) deletions_free(set->deletions[i]);
+    free(set->segments);
+    free(set->deletions);
+    free(set->doc_base);
+    free(set->shard_segments);
+    free_stop_words(set->stop_words, set->stop_word_count);
+    free(set);
+}
+
+// 索引目录当前的generation（算法与SegmentSet.generation一致），*sharded为是否分片；
+// 没有清单（旧的单段索引）或清单损坏时返回-1
+static int current_generation(const char *index_dir, uint64_t *generation, int *sharded) {
+    ShardList shards;
+    int status = shards_read(index_dir, &shards);
+    if (status < 0) return -1;
+    *sharded = status == 0;
+    if (!*sharded) {
+        Manifest manifest;
+        if (manifest_read(index_dir, &manifest) != 0) return -1;
+        manifest_free(&manifest);
+        *generation = manifest.generation;
+        return 0;
+    }
+    *generation = shards.generation << 32;
+    for (int i = 0; i < shards.num_shards && status == 0; i++) {
+        char path[1024];
+        Manifest manifest;
+        join_path(path, sizeof(path), index_dir, shards.dirs[i]);
+        status = manifest_read(path, &manifest) == 0 ? 0 : -1;
+        if (status == 0) {
+            *generation += manifest.generation;
+            manifest_free(&manifest);
+        }
+    }
+    shards_free(&shards);
+    return status;
+}
+
+int segment_set_is_stale(const SegmentSet *set, const char *index_dir) {
+    if (!set || !index_dir) return 0;
+    uint64_t generation;
+    int sharded;
+    if (current_generation(index_dir, &generation, &sharded) != 0) return 0; // 读取失败时维持现状
+    if (sharded != (set->num_shards > 1)) return 1;
+    return generation != set->generation;
+}
+
+int segment_set_locate(const SegmentSet *set, int doc_id, int *local_doc_id) {
+    if (!set || doc_id < 0 || doc_id >= set->total_docs) return -1;
+    // 段按文档ID顺序排列：二分找最后一个doc_base <= doc_id的段
+    int lo = 0, hi = set->num_segments - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (set->doc_base[mid] <= doc_id) lo = mid;
+        else hi = mid - 1;
+    }
+    *local_doc_id = doc_id - set->doc_base[lo];
+    return lo;
+}
+
+const char* segment_set_doc_path(const SegmentSet *set, int doc_id) {
+    int local_doc_id;
+    int index = segment_set_locate(set, doc_id, &local_doc_id);
+    if (index < 0) return NULL;
+    return segment_doc_path(set->segments[index], local_doc_id);
+}
+
+int segment_set_is_live(const SegmentSet *set, int doc_id) {
+    int local_doc_id;
+    int index = segment_set_locate(set, doc_id, &local_doc_id);
+    if (index < 0) return 0;
+    return DOC_IS_LIVE(segment_set_live_docs(set, index), local_doc_id);
+}
+
+int segment_set_indexes_token(const SegmentSet *set, const char *token, size_t len) {
+    return is_indexed_token(set->stop_words, set->stop_word_count, token, len);
+}
+
+const uint64_t* segment_set_live_docs(const SegmentSet *set, int segment_index) {
+    const SegmentDeletions *deletions = set->deletions[segment_index];
+    return deletions ? deletions->live_docs : NULL;
+}
+
+uint32_t segment_set_doc_count(const SegmentSet *set, int segment_index, int term_id) {
+    uint32_t doc_count = set->segments[segment_index]->terms[term_id].doc_count;
+    const SegmentDeletions *deletions = set->deletions[segment_index];
+    if (!deletions) return doc_count;
+    // (词条ID, 已删除postings数)对按词条ID升序，二分查找
+    int lo = 0, hi = deletions->num_term_counts;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (deletions->term_counts[2 * mid] < (uint32_t)term_id) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < deletions->num_term_counts && deletions->term_counts[2 * lo] == (uint32_t)term_id) {
+        doc_count -= deletions->term_counts[2 * lo + 1];
+    }
+    return doc_count;
+}
+
+static int compare_suggestions(const void *a, const void *b) {
+    const SetSuggestion *x = (const SetSuggestion*)a;
+    const SetSuggestion *y = (const SetSuggestion*)b;
+    if (x->doc_count != y->doc_count) return x->doc_count > y->doc_count ? -1 : 1;
+    return strcmp(x->term, y->term);
+}
+
+static int compare_suggestion_terms(const void *a, const void *b) {
+    return strcmp(((const SetSuggestion*)a)->term, ((const SetSuggestion*)b)->term);
+}
+
+static int compare_doc_counts_desc(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x < y) - (x > y);
+}
+
+// 第s个段的建议候选（term_ids由调用者释放）。预选的补全按段内文档频率排列，段有删除时存活文档频率可能更低：
+// 候选数不断加倍，直到第max高的存活文档频率超过最后一个候选的段内文档频率（之后的词条不可能再挤进前max名）
+static int segment_candidates(const SegmentSet *set, int s, const char *prefix, size_t len, int max, int **term_ids) {
+    const Segment *segment = set->segments[s];
+    for (int want = max; ; want *= 2) {
+        int *ids = (int*)malloc(want * sizeof(int));
+        if (!ids) return 0;
+        int found = segment_suggest(segment, prefix, len, ids, want);
+        if (!set->deletions[s] || found < want) {
+            *term_ids = ids;
+            return found;
+        }
+        uint32_t *live = (uint32_t*)malloc(found * sizeof(uint32_t));
+        if (!live) {
+            *term_ids = ids;
+            return found;
+        }
+        for (int i = 0; i < found; i++) live[i] = segment_set_doc_count(set, s, ids[i]);
+        qsort(live, found, sizeof(uint32_t), compare_doc_counts_desc);
+        int enough = live[max - 1] > segment->terms[ids[found - 1]].doc_count;
+        free(live);
+        if (enough) {
+            *term_ids = ids;
+            return found;
+        }
+        free(ids);
+    }
+}
+
+int segment_set_suggest(const SegmentSet *set, const char *prefix, size_t len, SetSuggestion *suggestions, int max) {
+    if (!set || !prefix || !suggestions || max <= 0 || set->num_segments <= 0) return 0;
+    SetSuggestion *candidates = NULL;
+    int count = 0, capacity = 0;
+    
+    // 收集各段的候选
+    for (int s = 0; s < set->num_segments; s++) {
+        int *term_ids = NULL;
+        int found = segment_candidates(set, s, prefix, len, max, &term_ids);
+        if (count + found > capacity) {
+            capacity = count + found > capacity * 2 ? count + found : capacity * 2;
+            SetSuggestion *grown = (SetSuggestion*)realloc(candidates, capacity * sizeof(SetSuggestion));
+            if (!grown) {
+                free(term_ids);
+                break;
+            }
+            candidates = grown;
+        }
+        for (int i = 0; i < found; i++) {
+            candidates[count].term = segment_term(set->segments[s], term_ids[i]);
+            candidates[count].doc_count = 0;
+            if (candidates[count].term) count++;
+        }
+        free(term_ids);
+    }
+    // 去重（按词条排序后相邻比较）
+    qsort(candidates, count, sizeof(SetSuggestion), compare_suggestion_terms);
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique > 0 && strcmp(candidates[unique - 1].term, candidates[i].term) == 0) continue;
+        candidates[unique++] = candidates[i];
+    }
+    count = unique;
+    
+    // 全局文档频率：在每个段中精确查找候选词（扣除已删除的文档），只出现在已删除文档中的词条不再建议
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        size_t term_len = strlen(candidates[i].term);
+        for (int s = 0; s < set->num_segments; s++) {
+            TermHandle handle;
+            if (segment_lookup(set->segments[s], candidates[i].term, term_len, &handle)) {
+                candidates[i].doc_count += segment_set_doc_count(set, s, handle.term_id);
+            }
+        }
+        if (candidates[i].doc_count > 0) candidates[kept++] = candidates[i];
+    }
+    count = kept;
+    qsort(candidates, count, sizeof(SetSuggestion), compare_suggestions);
+    if (count > max) count = max;
+    if (count > 0) memcpy(suggestions, candidates, count * sizeof(SetSuggestion));
+    free(candidates);
+    return count;
+}
+
+// ---------------------------------------------------------------------------
+// 分层合并
+// ---------------------------------------------------------------------------
+
+// 段所在的层：文档数每增长MERGE_TIER_FACTOR倍升一层
+static int merge_tier(int num_docs) {
+    int tier = 0;
+    long long limit = MERGE_MIN_TIER_DOCS;
+    while (num_docs > limit) {
+        limit *= MERGE_TIER_FACTOR;
+        tier++;
+    }
+    return tier;
+}
+
+static int live_doc_count(const ManifestEntry *entry) {
+    return entry->num_docs - entry->num_deleted;
+}
+
+// 找出要合并的一组相邻段[*first, *first + 返回值)：同层（按存活文档数分层）的连续段达到MERGE_TIER_FACTOR个时
+// 取前MERGE_TIER_FACTOR个，优先合并最低的层；否则单独重写已删除文档达到MERGE_RECLAIM_RATIO的段。
+// 只合并相邻段，合并后文档ID的相对顺序不变。没有可合并的返回0
+static int pick_merge(const Manifest *manifest, int *first) {
+    int best = -1, best_tier = 0;
+    for (int i = 0; i < manifest->num_entries; ) {
+        int tier = merge_tier(live_doc_count(&manifest->entries[i]));
+        int j = i + 1;
+        while (j < manifest->num_entries && merge_tier(live_doc_count(&manifest->entries[j])) == tier) j++;
+        if (j - i >= MERGE_TIER_FACTOR && (best < 0 || tier < best_tier)) {
+            best = i;
+            best_tier = tier;
+        }
+        i = j;
+    }
+    if (best >= 0) {
+        *first = best;
+        return MERGE_TIER_FACTOR;
+    }
+    for (int i = 0; i < manifest->num_entries; i++) {
+        const ManifestEntry *entry = &manifest->entries[i];
+        if (entry->num_deleted > 0 && (long long)entry->num_deleted * MERGE_RECLAIM_RATIO >= entry->num_docs) {
+            *first = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// [first, first+count)的段是否都有位置（只要有一个没有，合并结果就不带位置）
+static int segments_have_positions(const char *index_dir, const Manifest *manifest, int first, int count) {
+    for (int i = first; i < first + count; i++) {
+        char path[1024];
+        join_path(path, sizeof(path), index_dir, manifest->entries[i].name);
+        Segment *segment = segment_open(path);
+        int has_positions = segment_has_positions(segment);
+        segment_close(segment);
+        if (!has_positions) return 0;
+    }
+    return 1;
+}
+
+// 合并manifest中[first, first+count)的段（丢弃已删除的文档），写成临时段文件pending。
+// 成功返回合并后的文档数（为0时不写段文件），失败返回-1
+static int merge_segments(const char *index_dir, const Manifest *manifest, int first, int count, const char *pending) {
+    int with_positions = segments_have_positions(index_dir, manifest, first, count);
+    InvertedIndex *index = inverted_index_create(0, 0);
+    int total_docs = 0;
+    for (int i = first; i < first + count; i++) total_docs += live_doc_count(&manifest->entries[i]);
+    char **doc_paths = (char**)malloc((total_docs > 0 ? total_docs : 1) * sizeof(char*));
+    int num_docs = 0;
+    int failed = !index || !doc_paths;
+
+    for (int i = first; i < first + count && !failed; i++) {
+        const ManifestEntry *entry = &manifest->entries[i];
+        char path[1024];
+        join_path(path, sizeof(path), index_dir, entry->name);
+        Segment *segment = segment_open(path);
+        SegmentDeletions *deletions = segment && entry->deletions[0]
+            ? deletions_load(index_dir, entry->deletions, segment->num_docs) : NULL;
+        const uint64_t *live_docs = deletions ? deletions->live_docs : NULL;
+        if (!segment || (entry->deletions[0] && !deletions)
+            || num_docs + segment->num_docs - (deletions ? deletions->num_deleted : 0) > total_docs
+            || segment_append_to_index(segment, live_docs, index, num_docs, with_positions) < 0) {
+            deletions_free(deletions);
+            segment_close(segment);
+            failed = 1;
+            break;
+        }
+        for (int d = 0; d < segment->num_docs; d++) {
+            if (!DOC_IS_LIVE(live_docs, d)) continue;
+            const char *doc_path = segment_doc_path(segment, d);
+            doc_paths[num_docs++] = strdup(doc_path ? doc_path : "");
+        }
+        deletions_free(deletions);
+        segment_close(segment);
+    }
+
+    if (!failed && num_docs > 0) {
+        char pending_path[1024];
+        join_path(pending_path, sizeof(pending_path), index_dir, pending);
+        index->num_docs = num_docs;
+        failed = segment_write(index, doc_paths, num_docs, pending_path) != 0;
+    }
+    for (int i = 0; i < num_docs; i++) free(doc_paths[i]);
+    free(doc_paths);
+    inverted_index_free(index);
+    return failed ? -1 : num_docs;
+}
+
+static int same_entry(const ManifestEntry *a, const ManifestEntry *b) {
+    return strcmp(a->name, b->name) == 0 && strcmp(a->deletions, b->deletions) == 0;
+}
+
+static int merge_dir_once(const char *index_dir) {
+    Manifest manifest;
+    if (manifest_read(index_dir, &manifest) != 0) return 0; // 没有清单：单段索引无需合并
+
+    int first = 0;
+    int count = pick_merge(&manifest, &first);
+    if (count == 0) {
+        manifest_free(&manifest);
+        return 0;
+    }
+    ManifestEntry *merged = (ManifestEntry*)malloc(count * sizeof(ManifestEntry));
+    if (!merged) {
+        manifest_free(&manifest);
+        return -1;
+    }
+    memcpy(merged, manifest.entries + first, count * sizeof(ManifestEntry));
+
+    // 合并不持锁（耗时最长的部分），只在提交时持锁
+    char pending[SEGMENT_NAME_SIZE], pending_path[1024];
+    pending_segment_name(pending, sizeof(pending));
+    join_path(pending_path, sizeof(pending_path), index_dir, pending);
+    int num_docs = merge_segments(index_dir, &manifest, first, count, pending);
+    manifest_free(&manifest);
+    if (num_docs < 0 || manifest_lock(index_dir) != 0) {
+        remove(pending_path);
+        free(merged);
+        return -1;
+    }
+
+    // 提交前重新读取清单：期间可能追加了新段、删除了文档或被全量重建，
+    // 被合并的段及其删除标记仍须原样相邻地存在，否则放弃本次合并（下次重新合并）
+    int status = -1;
+    if (manifest_read(index_dir, &manifest) == 0) {
+        int at = -1;
+        for (int i = 0; i + count <= manifest.num_entries && at < 0; i++) {
+            if (same_entry(&manifest.entries[i], &merged[0])) at = i;
+        }
+        int intact = at >= 0;
+        for (int i = 0; intact && i < count; i++) {
+            intact = same_entry(&manifest.entries[at + i], &merged[i]);
+        }
+        // 全部文档都已删除时直接从清单中移除这些段
+        int replaced = num_docs > 0 ? 1 : 0;
+        ManifestEntry entry;
+        if (intact && (!replaced || commit_segment(index_dir, &manifest, pending, num_docs, &entry) == 0)) {
+            if (replaced) manifest.entries[at] = entry;
+            memmove(manifest.entries + at + replaced, manifest.entries + at + count,
+                    (manifest.num_entries - at - count) * sizeof(ManifestEntry));
+            manifest.num_entries -= count - replaced;
+            manifest.generation++;
+            status = manifest_write(index_dir, &manifest) == 0 ? 1 : -1;
+            if (status < 0 && replaced) remove_segment_file(index_dir, entry.name);
+        } else {
+            status = 0;
+        }
+        manifest_free(&manifest);
+    }
+    manifest_unlock(index_dir);
+
+    if (status == 1) {
+        for (int i = 0; i < count; i++) remove_entry_files(index_dir, &merged[i]);
+    } else {
+        remove(pending_path);
+    }
+    free(merged);
+    return status;
+}
+
+// ---------------------------------------------------------------------------
+// 后台合并线程
+// ---------------------------------------------------------------------------
+
+int segment_set_merge_once(const char *index_dir) {
+    if (!index_dir) return -1;
+    ShardList shards;
+    int status = shards_read(index_dir, &shards);
+    if (status < 0) return -1;
+    if (status == 1) return merge_dir_once(index_dir);
+
+    int merged = 0;
+    for (int i = 0; i < shards.num_shards && merged == 0; i++) {
+        char path[1024];
+        join_path(path, sizeof(path), index_dir, shards.dirs[i]);
+        merged = merge_dir_once(path);
+    }
+    shards_free(&shards);
+    return merged;
+}
+
+struct SegmentMerger {
+    char index_dir[1024];
+    Mutex lock;   // 保护stop
+    CondVar wake; // 要求停止时唤醒休眠中的合并线程
+    int stop;
+    ThreadHandle thread;
+};
+
+static int merger_stopping(SegmentMerger *merger) {
+    mutex_lock(&merger->lock);
+    int stop = merger->stop;
+    mutex_unlock(&merger->lock);
+    return stop;
+}
+
+static void merger_loop(void *arg) {
+    SegmentMerger *merger = (SegmentMerger*)arg;
+    while (!merger_stopping(merger)) {
+        while (!merger_stopping(merger) && segment_set_merge_once(merger->index_dir) == 1) {
+        }
+        // 休眠到下一次检查；要求停止时立即醒来（一次合并进行中时等它完成）
+        long long deadline = monotonic_ms() + MERGE_INTERVAL_MS;
+        mutex_lock(&merger->lock);
+        while (!merger->stop) {
+            long long remaining = deadline - monotonic_ms();
+            if (remaining <= 0) break;
+            cond_wait_ms(&merger->wake, &merger->lock, (int)remaining);
+        }
+        mutex_unlock(&merger->lock);
+    }
+}
+
+SegmentMerger* segment_merger_start(const char *index_dir) {
+    if (!index_dir) return NULL;
+    SegmentMerger *merger = (SegmentMerger*)malloc(sizeof(SegmentMerger));
+    if (!merger) return NULL;
+    snprintf(merger->index_dir, sizeof(merger->index_dir), "%s", index_dir);
+    merger->stop = 0;
+    if (mutex_init(&merger->lock) != 0) {
+        free(merger);
+        return NULL;
+    }
+    cond_init(&merger->wake);
+    if (thread_create(&merger->thread, merger_loop, merger) != 0) {
+        mutex_destroy(&merger->lock);
+        cond_destroy(&merger->wake);
+        free(merger);
+        return NULL;
+    }
+    return merger;
+}
+
+void segment_merger_stop(SegmentMerger *merger) {
+    if (!merger) return;
+    mutex_lock(&merger->lock);
+    merger->stop = 1;
+    cond_signal(&merger->wake);
+    mutex_unlock(&merger->lock);
+    thread_join(merger->thread);
+    mutex_destroy(&merger->lock);
+    cond_destroy(&merger->wake);
+    free(merger);
+}
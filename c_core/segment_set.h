@@ -0,0 +1,169 @@
+#ifndef SEGMENT_SET_H
+#define SEGMENT_SET_H
+
+#include <stdint.h>
+#include "segment.h"
+#include "inverted_index.h"
+
+// 多段索引（LSM）：索引目录中有若干不可变的段文件，由清单文件MANIFEST列出当前有效的段
+// 新文档写入一个新的小段，查询同时遍历所有段；后台按分层策略把大小相近的相邻段合并成一个段。
+// 清单先写临时文件再替换，读者总能看到完整的清单；修改清单时持有MANIFEST.lock，避免多个进程互相覆盖
+//
+// 段文件本身不可变，删除文档只为所在段写一个新的删除标记文件（.del），由清单引用；
+// 更新文档即删除旧文档并把新内容写成新段，两者在同一次清单替换中生效
+//
+// 清单格式（文本）：
+//   DSEGMANIFEST 2
+//   generation <每次修改清单加1>
+//   next_segment <下一个段文件编号>
+//   segments <段数>
+//   <段文件名> <文档数> <已删除文档数> <删除标记文件名或->      （每段一行，按文档ID顺序排列）
+// 版本1的清单没有后两列（没有删除），仍可读取
+// 分片索引：文档按路径排序后切成num_shards个连续区间，每个分片是索引目录下的一个子目录（本身是完整的多段索引），
+// 由根目录的分片清单SHARDS列出。打开时各分片的段按分片顺序拼接，全局文档ID与IDF统计和不分片时完全一致；
+// 查询时每个分片在自己的线程中打分，各分片的前k名再合并（见search.c）
+//
+// 分片清单格式（文本）：
+//   DSHARDS 1
+//   generation <每次全量重建递增，与根目录清单的generation共用一个计数（分片期间根目录保留一个空清单）>
+//   shards <分片数>
+//   <分片目录名>                                                  （每个分片一行，按文档ID顺序排列）
+// 增量添加写入最后一个分片（新文档的ID仍接在已有文档之后），删除与合并对每个分片分别进行
+//
+// 打开后的SegmentSet不可变：查询与前缀建议只读取它，可以由多个线程同时使用；清单变化后打开一个新的集合替换，
+// 而不是修改原集合，旧集合在没有线程使用后再关闭
+#define SHARDS_FILE_NAME "SHARDS"
+#define SHARDS_MAGIC "DSHARDS"
+#define SHARDS_VERSION 1
+#define MAX_SHARDS 256
+
+#define MANIFEST_FILE_NAME "MANIFEST"
+#define MANIFEST_LOCK_NAME "MANIFEST.lock"
+#define MANIFEST_MAGIC "DSEGMANIFEST"
+#define MANIFEST_VERSION 2
+
+// 删除标记文件：文件头之后是存活文档位图（uint64数组，第i位为1表示段内文档i存活），
+// 再之后是按词条ID升序的(词条ID, 该词条在已删除文档中的postings数)对，查询时据此扣减文档频率
+#define DELETIONS_MAGIC "DSEGDEL"
+#define DELETIONS_VERSION 1
+#define LEGACY_SEGMENT_NAME "index.seg" // 没有清单时按单段索引打开
+#define SEGMENT_NAME_SIZE 64
+
+// 分层合并策略：文档数在同一数量级（按MERGE_TIER_FACTOR分层）的相邻段达到MERGE_TIER_FACTOR个时合并
+#define MERGE_TIER_FACTOR 4
+#define MERGE_MIN_TIER_DOCS 64        // 文档数不超过该值的段都算最低一层
+#define MERGE_INTERVAL_MS 1000        // 后台合并线程检查清单的间隔
+#define MERGE_RECLAIM_RATIO 4         // 已删除文档达到段内文档数的1/4时单独重写该段，回收已删除的postings
+
+typedef struct ManifestEntry {
+    char name[SEGMENT_NAME_SIZE];      // 段文件名（相对索引目录）
+    int num_docs;                      // 段内文档数（含已删除的文档）
+    int num_deleted;
+    char deletions[SEGMENT_NAME_SIZE]; // 删除标记文件名，没有删除时为空串
+} ManifestEntry;
+
+typedef struct Manifest {
+    uint64_t generation;
+    uint64_t next_segment;
+    ManifestEntry *entries;
+    int num_entries;
+} Manifest;
+
+// 段的删除标记（读入内存）：存活文档位图与各词条在已删除文档中的postings数
+typedef struct SegmentDeletions {
+    const uint64_t *live_docs;
+    const uint32_t *term_counts; // (词条ID, 已删除postings数)对，按词条ID升序
+    int num_term_counts;
+    int num_deleted;
+    void *buffer;
+} SegmentDeletions;
+
+// 已打开的多段索引：全局文档ID = 段的doc_base + 段内文档ID（已删除的文档仍占用ID），
+// IDF使用所有段的存活文档总数live_docs与扣除已删除文档后的文档频率，打开时统计存活文档的总长度
+typedef struct SegmentSet {
+    Segment **segments;
+    SegmentDeletions **deletions; // 没有删除的段为NULL
+    int *doc_base;
+    int num_segments;
+    int total_docs;               // 文档ID空间的大小（含已删除的文档）
+    int live_docs;
+    uint64_t total_doc_length;    // 存活文档的长度之和（量化后的长度，BM25的平均文档长度由此得到）
+    // 打开时清单的generation（没有清单时为0）；分片索引为 (分片清单的generation << 32) + 各分片清单的generation之和
+    uint64_t generation;
+    int num_shards;               // 分片数（不分片的索引为1）
+    int *shard_segments;          // 第i个分片的段为[shard_segments[i], shard_segments[i + 1])
+    char **stop_words;            // 构建索引时使用的停用词表（有序，见utils.h）
+    int stop_word_count;
+} SegmentSet;
+
+// 读取清单：成功返回0；清单不存在返回1（manifest置为空）；格式错误返回-1
+int manifest_read(const char *index_dir, Manifest *manifest);
+void manifest_free(Manifest *manifest);
+
+// 打开清单中的全部段；有分片清单时依次打开各分片并拼接；没有清单时打开旧的单段索引index.seg。失败返回NULL
+SegmentSet* segment_set_open(const char *index_dir);
+void segment_set_close(SegmentSet *set);
+
+// 清单的generation是否已不同于set打开时的值（其他进程或后台合并修改了清单，或索引在分片与不分片之间重建）
+int segment_set_is_stale(const SegmentSet *set, const char *index_dir);
+
+// 全局文档ID对应的段与段内文档ID，超出范围返回-1
+int segment_set_locate(const SegmentSet *set, int doc_id, int *local_doc_id);
+const char* segment_set_doc_path(const SegmentSet *set, int doc_id);
+// 文档是否存活（未被删除）
+int segment_set_is_live(const SegmentSet *set, int doc_id);
+
+// 构建索引时是否会收录该词条（停用词与长度不超过1的词不收录，在短语中只占位置）
+int segment_set_indexes_token(const SegmentSet *set, const char *token, size_t len);
+
+// 第segment_index个段的存活文档位图，没有删除时为NULL
+const uint64_t* segment_set_live_docs(const SegmentSet *set, int segment_index);
+// 词条在第segment_index个段中的存活文档频率（段内文档频率减去已删除文档中的postings数）
+uint32_t segment_set_doc_count(const SegmentSet *set, int segment_index, int term_id);
+
+// 跨段的前缀建议：词条与其在所有段中的文档频率合计
+typedef struct SetSuggestion {
+    const char *term; // 指向某个段映射区域中的词条，set关闭后失效
+    long long doc_count;
+} SetSuggestion;
+
+// 以prefix开头、全局文档频率最高的至多max个词条（按文档频率降序、同频率按字典序），返回个数
+// 候选为各段各自的前max个建议（有删除的段按存活文档频率取够），再按全局文档频率重排：
+// 单段时结果精确，多段时只出现在各段前max名之外的词条可能被遗漏
+int segment_set_suggest(const SegmentSet *set, const char *prefix, size_t len, SetSuggestion *suggestions, int max);
+
+// 全量重建：把index写成一个新段，清单替换为只含该段，旧段随后删除（原来是分片索引时删除分片清单与各分片）。成功返回0
+int segment_set_replace(const char *index_dir, InvertedIndex *index, char **doc_paths, int num_docs);
+
+// 分片构建回调：把第shard个分片（共num_shards个）的文档写入shard_dir（目录已创建，如用segment_set_replace），成功返回0
+typedef int (*ShardBuildFunc)(int shard, int num_shards, const char *shard_dir, void *context);
+
+// 全量重建为num_shards（2..MAX_SHARDS）个分片：为本次重建创建新的分片目录并依次调用build，
+// 全部成功后替换分片清单，之前的段与分片随后删除；失败时删除新建的分片，原索引保持不变。成功返回0
+int segment_set_replace_sharded(const char *index_dir, int num_shards, ShardBuildFunc build, void *context);
+
+// 索引目录的分片数（不分片的索引为1，分片清单损坏时返回-1）
+int segment_set_shard_count(const char *index_dir);
+
+// 增量添加：把index写成一个新段追加到清单末尾（文档ID接在已有文档之后；分片索引追加到最后一个分片）。成功返回0
+int segment_set_append(const char *index_dir, InvertedIndex *index, char **doc_paths, int num_docs);
+
+// 按文档路径删除（路径须与索引中记录的一致），返回删除的文档数，失败返回-1
+int segment_set_delete(const char *index_dir, char **paths, int num_paths);
+
+// 更新：删除delete_paths对应的已有文档，同时把index（可为NULL）写成新段追加到清单末尾，
+// 删除与追加在同一次清单替换中生效。返回删除的文档数，失败返回-1（清单保持不变）。
+// 分片索引先在其余分片中删除，再在最后一个分片中同时删除与追加，各分片分别生效
+int segment_set_update(const char *index_dir, char **delete_paths, int num_delete,
+                       InvertedIndex *index, char **doc_paths, int num_docs);
+
+// 按分层策略执行一次合并（已删除文档达到MERGE_RECLAIM_RATIO的段也会单独重写），合并时丢弃已删除文档：
+// 返回1表示合并了一组段，0表示没有需要合并的段，-1表示失败（分片索引依次检查各分片，合并了一组即返回）
+int segment_set_merge_once(const char *index_dir);
+
+// 后台合并线程：每隔MERGE_INTERVAL_MS检查一次清单并合并，直到stop（stop唤醒休眠中的线程，只等进行中的合并完成）
+typedef struct SegmentMerger SegmentMerger;
+SegmentMerger* segment_merger_start(const char *index_dir);
+void segment_merger_stop(SegmentMerger *merger);
+
+#endif
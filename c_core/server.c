@@ -0,0 +1,355 @@
+#include "server.h"
+#include "search.h"
+#include "query_cache.h"
+#include "query_stats.h"
+#include "thread.h"
+#include "worker_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+typedef struct ServerState ServerState;
+
+// 一个请求：读取线程填好后交给工作线程执行，响应按序号的顺序写出
+typedef struct ServerJob {
+    ServerState *server;
+    unsigned long long seq;
+    const SegmentSet *set; // 读取请求时的段集合（替换段集合前等待所有请求完成）
+    char command[32];
+    char model[32];
+    int limit;
+    char payload[SERVER_MAX_PAYLOAD + 1];
+} ServerJob;
+
+struct ServerState {
+    FILE *out;
+    int record_stats;
+    int num_workers;
+    WorkerPool *pool;         // 只有一个工作线程时为NULL，请求直接在读取线程中执行
+    SearchContext **contexts; // 每个工作线程一个查询上下文与一个查询缓存，执行查询时不加锁
+    QueryCache **caches;
+    WorkerPool *scoring_pool; // 各上下文共用的分片与段内并行线程池（cpu_count个线程）
+    ServerJob *jobs;          // 请求槽，按序号循环使用
+    int num_jobs;
+    Mutex lock;               // 只保护written，临界区只有一次比较或加1
+    CondVar turn;
+    unsigned long long next_seq; // 下一个请求的序号（只由读取线程修改）
+    unsigned long long written;  // 已写出响应的请求数（序号小于它的请求都已完成）
+};
+
+// 读取一行请求头并解析，返回0成功，-1输入结束，-2格式错误，-3负载超过SERVER_MAX_PAYLOAD
+// （仍写出payload_len，调用者需要读掉负载）；model没有给出时为空串
+static int read_header(FILE *in, char *command, size_t command_size, long *payload_len, int *limit,
+                       char *model, size_t model_size) {
+    char line[256];
+    if (!fgets(line, sizeof(line), in)) return -1;
+
+    char name[32];
+    char model_name[32] = "";
+    long len = 0;
+    int lim = 0;
+    int fields = sscanf(line, "%31s %ld %d %31s", name, &len, &lim, model_name);
+    if (fields < 2 || len < 0) return -2;
+    *payload_len = len;
+    if (len > SERVER_MAX_PAYLOAD) return -3;
+
+    snprintf(command, command_size, "%s", name);
+    snprintf(model, model_size, "%s", fields >= 4 ? model_name : "");
+    *limit = fields >= 3 ? lim : 0;
+    return 0;
+}
+
+// 等待轮到job写出响应（序号更小的响应都已写出），返回输出流
+static FILE* await_turn(ServerJob *job) {
+    ServerState *server = job->server;
+    mutex_lock(&server->lock);
+    while (server->written != job->seq) cond_wait(&server->turn, &server->lock);
+    mutex_unlock(&server->lock);
+    return server->out;
+}
+
+// job的响应已写完：刷新输出并让下一个请求写出
+static void finish_turn(ServerJob *job) {
+    ServerState *server = job->server;
+    fflush(server->out);
+    mutex_lock(&server->lock);
+    server->written++;
+    cond_broadcast(&server->turn);
+    mutex_unlock(&server->lock);
+}
+
+// 等待已分发的请求全部完成（之后读取线程可以独占输出、缓存与段集合）
+static void drain(ServerState *server) {
+    mutex_lock(&server->lock);
+    while (server->written != server->next_seq) cond_wait(&server->turn, &server->lock);
+    mutex_unlock(&server->lock);
+}
+
+// 解析search与profile共用的选项，模型无法识别时返回-1
+static int search_options_for(int limit, const char *model, SearchOptions *options) {
+    search_options_init(options);
+    options->top_k = limit > 0 ? limit : SERVER_DEFAULT_LIMIT;
+    if (model[0] && parse_scoring_model(model, &options->model) != 0) return -1;
+    return 0;
+}
+
+static void handle_search(ServerJob *job, int worker) {
+    ServerState *server = job->server;
+    QueryCache *cache = server->caches[worker];
+    SearchOptions options;
+    if (search_options_for(job->limit, job->model, &options) != 0) {
+        fprintf(await_turn(job), "ERR unknown model\n");
+        return;
+    }
+    // 命中缓存时不执行搜索，统计保持为空，只有未命中的查询计入直方图
+    QueryStats stats;
+    memset(&stats, 0, sizeof(QueryStats));
+    QueryCacheStats before;
+    if (server->record_stats) {
+        options.stats = &stats;
+        query_cache_stats(cache, &before);
+    }
+    // 结果归缓存或查询上下文所有，不需要释放（在本线程的下一次查询之前有效）
+    int result_count;
+    const SearchResult *results = query_cache_search(cache, server->contexts[worker], job->set, job->payload,
+                                                     &options, &result_count);
+    if (server->record_stats) {
+        QueryCacheStats after;
+        query_cache_stats(cache, &after);
+        if (after.misses != before.misses) query_stats_record(&stats);
+    }
+
+    FILE *out = await_turn(job);
+    fprintf(out, "OK %d\n", result_count);
+    for (int i = 0; i < result_count; i++) {
+        fprintf(out, "%.4f\t%s\n", results[i].score, results[i].doc_path);
+    }
+}
+
+static void handle_profile(ServerJob *job, int worker) {
+    SearchOptions options;
+    if (search_options_for(job->limit, job->model, &options) != 0) {
+        fprintf(await_turn(job), "ERR unknown model\n");
+        return;
+    }
+    QueryStats stats;
+    memset(&stats, 0, sizeof(QueryStats));
+    options.stats = &stats;
+    int result_count;
+    search_context_run(job->server->contexts[worker], job->set, job->payload, &options, &result_count);
+    query_stats_record(&stats);
+    FILE *out = await_turn(job);
+    fprintf(out, "OK 1\n");
+    query_stats_write_json(&stats, out);
+    fputc('\n', out);
+}
+
+static void handle_histograms(FILE *out) {
+    fprintf(out, "OK 1\n");
+    query_stats_write_histograms_json(out);
+    fputc('\n', out);
+}
+
+// 各工作线程缓存的合计（调用前须drain）
+static void handle_stats(const ServerState *server, FILE *out) {
+    QueryCacheStats stats;
+    memset(&stats, 0, sizeof(QueryCacheStats));
+    for (int i = 0; i < server->num_workers; i++) {
+        QueryCacheStats cache;
+        query_cache_stats(server->caches[i], &cache);
+        stats.hits += cache.hits;
+        stats.misses += cache.misses;
+        stats.evictions += cache.evictions;
+        stats.invalidations += cache.invalidations;
+        stats.entries += cache.entries;
+        stats.bytes += cache.bytes;
+        stats.max_bytes += cache.max_bytes;
+    }
+    fprintf(out, "OK 7\n");
+    fprintf(out, "cache_hits %llu\n", (unsigned long long)stats.hits);
+    fprintf(out, "cache_misses %llu\n", (unsigned long long)stats.misses);
+    fprintf(out, "cache_evictions %llu\n", (unsigned long long)stats.evictions);
+    fprintf(out, "cache_invalidations %llu\n", (unsigned long long)stats.invalidations);
+    fprintf(out, "cache_entries %d\n", stats.entries);
+    fprintf(out, "cache_bytes %llu\n", (unsigned long long)stats.bytes);
+    fprintf(out, "cache_max_bytes %llu\n", (unsigned long long)stats.max_bytes);
+}
+
+// 前缀建议：按文档频率排序的前limit个词条，limit不超过TRIE_COMPLETION_SLOTS时直接读取构建期预选的结果
+static void handle_suggest(ServerJob *job) {
+    char *prefix = job->payload;
+    int limit = job->limit;
+    if (limit <= 0) limit = SERVER_SUGGEST_LIMIT;
+    if (limit > SERVER_DEFAULT_LIMIT) limit = SERVER_DEFAULT_LIMIT;
+    for (int i = 0; prefix[i]; i++) {
+        prefix[i] = tolower((unsigned char)prefix[i]);
+    }
+
+    SetSuggestion suggestions[SERVER_DEFAULT_LIMIT];
+    int shown = 0;
+    if (prefix[0] != '\0') {
+        shown = segment_set_suggest(job->set, prefix, strlen(prefix), suggestions, limit);
+    }
+
+    FILE *out = await_turn(job);
+    fprintf(out, "OK %d\n", shown);
+    for (int i = 0; i < shown; i++) {
+        fprintf(out, "%s\n", suggestions[i].term);
+    }
+}
+
+// 在工作线程（或只有一个工作线程时的读取线程）中执行一个请求，并按序写出响应
+static void run_job(void *arg, int worker) {
+    ServerJob *job = (ServerJob*)arg;
+    if (strcmp(job->command, "search") == 0) handle_search(job, worker);
+    else if (strcmp(job->command, "profile") == 0) handle_profile(job, worker);
+    else handle_suggest(job);
+    finish_turn(job);
+}
+
+// 清单已变化时重新打开段集合；打开失败（如正在替换）时继续使用旧集合，下次检查再试
+// 替换前等待已分发的请求完成，旧集合关闭时没有请求还在使用它
+static void reload_if_stale(ServerState *server, SegmentSet **set, const char *index_dir, long long *last_check) {
+    long long now = monotonic_ms();
+    if (now - *last_check < SERVER_RELOAD_CHECK_MS) return;
+    *last_check = now;
+    if (!segment_set_is_stale(*set, index_dir)) return;
+    SegmentSet *reopened = segment_set_open(index_dir);
+    if (!reopened) return;
+    drain(server);
+    segment_set_close(*set);
+    *set = reopened;
+}
+
+static void server_free(ServerState *server) {
+    worker_pool_free(server->pool);
+    for (int i = 0; i < server->num_workers; i++) {
+        if (server->caches) query_cache_free(server->caches[i]);
+        if (server->contexts) search_context_free(server->contexts[i]);
+    }
+    worker_pool_free(server->scoring_pool);
+    free(server->caches);
+    free(server->contexts);
+    free(server->jobs);
+    mutex_destroy(&server->lock);
+    cond_destroy(&server->turn);
+}
+
+// 准备各工作线程的查询上下文与缓存（缓存上限均分）、请求槽与线程池，失败返回-1。
+// 各上下文的分片与段内并行任务共用一个cpu_count个线程的池，N个工作线程同时执行重查询时也不会创建N倍的线程
+static int server_init(ServerState *server, size_t cache_bytes, int num_workers, int record_stats, FILE *out) {
+    memset(server, 0, sizeof(ServerState));
+    server->out = out;
+    server->record_stats = record_stats;
+    server->num_workers = num_workers;
+    server->num_jobs = num_workers * SERVER_JOBS_PER_WORKER;
+    mutex_init(&server->lock);
+    cond_init(&server->turn);
+    server->contexts = (SearchContext**)calloc(num_workers, sizeof(SearchContext*));
+    server->caches = (QueryCache**)calloc(num_workers, sizeof(QueryCache*));
+    server->jobs = (ServerJob*)malloc(server->num_jobs * sizeof(ServerJob));
+    server->scoring_pool = worker_pool_create(cpu_count(), 0);
+    if (!server->contexts || !server->caches || !server->jobs || !server->scoring_pool) return -1;
+    for (int i = 0; i < num_workers; i++) {
+        server->contexts[i] = search_context_create();
+        server->caches[i] = query_cache_create(cache_bytes / num_workers);
+        if (!server->contexts[i] || !server->caches[i]) return -1;
+        search_context_set_pool(server->contexts[i], server->scoring_pool);
+    }
+    // 队列容量与请求槽数相同，分发时不会因队列满而等待
+    if (num_workers > 1) {
+        server->pool = worker_pool_create(num_workers, server->num_jobs);
+        if (!server->pool) return -1;
+    }
+    return 0;
+}
+
+int server_run(SegmentSet **set, const char *index_dir, size_t cache_bytes, int record_stats, int num_workers,
+               FILE *in, FILE *out) {
+    if (!set || !*set || !in || !out) return 1;
+    if (num_workers < 1) num_workers = 1;
+    ServerState server;
+    if (server_init(&server, cache_bytes, num_workers, record_stats, out) != 0) {
+        server_free(&server);
+        return 1;
+    }
+
+    fprintf(out, "READY %d\n", (*set)->live_docs);
+    fflush(out);
+
+    long long last_check = monotonic_ms();
+
+    char payload[SERVER_MAX_PAYLOAD + 1];
+    while (1) {
+        char command[32];
+        long payload_len;
+        int limit;
+        char model[32];
+        int status = read_header(in, command, sizeof(command), &payload_len, &limit, model, sizeof(model));
+        if (status == -1) break;
+        if (status == -2) {
+            drain(&server);
+            fprintf(out, "ERR bad header\n");
+            fflush(out);
+            continue;
+        }
+        if (status == -3) {
+            // 读掉过长的负载，保证下一个请求从头部开始
+            long remaining = payload_len;
+            while (remaining > 0) {
+                size_t chunk = remaining > SERVER_MAX_PAYLOAD ? SERVER_MAX_PAYLOAD : (size_t)remaining;
+                if (fread(payload, 1, chunk, in) != chunk) break;
+                remaining -= (long)chunk;
+            }
+            if (remaining > 0) break;
+            drain(&server);
+            fprintf(out, "ERR payload too large\n");
+            fflush(out);
+            continue;
+        }
+
+        if (fread(payload, 1, (size_t)payload_len, in) != (size_t)payload_len) break;
+        payload[payload_len] = '\0';
+
+        if (index_dir) reload_if_stale(&server, set, index_dir, &last_check);
+        if (strcmp(command, "search") == 0 || strcmp(command, "profile") == 0 || strcmp(command, "suggest") == 0) {
+            // 等待最早的请求槽空出（序号相差num_jobs的请求已写出响应）
+            unsigned long long seq = server.next_seq;
+            mutex_lock(&server.lock);
+            while (seq - server.written >= (unsigned long long)server.num_jobs) {
+                cond_wait(&server.turn, &server.lock);
+            }
+            mutex_unlock(&server.lock);
+            ServerJob *job = &server.jobs[seq % server.num_jobs];
+            job->server = &server;
+            job->seq = seq;
+            job->set = *set;
+            job->limit = limit;
+            snprintf(job->command, sizeof(job->command), "%s", command);
+            snprintf(job->model, sizeof(job->model), "%s", model);
+            memcpy(job->payload, payload, (size_t)payload_len + 1);
+            server.next_seq++;
+            if (server.pool) worker_pool_submit(server.pool, run_job, job);
+            else run_job(job, 0);
+            continue;
+        }
+
+        // 其余命令在读取线程中执行：先等已分发的请求写出响应，保持响应顺序
+        drain(&server);
+        if (strcmp(command, "histograms") == 0) {
+            handle_histograms(out);
+        } else if (strcmp(command, "stats") == 0) {
+            handle_stats(&server, out);
+        } else if (strcmp(command, "quit") == 0) {
+            fprintf(out, "OK 0\n");
+            fflush(out);
+            break;
+        } else {
+            fprintf(out, "ERR unknown command\n");
+        }
+        fflush(out);
+    }
+    drain(&server);
+    server_free(&server);
+    return 0;
+}
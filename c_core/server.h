@@ -0,0 +1,57 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdio.h>
+#include "segment.h"
+#include "search.h"
+#include "segment_set.h"
+
+// 常驻服务模式的分帧协议（stdin/stdout，供build_bridge.py长期持有一个引擎进程）
+//
+// 启动后先输出一行：READY <文档数>
+// 索引目录的清单被修改（增量添加或后台合并）后，下一个请求前重新打开段集合，之后的请求使用新的段
+// 搜索结果经过查询结果缓存（见query_cache.h），重新打开段集合后缓存随generation变化自动清空；
+//
+// 读取线程逐个读取请求；search、profile、suggest分发给工作线程池（见worker_pool.h）并发执行，
+// 所有工作线程共享同一个只读的段集合，各自使用自己的查询上下文（见search.h）与查询缓存。
+// 缓存不在线程之间共享：cache_bytes是总上限，每个线程的缓存上限为cache_bytes/num_workers，一个查询只在
+// 缓存了它的线程上命中。线程越多，同样的总上限下每个缓存容纳的查询越少、命中率越低，需要时按线程数调大上限；
+// stats命令返回各线程缓存的合计。
+// 执行查询时不持有任何全局锁；超过门槛的重查询还会在段内并行打分（见search.h），各工作线程的分片与区间任务
+// 共用一个CPU核数个线程的池，并发的重查询在池中排队，不会按工作线程数成倍地增加线程。
+// 稳定之后执行搜索本身不再向系统申请内存（普通查询用查询上下文的arena，规范化用缓存的arena），
+// 仍使用malloc的只有：缓存未命中的布尔查询的解析与求值（见query.h）、把未命中的结果复制进新缓存项、
+// suggest的候选列表。
+// 响应严格按请求的顺序写出（客户端可以连续发送多个请求再按序读取响应）：先完成的请求等待前面的响应写出，
+// 一个慢查询会推迟其后的响应，但不妨碍其他工作线程继续执行后面的请求。
+// 其余命令（stats、histograms、quit）与替换段集合都先等待已分发的请求完成，再在读取线程中执行
+// 请求：一行头部 "<命令> <负载字节数> [结果上限] [打分模型]\n"，后跟负载字节（查询词或前缀，UTF-8）
+//   search  <len> [limit] [tfidf|bm25]  搜索，负载为查询词（默认TF-IDF，未知的模型返回ERR）
+//   suggest <len> [limit]  前缀建议，负载为前缀
+//   stats   0              查询缓存的计数器
+//   profile <len> [limit] [tfidf|bm25]  不经过缓存执行一次搜索，返回这次查询的分阶段耗时与计数器（见query_stats.h）
+//   histograms 0           进程内各阶段耗时的直方图与计数器合计
+//   quit    0              退出
+// 响应：成功为 "OK <行数>\n" 后跟每行一个结果，失败为 "ERR <原因>\n"
+//   头部无法解析时返回 "ERR bad header"（不读取负载）；负载超过SERVER_MAX_PAYLOAD时读掉负载并返回
+//   "ERR payload too large"
+//   search  结果行："<分数>\t<文档路径>"
+//   suggest 结果行："<词条>"（按文档频率降序，至多SERVER_DEFAULT_LIMIT个）
+//   stats   结果行："<名称> <值>"（cache_hits、cache_misses、cache_evictions、cache_invalidations、
+//           cache_entries、cache_bytes、cache_max_bytes）
+//   profile、histograms  一行JSON
+// record_stats非0时每次实际执行的搜索（缓存未命中）都计入直方图；profile总是计入
+#define SERVER_MAX_PAYLOAD 4096
+#define SERVER_DEFAULT_LIMIT SEARCH_DEFAULT_TOP_K
+#define SERVER_SUGGEST_LIMIT 5
+#define SERVER_RELOAD_CHECK_MS 100 // 检查清单是否变化的最小间隔
+#define SERVER_JOBS_PER_WORKER 4   // 每个工作线程可同时排队的请求数（读取线程在请求槽用完时等待）
+
+// 处理请求直到输入结束或收到quit，返回0表示正常退出
+// *set为已打开的段集合；index_dir非NULL时清单变化后会替换*set（旧集合由server_run关闭），调用者最后关闭*set
+// cache_bytes为各工作线程的查询结果缓存合计的内存上限（0表示不缓存，每个线程cache_bytes/num_workers），record_stats见上
+// num_workers为执行请求的工作线程数，为1时不创建线程，请求直接在读取线程中执行
+int server_run(SegmentSet **set, const char *index_dir, size_t cache_bytes, int record_stats, int num_workers,
+               FILE *in, FILE *out);
+
+#endif
@@ -1,5 +1,8 @@
 #include "tfidf.h"
+#include "topk.h"
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
 
 double calculate_tfidf(int term_freq, int doc_count, int total_docs) {
     if (doc_count == 0) return 0.0;
@@ -13,73 +16,454 @@ double calculate_tfidf(int term_freq, int doc_count, int total_docs) {
     return tf * idf;
 }
 
-DocScore* calculate_document_scores(InvertedIndex *index, char **terms, int num_terms, int *result_count) {
-    if (!index || !terms || num_terms <= 0) {
-        *result_count = 0;
+double calculate_bm25_idf(int doc_count, int total_docs) {
+    return log(1.0 + (total_docs - doc_count + 0.5) / (doc_count + 0.5));
+}
+
+void scoring_params_init(ScoringParams *params, ScoringModel model, int total_docs, double avg_doc_length) {
+    params->model = model;
+    params->k1 = BM25_DEFAULT_K1;
+    params->b = BM25_DEFAULT_B;
+    params->total_docs = total_docs;
+    params->avg_doc_length = avg_doc_length;
+    params->counters = NULL;
+    params->scratch = NULL;
+    params->doc_begin = 0;
+    params->doc_end = 0;
+}
+
+int parse_scoring_model(const char *name, ScoringModel *model) {
+    if (!name) return -1;
+    if (strcmp(name, "tfidf") == 0) {
+        *model = SCORING_MODEL_TFIDF;
+    } else if (strcmp(name, "bm25") == 0) {
+        *model = SCORING_MODEL_BM25;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+const char* scoring_model_name(ScoringModel model) {
+    return model == SCORING_MODEL_BM25 ? "bm25" : "tfidf";
+}
+
+// 按文档ID分页的分数累加器：页在第一次被命中时才分配，
+// 大语料上只为实际匹配的文档区间付出内存，且每次累加都是O(1)的数组访问；
+// 使用scratch时页从arena复用，分配后只清空seen位图，分数在文档第一次命中时清零
+#define ACCUMULATOR_PAGE_BITS 10
+#define ACCUMULATOR_PAGE_SIZE (1 << ACCUMULATOR_PAGE_BITS)
+
+// 上界放宽系数：上界与实际分数的累加顺序不同，浮点舍入可能使上界略小于实际分数，
+// 放宽后剪枝只会更保守，不会漏掉能进入前k名的文档
+#define SCORE_BOUND_SLACK (1.0 + 1e-9)
+
+// 词条的postings长度不小于已命中文档数的1/4时才检查能否转入剪枝阶段（检查本身要扫描一遍命中文档）
+#define SCORE_PRUNE_CHECK_RATIO 4
+
+typedef struct AccumulatorPage {
+    double scores[ACCUMULATOR_PAGE_SIZE];
+    uint64_t seen[ACCUMULATOR_PAGE_SIZE / 64]; // 已命中的文档（分数可能为0，不能用分数判断）
+} AccumulatorPage;
+
+typedef struct Accumulators {
+    Arena *arena;
+    AccumulatorPage **pages;
+    int num_pages;
+    int *touched; // 命中过的文档ID，最后只扫描这些文档
+    int num_touched;
+    int touched_capacity;
+    int allocations; // 页与touched数组的分配次数
+} Accumulators;
+
+static size_t page_table_size(const Accumulators *acc) {
+    return (acc->num_pages > 0 ? acc->num_pages : 1) * sizeof(AccumulatorPage*);
+}
+
+static int accumulators_init(Accumulators *acc, int num_docs, Arena *arena) {
+    acc->arena = arena;
+    acc->num_pages = (num_docs + ACCUMULATOR_PAGE_SIZE - 1) / ACCUMULATOR_PAGE_SIZE;
+    acc->pages = (AccumulatorPage**)arena_alloc(arena, page_table_size(acc));
+    acc->touched = NULL;
+    acc->num_touched = 0;
+    acc->touched_capacity = 0;
+    acc->allocations = 1;
+    if (!acc->pages) return -1;
+    memset(acc->pages, 0, page_table_size(acc));
+    return 0;
+}
+
+static void accumulators_free(Accumulators *acc) {
+    for (int i = 0; i < acc->num_pages; i++) arena_release(acc->arena, acc->pages[i], sizeof(AccumulatorPage));
+    arena_release(acc->arena, acc->pages, page_table_size(acc));
+    arena_release(acc->arena, acc->touched, acc->touched_capacity * sizeof(int));
+}
+
+static inline void accumulators_add(Accumulators *acc, int doc_id, double score) {
+    int page_id = doc_id >> ACCUMULATOR_PAGE_BITS;
+    if (doc_id < 0 || page_id >= acc->num_pages) return;
+
+    AccumulatorPage *page = acc->pages[page_id];
+    if (!page) {
+        page = (AccumulatorPage*)arena_alloc(acc->arena, sizeof(AccumulatorPage));
+        if (!page) return;
+        memset(page->seen, 0, sizeof(page->seen));
+        acc->pages[page_id] = page;
+        acc->allocations++;
+    }
+
+    int slot = doc_id & (ACCUMULATOR_PAGE_SIZE - 1);
+    uint64_t bit = 1ULL << (slot & 63);
+    if (!(page->seen[slot >> 6] & bit)) {
+        page->seen[slot >> 6] |= bit;
+        page->scores[slot] = 0.0;
+        if (acc->num_touched == acc->touched_capacity) {
+            int capacity = acc->touched_capacity ? acc->touched_capacity * 2 : 256;
+            int *touched = (int*)arena_grow(acc->arena, acc->touched, acc->touched_capacity * sizeof(int),
+                                            capacity * sizeof(int));
+            if (!touched) return;
+            acc->touched = touched;
+            acc->touched_capacity = capacity;
+            acc->allocations++;
+        }
+        acc->touched[acc->num_touched++] = doc_id;
+    }
+    page->scores[slot] += score;
+}
+
+static inline double accumulators_get(const Accumulators *acc, int doc_id) {
+    return acc->pages[doc_id >> ACCUMULATOR_PAGE_BITS]->scores[doc_id & (ACCUMULATOR_PAGE_SIZE - 1)];
+}
+
+// 打分顺序：按词条分数上界降序（同上界按输入下标），穷举与剪枝两种方式使用同一顺序，
+// 每个文档的分数以相同顺序累加，结果逐位一致
+typedef struct TermOrder {
+    int index;    // 在输入词条数组中的下标
+    double idf;   // 每个词条只算一次，不在postings循环中重复计算
+    double bound; // 词条级分数上界（最大词频对应的分数）
+} TermOrder;
+
+static int compare_term_order(const void *a, const void *b) {
+    const TermOrder *order_a = (const TermOrder*)a;
+    const TermOrder *order_b = (const TermOrder*)b;
+    if (order_a->bound > order_b->bound) return -1;
+    if (order_a->bound < order_b->bound) return 1;
+    return order_a->index - order_b->index;
+}
+
+// TF-IDF的词频权重log10(1+tf)：常见的小词频查表
+#define TF_WEIGHT_CACHE_SIZE 64
+
+// 一次打分调用的模型状态：与词条无关的部分在这里预先算好，postings循环中只剩查表与一次乘除
+typedef struct Scorer {
+    ScoringModel model;
+    int total_docs;
+    double tf_weights[TF_WEIGHT_CACHE_SIZE]; // TF-IDF：log10(1+tf)
+    double k1_plus_1;                        // BM25：k1+1
+    double norms[256];                       // BM25：k1×(1-b+b×dl/avgdl)，按量化长度编码查表
+    double min_norm;                         // norms中的最小值（分数上界用）
+    const uint8_t *doc_lengths;
+} Scorer;
+
+static void scorer_init(Scorer *scorer, const Segment *segment, const ScoringParams *params) {
+    scorer->model = params ? params->model : SCORING_MODEL_TFIDF;
+    scorer->total_docs = params && params->total_docs > 0 ? params->total_docs : segment->num_docs;
+    for (int tf = 0; tf < TF_WEIGHT_CACHE_SIZE; tf++) scorer->tf_weights[tf] = log10(1 + tf);
+    scorer->doc_lengths = segment->doc_lengths;
+    scorer->k1_plus_1 = 0.0;
+    scorer->min_norm = 0.0;
+    if (scorer->model != SCORING_MODEL_BM25) return;
+
+    double avg_doc_length = params->avg_doc_length;
+    if (avg_doc_length <= 0) {
+        uint64_t total = 0;
+        for (int doc_id = 0; doc_id < segment->num_docs; doc_id++) {
+            total += segment_decode_doc_length(segment->doc_lengths[doc_id]);
+        }
+        avg_doc_length = segment->num_docs > 0 ? (double)total / segment->num_docs : 0.0;
+    }
+    if (avg_doc_length <= 0) avg_doc_length = 1.0;
+    scorer->k1_plus_1 = params->k1 + 1.0;
+    for (int code = 0; code < 256; code++) {
+        double length = segment_decode_doc_length((uint8_t)code);
+        scorer->norms[code] = params->k1 * (1.0 - params->b + params->b * length / avg_doc_length);
+    }
+    // 编码越大长度越长：b>=0时编码0的因子最小
+    scorer->min_norm = scorer->norms[0] < scorer->norms[255] ? scorer->norms[0] : scorer->norms[255];
+}
+
+static inline double scorer_idf(const Scorer *scorer, int doc_count) {
+    if (doc_count <= 0) return 0.0;
+    return scorer->model == SCORING_MODEL_BM25 ? calculate_bm25_idf(doc_count, scorer->total_docs)
+                                               : log10((double)scorer->total_docs / doc_count);
+}
+
+static inline double tf_weight(const Scorer *scorer, int term_freq) {
+    return term_freq < TF_WEIGHT_CACHE_SIZE ? scorer->tf_weights[term_freq] : log10(1 + term_freq);
+}
+
+// 单个posting的分数（TF-IDF时与calculate_tfidf逐位一致）
+static inline double scorer_score(const Scorer *scorer, double idf, int doc_id, int term_freq) {
+    if (scorer->model == SCORING_MODEL_BM25) {
+        double tf = term_freq;
+        return idf * (tf * scorer->k1_plus_1) / (tf + scorer->norms[scorer->doc_lengths[doc_id]]);
+    }
+    return tf_weight(scorer, term_freq) * idf;
+}
+
+// 词频不超过max_tf的posting的分数上界
+static inline double scorer_bound(const Scorer *scorer, double idf, int max_tf) {
+    if (scorer->model == SCORING_MODEL_BM25) {
+        double tf = max_tf;
+        return tf > 0 ? idf * (tf * scorer->k1_plus_1) / (tf + scorer->min_norm) : 0.0;
+    }
+    return tf_weight(scorer, max_tf) * idf;
+}
+
+// 按模型计算各词条的IDF与上界，并排好打分顺序（排序的临时缓冲区从scratch分配）
+static void order_terms(const Scorer *scorer, const TermHandle *terms, int num_terms, TermOrder *order,
+                        Arena *scratch) {
+    for (int i = 0; i < num_terms; i++) {
+        order[i].index = i;
+        order[i].idf = scorer_idf(scorer, terms[i].doc_count);
+        order[i].bound = scorer_bound(scorer, order[i].idf, terms[i].max_tf);
+    }
+    arena_sort(scratch, order, num_terms, sizeof(TermOrder), compare_term_order);
+}
+
+static int compare_doc_ids(const void *a, const void *b) {
+    int doc_a = *(const int*)a;
+    int doc_b = *(const int*)b;
+    return (doc_a > doc_b) - (doc_a < doc_b);
+}
+
+// 当前累加分数中的第k高分（命中文档不足k个时返回-1）
+static double kth_best_score(const Accumulators *acc, int k) {
+    TopK topk;
+    if (topk_init(&topk, k, acc->arena) != 0) return -1.0;
+    for (int i = 0; i < acc->num_touched; i++) {
+        topk_push(&topk, acc->touched[i], accumulators_get(acc, acc->touched[i]));
+    }
+    double threshold = topk_threshold(&topk);
+    topk_free(&topk);
+    return threshold;
+}
+
+// 剪枝阶段：未命中文档的分数上界已低于门槛，只对候选文档继续累加剩余词条。
+// 候选文档按文档ID升序，游标借助跳表头跳到候选文档；块级上界不够门槛的候选直接淘汰，不解码该块。
+// 返回剩余的候选文档数（candidates原地压缩）
+static int score_candidates(const Segment *segment, const Scorer *scorer, const TermHandle *terms,
+                            const TermOrder *order, const double *suffix_bound, int first, int num_terms,
+                            double threshold, Accumulators *acc, int *candidates, int num_candidates,
+                            long long *postings) {
+    for (int i = first; i < num_terms && num_candidates > 0; i++) {
+        const TermHandle *term = &terms[order[i].index];
+        double idf = order[i].idf;
+        double rest = suffix_bound[i + 1]; // 之后各词条的上界之和
+        PostingCursor cursor;
+        if (!segment_posting_cursor(segment, term, &cursor)) continue;
+
+        int block = 0;
+        double block_score = -1.0;
+        int kept = 0;
+        for (int c = 0; c < num_candidates; c++) {
+            int doc_id = candidates[c];
+            double score = accumulators_get(acc, doc_id);
+
+            // 只查跳表头：候选文档所在块的分数上界
+            int previous = block;
+            while (block < cursor.num_blocks && (int)cursor.blocks[block].last_doc_id < doc_id) block++;
+            if (block != previous || block_score < 0) {
+                block_score = block < cursor.num_blocks
+                    ? scorer_bound(scorer, idf, (int)cursor.blocks[block].max_tf)
+                    : 0.0;
+            }
+            if ((score + block_score + rest) * SCORE_BOUND_SLACK < threshold) continue;
+
+            if (block < cursor.num_blocks) {
+                (*postings)++;
+                if (posting_cursor_advance(&cursor, doc_id) && cursor.doc_id == doc_id) {
+                    accumulators_add(acc, doc_id, scorer_score(scorer, idf, doc_id, cursor.term_frequency));
+                    score = accumulators_get(acc, doc_id);
+                }
+            }
+            if ((score + rest) * SCORE_BOUND_SLACK < threshold) continue;
+            candidates[kept++] = doc_id;
+        }
+        num_candidates = kept;
+    }
+    return num_candidates;
+}
+
+// 逐词条（term-at-a-time）累加打分；prune非0时启用MaxScore剪枝
+static DocScore* score_terms(const Segment *segment, const TermHandle *terms, int num_terms,
+                             const uint64_t *live_docs, const ScoringParams *params, int k, int prune,
+                             int *result_count) {
+    *result_count = 0;
+    if (!segment || !terms || num_terms <= 0) {
         return NULL;
     }
+    int num_docs = segment->num_docs;
+    int doc_begin = params && params->doc_begin > 0 ? params->doc_begin : 0;
+    int doc_end = params && params->doc_end > 0 && params->doc_end < num_docs ? params->doc_end : num_docs;
+    Scorer scorer;
+    scorer_init(&scorer, segment, params);
+    Arena *scratch = params ? params->scratch : NULL;
     
-    // 使用哈希表存储文档分数
-    DocScore *scores = NULL;
-    *result_count = 0;
+    TermOrder *order = (TermOrder*)arena_alloc(scratch, num_terms * sizeof(TermOrder));
+    double *suffix_bound = (double*)arena_alloc(scratch, (num_terms + 1) * sizeof(double));
+    Accumulators acc;
+    if (!order || !suffix_bound || accumulators_init(&acc, num_docs, scratch) != 0) {
+        arena_release(scratch, order, num_terms * sizeof(TermOrder));
+        arena_release(scratch, suffix_bound, (num_terms + 1) * sizeof(double));
+        return NULL;
+    }
+    order_terms(&scorer, terms, num_terms, order, scratch);
+    suffix_bound[num_terms] = 0.0;
+    for (int i = num_terms - 1; i >= 0; i--) {
+        suffix_bound[i] = suffix_bound[i + 1] + order[i].bound;
+    }
     
+    // 1. 逐词条遍历postings，分数直接累加到文档ID对应的位置
+    int first_pruned = num_terms;
+    double threshold = -1.0;
+    long long postings = 0;
     for (int i = 0; i < num_terms; i++) {
-        const char *term = terms[i];
-        Posting *postings = inverted_index_get_postings(index, term);
-        
-        if (!postings) continue;
+        const TermHandle *term = &terms[order[i].index];
+        double idf = order[i].idf;
         
-        // 查找该词的文档计数
-        unsigned int bucket = hash_function(term, index->num_buckets);
-        IndexNode *node = index->buckets[bucket];
-        while (node && strcmp(node->term, term) != 0) {
-            node = node->next;
+        // 处理较长的postings之前检查：剩余词条的上界之和若已低于当前第k高分，
+        // 未命中的文档不可能再进入前k名，转入只对候选文档累加的剪枝阶段
+        if (prune && k > 0 && acc.num_touched >= k
+            && (int64_t)term->doc_count * SCORE_PRUNE_CHECK_RATIO >= acc.num_touched) {
+            threshold = kth_best_score(&acc, k);
+            if (suffix_bound[i] * SCORE_BOUND_SLACK < threshold) {
+                first_pruned = i;
+                break;
+            }
         }
         
-        if (!node) continue;
-        int doc_count = node->doc_count;
+        PostingCursor cursor;
+        if (!segment_posting_cursor(segment, term, &cursor)) continue;
         
-        // 计算每个文档的TF-IDF并累加
-        Posting *post = postings;
-        while (post) {
-            double tfidf = calculate_tfidf(post->term_frequency, doc_count, index->num_docs);
-            
-            // 检查文档是否已在分数列表中
-            int found = 0;
-            for (int j = 0; j < *result_count; j++) {
-                if (scores[j].doc_id == post->doc_id) {
-                    scores[j].score += tfidf;
-                    found = 1;
-                    break;
-                }
-            }
-            
-            // 如果不在列表中，添加新条目
-            if (!found) {
-                *result_count += 1;
-                scores = (DocScore*)realloc(scores, *result_count * sizeof(DocScore));
-                scores[*result_count - 1].doc_id = post->doc_id;
-                scores[*result_count - 1].score = tfidf;
+        // 直接在压缩块上迭代，计算每个文档的分数并累加（已删除的文档不进入累加器，也就不会成为候选）；
+        // 只打分一个区间时借助跳表头跳到区间起点，越过区间终点即停止
+        int more = doc_begin > 0 ? posting_cursor_advance(&cursor, doc_begin) : posting_cursor_next(&cursor);
+        for (; more && cursor.doc_id < doc_end; more = posting_cursor_next(&cursor)) {
+            postings++;
+            if (!DOC_IS_LIVE(live_docs, cursor.doc_id)) continue;
+            accumulators_add(&acc, cursor.doc_id, scorer_score(&scorer, idf, cursor.doc_id, cursor.term_frequency));
+        }
+    }
+    
+    // 2. 剪枝阶段：只保留上界够得着门槛的候选文档
+    int *candidates = acc.touched;
+    int num_candidates = acc.num_touched;
+    if (first_pruned < num_terms) {
+        int kept = 0;
+        for (int i = 0; i < acc.num_touched; i++) {
+            int doc_id = acc.touched[i];
+            if ((accumulators_get(&acc, doc_id) + suffix_bound[first_pruned]) * SCORE_BOUND_SLACK >= threshold) {
+                candidates[kept++] = doc_id;
             }
-            
-            post = post->next;
         }
+        arena_sort(scratch, candidates, kept, sizeof(int), compare_doc_ids);
+        num_candidates = score_candidates(segment, &scorer, terms, order, suffix_bound, first_pruned, num_terms,
+                                          threshold, &acc, candidates, kept, &postings);
     }
     
+    // 3. 只把候选文档送入有界小顶堆，不对全部匹配文档排序
+    TopK topk;
+    DocScore *scores = NULL;
+    if (topk_init(&topk, k, scratch) == 0) {
+        for (int i = 0; i < num_candidates; i++) {
+            topk_push(&topk, candidates[i], accumulators_get(&acc, candidates[i]));
+        }
+        scores = topk_finish(&topk, result_count);
+    }
+    if (params && params->counters) {
+        params->counters->postings += postings;
+        params->counters->accumulators += acc.num_touched;
+        if (!scratch) params->counters->allocations += acc.allocations + 3; // 另有order、suffix_bound与小顶堆
+    }
+    accumulators_free(&acc);
+    arena_release(scratch, order, num_terms * sizeof(TermOrder));
+    arena_release(scratch, suffix_bound, (num_terms + 1) * sizeof(double));
     return scores;
 }
 
+DocScore* calculate_document_scores(const Segment *segment, const TermHandle *terms, int num_terms,
+                                    const uint64_t *live_docs, const ScoringParams *params, int k,
+                                    int *result_count) {
+    return score_terms(segment, terms, num_terms, live_docs, params, k, 0, result_count);
+}
+
+DocScore* calculate_document_scores_pruned(const Segment *segment, const TermHandle *terms, int num_terms,
+                                           const uint64_t *live_docs, const ScoringParams *params, int k,
+                                           int *result_count) {
+    return score_terms(segment, terms, num_terms, live_docs, params, k, 1, result_count);
+}
+
+DocScore* calculate_candidate_scores(const Segment *segment, const TermHandle *terms, int num_terms,
+                                     const int *candidates, int num_candidates, const ScoringParams *params, int k,
+                                     int *result_count) {
+    *result_count = 0;
+    if (!segment || num_terms < 0 || !candidates || num_candidates <= 0) {
+        return NULL;
+    }
+    Scorer scorer;
+    scorer_init(&scorer, segment, params);
+    Arena *scratch = params ? params->scratch : NULL;
+    
+    size_t order_size = (num_terms > 0 ? num_terms : 1) * sizeof(TermOrder);
+    TermOrder *order = (TermOrder*)arena_alloc(scratch, order_size);
+    double *scores = (double*)arena_alloc(scratch, num_candidates * sizeof(double));
+    TopK topk;
+    if (!order || !scores || topk_init(&topk, k, scratch) != 0) {
+        arena_release(scratch, order, order_size);
+        arena_release(scratch, scores, num_candidates * sizeof(double));
+        return NULL;
+    }
+    memset(scores, 0, num_candidates * sizeof(double));
+    order_terms(&scorer, terms, num_terms, order, scratch);
+    
+    // 候选文档升序，游标只前进不后退：借助跳表头跳过候选之间的块，只解码含候选文档的块
+    long long postings = 0;
+    for (int i = 0; i < num_terms; i++) {
+        PostingCursor cursor;
+        if (!segment_posting_cursor(segment, &terms[order[i].index], &cursor)) continue;
+        for (int c = 0; c < num_candidates; c++) {
+            postings++;
+            if (!posting_cursor_advance(&cursor, candidates[c])) break;
+            if (cursor.doc_id != candidates[c]) continue;
+            scores[c] += scorer_score(&scorer, order[i].idf, candidates[c], cursor.term_frequency);
+        }
+    }
+    for (int c = 0; c < num_candidates; c++) {
+        topk_push(&topk, candidates[c], scores[c]);
+    }
+    DocScore *results = topk_finish(&topk, result_count);
+    if (params && params->counters) {
+        params->counters->postings += postings;
+        params->counters->accumulators += num_candidates;
+        if (!scratch) params->counters->allocations += 3; // order、scores与小顶堆
+    }
+    arena_release(scratch, order, order_size);
+    arena_release(scratch, scores, num_candidates * sizeof(double));
+    return results;
+}
+
 // 快速排序比较函数
 static int compare_scores(const void *a, const void *b) {
     DocScore *score_a = (DocScore*)a;
     DocScore *score_b = (DocScore*)b;
     
-    // 降序排列
+    // 降序排列，同分按文档ID升序（与TopK的排名规则一致）
     if (score_a->score < score_b->score) return 1;
     if (score_a->score > score_b->score) return -1;
-    return 0;
+    return (score_a->doc_id > score_b->doc_id) - (score_a->doc_id < score_b->doc_id);
 }
 
-void sort_doc_scores(DocScore *scores, int count) {
-    qsort(scores, count, sizeof(DocScore), compare_scores);
+void sort_doc_scores(DocScore *scores, int count, Arena *scratch) {
+    arena_sort(scratch, scores, count, sizeof(DocScore), compare_scores);
 }
\ No newline at end of file
@@ -3,20 +3,84 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include "inverted_index.h"
+#include "segment.h"
+#include "arena.h"
 
 typedef struct DocScore {
     int doc_id;
     double score;
 } DocScore;
 
+// 打分模型（每次查询可选，同一索引上两者都能直接使用）
+typedef enum ScoringModel {
+    SCORING_MODEL_TFIDF = 0, // log10(1+tf) × log10(N/df)，不做文档长度归一化
+    SCORING_MODEL_BM25       // idf × tf×(k1+1) / (tf + k1×(1-b+b×dl/avgdl))，idf = ln(1 + (N-df+0.5)/(df+0.5))
+} ScoringModel;
+
+#define BM25_DEFAULT_K1 1.2
+#define BM25_DEFAULT_B 0.75
+
+// 打分函数的计数器（查询统计用，见query_stats.h），每次调用累加
+typedef struct ScoringCounters {
+    long long postings;     // 解码的postings数：全量遍历的每个posting，加上跳到候选文档的每次探测
+    long long accumulators; // 累加器中命中的文档数（只对候选打分时为候选文档数）
+    long long allocations;  // 打分过程中的堆分配次数（使用scratch时不在这里计，见ScoringParams）
+    long long parallel_ranges; // 段内并行打分切出的区间数（整段在调用线程中打分时不计，见search.h）
+} ScoringCounters;
+
+// 打分参数：模型与全局统计
+typedef struct ScoringParams {
+    ScoringModel model;
+    double k1;             // BM25词频饱和参数
+    double b;              // BM25长度归一化程度（0表示不归一化，1表示完全按长度比例）
+    int total_docs;        // N：多段索引时为所有段的存活文档总数（<=0表示segment->num_docs）
+    double avg_doc_length; // avgdl：所有段存活文档的平均长度（<=0表示按段自身的文档长度计算）
+    ScoringCounters *counters; // 非NULL时累加计数（多线程打分时每个线程使用自己的计数器）
+    Arena *scratch;        // 非NULL时临时内存与返回的结果都从这里分配（结果不必释放，随arena_reset作废）；
+                           // 同一时间只能由一个线程使用。NULL表示malloc，结果由调用者free
+    int doc_begin;         // 只对段内文档ID在[doc_begin, doc_end)内的文档打分（doc_end<=0表示到段末尾）：
+    int doc_end;           // 把段切成几个区间分别打分再合并各区间的前k名，与整段打分的结果相同
+                           // （calculate_candidate_scores只看候选文档，不使用区间）
+} ScoringParams;
+
+// 填充参数（k1、b取默认值，不计数，不使用scratch，打分范围为整个段）
+void scoring_params_init(ScoringParams *params, ScoringModel model, int total_docs, double avg_doc_length);
+
+// 解析打分模型名称（"tfidf"/"bm25"），无法识别返回-1
+int parse_scoring_model(const char *name, ScoringModel *model);
+const char* scoring_model_name(ScoringModel model);
+
 // 计算TF-IDF分数
 double calculate_tfidf(int term_freq, int doc_count, int total_docs);
+// BM25的IDF（始终为正）
+double calculate_bm25_idf(int doc_count, int total_docs);
+
+// 为一组词条句柄计算文档分数，返回分数最高的k个文档（已按分数降序、同分按文档ID升序排好）
+// 分数按文档ID累加（分页累加器），再经有界小顶堆选出前k名；k<=0表示返回全部匹配文档
+// 词条按分数上界降序处理（上界由段文件中的最大词频得到），每个文档的分数都按这一顺序累加
+// IDF使用句柄中的文档频率与params->total_docs（多段索引时两者都是所有段的合计），每个词条只算一次；
+// params为NULL时按TF-IDF打分。BM25的长度归一化因子按段中量化的文档长度预先查表，每个posting只做一次除法
+// live_docs为段的存活文档位图（NULL表示没有删除），已删除的文档不参与累加
+DocScore* calculate_document_scores(const Segment *segment, const TermHandle *terms, int num_terms,
+                                    const uint64_t *live_docs, const ScoringParams *params, int k,
+                                    int *result_count);
+
+// 带动态剪枝（MaxScore）的打分，结果与calculate_document_scores完全一致：
+// 剩余词条的上界之和低于当前第k高分后，不再接纳新文档，只对候选文档继续累加；
+// 此时游标借助跳表头跳到候选文档，块级最大词频不够门槛的候选文档直接淘汰，不解码该块
+// 分数上界：TF-IDF按最大词频；BM25按最大词频与最短文档长度（上界偏松，剪枝更保守，结果不变）
+DocScore* calculate_document_scores_pruned(const Segment *segment, const TermHandle *terms, int num_terms,
+                                           const uint64_t *live_docs, const ScoringParams *params, int k,
+                                           int *result_count);
 
-// 为一组词计算文档分数
-DocScore* calculate_document_scores(InvertedIndex *index, char **terms, int num_terms, int *result_count);
+// 只对候选文档（段内文档ID升序，如布尔查询的匹配结果）打分，返回前k名；没有命中任何词条的候选分数为0
+// 词条的累加顺序与上面两个函数相同，同一文档的分数逐位一致；游标借助跳表头跳到候选文档，
+// 只解码含候选文档的块，候选远少于postings时代价与候选数成正比
+DocScore* calculate_candidate_scores(const Segment *segment, const TermHandle *terms, int num_terms,
+                                     const int *candidates, int num_candidates, const ScoringParams *params, int k,
+                                     int *result_count);
 
-// 对文档分数进行排序
-void sort_doc_scores(DocScore *scores, int count);
+// 对文档分数进行排序（降序，同分按文档ID升序）；排序的临时缓冲区从scratch分配，scratch为NULL时使用qsort
+void sort_doc_scores(DocScore *scores, int count, Arena *scratch);
 
 #endif
\ No newline at end of file
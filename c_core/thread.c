@@ -0,0 +1,196 @@
+#include "thread.h"
+#include <stdlib.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <time.h>
+#endif
+
+// 两个平台的线程入口签名不同，经由统一的启动参数转发
+typedef struct ThreadStart {
+    ThreadFunc func;
+    void *arg;
+} ThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI thread_entry(LPVOID param) {
+#else
+static void* thread_entry(void *param) {
+#endif
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.func(start.arg);
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+int thread_create(ThreadHandle *thread, ThreadFunc func, void *arg) {
+    ThreadStart *start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) return -1;
+    start->func = func;
+    start->arg = arg;
+
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, thread_entry, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return -1;
+    }
+#else
+    if (pthread_create(thread, NULL, thread_entry, start) != 0) {
+        free(start);
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+void thread_join(ThreadHandle thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+#ifdef _WIN32
+int mutex_init(Mutex *mutex) {
+    InitializeSRWLock(mutex);
+    return 0;
+}
+
+void mutex_destroy(Mutex *mutex) {
+    (void)mutex; // SRW锁不需要销毁
+}
+
+void mutex_lock(Mutex *mutex) {
+    AcquireSRWLockExclusive(mutex);
+}
+
+void mutex_unlock(Mutex *mutex) {
+    ReleaseSRWLockExclusive(mutex);
+}
+
+int cond_init(CondVar *cond) {
+    InitializeConditionVariable(cond);
+    return 0;
+}
+
+void cond_destroy(CondVar *cond) {
+    (void)cond;
+}
+
+void cond_wait(CondVar *cond, Mutex *mutex) {
+    SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+}
+
+void cond_wait_ms(CondVar *cond, Mutex *mutex, int ms) {
+    SleepConditionVariableSRW(cond, mutex, ms > 0 ? (DWORD)ms : 0, 0);
+}
+
+void cond_signal(CondVar *cond) {
+    WakeConditionVariable(cond);
+}
+
+void cond_broadcast(CondVar *cond) {
+    WakeAllConditionVariable(cond);
+}
+#else
+int mutex_init(Mutex *mutex) {
+    return pthread_mutex_init(mutex, NULL) == 0 ? 0 : -1;
+}
+
+void mutex_destroy(Mutex *mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+void mutex_lock(Mutex *mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void mutex_unlock(Mutex *mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+int cond_init(CondVar *cond) {
+    return pthread_cond_init(cond, NULL) == 0 ? 0 : -1;
+}
+
+void cond_destroy(CondVar *cond) {
+    pthread_cond_destroy(cond);
+}
+
+void cond_wait(CondVar *cond, Mutex *mutex) {
+    pthread_cond_wait(cond, mutex);
+}
+
+void cond_wait_ms(CondVar *cond, Mutex *mutex, int ms) {
+    // pthread_cond_timedwait使用CLOCK_REALTIME的绝对时间
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (ms > 0) {
+        deadline.tv_sec += ms / 1000;
+        deadline.tv_nsec += (long)(ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+    pthread_cond_timedwait(cond, mutex, &deadline);
+}
+
+void cond_signal(CondVar *cond) {
+    pthread_cond_signal(cond);
+}
+
+void cond_broadcast(CondVar *cond) {
+    pthread_cond_broadcast(cond);
+}
+#endif
+
+void thread_sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    usleep((useconds_t)ms * 1000);
+#endif
+}
+
+long long monotonic_ms(void) {
+#ifdef _WIN32
+    return (long long)GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+long long monotonic_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (long long)(counter.QuadPart / frequency.QuadPart * 1000000000LL
+                       + counter.QuadPart % frequency.QuadPart * 1000000000LL / frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+int cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = (int)info.dwNumberOfProcessors;
+#else
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? count : 1;
+}
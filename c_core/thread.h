@@ -0,0 +1,49 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+// 线程的跨平台封装（Windows使用Win32线程，其他平台使用pthread）
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE ThreadHandle;
+typedef SRWLOCK Mutex;
+typedef CONDITION_VARIABLE CondVar;
+#else
+#include <pthread.h>
+typedef pthread_t ThreadHandle;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+#endif
+
+typedef void (*ThreadFunc)(void *arg);
+
+// 创建线程执行func(arg)，成功返回0
+int thread_create(ThreadHandle *thread, ThreadFunc func, void *arg);
+// 等待线程结束
+void thread_join(ThreadHandle thread);
+
+// 互斥锁与条件变量（不可重入；cond_wait返回后需重新检查条件），初始化成功返回0
+int mutex_init(Mutex *mutex);
+void mutex_destroy(Mutex *mutex);
+void mutex_lock(Mutex *mutex);
+void mutex_unlock(Mutex *mutex);
+int cond_init(CondVar *cond);
+void cond_destroy(CondVar *cond);
+// 释放mutex并等待唤醒，返回前重新持有mutex
+void cond_wait(CondVar *cond, Mutex *mutex);
+// 同cond_wait，但最多等待ms毫秒（超时返回时同样重新持有mutex）
+void cond_wait_ms(CondVar *cond, Mutex *mutex, int ms);
+void cond_signal(CondVar *cond);
+void cond_broadcast(CondVar *cond);
+
+// 当前线程休眠ms毫秒
+void thread_sleep_ms(int ms);
+
+// 单调时钟的当前毫秒数（只用于计算时间间隔）
+long long monotonic_ms(void);
+// 单调时钟的当前纳秒数（用于计时短操作，如单次查询的各阶段）
+long long monotonic_ns(void);
+
+// 可用的CPU核数（至少为1）
+int cpu_count(void);
+
+#endif
@@ -0,0 +1,155 @@
+#include "tokenizer.h"
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TOKENIZER_X86 1
+#include <immintrin.h>
+#endif
+
+// 扫描状态：上一批结束时是否处在词条中，以及该词条的起始偏移
+typedef struct TokenScan {
+    char *buffer;
+    int in_token;
+    size_t token_start;
+    TokenHandler handler;
+    void *context;
+} TokenScan;
+
+// 字母判断与折叠：(c | 0x20)落在'a'..'z'即为字母，折叠后即为小写
+static inline int is_letter(unsigned char c) {
+    return (unsigned char)((c | 0x20) - 'a') < 26;
+}
+
+static void scan_scalar(TokenScan *scan, size_t begin, size_t end) {
+    char *buffer = scan->buffer;
+    for (size_t i = begin; i < end; i++) {
+        unsigned char c = (unsigned char)buffer[i];
+        if (is_letter(c)) {
+            buffer[i] = (char)(c | 0x20);
+            if (!scan->in_token) {
+                scan->in_token = 1;
+                scan->token_start = i;
+            }
+        } else if (scan->in_token) {
+            scan->in_token = 0;
+            scan->handler(buffer + scan->token_start, i - scan->token_start, scan->context);
+        }
+    }
+}
+
+#ifdef TOKENIZER_X86
+// 一批字节的字母位图（第i位对应base+i）：位图中0/1的每次翻转都是词条的开始或结束
+static inline void scan_mask(TokenScan *scan, uint32_t mask, size_t base, int width) {
+    uint32_t valid = width == 32 ? 0xffffffffu : ((1u << width) - 1);
+    uint32_t transitions = (mask ^ ((mask << 1) | (uint32_t)scan->in_token)) & valid;
+    while (transitions) {
+        int bit = __builtin_ctz(transitions);
+        transitions &= transitions - 1;
+        if (!scan->in_token) {
+            scan->in_token = 1;
+            scan->token_start = base + bit;
+        } else {
+            scan->in_token = 0;
+            scan->handler(scan->buffer + scan->token_start, base + bit - scan->token_start, scan->context);
+        }
+    }
+}
+
+// 向量化的字母判断：把(c | 0x20)平移到有符号字节的最小值附近，一次比较得到是否落在'a'..'z'
+__attribute__((target("sse2")))
+static size_t scan_sse2(TokenScan *scan, size_t begin, size_t end) {
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i shift = _mm_set1_epi8((char)(0x80 - 'a'));
+    const __m128i limit = _mm_set1_epi8((char)(0x80 + 26));
+    size_t i = begin;
+    for (; i + 16 <= end; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(scan->buffer + i));
+        __m128i folded = _mm_or_si128(bytes, case_bit);
+        __m128i letters = _mm_cmplt_epi8(_mm_add_epi8(folded, shift), limit);
+        // 只有字母需要折叠：bytes | (letters & 0x20)
+        _mm_storeu_si128((__m128i*)(scan->buffer + i), _mm_or_si128(bytes, _mm_and_si128(letters, case_bit)));
+        scan_mask(scan, (uint32_t)_mm_movemask_epi8(letters), i, 16);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(TokenScan *scan, size_t begin, size_t end) {
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i shift = _mm256_set1_epi8((char)(0x80 - 'a'));
+    const __m256i limit = _mm256_set1_epi8((char)(0x80 + 26));
+    size_t i = begin;
+    for (; i + 32 <= end; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(scan->buffer + i));
+        __m256i folded = _mm256_or_si256(bytes, case_bit);
+        // AVX2没有有符号小于比较，用limit > x代替
+        __m256i letters = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(folded, shift));
+        _mm256_storeu_si256((__m256i*)(scan->buffer + i), _mm256_or_si256(bytes, _mm256_and_si256(letters, case_bit)));
+        scan_mask(scan, (uint32_t)_mm256_movemask_epi8(letters), i, 32);
+    }
+    return i;
+}
+#endif
+
+int tokenizer_kernel_supported(TokenizerKernel kernel) {
+    switch (kernel) {
+        case TOKENIZER_SCALAR:
+            return 1;
+#ifdef TOKENIZER_X86
+        case TOKENIZER_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case TOKENIZER_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return 0;
+    }
+}
+
+TokenizerKernel tokenizer_detect_kernel(void) {
+    if (tokenizer_kernel_supported(TOKENIZER_AVX2)) return TOKENIZER_AVX2;
+    if (tokenizer_kernel_supported(TOKENIZER_SSE2)) return TOKENIZER_SSE2;
+    return TOKENIZER_SCALAR;
+}
+
+const char* tokenizer_kernel_name(TokenizerKernel kernel) {
+    switch (kernel) {
+        case TOKENIZER_SSE2: return "sse2";
+        case TOKENIZER_AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+size_t tokenize_buffer_with(TokenizerKernel kernel, char *buffer, size_t len, int final,
+                            TokenHandler handler, void *context) {
+    TokenScan scan;
+    scan.buffer = buffer;
+    scan.in_token = 0;
+    scan.token_start = 0;
+    scan.handler = handler;
+    scan.context = context;
+
+    size_t done = 0;
+#ifdef TOKENIZER_X86
+    if (kernel == TOKENIZER_AVX2 && tokenizer_kernel_supported(TOKENIZER_AVX2)) {
+        done = scan_avx2(&scan, 0, len);
+    }
+    if (kernel != TOKENIZER_SCALAR && tokenizer_kernel_supported(TOKENIZER_SSE2)) {
+        done = scan_sse2(&scan, done, len); // AVX2剩下不足32字节的部分也先按16字节处理
+    }
+#else
+    (void)kernel;
+#endif
+    scan_scalar(&scan, done, len);
+
+    if (!scan.in_token) return len;
+    if (final) {
+        handler(buffer + scan.token_start, len - scan.token_start, context);
+        return len;
+    }
+    return scan.token_start;
+}
+
+size_t tokenize_buffer(char *buffer, size_t len, int final, TokenHandler handler, void *context) {
+    return tokenize_buffer_with(tokenizer_detect_kernel(), buffer, len, final, handler, context);
+}
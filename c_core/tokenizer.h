@@ -0,0 +1,32 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <stddef.h>
+
+// 文档与查询共用的分词器：词条是连续的ASCII字母，其他字节都是分隔符，字母原地折叠为小写
+// 字符分类与大小写折叠按16/32字节一批用SSE2/AVX2完成，运行时按CPU选择实现，其他平台使用逐字节实现
+
+// 词条回调：token指向缓冲区内已转为小写的词条字节（不以'\0'结尾），只在回调期间有效
+typedef void (*TokenHandler)(const char *token, size_t len, void *context);
+
+typedef enum TokenizerKernel {
+    TOKENIZER_SCALAR = 0, // 逐字节
+    TOKENIZER_SSE2,       // 每批16字节
+    TOKENIZER_AVX2        // 每批32字节
+} TokenizerKernel;
+
+// 当前CPU支持的最快实现
+TokenizerKernel tokenizer_detect_kernel(void);
+int tokenizer_kernel_supported(TokenizerKernel kernel);
+const char* tokenizer_kernel_name(TokenizerKernel kernel);
+
+// 在buffer[0, len)中原地折叠大小写并切分词条，对每个完整词条调用handler
+// final非0时末尾的词条也交出并返回len；否则末尾未遇到分隔符的词条可能延续到下一块，
+// 不交出，返回它的起始偏移（没有这样的词条时返回len）
+size_t tokenize_buffer(char *buffer, size_t len, int final, TokenHandler handler, void *context);
+
+// 同上，指定实现（kernel不受支持时退回逐字节实现），供基准测试对比
+size_t tokenize_buffer_with(TokenizerKernel kernel, char *buffer, size_t len, int final,
+                            TokenHandler handler, void *context);
+
+#endif
@@ -0,0 +1,102 @@
+#include "topk.h"
+
+// a的排名是否低于b（堆顶放排名最低的文档）
+static inline int ranks_lower(const DocScore *a, const DocScore *b) {
+    if (a->score != b->score) return a->score < b->score;
+    return a->doc_id > b->doc_id;
+}
+
+static void sift_up(DocScore *items, int i) {
+    DocScore item = items[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!ranks_lower(&item, &items[parent])) break;
+        items[i] = items[parent];
+        i = parent;
+    }
+    items[i] = item;
+}
+
+static void sift_down(DocScore *items, int count, int i) {
+    DocScore item = items[i];
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= count) break;
+        if (child + 1 < count && ranks_lower(&items[child + 1], &items[child])) child++;
+        if (!ranks_lower(&items[child], &item)) break;
+        items[i] = items[child];
+        i = child;
+    }
+    items[i] = item;
+}
+
+int topk_init(TopK *topk, int k, Arena *arena) {
+    topk->count = 0;
+    topk->k = k > 0 ? k : 0;
+    topk->capacity = k > 0 ? k : 64;
+    topk->arena = arena;
+    topk->items = (DocScore*)arena_alloc(arena, topk->capacity * sizeof(DocScore));
+    return topk->items ? 0 : -1;
+}
+
+void topk_free(TopK *topk) {
+    arena_release(topk->arena, topk->items, topk->capacity * sizeof(DocScore));
+    topk->items = NULL;
+    topk->count = 0;
+}
+
+int topk_would_enter(const TopK *topk, int doc_id, double score) {
+    if (topk->k == 0 || topk->count < topk->k) return 1;
+    DocScore candidate = { doc_id, score };
+    return ranks_lower(&topk->items[0], &candidate);
+}
+
+double topk_threshold(const TopK *topk) {
+    if (topk->k == 0 || topk->count < topk->k) return -1.0;
+    return topk->items[0].score;
+}
+
+int topk_push(TopK *topk, int doc_id, double score) {
+    if (topk->k == 0) {
+        // 不设上限：容量不足时翻倍
+        if (topk->count == topk->capacity) {
+            DocScore *items = (DocScore*)arena_grow(topk->arena, topk->items, topk->capacity * sizeof(DocScore),
+                                                    topk->capacity * 2 * sizeof(DocScore));
+            if (!items) return 0;
+            topk->items = items;
+            topk->capacity *= 2;
+        }
+    } else if (topk->count == topk->k) {
+        DocScore candidate = { doc_id, score };
+        if (!ranks_lower(&topk->items[0], &candidate)) return 0;
+        topk->items[0] = candidate;
+        sift_down(topk->items, topk->count, 0);
+        return 1;
+    }
+    topk->items[topk->count].doc_id = doc_id;
+    topk->items[topk->count].score = score;
+    sift_up(topk->items, topk->count);
+    topk->count++;
+    return 1;
+}
+
+DocScore* topk_finish(TopK *topk, int *result_count) {
+    // 原地堆排序：依次把堆顶（排名最低）换到末尾，得到按排名排列的数组
+    int count = topk->count;
+    for (int end = count - 1; end > 0; end--) {
+        DocScore tmp = topk->items[0];
+        topk->items[0] = topk->items[end];
+        topk->items[end] = tmp;
+        sift_down(topk->items, end, 0);
+    }
+
+    *result_count = count;
+    DocScore *items = topk->items;
+    if (count == 0) {
+        arena_release(topk->arena, items, topk->capacity * sizeof(DocScore));
+        items = NULL;
+    }
+    topk->items = NULL;
+    topk->count = 0;
+    return items;
+}
@@ -0,0 +1,36 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tfidf.h"
+#include "arena.h"
+
+// 有界小顶堆：只保留分数最高的k个文档，堆顶是当前第k名（最容易被淘汰的文档）
+// 排名规则：分数高者在前，同分时文档ID小者在前（保证结果确定、与遍历顺序无关）
+typedef struct TopK {
+    DocScore *items;
+    int count;
+    int k;
+    int capacity;
+    Arena *arena; // 堆的内存来源（NULL表示malloc）
+} TopK;
+
+// k<=0时不设上限（堆随匹配文档数增长）；堆从arena分配（NULL表示malloc）
+int topk_init(TopK *topk, int k, Arena *arena);
+void topk_free(TopK *topk);
+
+// 尝试加入一个文档，返回1表示进入了前k名
+int topk_push(TopK *topk, int doc_id, double score);
+
+// 若(doc_id, score)能进入前k名返回1（堆未满时总是1）
+int topk_would_enter(const TopK *topk, int doc_id, double score);
+
+// 当前第k名的分数（堆未满时返回-1，表示任何文档都能进入）
+double topk_threshold(const TopK *topk);
+
+// 取出结果（按排名排序），堆的内存转交给调用者（arena非NULL时仍归arena所有），topk随后为空；
+// 没有结果时返回NULL
+DocScore* topk_finish(TopK *topk, int *result_count);
+
+#endif
@@ -1,89 +1,356 @@
 #include "trie.h"
 
-TrieNode* trie_create_node() {
-    TrieNode *node = (TrieNode*)malloc(sizeof(TrieNode));
-    if (node) {
-        node->is_end_of_word = false;
-        for (int i = 0; i < ALPHABET_SIZE; i++) {
-            node->children[i] = NULL;
-        }
+// ---------------------------------------------------------------------------
+// 构建
+// ---------------------------------------------------------------------------
+
+#define TRIE_MAX_ATTEMPTS 16
+
+// 构建期状态：空闲状态串成按下标递增的双向链表，为子状态找基址时只遍历空闲位置
+typedef struct TrieBuilder {
+    TrieState *states;
+    int32_t *free_next;
+    int32_t *free_prev;
+    unsigned char *attempts; // 空闲位置作为基址候选失败的次数，达到上限后移出链表（位置本身仍空闲）
+    int32_t free_head;
+    int32_t free_tail;
+    uint32_t capacity;
+    uint32_t used; // 已占用的最大下标+1
+} TrieBuilder;
+
+// 待展开的状态：对应words[lo, hi)的共同前缀，长度为depth
+typedef struct TrieTask {
+    int32_t state;
+    int lo;
+    int hi;
+    size_t depth;
+} TrieTask;
+
+static int builder_grow(TrieBuilder *builder, uint32_t min_capacity) {
+    uint32_t capacity = builder->capacity ? builder->capacity : 256;
+    while (capacity < min_capacity) capacity *= 2;
+    if (capacity == builder->capacity) return 0;
+
+    TrieState *states = (TrieState*)realloc(builder->states, capacity * sizeof(TrieState));
+    if (!states) return -1;
+    builder->states = states;
+    int32_t *free_next = (int32_t*)realloc(builder->free_next, capacity * sizeof(int32_t));
+    if (!free_next) return -1;
+    builder->free_next = free_next;
+    int32_t *free_prev = (int32_t*)realloc(builder->free_prev, capacity * sizeof(int32_t));
+    if (!free_prev) return -1;
+    builder->free_prev = free_prev;
+    unsigned char *attempts = (unsigned char*)realloc(builder->attempts, capacity);
+    if (!attempts) return -1;
+    builder->attempts = attempts;
+
+    // 新位置按下标顺序接到空闲链表尾部
+    for (uint32_t i = builder->capacity; i < capacity; i++) {
+        states[i].base = 0;
+        states[i].check = TRIE_FREE_CHECK;
+        states[i].term_lo = 0;
+        states[i].term_hi = 0;
+        attempts[i] = 0;
+        free_prev[i] = builder->free_tail;
+        free_next[i] = -1;
+        if (builder->free_tail >= 0) free_next[builder->free_tail] = (int32_t)i;
+        else builder->free_head = (int32_t)i;
+        builder->free_tail = (int32_t)i;
     }
-    return node;
+    builder->capacity = capacity;
+    return 0;
 }
 
-void trie_insert(TrieNode *root, const char *word) {
-    TrieNode *current = root;
-    for (int i = 0; word[i] != '\0'; i++) {
-        int index = word[i] - 'a';
-        if (index < 0 || index >= ALPHABET_SIZE) continue;
-        
-        if (!current->children[index]) {
-            current->children[index] = trie_create_node();
+static void builder_unlink(TrieBuilder *builder, int32_t index) {
+    int32_t prev = builder->free_prev[index];
+    int32_t next = builder->free_next[index];
+    if (prev >= 0) builder->free_next[prev] = next;
+    else builder->free_head = next;
+    if (next >= 0) builder->free_prev[next] = prev;
+    else builder->free_tail = prev;
+    builder->attempts[index] = TRIE_MAX_ATTEMPTS;
+}
+
+static void builder_occupy(TrieBuilder *builder, int32_t index, int32_t parent) {
+    if (builder->attempts[index] < TRIE_MAX_ATTEMPTS) builder_unlink(builder, index);
+    builder->states[index].check = parent;
+    if ((uint32_t)index >= builder->used) builder->used = (uint32_t)index + 1;
+}
+
+// 找一个基址，使base + codes[i]全部空闲（codes递增），返回-1表示内存不足
+static int32_t builder_find_base(TrieBuilder *builder, const int *codes, int num_codes) {
+    int32_t pos = builder->free_head;
+    while (1) {
+        if (pos < 0) {
+            // 空闲位置用完：扩容后从新位置继续
+            uint32_t old_capacity = builder->capacity;
+            if (builder_grow(builder, old_capacity * 2) != 0) return -1;
+            pos = (int32_t)old_capacity;
         }
-        current = current->children[index];
+        int32_t base = pos - codes[0];
+        if (base >= 0) {
+            uint32_t last = (uint32_t)base + (uint32_t)codes[num_codes - 1];
+            if (last >= builder->capacity && builder_grow(builder, last + 1) != 0) return -1;
+            int fits = 1;
+            for (int i = 1; i < num_codes; i++) {
+                if (builder->states[base + codes[i]].check != TRIE_FREE_CHECK) {
+                    fits = 0;
+                    break;
+                }
+            }
+            if (fits) return base;
+        }
+        // 屡次不合适的空闲位置不再参与遍历，避免数组前部的零散空位拖慢后续每次查找
+        int32_t next = builder->free_next[pos];
+        if (++builder->attempts[pos] >= TRIE_MAX_ATTEMPTS) builder_unlink(builder, pos);
+        pos = next;
     }
-    current->is_end_of_word = true;
 }
 
-bool trie_search(TrieNode *root, const char *word) {
-    TrieNode *current = root;
-    for (int i = 0; word[i] != '\0'; i++) {
-        int index = word[i] - 'a';
-        if (index < 0 || index >= ALPHABET_SIZE || !current->children[index]) {
-            return false;
+static void builder_free(TrieBuilder *builder) {
+    free(builder->states);
+    free(builder->free_next);
+    free(builder->free_prev);
+    free(builder->attempts);
+}
+
+Trie* trie_build(const char *const *words, int count) {
+    if (!words || count < 0) return NULL;
+
+    Trie *trie = (Trie*)malloc(sizeof(Trie));
+    TrieBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.free_head = builder.free_tail = -1;
+    // 待展开状态按先进先出处理；每个状态恰好入队一次，队列随状态数增长
+    int task_capacity = 256;
+    TrieTask *tasks = (TrieTask*)malloc(task_capacity * sizeof(TrieTask));
+    if (!trie || !tasks || builder_grow(&builder, 256) != 0) {
+        free(trie);
+        free(tasks);
+        builder_free(&builder);
+        return NULL;
+    }
+
+    builder_occupy(&builder, TRIE_ROOT, TRIE_ROOT);
+    tasks[0].state = TRIE_ROOT;
+    tasks[0].lo = 0;
+    tasks[0].hi = count;
+    tasks[0].depth = 0;
+    int head = 0, tail = 1;
+    int codes[256];
+    int bounds[257];
+    int failed = 0;
+
+    while (head < tail && !failed) {
+        TrieTask task = tasks[head++];
+        TrieState *state = &builder.states[task.state];
+        state->term_lo = (uint32_t)task.lo;
+        state->term_hi = (uint32_t)task.hi;
+
+        // 区间内第一个词条可能恰好是前缀本身，其余词条按下一个字节分组（有序，所以各组连续）
+        int start = task.lo;
+        if (start < task.hi && words[start][task.depth] == '\0') {
+            state->term_lo |= TRIE_TERMINAL;
+            start++;
+        }
+        int num_codes = 0;
+        for (int i = start; i < task.hi; ) {
+            unsigned char c = (unsigned char)words[i][task.depth];
+            codes[num_codes] = c;
+            bounds[num_codes++] = i;
+            while (i < task.hi && (unsigned char)words[i][task.depth] == c) i++;
         }
-        current = current->children[index];
+        bounds[num_codes] = task.hi;
+        if (num_codes == 0) continue;
+
+        int32_t base = builder_find_base(&builder, codes, num_codes);
+        if (base < 0) {
+            failed = 1;
+            break;
+        }
+        builder.states[task.state].base = base;
+
+        if (tail + num_codes > task_capacity) {
+            while (tail + num_codes > task_capacity) task_capacity *= 2;
+            TrieTask *grown = (TrieTask*)realloc(tasks, task_capacity * sizeof(TrieTask));
+            if (!grown) {
+                failed = 1;
+                break;
+            }
+            tasks = grown;
+        }
+        for (int i = 0; i < num_codes; i++) {
+            builder_occupy(&builder, base + codes[i], task.state);
+            tasks[tail].state = base + codes[i];
+            tasks[tail].lo = bounds[i];
+            tasks[tail].hi = bounds[i + 1];
+            tasks[tail].depth = task.depth + 1;
+            tail++;
+        }
+        // 队列前部已处理的任务不再需要，积累较多时整体前移
+        if (head > 4096 && head * 2 > tail) {
+            memmove(tasks, tasks + head, (tail - head) * sizeof(TrieTask));
+            tail -= head;
+            head = 0;
+        }
+    }
+    free(tasks);
+    free(builder.free_next);
+    free(builder.free_prev);
+    free(builder.attempts);
+    if (failed) {
+        free(builder.states);
+        free(trie);
+        return NULL;
     }
-    return current->is_end_of_word;
+
+    // 截掉末尾的空闲位置（剩余的空闲位置check为TRIE_FREE_CHECK，不会被任何转移命中）
+    TrieState *states = (TrieState*)realloc(builder.states, builder.used * sizeof(TrieState));
+    trie->storage = states ? states : builder.states;
+    trie->states = trie->storage;
+    trie->num_states = builder.used;
+    trie->completion_offsets = NULL;
+    trie->completions = NULL;
+    trie->num_completions = 0;
+    return trie;
+}
+
+void trie_attach(Trie *trie, const TrieState *states, uint32_t num_states) {
+    trie->states = states;
+    trie->num_states = num_states;
+    trie->storage = NULL;
+    trie->completion_offsets = NULL;
+    trie->completions = NULL;
+    trie->num_completions = 0;
 }
 
-static void collect_words(TrieNode *node, char *current_word, int depth, char ***matches, int *count) {
-    if (node->is_end_of_word) {
-        current_word[depth] = '\0';
-        *matches = (char**)realloc(*matches, (*count + 1) * sizeof(char*));
-        (*matches)[*count] = (char*)malloc((depth + 1) * sizeof(char));
-        strcpy((*matches)[*count], current_word);
-        (*count)++;
+// ---------------------------------------------------------------------------
+// 查询（状态数组可能来自文件，每次转移都检查下标范围）
+// ---------------------------------------------------------------------------
+
+// 沿key逐字节转移，返回到达的状态，中途失配返回-1
+static int32_t trie_walk(const Trie *trie, const char *key, size_t len) {
+    if (!trie || trie->num_states == 0) return -1;
+    int32_t state = TRIE_ROOT;
+    for (size_t i = 0; i < len; i++) {
+        int64_t next = (int64_t)trie->states[state].base + (unsigned char)key[i];
+        if (next <= TRIE_ROOT || next >= trie->num_states || trie->states[next].check != state) return -1;
+        state = (int32_t)next;
     }
-    
-    for (int i = 0; i < ALPHABET_SIZE; i++) {
-        if (node->children[i]) {
-            current_word[depth] = 'a' + i;
-            collect_words(node->children[i], current_word, depth + 1, matches, count);
+    return state;
+}
+
+int trie_find(const Trie *trie, const char *word, size_t len) {
+    if (!word) return -1;
+    int32_t state = trie_walk(trie, word, len);
+    if (state < 0 || !(trie->states[state].term_lo & TRIE_TERMINAL)) return -1;
+    return (int)(trie->states[state].term_lo & ~TRIE_TERMINAL);
+}
+
+bool trie_search(const Trie *trie, const char *word) {
+    return word && trie_find(trie, word, strlen(word)) >= 0;
+}
+
+void trie_prefix_range(const Trie *trie, const char *prefix, size_t len, int *lo, int *hi) {
+    *lo = *hi = 0;
+    if (!prefix) return;
+    int32_t state = trie_walk(trie, prefix, len);
+    if (state < 0) return;
+    *lo = (int)(trie->states[state].term_lo & ~TRIE_TERMINAL);
+    *hi = (int)trie->states[state].term_hi;
+    if (*hi < *lo) *hi = *lo;
+}
+
+// ---------------------------------------------------------------------------
+// 补全
+// ---------------------------------------------------------------------------
+
+// 在词条区间[lo, hi)中挑选权重最高的至多max个词条：按ID顺序扫描，插入排序维护前max名
+// （权重相同时先扫描到的ID在前）；没有权重回调时按ID顺序取前max个
+static int select_top_terms(int lo, int hi, TrieWeightFunc weight_of, const void *context, int *term_ids, int max) {
+    int count = 0;
+    for (int id = lo; id < hi; id++) {
+        if (!weight_of) {
+            if (count >= max) break;
+            term_ids[count++] = id;
+            continue;
         }
+        uint32_t weight = weight_of(context, id);
+        if (count == max && weight <= weight_of(context, term_ids[count - 1])) continue;
+        int j = count < max ? count++ : count - 1;
+        while (j > 0 && weight_of(context, term_ids[j - 1]) < weight) {
+            term_ids[j] = term_ids[j - 1];
+            j--;
+        }
+        term_ids[j] = id;
     }
+    return count;
 }
 
-void trie_get_prefix_matches(TrieNode *root, const char *prefix, char ***matches, int *count) {
-    *matches = NULL;
-    *count = 0;
-    
-    TrieNode *current = root;
-    int prefix_len = strlen(prefix);
-    
-    // 移动到前缀的最后一个节点
-    for (int i = 0; i < prefix_len; i++) {
-        int index = prefix[i] - 'a';
-        if (index < 0 || index >= ALPHABET_SIZE || !current->children[index]) {
-            return; // 前缀不存在
+uint32_t* trie_build_completions(const Trie *trie, TrieWeightFunc weight_of, const void *context, uint32_t *size) {
+    *size = 0;
+    if (!trie || !weight_of) return NULL;
+
+    // 先数出需要预计算的状态，一次分配整张表
+    uint32_t heavy = 0;
+    for (uint32_t s = 0; s < trie->num_states; s++) {
+        const TrieState *state = &trie->states[s];
+        if (state->check == TRIE_FREE_CHECK) continue;
+        if (state->term_hi - (state->term_lo & ~TRIE_TERMINAL) > TRIE_COMPLETION_SLOTS) heavy++;
+    }
+    uint64_t total = (uint64_t)trie->num_states + (uint64_t)heavy * TRIE_COMPLETION_SLOTS;
+    if (total > UINT32_MAX) return NULL;
+    uint32_t *table = (uint32_t*)malloc((total > 0 ? total : 1) * sizeof(uint32_t));
+    if (!table) return NULL;
+
+    // 每个状态独立地在自己的区间内挑选：总开销与所有词条的长度之和成正比
+    uint32_t *completions = table + trie->num_states;
+    uint32_t cursor = 0;
+    int selected[TRIE_COMPLETION_SLOTS];
+    for (uint32_t s = 0; s < trie->num_states; s++) {
+        const TrieState *state = &trie->states[s];
+        uint32_t lo = state->term_lo & ~TRIE_TERMINAL;
+        if (state->check == TRIE_FREE_CHECK || state->term_hi - lo <= TRIE_COMPLETION_SLOTS) {
+            table[s] = TRIE_NO_COMPLETIONS;
+            continue;
         }
-        current = current->children[index];
+        select_top_terms((int)lo, (int)state->term_hi, weight_of, context, selected, TRIE_COMPLETION_SLOTS);
+        table[s] = cursor;
+        for (int i = 0; i < TRIE_COMPLETION_SLOTS; i++) completions[cursor++] = (uint32_t)selected[i];
     }
-    
-    // 收集所有匹配的单词
-    char *current_word = (char*)malloc((prefix_len + 100) * sizeof(char)); // 假设单词长度不超过100
-    strcpy(current_word, prefix);
-    collect_words(current, current_word, prefix_len, matches, count);
-    
-    free(current_word);
-}
-
-void trie_free(TrieNode *root) {
-    if (!root) return;
-    
-    for (int i = 0; i < ALPHABET_SIZE; i++) {
-        trie_free(root->children[i]);
+    *size = (uint32_t)total;
+    return table;
+}
+
+int trie_attach_completions(Trie *trie, const uint32_t *table, uint32_t size) {
+    if (!trie || !table || size < trie->num_states) return -1;
+    trie->completion_offsets = table;
+    trie->completions = table + trie->num_states;
+    trie->num_completions = size - trie->num_states;
+    return 0;
+}
+
+int trie_complete(const Trie *trie, const char *prefix, size_t len, TrieWeightFunc weight_of, const void *context,
+                  int *term_ids, int max) {
+    if (!prefix || !term_ids || max <= 0) return 0;
+    int32_t s = trie_walk(trie, prefix, len);
+    if (s < 0) return 0;
+
+    const TrieState *state = &trie->states[s];
+    int lo = (int)(state->term_lo & ~TRIE_TERMINAL);
+    int hi = (int)state->term_hi;
+    if (max <= TRIE_COMPLETION_SLOTS && trie->completion_offsets) {
+        uint32_t offset = trie->completion_offsets[s];
+        if (offset != TRIE_NO_COMPLETIONS && (uint64_t)offset + TRIE_COMPLETION_SLOTS <= trie->num_completions) {
+            for (int i = 0; i < max; i++) term_ids[i] = (int)trie->completions[offset + i];
+            return max;
+        }
     }
-    
-    free(root);
-}
\ No newline at end of file
+    return select_top_terms(lo, hi, weight_of, context, term_ids, max);
+}
+
+void trie_free(Trie *trie) {
+    if (!trie) return;
+    free(trie->storage);
+    free(trie);
+}
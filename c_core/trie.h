@@ -4,19 +4,68 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <stdbool.h>
 
-#define ALPHABET_SIZE 26
+// 双数组Trie：由按字典序严格递增的词表静态构建，所有状态存放在一个平坦的TrieState数组中，
+// 可原样写入段文件并在mmap后直接查询。状态s经字节c转移到t = base[s] + c，当且仅当check[t] == s。
+// 词表有序，所以任一前缀对应的词条是一段连续的词条ID，每个状态直接记录该区间：
+// 精确查找与前缀查询都只需沿前缀逐字节访问状态数组，不比较字符串
+#define TRIE_ROOT 0
+#define TRIE_FREE_CHECK -1
+#define TRIE_TERMINAL 0x80000000u // term_lo的最高位：该状态对应的前缀本身就是一个词条（即区间的第一个词条）
 
-typedef struct TrieNode {
-    struct TrieNode *children[ALPHABET_SIZE];
-    bool is_end_of_word;
-} TrieNode;
+typedef struct TrieState {
+    int32_t base;     // 子状态的基址（没有子状态时为0）
+    int32_t check;    // 父状态；空闲状态为TRIE_FREE_CHECK
+    uint32_t term_lo; // 以该前缀开头的词条ID区间[term_lo, term_hi)，最高位为TRIE_TERMINAL
+    uint32_t term_hi;
+} TrieState;
 
-TrieNode* trie_create_node();
-void trie_insert(TrieNode *root, const char *word);
-bool trie_search(TrieNode *root, const char *word);
-void trie_get_prefix_matches(TrieNode *root, const char *prefix, char ***matches, int *count);
-void trie_free(TrieNode *root);
+// 补全表：词条数超过TRIE_COMPLETION_SLOTS的状态预先保存权重最高的TRIE_COMPLETION_SLOTS个词条ID，
+// 前缀建议只需走到前缀对应的状态，不遍历子树；词条较少的状态直接在其词条区间内现场挑选
+#define TRIE_COMPLETION_SLOTS 8
+#define TRIE_NO_COMPLETIONS 0xffffffffu
 
-#endif
\ No newline at end of file
+typedef struct Trie {
+    const TrieState *states;
+    uint32_t num_states;
+    TrieState *storage; // trie_build分配的数组；指向外部内存（如段文件映射区域）时为NULL
+    // 补全表（可选）：completion_offsets[state]为该状态的补全在completions中的起始下标，没有时为TRIE_NO_COMPLETIONS
+    const uint32_t *completion_offsets;
+    const uint32_t *completions;
+    uint32_t num_completions;
+} Trie;
+
+// 取词条权重的回调（如文档频率）
+typedef uint32_t (*TrieWeightFunc)(const void *context, int term_id);
+
+// 由严格递增的词表（以'\0'结尾）构建，词条ID即在words中的下标；失败返回NULL
+Trie* trie_build(const char *const *words, int count);
+
+// 在外部的状态数组上查询（不复制、不释放，数组须在trie使用期间有效）
+void trie_attach(Trie *trie, const TrieState *states, uint32_t num_states);
+
+// 精确查找，返回词条ID，不存在返回-1
+int trie_find(const Trie *trie, const char *word, size_t len);
+bool trie_search(const Trie *trie, const char *word);
+
+// 以prefix开头的词条ID区间[*lo, *hi)，没有时*lo == *hi；空前缀对应全部词条
+void trie_prefix_range(const Trie *trie, const char *prefix, size_t len, int *lo, int *hi);
+
+// 按权重为trie计算补全表：返回的数组前num_states个元素为各状态的偏移，之后是各组补全的词条ID
+// （组内按权重降序、同权重按词条ID升序），*size为数组元素总数；失败返回NULL。可原样写入段文件
+uint32_t* trie_build_completions(const Trie *trie, TrieWeightFunc weight_of, const void *context, uint32_t *size);
+
+// 挂接补全表（table为trie_build_completions的结果或其映射，不复制、不释放），表与trie不匹配时返回-1
+int trie_attach_completions(Trie *trie, const uint32_t *table, uint32_t size);
+
+// 以prefix开头、权重最高的至多max个词条ID写入term_ids（按权重降序、同权重按词条ID升序），返回个数
+// max不超过TRIE_COMPLETION_SLOTS时直接复制预计算的结果；否则（或没有补全表时）在前缀的词条区间内现场挑选
+int trie_complete(const Trie *trie, const char *prefix, size_t len, TrieWeightFunc weight_of, const void *context,
+                  int *term_ids, int max);
+
+// 释放trie_build的结果
+void trie_free(Trie *trie);
+
+#endif
@@ -1,9 +1,15 @@
 #include "utils.h"
+#include "thread.h"
+#include "tokenizer.h"
 #include <dirent.h>
 #include <ctype.h>
 #include <string.h>
 #include <sys/stat.h>  // 新增：用于文件类型判断
 
+static int compare_strings(const void *a, const void *b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
 char** load_stop_words(const char *filename, int *count) {
     *count = 0;
     char **stop_words = NULL;
@@ -28,158 +34,366 @@ char** load_stop_words(const char *filename, int *count) {
     }
     
     fclose(file);
+    
+    // 排序后供is_stop_word二分查找
+    if (*count > 1) qsort(stop_words, *count, sizeof(char*), compare_strings);
     return stop_words;
 }
 
-int is_stop_word(char **stop_words, int count, const char *word) {
-    for (int i = 0; i < count; i++) {
-        if (strcmp(stop_words[i], word) == 0) {
-            return 1;
-        }
+// 比较(word, len)与以'\0'结尾的字符串，顺序与strcmp一致
+static int compare_word(const char *word, size_t len, const char *str) {
+    size_t i = 0;
+    for (; i < len && str[i]; i++) {
+        if (word[i] != str[i]) return (unsigned char)word[i] < (unsigned char)str[i] ? -1 : 1;
     }
-    return 0;
+    if (i < len) return 1;
+    return str[i] ? -1 : 0;
 }
 
-// 简单的分词函数
-static char** tokenize_document(const char *content, int *token_count, char **stop_words, int stop_word_count) {
-    *token_count = 0;
-    char **tokens = NULL;
-    
-    if (!content || strlen(content) == 0) {
-        return NULL;
+int is_stop_word(char **stop_words, int count, const char *word, size_t len) {
+    int left = 0, right = count - 1;
+    while (left <= right) {
+        int mid = left + (right - left) / 2;
+        int cmp = compare_word(word, len, stop_words[mid]);
+        if (cmp == 0) return 1;
+        if (cmp < 0) right = mid - 1;
+        else left = mid + 1;
     }
-    
-    // 创建内容副本以便修改
-    char *content_copy = (char*)malloc(strlen(content) + 1);
-    strcpy(content_copy, content);
-    
-    // 转换为小写并替换非字母字符为空格
-    for (int i = 0; content_copy[i]; i++) {
-        if (isalpha(content_copy[i])) {
-            content_copy[i] = tolower(content_copy[i]);
-        } else {
-            content_copy[i] = ' ';
-        }
-    }
-    
-    // 分词
-    char *token = strtok(content_copy, " ");
-    while (token) {
-        // 过滤短词和停用词
-        if (strlen(token) > 1 && !is_stop_word(stop_words, stop_word_count, token)) {
-            *token_count += 1;
-            tokens = (char**)realloc(tokens, *token_count * sizeof(char*));
-            tokens[*token_count - 1] = (char*)malloc(strlen(token) + 1);
-            strcpy(tokens[*token_count - 1], token);
-        }
-        token = strtok(NULL, " ");
+    return 0;
+}
+
+int is_indexed_token(char **stop_words, int count, const char *token, size_t len) {
+    return len > 1 && !is_stop_word(stop_words, count, token, len);
+}
+
+void free_stop_words(char **stop_words, int count) {
+    for (int i = 0; i < count; i++) free(stop_words[i]);
+    free(stop_words);
+}
+
+int save_index_stop_words(const char *index_dir) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", index_dir, STOP_WORDS_FILE);
+    int count;
+    char **stop_words = load_stop_words(STOP_WORDS_FILE, &count);
+    FILE *file = fopen(path, "w");
+    int status = file ? 0 : -1;
+    for (int i = 0; file && i < count; i++) {
+        if (fprintf(file, "%s\n", stop_words[i]) < 0) status = -1;
     }
-    
-    free(content_copy);
-    return tokens;
+    if (file && fclose(file) != 0) status = -1;
+    free_stop_words(stop_words, count);
+    return status;
 }
 
-// 读取文件内容
-static char* read_file_content(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) return NULL;
-    
-    // 获取文件大小
-    fseek(file, 0, SEEK_END);
-    long length = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    // 分配内存并读取内容
-    char *content = (char*)malloc(length + 1);
-    if (content) {
-        fread(content, 1, length, file);
-        content[length] = '\0';
+char** load_index_stop_words(const char *index_dir, int *count) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", index_dir, STOP_WORDS_FILE);
+    FILE *file = fopen(path, "r");
+    if (!file) return load_stop_words(STOP_WORDS_FILE, count);
+    fclose(file);
+    return load_stop_words(path, count);
+}
+
+// 按固定大小的块流式读取文件并分词（原地转小写，非字母字符为分隔符），
+// 跨块边界的词条先挪到缓冲区开头再续读；整个过程只使用调用者提供的缓冲区，不按词条分配内存。
+// 超过缓冲区大小的超长词条按缓冲区大小截断成多段。成功返回0，文件无法打开返回-1
+static int scan_file_tokens(const char *path, char *buffer, size_t buffer_size,
+                            TokenHandler handler, void *context) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return -1;
+    
+    size_t carry = 0; // 缓冲区开头属于上一块末尾、尚未结束的词条字节数
+    while (1) {
+        size_t read = fread(buffer + carry, 1, buffer_size - carry, file);
+        size_t end = carry + read;
+        int eof = read == 0;
+        
+        // 字符分类与大小写折叠由共享分词器完成（与查询分词一致），start为末尾未结束词条的起点
+        size_t start = tokenize_buffer(buffer, end, eof, handler, context);
+        if (start == 0 && end == buffer_size) {
+            // 词条占满了整个缓冲区：把它作为一个词条交出
+            handler(buffer, end, context);
+            carry = 0;
+            continue;
+        }
+        if (eof) break;
+        
+        // 末尾未结束的词条挪到缓冲区开头，与下一块拼接
+        carry = end - start;
+        memmove(buffer, buffer + start, carry);
     }
     
     fclose(file);
-    return content;
+    return 0;
 }
 
-void build_index_from_docs(const char *doc_dir, TrieNode *trie, InvertedIndex *index, 
-                          char ***doc_paths, int *num_docs) {
-    *num_docs = 0;
-    *doc_paths = NULL;
-    
+// 目录中的一个待索引文件
+typedef struct DocFile {
+    char *path;
+    long size;
+} DocFile;
+
+static int compare_doc_files(const void *a, const void *b) {
+    return strcmp(((const DocFile*)a)->path, ((const DocFile*)b)->path);
+}
+
+// 列出目录中的普通文件（跳过隐藏文件），按路径排序，文档ID即排序后的下标
+static DocFile* list_doc_files(const char *doc_dir, int *count) {
+    *count = 0;
     DIR *dir = opendir(doc_dir);
-    if (!dir) return;
-    
-    // 加载停用词
-    int stop_word_count;
-    char **stop_words = load_stop_words("stop_words.txt", &stop_word_count);
+    if (!dir) return NULL;
     
+    DocFile *files = NULL;
+    int capacity = 0;
     struct dirent *entry;
     while ((entry = readdir(dir)) != NULL) {
-        // 构建完整路径（仅定义一次）
+        if (entry->d_name[0] == '.') continue;
+        
         char *full_path = (char*)malloc(strlen(doc_dir) + strlen(entry->d_name) + 2);
         strcpy(full_path, doc_dir);
         strcat(full_path, "/");
         strcat(full_path, entry->d_name);
         
-        // 检查是否为文件（而非目录）和隐藏文件
+        // 检查是否为文件（而非目录）
         struct stat path_stat;
-        stat(full_path, &path_stat);
-        if (!S_ISREG(path_stat.st_mode) || entry->d_name[0] == '.') {
-            free(full_path);  // 释放内存
-            continue;
-        }
-        
-        // 读取文件内容
-        char *content = read_file_content(full_path);
-        if (!content) {
+        if (stat(full_path, &path_stat) != 0 || !S_ISREG(path_stat.st_mode)) {
             free(full_path);
             continue;
         }
         
-        // 分词
-        int token_count;
-        char **tokens = tokenize_document(content, &token_count, stop_words, stop_word_count);
-        
-        // 添加到Trie树和倒排索引
-        for (int i = 0; i < token_count; i++) {
-            trie_insert(trie, tokens[i]);
-            inverted_index_add_term(index, tokens[i], *num_docs);
-            
-            free(tokens[i]);
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            files = (DocFile*)realloc(files, capacity * sizeof(DocFile));
         }
-        free(tokens);
-        
-        // 保存文档路径
-        *num_docs += 1;
-        *doc_paths = (char**)realloc(*doc_paths, *num_docs * sizeof(char*));
-        (*doc_paths)[*num_docs - 1] = full_path;  // 使用之前定义的full_path
-        
-        free(content);
+        files[*count].path = full_path;
+        files[*count].size = (long)path_stat.st_size;
+        *count += 1;
     }
+    closedir(dir);
     
-    // 清理
-    for (int i = 0; i < stop_word_count; i++) {
-        free(stop_words[i]);
+    qsort(files, *count, sizeof(DocFile), compare_doc_files);
+    return files;
+}
+
+char** list_documents(const char *doc_dir, int *count) {
+    int num_files;
+    DocFile *files = list_doc_files(doc_dir, &num_files);
+    *count = 0;
+    if (!files) return NULL;
+    char **paths = (char**)malloc((num_files > 0 ? num_files : 1) * sizeof(char*));
+    for (int i = 0; i < num_files; i++) {
+        if (paths) paths[i] = files[i].path;
+        else free(files[i].path);
     }
-    free(stop_words);
+    free(files);
+    if (paths) *count = num_files;
+    return paths;
+}
+
+// 每个构建线程的读取缓冲区大小
+#define INGEST_CHUNK_SIZE (64 * 1024)
+
+// 构建线程的任务：为文档ID区间[begin, end)构建部分索引
+typedef struct BuildTask {
+    const DocFile *files;
+    int begin;
+    int end;
+    char **stop_words;
+    int stop_word_count;
+    InvertedIndex *partial;
+    int doc_id; // 正在处理的文档
+    uint32_t position; // 下一个词条在文档中的位置（短词和停用词也占位置，短语查询据此保留间隔）
+} BuildTask;
+
+// 合并线程的任务：按区间顺序把各部分索引中属于本stripe的postings接到最终索引
+typedef struct MergeTask {
+    InvertedIndex *index;
+    BuildTask *parts;
+    int **mappings;
+    int num_parts;
+    int stripe;
+    int num_stripes;
+    Arena *arena; // 本stripe扩容postings用的分配区，完成后交给最终索引
+} MergeTask;
+
+static void merge_partial_postings(void *arg) {
+    MergeTask *task = (MergeTask*)arg;
+    for (int t = 0; t < task->num_parts; t++) {
+        if (!task->mappings[t]) continue;
+        inverted_index_merge_postings(task->index, task->parts[t].partial, task->mappings[t],
+                                      task->stripe, task->num_stripes, task->arena);
+    }
+}
+
+// 过滤短词和停用词后直接以(指针, 长度)插入部分索引（前缀查询由段文件中按字典序排列的词典完成）
+static void index_token(const char *token, size_t len, void *context) {
+    BuildTask *task = (BuildTask*)context;
+    uint32_t position = task->position++;
+    if (!is_indexed_token(task->stop_words, task->stop_word_count, token, len)) return;
+    inverted_index_add_term_at(task->partial, token, len, task->doc_id, position);
+}
+
+static void build_partial_index(void *arg) {
+    BuildTask *task = (BuildTask*)arg;
+    char *buffer = (char*)malloc(INGEST_CHUNK_SIZE);
+    if (!buffer) return;
+    
+    // 读取失败的文档保留文档ID，只是没有词条
+    for (task->doc_id = task->begin; task->doc_id < task->end; task->doc_id++) {
+        task->position = 0;
+        scan_file_tokens(task->files[task->doc_id].path, buffer, INGEST_CHUNK_SIZE, index_token, task);
+    }
+    free(buffer);
+}
+
+static void build_index_from_doc_files(DocFile *files, int num_files, InvertedIndex *index,
+                                       char ***doc_paths, int *num_docs, int num_threads);
+
+void build_index_from_docs(const char *doc_dir, InvertedIndex *index, 
+                          char ***doc_paths, int *num_docs, int num_threads) {
+    build_index_from_filtered_docs(doc_dir, NULL, NULL, index, doc_paths, num_docs, num_threads);
+}
+
+void build_index_from_filtered_docs(const char *doc_dir, DocFilter filter, void *context, InvertedIndex *index,
+                                    char ***doc_paths, int *num_docs, int num_threads) {
+    *num_docs = 0;
+    *doc_paths = NULL;
     
-    closedir(dir);
+    int num_files;
+    DocFile *files = list_doc_files(doc_dir, &num_files);
+    if (!files) return;
+    if (filter) {
+        // 过滤后保持路径顺序，文档ID仍是排序后的下标
+        int kept = 0;
+        for (int i = 0; i < num_files; i++) {
+            if (filter(files[i].path, context)) files[kept++] = files[i];
+            else free(files[i].path);
+        }
+        num_files = kept;
+    }
+    build_index_from_doc_files(files, num_files, index, doc_paths, num_docs, num_threads);
 }
 
-void save_doc_paths(char **doc_paths, int num_docs, const char *filename) {
-    if (!doc_paths || num_docs <= 0 || !filename) return;
+void build_index_from_files(char **paths, int count, InvertedIndex *index,
+                            char ***doc_paths, int *num_docs, int num_threads) {
+    *num_docs = 0;
+    *doc_paths = NULL;
     
-    FILE *file = fopen(filename, "wb");
-    if (!file) return;
+    DocFile *files = (DocFile*)malloc((count > 0 ? count : 1) * sizeof(DocFile));
+    if (!files) return;
+    int num_files = 0;
+    for (int i = 0; i < count; i++) {
+        // 不存在或不是普通文件的路径跳过（如已被删除的文档）
+        struct stat path_stat;
+        if (stat(paths[i], &path_stat) != 0 || !S_ISREG(path_stat.st_mode)) continue;
+        files[num_files].path = strdup(paths[i]);
+        files[num_files].size = (long)path_stat.st_size;
+        num_files++;
+    }
+    qsort(files, num_files, sizeof(DocFile), compare_doc_files);
+    // 重复的路径只保留一个
+    int kept = 0;
+    for (int i = 0; i < num_files; i++) {
+        if (kept > 0 && strcmp(files[kept - 1].path, files[i].path) == 0) free(files[i].path);
+        else files[kept++] = files[i];
+    }
+    build_index_from_doc_files(files, kept, index, doc_paths, num_docs, num_threads);
+}
+
+// 为已排序的文件列表构建索引（接管files及其中的路径）
+static void build_index_from_doc_files(DocFile *files, int num_files, InvertedIndex *index,
+                                       char ***doc_paths, int *num_docs, int num_threads) {
+    // 加载停用词（各线程只读共享）
+    int stop_word_count;
+    char **stop_words = load_stop_words(STOP_WORDS_FILE, &stop_word_count);
+    
+    if (num_threads <= 0) num_threads = cpu_count();
+    if (num_threads > num_files) num_threads = num_files;
+    if (num_threads < 1) num_threads = 1;
+    
+    // 按文件字节数把文档ID切成连续区间，每个线程构建一个部分索引
+    long long total_bytes = 0;
+    for (int i = 0; i < num_files; i++) total_bytes += files[i].size;
+    
+    BuildTask *tasks = (BuildTask*)calloc(num_threads, sizeof(BuildTask));
+    ThreadHandle *threads = (ThreadHandle*)malloc(num_threads * sizeof(ThreadHandle));
+    int *started = (int*)calloc(num_threads, sizeof(int));
+    long long bytes = 0;
+    int next = 0;
+    for (int t = 0; t < num_threads; t++) {
+        BuildTask *task = &tasks[t];
+        task->files = files;
+        task->begin = next;
+        long long target = total_bytes * (t + 1) / num_threads;
+        while (next < num_files && (bytes < target || t == num_threads - 1)) {
+            bytes += files[next].size;
+            next++;
+        }
+        task->end = next;
+        task->stop_words = stop_words;
+        task->stop_word_count = stop_word_count;
+        task->partial = inverted_index_create(0, 0);
+    }
     
-    fwrite(&num_docs, sizeof(int), 1, file);
+    for (int t = 1; t < num_threads; t++) {
+        started[t] = thread_create(&threads[t], build_partial_index, &tasks[t]) == 0;
+    }
+    // 当前线程负责第一个区间；线程创建失败的区间也在当前线程完成
+    build_partial_index(&tasks[0]);
+    for (int t = 1; t < num_threads; t++) {
+        if (started[t]) thread_join(threads[t]);
+        else build_partial_index(&tasks[t]);
+    }
     
-    for (int i = 0; i < num_docs; i++) {
-        int len = strlen(doc_paths[i]);
-        fwrite(&len, sizeof(int), 1, file);
-        fwrite(doc_paths[i], sizeof(char), len, file);
+    // 合并：先按区间顺序把词条插入最终索引（文档ID区间有序，postings只需首尾相接），
+    // 再按词条ID分成互不相交的stripe，由各线程并行拼接postings
+    int **mappings = (int**)calloc(num_threads, sizeof(int*));
+    for (int t = 0; t < num_threads; t++) {
+        mappings[t] = inverted_index_merge_terms(index, tasks[t].partial);
+    }
+    MergeTask *merges = (MergeTask*)malloc(num_threads * sizeof(MergeTask));
+    int parallel = 1; // 每个stripe都有自己的arena时才能并行
+    for (int t = 0; t < num_threads; t++) {
+        merges[t].index = index;
+        merges[t].parts = tasks;
+        merges[t].mappings = mappings;
+        merges[t].num_parts = num_threads;
+        merges[t].stripe = t;
+        merges[t].num_stripes = num_threads;
+        merges[t].arena = arena_create();
+        if (!merges[t].arena) parallel = 0;
     }
+    for (int t = 1; t < num_threads; t++) {
+        started[t] = parallel && thread_create(&threads[t], merge_partial_postings, &merges[t]) == 0;
+    }
+    merge_partial_postings(&merges[0]);
+    for (int t = 1; t < num_threads; t++) {
+        if (started[t]) thread_join(threads[t]);
+        else merge_partial_postings(&merges[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        inverted_index_adopt_arena(index, merges[t].arena);
+        arena_destroy(merges[t].arena);
+        free(mappings[t]);
+        inverted_index_free(tasks[t].partial);
+    }
+    free(mappings);
+    free(merges);
     
-    fclose(file);
+    // 保存文档路径
+    *doc_paths = (char**)malloc((num_files > 0 ? num_files : 1) * sizeof(char*));
+    for (int i = 0; i < num_files; i++) {
+        (*doc_paths)[i] = files[i].path;
+    }
+    *num_docs = num_files;
+    
+    // 清理
+    free_stop_words(stop_words, stop_word_count);
+    free(tasks);
+    free(threads);
+    free(started);
+    free(files);
 }
 
 char** load_doc_paths(const char *filename, int *num_docs) {
@@ -214,67 +428,68 @@ char** load_doc_paths(const char *filename, int *num_docs) {
     return doc_paths;
 }
 
-// 递归保存Trie树
-static void trie_save_recursive(TrieNode *node, FILE *file) {
-    if (!node || !file) return;
-    
-    // 保存节点信息
-    fwrite(&node->is_end_of_word, sizeof(bool), 1, file);
-    
-    // 保存子节点
-    for (int i = 0; i < ALPHABET_SIZE; i++) {
-        int has_child = (node->children[i] != NULL) ? 1 : 0;
-        fwrite(&has_child, sizeof(int), 1, file);
-        
-        if (has_child) {
-            trie_save_recursive(node->children[i], file);
+// 旧格式按先序逐节点保存：1字节词尾标志，再为26个子节点各写一个int标志，有子节点时紧接着递归保存该子节点。
+// 子节点按字母顺序出现，先序遍历得到的词条天然有序，直接收集后构建双数组Trie，不再逐节点分配内存
+typedef struct LegacyTrieWords {
+    char **words;
+    int count;
+    int capacity;
+    char *prefix;
+    size_t prefix_capacity;
+} LegacyTrieWords;
+
+static int trie_load_recursive(FILE *file, LegacyTrieWords *collected, size_t depth) {
+    bool is_end_of_word;
+    if (fread(&is_end_of_word, sizeof(bool), 1, file) != 1) return -1;
+    
+    if (is_end_of_word && depth > 0) {
+        if (collected->count >= collected->capacity) {
+            collected->capacity = collected->capacity ? collected->capacity * 2 : 1024;
+            char **words = (char**)realloc(collected->words, collected->capacity * sizeof(char*));
+            if (!words) return -1;
+            collected->words = words;
         }
+        char *word = (char*)malloc(depth + 1);
+        if (!word) return -1;
+        memcpy(word, collected->prefix, depth);
+        word[depth] = '\0';
+        collected->words[collected->count++] = word;
     }
-}
-
-void trie_save(TrieNode *root, const char *filename) {
-    if (!root || !filename) return;
-    
-    FILE *file = fopen(filename, "wb");
-    if (!file) return;
-    
-    trie_save_recursive(root, file);
-    fclose(file);
-}
-
-// 递归加载Trie树
-static TrieNode* trie_load_recursive(FILE *file) {
-    if (!file) return NULL;
-    
-    TrieNode *node = trie_create_node();
-    if (!node) return NULL;
-    
-    // 加载节点信息
-    fread(&node->is_end_of_word, sizeof(bool), 1, file);
     
     // 加载子节点
-    for (int i = 0; i < ALPHABET_SIZE; i++) {
+    for (int i = 0; i < 26; i++) {
         int has_child;
-        fread(&has_child, sizeof(int), 1, file);
+        if (fread(&has_child, sizeof(int), 1, file) != 1) return -1;
+        if (!has_child) continue;
         
-        if (has_child) {
-            node->children[i] = trie_load_recursive(file);
-        } else {
-            node->children[i] = NULL;
+        if (depth + 1 >= collected->prefix_capacity) {
+            collected->prefix_capacity *= 2;
+            char *prefix = (char*)realloc(collected->prefix, collected->prefix_capacity);
+            if (!prefix) return -1;
+            collected->prefix = prefix;
         }
+        collected->prefix[depth] = (char)('a' + i);
+        if (trie_load_recursive(file, collected, depth + 1) != 0) return -1;
     }
-    
-    return node;
+    return 0;
 }
 
-TrieNode* trie_load(const char *filename) {
+Trie* trie_load(const char *filename) {
     if (!filename) return NULL;
     
     FILE *file = fopen(filename, "rb");
     if (!file) return NULL;
     
-    TrieNode *root = trie_load_recursive(file);
+    LegacyTrieWords collected = { NULL, 0, 0, NULL, 64 };
+    collected.prefix = (char*)malloc(collected.prefix_capacity);
+    Trie *trie = NULL;
+    if (collected.prefix && trie_load_recursive(file, &collected, 0) == 0) {
+        trie = trie_build((const char *const *)collected.words, collected.count);
+    }
     fclose(file);
     
-    return root;
-}
\ No newline at end of file
+    for (int i = 0; i < collected.count; i++) free(collected.words[i]);
+    free(collected.words);
+    free(collected.prefix);
+    return trie;
+}
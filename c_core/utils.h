@@ -6,26 +6,48 @@
 #include "trie.h"
 #include "inverted_index.h"
 
-// 从文件加载停用词
+// 构建索引时从当前目录读取的停用词表；全量重建时复制一份到索引目录，查询时按构建时的词表判断停用词
+#define STOP_WORDS_FILE "stop_words.txt"
+
+// 从文件加载停用词（转为小写并排序）
 char** load_stop_words(const char *filename, int *count);
+void free_stop_words(char **stop_words, int count);
 
-// 检查是否是停用词
-int is_stop_word(char **stop_words, int count, const char *word);
+// 检查(word, len)是否是停用词（stop_words为load_stop_words返回的有序数组，二分查找）
+int is_stop_word(char **stop_words, int count, const char *word, size_t len);
 
-// 从文档目录构建Trie树和倒排索引
-void build_index_from_docs(const char *doc_dir, TrieNode *trie, InvertedIndex *index, 
-                          char ***doc_paths, int *num_docs);
+// 构建索引时是否收录该词条：长度不超过1的词与停用词不收录（但仍占一个位置）
+int is_indexed_token(char **stop_words, int count, const char *token, size_t len);
 
-// 保存文档路径
-void save_doc_paths(char **doc_paths, int num_docs, const char *filename);
+// 把当前目录的停用词表写入索引目录（没有停用词表时写入空表）。成功返回0，失败返回-1
+int save_index_stop_words(const char *index_dir);
 
-// 加载文档路径
-char** load_doc_paths(const char *filename, int *num_docs);
+// 加载索引目录中的停用词表；旧索引没有时退回当前目录的停用词表
+char** load_index_stop_words(const char *index_dir, int *count);
+
+// 从文档目录构建倒排索引：文档按路径排序后依次编号，num_threads个线程（<=0表示CPU核数）
+// 各自为一段连续的文档ID区间构建部分索引，最后按区间顺序合并，结果与线程数无关
+void build_index_from_docs(const char *doc_dir, InvertedIndex *index, 
+                          char ***doc_paths, int *num_docs, int num_threads);
+
+// 列出文档目录中的普通文件路径（跳过隐藏文件），按路径排序即构建索引时的文档ID顺序；调用者释放每个路径与数组
+char** list_documents(const char *doc_dir, int *count);
 
-// 保存Trie树
-void trie_save(TrieNode *root, const char *filename);
+// 文档过滤回调：返回非0表示收录该文档
+typedef int (*DocFilter)(const char *path, void *context);
+
+// 同build_index_from_docs，但只收录filter返回非0的文档（filter为NULL时收录全部），用于增量添加
+void build_index_from_filtered_docs(const char *doc_dir, DocFilter filter, void *context, InvertedIndex *index,
+                                    char ***doc_paths, int *num_docs, int num_threads);
+
+// 为给定的文件列表构建索引（路径排序去重后编号，不存在的文件跳过），用于更新文档
+void build_index_from_files(char **paths, int count, InvertedIndex *index,
+                            char ***doc_paths, int *num_docs, int num_threads);
+
+// 加载旧格式的文档路径文件（doc_paths.dat，仅供格式转换使用）
+char** load_doc_paths(const char *filename, int *num_docs);
 
-// 加载Trie树
-TrieNode* trie_load(const char *filename);
+// 加载旧格式的Trie树文件（trie.dat，仅供格式转换使用），转为双数组Trie
+Trie* trie_load(const char *filename);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "worker_pool.h"
+#include "thread.h"
+#include <stdlib.h>
+
+typedef struct WorkerTask {
+    WorkerFunc func;
+    void *arg;
+    WorkerGroup *group; // 不属于任何组时为NULL
+} WorkerTask;
+
+typedef struct WorkerSlot {
+    WorkerPool *pool;
+    int index;
+} WorkerSlot;
+
+struct WorkerPool {
+    Mutex lock;
+    CondVar has_task;  // 队列非空或要求退出
+    CondVar has_space; // 队列有空位
+    CondVar idle;      // 已提交的任务全部执行完
+    CondVar group_done; // 某一组的任务全部执行完（等待方各自检查自己的组）
+    WorkerTask *queue; // 环形队列
+    int capacity;
+    int head;          // 队首下标
+    int count;         // 队列中的任务数
+    int pending;       // 已提交、尚未执行完的任务数（含正在执行的）
+    int stop;
+    ThreadHandle *threads;
+    WorkerSlot *slots;
+    int num_workers;
+};
+
+static void worker_main(void *arg) {
+    WorkerSlot *slot = (WorkerSlot*)arg;
+    WorkerPool *pool = slot->pool;
+    while (1) {
+        mutex_lock(&pool->lock);
+        while (pool->count == 0 && !pool->stop) cond_wait(&pool->has_task, &pool->lock);
+        if (pool->count == 0) { // 要求退出且队列已空
+            mutex_unlock(&pool->lock);
+            return;
+        }
+        WorkerTask task = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        cond_signal(&pool->has_space);
+        mutex_unlock(&pool->lock);
+
+        task.func(task.arg, slot->index);
+
+        mutex_lock(&pool->lock);
+        if (--pool->pending == 0) cond_broadcast(&pool->idle);
+        if (task.group && --task.group->pending == 0) cond_broadcast(&pool->group_done);
+        mutex_unlock(&pool->lock);
+    }
+}
+
+// 通知已启动的started个线程退出并等待它们结束，然后释放
+static void pool_destroy(WorkerPool *pool, int started) {
+    mutex_lock(&pool->lock);
+    pool->stop = 1;
+    cond_broadcast(&pool->has_task);
+    mutex_unlock(&pool->lock);
+    for (int i = 0; i < started; i++) thread_join(pool->threads[i]);
+    mutex_destroy(&pool->lock);
+    cond_destroy(&pool->has_task);
+    cond_destroy(&pool->has_space);
+    cond_destroy(&pool->idle);
+    cond_destroy(&pool->group_done);
+    free(pool->queue);
+    free(pool->threads);
+    free(pool->slots);
+    free(pool);
+}
+
+WorkerPool* worker_pool_create(int num_workers, int queue_capacity) {
+    if (num_workers < 1) num_workers = 1;
+    if (queue_capacity <= 0) queue_capacity = num_workers * 4;
+    WorkerPool *pool = (WorkerPool*)calloc(1, sizeof(WorkerPool));
+    if (!pool) return NULL;
+    pool->queue = (WorkerTask*)malloc(queue_capacity * sizeof(WorkerTask));
+    pool->threads = (ThreadHandle*)malloc(num_workers * sizeof(ThreadHandle));
+    pool->slots = (WorkerSlot*)malloc(num_workers * sizeof(WorkerSlot));
+    if (!pool->queue || !pool->threads || !pool->slots || mutex_init(&pool->lock) != 0) {
+        free(pool->queue);
+        free(pool->threads);
+        free(pool->slots);
+        free(pool);
+        return NULL;
+    }
+    cond_init(&pool->has_task);
+    cond_init(&pool->has_space);
+    cond_init(&pool->idle);
+    cond_init(&pool->group_done);
+    pool->capacity = queue_capacity;
+    pool->num_workers = num_workers;
+
+    for (int i = 0; i < num_workers; i++) {
+        pool->slots[i].pool = pool;
+        pool->slots[i].index = i;
+        if (thread_create(&pool->threads[i], worker_main, &pool->slots[i]) != 0) {
+            pool_destroy(pool, i);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+int worker_pool_size(const WorkerPool *pool) {
+    return pool ? pool->num_workers : 0;
+}
+
+int worker_pool_submit(WorkerPool *pool, WorkerFunc func, void *arg) {
+    return worker_pool_submit_group(pool, NULL, func, arg);
+}
+
+int worker_pool_submit_group(WorkerPool *pool, WorkerGroup *group, WorkerFunc func, void *arg) {
+    if (!pool || !func) return -1;
+    mutex_lock(&pool->lock);
+    while (pool->count == pool->capacity) cond_wait(&pool->has_space, &pool->lock);
+    pool->queue[(pool->head + pool->count) % pool->capacity] = (WorkerTask){ func, arg, group };
+    pool->count++;
+    pool->pending++;
+    if (group) group->pending++;
+    cond_signal(&pool->has_task);
+    mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void worker_pool_wait(WorkerPool *pool) {
+    if (!pool) return;
+    mutex_lock(&pool->lock);
+    while (pool->pending > 0) cond_wait(&pool->idle, &pool->lock);
+    mutex_unlock(&pool->lock);
+}
+
+void worker_pool_wait_group(WorkerPool *pool, WorkerGroup *group) {
+    if (!pool || !group) return;
+    mutex_lock(&pool->lock);
+    while (group->pending > 0) cond_wait(&pool->group_done, &pool->lock);
+    mutex_unlock(&pool->lock);
+}
+
+void worker_pool_free(WorkerPool *pool) {
+    if (!pool) return;
+    pool_destroy(pool, pool->num_workers);
+}
@@ -0,0 +1,32 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+// 工作线程池：固定数目的线程从一个有界环形队列中取任务执行
+// 队列由一把锁保护，锁内只做O(1)的入队/出队，任务本身在锁外执行；队列满时提交方等待空位。
+// 任务函数收到执行它的线程编号（0..num_workers-1），调用者可按编号为每个线程准备各自的状态
+// （如查询上下文），任务之间不必再加锁
+typedef void (*WorkerFunc)(void *arg, int worker);
+
+typedef struct WorkerPool WorkerPool;
+
+// 一组任务的完成计数：多个提交方共用一个池时（如多个查询各自拆出的子任务），
+// 每个提交方只等待自己那一组执行完。用前清零，pending由池的锁保护
+typedef struct WorkerGroup {
+    int pending; // 已提交、尚未执行完的任务数
+} WorkerGroup;
+
+// 创建num_workers（至少1）个线程，queue_capacity<=0时队列容量取num_workers的4倍，失败返回NULL
+WorkerPool* worker_pool_create(int num_workers, int queue_capacity);
+int worker_pool_size(const WorkerPool *pool);
+// 提交任务，队列满时等待，成功返回0
+int worker_pool_submit(WorkerPool *pool, WorkerFunc func, void *arg);
+// 提交属于group的任务，其余同worker_pool_submit
+int worker_pool_submit_group(WorkerPool *pool, WorkerGroup *group, WorkerFunc func, void *arg);
+// 等待已提交的任务全部执行完
+void worker_pool_wait(WorkerPool *pool);
+// 只等待group中已提交的任务执行完（不等其他组与不属于任何组的任务）
+void worker_pool_wait_group(WorkerPool *pool, WorkerGroup *group);
+// 执行完已提交的任务后结束全部线程并释放
+void worker_pool_free(WorkerPool *pool);
+
+#endif
@@ -2,6 +2,51 @@ import os
 import subprocess
 import json
 import re
+import threading
+
+# 与server.h的SERVER_MAX_PAYLOAD一致：超过的负载引擎会读掉并返回ERR
+MAX_PAYLOAD = 4096
+
+class _EngineProcess:
+    """一个常驻引擎进程：引擎按请求的顺序写出响应，发送时分配序号，读取时按序号轮流读取"""
+    def __init__(self, process):
+        self.process = process
+        self.sent = 0          # 已发送的请求数（即下一个请求的序号）
+        self.read = 0          # 已读完响应的请求数
+        self.broken = False    # 读写失败后不再使用（下一个请求启动新进程）
+        self.turn = threading.Condition()
+
+    def read_response(self, ticket):
+        """等前面的请求读完后读取序号为ticket的响应，返回结果行列表"""
+        with self.turn:
+            while self.read != ticket and not self.broken:
+                self.turn.wait()
+            try:
+                if self.broken:
+                    raise OSError("C引擎进程已退出")
+                status = self.process.stdout.readline().decode('utf-8', errors='ignore').strip()
+                if not status:
+                    raise OSError("C引擎进程已退出")
+                if status.startswith("ERR "):
+                    raise RuntimeError(f"C引擎返回错误：{status}")
+                if not status.startswith("OK "):
+                    # 无法识别的状态行说明输出流已经错位，之后的响应都不可信
+                    raise ValueError(f"C引擎响应格式错误：{status}")
+                count = int(status[3:])
+                lines = []
+                for _ in range(count):
+                    line = self.process.stdout.readline()
+                    if not line.endswith(b'\n'):
+                        raise OSError("C引擎进程已退出")
+                    lines.append(line.decode('utf-8', errors='ignore').rstrip('\n'))
+                return lines
+            except (OSError, ValueError):
+                self.broken = True
+                raise
+            finally:
+                self.read += 1
+                self.turn.notify_all()
+
 
 class SearchEngineBridge:
     # def __init__(self, c_engine_path="../c_core/search_engine.exe", index_dir="../c_core/index_data"): 
@@ -13,6 +58,10 @@ class SearchEngineBridge:
         """
         self.c_engine_path = c_engine_path
         self.index_dir = index_dir
+        # 常驻引擎进程（search_engine serve），每个桥接器持有一个，HTTP服务的各请求线程共用；
+        # 引擎内部由多个工作线程并发执行查询，各线程连续发送请求（只在写入一帧时持锁），再按发送顺序读取响应
+        self._engine = None
+        self._engine_lock = threading.Lock()
         
         # 验证C引擎路径是否存在
         if not os.path.exists(self.c_engine_path):
@@ -55,78 +104,192 @@ class SearchEngineBridge:
             print(f"索引构建过程中发生错误：{str(e)}")
             return False
 
-    def search(self, query):
-        """调用C程序进行搜索（命令行模式）"""
-        if not query.strip():
-            print("查询词不能为空")
-            return []
+    def add_documents(self, doc_dir):
+        """增量添加：只索引目录中尚未收录的文档，写成一个新段（常驻引擎会自动切换到新的段集合）"""
+        doc_dir_abs = os.path.abspath(doc_dir)
+        if not os.path.exists(doc_dir_abs):
+            print(f"文档目录不存在：{doc_dir_abs}")
+            return False
         
         try:
-            # 调用C引擎的命令行搜索模式：search_engine.exe search "查询词"
             result = subprocess.run(
-                [self.c_engine_path, "search", query.strip()],
+                [self.c_engine_path, "add", doc_dir_abs],
                 capture_output=True,
                 text=True,
                 check=True,
                 encoding='utf-8',
                 errors='ignore'
             )
-            
-            stdout = result.stdout
-            stderr = result.stderr
-            
-            # 打印调试信息（可选）
-            print("=== C引擎原始输出 ===")
-            print(stdout)
-            if stderr:
-                print("=== C引擎错误输出 ===")
-                print(stderr)
-            
-            # 解析搜索结果
-            parsed_results = self._parse_search_results(stdout, query)
-            return parsed_results
+            print("=== 增量添加输出 ===")
+            print(result.stdout)
+            return True
+        except subprocess.CalledProcessError as e:
+            print(f"增量添加失败（返回码：{e.returncode}）：")
+            print(f"错误输出：{e.stderr}")
+            return False
+        except Exception as e:
+            print(f"增量添加过程中发生错误：{str(e)}")
+            return False
+
+    def _run_engine_command(self, args, action):
+        """执行一次引擎子命令并打印输出，成功返回True"""
+        try:
+            result = subprocess.run(
+                [self.c_engine_path] + args,
+                capture_output=True,
+                text=True,
+                check=True,
+                encoding='utf-8',
+                errors='ignore'
+            )
+            print(result.stdout)
+            return True
         except subprocess.CalledProcessError as e:
-            print(f"搜索失败（返回码：{e.returncode}）：")
+            print(f"{action}失败（返回码：{e.returncode}）：")
             print(f"错误输出：{e.stderr}")
+            return False
+        except Exception as e:
+            print(f"{action}过程中发生错误：{str(e)}")
+            return False
+
+    def delete_documents(self, doc_paths):
+        """按文档路径删除（路径与搜索结果中的一致），只写删除标记，不重建索引"""
+        return self._run_engine_command(["delete"] + list(doc_paths), "删除")
+
+    def update_documents(self, doc_paths):
+        """更新文档：删除旧版本并重新索引仍存在的文件（已不存在的文件即被删除）"""
+        paths = [os.path.abspath(path) for path in doc_paths]
+        return self._run_engine_command(["update"] + paths, "更新")
+
+    def _start_engine(self):
+        """启动常驻引擎进程并等待READY握手（打开查询统计，供/stats汇总各阶段耗时）"""
+        engine = subprocess.Popen(
+            [self.c_engine_path, "serve", "--stats"],
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE
+        )
+        ready = engine.stdout.readline().decode('utf-8', errors='ignore').strip()
+        if not ready.startswith("READY"):
+            error = engine.stderr.read().decode('utf-8', errors='ignore').strip()
+            engine.kill()
+            raise RuntimeError(f"C引擎启动失败：{error or ready}")
+        return engine
+
+    def _request(self, command, payload, limit=0, model=None):
+        """向常驻引擎发送一帧请求，返回结果行列表（引擎退出时自动重启一次）"""
+        data = payload.encode('utf-8')
+        if len(data) > MAX_PAYLOAD:
+            raise ValueError(f"请求负载过长（{len(data)}字节，上限{MAX_PAYLOAD}字节）")
+        header = f"{command} {len(data)} {limit}{' ' + model if model else ''}\n".encode('utf-8')
+        for attempt in range(2):
+            try:
+                with self._engine_lock:
+                    if self._engine is None or self._engine.broken or self._engine.process.poll() is not None:
+                        self._engine = _EngineProcess(self._start_engine())
+                    engine = self._engine
+                    try:
+                        engine.process.stdin.write(header + data)
+                        engine.process.stdin.flush()
+                    except OSError:
+                        engine.broken = True
+                        raise
+                    ticket = engine.sent
+                    engine.sent += 1
+                return engine.read_response(ticket)
+            except (OSError, ValueError):
+                if attempt == 1:
+                    raise
+
+    def close(self):
+        """关闭常驻引擎进程"""
+        with self._engine_lock:
+            if self._engine is not None and self._engine.process.poll() is None:
+                process = self._engine.process
+                try:
+                    process.stdin.write(b"quit 0\n")
+                    process.stdin.flush()
+                    process.wait(timeout=2)
+                except Exception:
+                    process.kill()
+            self._engine = None
+
+    def search(self, query, model=None):
+        """通过常驻引擎进行搜索（不再为每个请求启动新进程）；model为打分模型tfidf/bm25，None表示引擎默认"""
+        if not query.strip():
+            print("查询词不能为空")
             return []
+        
+        try:
+            lines = self._request("search", query.strip(), model=model)
+            return self._parse_search_results(lines)
         except Exception as e:
             print(f"搜索过程中出错：{str(e)}")
             return []
 
-    def _parse_search_results(self, output, query):
-        """解析C引擎的搜索输出"""
+    def suggest(self, prefix, limit=5):
+        """通过常驻引擎获取前缀建议词"""
+        prefix = prefix.strip()
+        if not prefix:
+            return []
+        try:
+            return [line for line in self._request("suggest", prefix, limit) if line]
+        except Exception as e:
+            print(f"获取建议过程中出错：{str(e)}")
+            return []
+
+    def cache_stats(self):
+        """常驻引擎查询结果缓存的计数器（名称→数值）"""
+        try:
+            stats = {}
+            for line in self._request("stats", ""):
+                name, _, value = line.partition(' ')
+                if value:
+                    stats[name] = int(value)
+            return stats
+        except Exception as e:
+            print(f"获取缓存统计过程中出错：{str(e)}")
+            return {}
+
+    def query_histograms(self):
+        """常驻引擎进程内各阶段查询耗时的直方图与计数器合计"""
+        try:
+            lines = self._request("histograms", "")
+            return json.loads(lines[0]) if lines else {}
+        except Exception as e:
+            print(f"获取查询统计过程中出错：{str(e)}")
+            return {}
+
+    def profile(self, query, model=None):
+        """不经过缓存执行一次搜索，返回这次查询的分阶段耗时与计数器"""
+        if not query.strip():
+            return {}
+        try:
+            lines = self._request("profile", query.strip(), model=model)
+            return json.loads(lines[0]) if lines else {}
+        except Exception as e:
+            print(f"分析查询过程中出错：{str(e)}")
+            return {}
+
+    def _parse_search_results(self, lines):
+        """解析常驻引擎返回的结果行（格式：分数\t文档路径）"""
         results = []
-        lines = [line.strip() for line in output.split('\n') if line.strip()]
-        
-        # 找到结果开始的行（匹配"找到 X 个结果："）
-        result_start_idx = -1
-        for idx, line in enumerate(lines):
-            if re.match(r'^找到 \d+ 个结果：$', line):
-                result_start_idx = idx + 1
-                break
-        
-        if result_start_idx == -1:
-            return results  # 无结果
-        
-        # 解析每个结果行（格式：1. 文档: 路径 (分数: 0.1234)）
-        result_pattern = re.compile(r'^(\d+)\. 文档: (.*?) \(分数: ([\d.]+)\)$')
-        for line in lines[result_start_idx:]:
-            match = result_pattern.match(line)
-            if match:
-                doc_path = match.group(2)
-                score = float(match.group(3))
-                
-                # 标准化文档路径（处理Windows/Linux斜杠差异）
-                doc_path_norm = os.path.normpath(doc_path)
-                
-                # 获取文档预览（最多200字符）
-                preview = self._get_document_preview(doc_path_norm)
-                
-                results.append({
-                    "doc_path": doc_path_norm,
-                    "score": score,
-                    "preview": preview
-                })
+        for line in lines:
+            score_text, _, doc_path = line.partition('\t')
+            if not doc_path:
+                continue
+            
+            # 标准化文档路径（处理Windows/Linux斜杠差异）
+            doc_path_norm = os.path.normpath(doc_path)
+            
+            # 获取文档预览（最多200字符）
+            preview = self._get_document_preview(doc_path_norm)
+            
+            results.append({
+                "doc_path": doc_path_norm,
+                "score": float(score_text),
+                "preview": preview
+            })
         
         return results
 
@@ -146,7 +309,7 @@ class SearchEngineBridge:
 
     def run_server(self, host="localhost", port=8000):
         """启动HTTP服务器，提供搜索和建议API（修复参数传递问题）"""
-        from http.server import BaseHTTPRequestHandler, HTTPServer
+        from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
         import urllib.parse
 
         # -------------------------- 核心修复：用类继承传递bridge参数 --------------------------
@@ -171,10 +334,14 @@ class SearchEngineBridge:
                 parsed_path = urllib.parse.urlparse(self.path)
                 query_params = urllib.parse.parse_qs(parsed_path.query)
 
-                # 1. 搜索API：/search?q=查询词
+                # 1. 搜索API：/search?q=查询词[&model=tfidf|bm25]
                 if parsed_path.path == '/search' and 'q' in query_params:
                     query = query_params['q'][0]
-                    results = self.bridge.search(query)  # 直接使用类属性bridge
+                    model = query_params.get('model', [None])[0]
+                    if model not in (None, 'tfidf', 'bm25'):
+                        self._send_json_response({"error": "model只支持tfidf或bm25"}, 400)
+                        return
+                    results = self.bridge.search(query, model)  # 直接使用类属性bridge
                     self._send_json_response(results)
                 
                 # 2. 建议API：/suggest?q=前缀（基于Trie的前缀匹配）
@@ -183,29 +350,33 @@ class SearchEngineBridge:
                     if len(prefix) < 2:
                         self._send_json_response([])
                         return
-                    suggestions = self._get_prefix_suggestions(prefix)
-                    self._send_json_response(suggestions[:5])  # 最多返回5个建议
+                    suggestions = self.bridge.suggest(prefix, limit=5)  # 最多返回5个建议
+                    self._send_json_response(suggestions)
                 
-                # 3. 无效API
+                # 3. 统计API：/stats（查询结果缓存的计数器，query为各阶段查询耗时的直方图）
+                elif parsed_path.path == '/stats':
+                    stats = self.bridge.cache_stats()
+                    stats["query"] = self.bridge.query_histograms()
+                    self._send_json_response(stats)
+
+                # 4. 查询分析API：/profile?q=查询词[&model=tfidf|bm25]（单次查询的分阶段耗时与计数器）
+                elif parsed_path.path == '/profile' and 'q' in query_params:
+                    model = query_params.get('model', [None])[0]
+                    if model not in (None, 'tfidf', 'bm25'):
+                        self._send_json_response({"error": "model只支持tfidf或bm25"}, 400)
+                        return
+                    self._send_json_response(self.bridge.profile(query_params['q'][0], model))
+
+                # 5. 无效API
                 else:
-                    self._send_json_response({"error": "无效API路径，支持/search和/suggest"}, 404)
-
-            def _get_prefix_suggestions(self, prefix):
-                """简化的前缀建议：从搜索结果中提取以prefix开头的词"""
-                suggestions = set()
-                results = self.bridge.search(prefix)
-                for res in results:
-                    words = re.findall(r'\b[a-z]+\b', res['preview'].lower())
-                    for word in words:
-                        if word.startswith(prefix.lower()) and len(word) > len(prefix):
-                            suggestions.add(word)
-                suggestions.add(prefix.lower())
-                return sorted(suggestions)
+                    self._send_json_response({"error": "无效API路径，支持/search、/suggest、/stats和/profile"}, 404)
 
         # -------------------------- 修复服务器初始化：直接传递Handler类 --------------------------
         # 不再用lambda，直接传递SearchServerHandler类（类属性已绑定bridge）
         server_address = (host, port)
-        httpd = HTTPServer(server_address, SearchServerHandler)
+        # 每个HTTP请求一个线程，并发的查询经同一个引擎进程的流水线交给引擎的工作线程执行
+        httpd = ThreadingHTTPServer(server_address, SearchServerHandler)
+        httpd.daemon_threads = True
 
         print(f"=== 搜索服务器启动 ===")
         print(f"地址：http://{host}:{port}")
@@ -217,14 +388,20 @@ class SearchEngineBridge:
             httpd.serve_forever()
         except KeyboardInterrupt:
             print("\n=== 服务器正在关闭 ===")
-            httpd.shutdown()
+            httpd.server_close()
+        finally:
+            self.close()
 
 if __name__ == "__main__":
     import argparse
 
     parser = argparse.ArgumentParser(description='C-Python前端桥接程序（搜索引擎）')
     parser.add_argument('--build-index', help='构建索引的文档目录（绝对路径或相对当前目录）')
+    parser.add_argument('--add-docs', help='增量添加文档目录中尚未收录的文档（写成新段，后台自动合并）')
+    parser.add_argument('--delete-docs', nargs='+', help='按路径删除文档（路径与搜索结果中的一致）')
+    parser.add_argument('--update-docs', nargs='+', help='按路径更新文档（文件已不存在时即删除）')
     parser.add_argument('--search', help='测试搜索：--search "查询词"')
+    parser.add_argument('--model', choices=['tfidf', 'bm25'], help='测试搜索使用的打分模型（默认tfidf）')
     parser.add_argument('--server', action='store_true', help='启动HTTP服务器（默认localhost:8000）')
     parser.add_argument('--host', default='localhost', help='服务器主机（默认localhost）')
     parser.add_argument('--port', type=int, default=8000, help='服务器端口（默认8000）')
@@ -242,11 +419,25 @@ if __name__ == "__main__":
             success = bridge.build_index(doc_dir)
             print("索引构建成功！" if success else "索引构建失败！")
         
+        # 增量添加
+        elif args.add_docs:
+            print(f"开始增量添加，文档目录：{args.add_docs}")
+            success = bridge.add_documents(args.add_docs)
+            print("增量添加成功！" if success else "增量添加失败！")
+        
+        # 删除/更新文档
+        elif args.delete_docs:
+            success = bridge.delete_documents(args.delete_docs)
+            print("删除成功！" if success else "删除失败！")
+        elif args.update_docs:
+            success = bridge.update_documents(args.update_docs)
+            print("更新成功！" if success else "更新失败！")
+        
         # 模式2：测试搜索
         elif args.search:
             query = args.search
             print(f"测试搜索：{query}")
-            results = bridge.search(query)
+            results = bridge.search(query, args.model)
             if results:
                 print(f"\n找到 {len(results)} 个结果：")
                 for i, res in enumerate(results, 1):
@@ -263,5 +454,7 @@ if __name__ == "__main__":
         # 无参数：显示帮助
         else:
             parser.print_help()
+
+        bridge.close()
     except Exception as e:
         print(f"程序初始化失败：{str(e)}")
\ No newline at end of file